@@ -0,0 +1,261 @@
+#include <err.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "aot_runtime.h"
+#include "cmonkey_utils.h"
+
+monkey_object_t *aot_top;
+
+/* frames on the call stack, the top level counts as one like in the VM */
+static size_t frame_count = 1;
+
+void
+aot_error(const char *s, ...)
+{
+    va_list ap;
+    va_start(ap, s);
+    printf("VM Error: ");
+    vprintf(s, ap);
+    printf("\n");
+    va_end(ap);
+    exit(EXIT_SUCCESS);
+}
+
+void
+aot_stack_overflow(void)
+{
+    aot_error("Stackoverflow error: execeeded max stack size of %d", STACKSIZE);
+}
+
+/* the program has finished, print its result like monkeyvm */
+void
+aot_finish(void)
+{
+    if (aot_top != NULL && get_monkey_object_type(aot_top) != MONKEY_NULL) {
+        char *s = inspect(aot_top);
+        printf("%s\n", s);
+        free(s);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+static monkey_object_t *
+binary_int_op(opcode_t op, long left, long right)
+{
+    opcode_definition_t op_def;
+    switch (op) {
+    case OPADD:
+        return create_monkey_int_object(left + right);
+    case OPSUB:
+        return create_monkey_int_object(left - right);
+    case OPMUL:
+        return create_monkey_int_object(left * right);
+    case OPDIV:
+        return create_monkey_int_object(left / right);
+    default:
+        op_def = opcode_definition_lookup(op);
+        aot_error("opcode %s not supported for integer operands", op_def.name);
+    }
+}
+
+static monkey_object_t *
+binary_string_op(opcode_t op, monkey_string_t *left, monkey_string_t *right)
+{
+    opcode_definition_t op_def;
+    if (op != OPADD) {
+        op_def = opcode_definition_lookup(op);
+        aot_error("opcode %s not support for string operands", op_def.name);
+    }
+    return (monkey_object_t *) concat_monkey_strings(left, right);
+}
+
+monkey_object_t *
+aot_binary_op(opcode_t op, monkey_object_t *left, monkey_object_t *right)
+{
+    monkey_object_type left_type = get_monkey_object_type(left);
+    monkey_object_type right_type = get_monkey_object_type(right);
+    monkey_object_t *result;
+    opcode_definition_t op_def;
+    if (left_type == MONKEY_INT && right_type == MONKEY_INT)
+        result = binary_int_op(op, get_monkey_int_value(left), get_monkey_int_value(right));
+    else if (left_type == MONKEY_STRING && right_type == MONKEY_STRING)
+        result = binary_string_op(op, (monkey_string_t *) left, (monkey_string_t *) right);
+    else {
+        op_def = opcode_definition_lookup(op);
+        aot_error("'%s' operation not supported with types %s and %s",
+            op_def.desc, get_type_name(left_type), get_type_name(right_type));
+    }
+    aot_release(left);
+    aot_release(right);
+    return result;
+}
+
+monkey_object_t *
+aot_comparison_op(opcode_t op, monkey_object_t *left, monkey_object_t *right)
+{
+    monkey_object_type left_type = get_monkey_object_type(left);
+    monkey_object_type right_type = get_monkey_object_type(right);
+    _Bool result;
+    opcode_definition_t op_def;
+    if (left_type == MONKEY_INT && right_type == MONKEY_INT) {
+        long leftval = get_monkey_int_value(left);
+        long rightval = get_monkey_int_value(right);
+        switch (op) {
+        case OPGREATERTHAN:
+            result = leftval > rightval;
+            break;
+        case OPEQUAL:
+            result = leftval == rightval;
+            break;
+        case OPNOTEQUAL:
+            result = leftval != rightval;
+            break;
+        default:
+            op_def = opcode_definition_lookup(op);
+            aot_error("Unsupported opcode %s for integer operands", op_def.name);
+        }
+    } else if (left_type == MONKEY_BOOL && right_type == MONKEY_BOOL) {
+        switch (op) {
+        case OPGREATERTHAN:
+            result = false;
+            break;
+        case OPEQUAL:
+            result = left == right;
+            break;
+        case OPNOTEQUAL:
+            result = left != right;
+            break;
+        default:
+            op_def = opcode_definition_lookup(op);
+            aot_error("Unsupported opcode %s", op_def.name);
+        }
+    } else {
+        aot_error("Unsupported operand types %s and %s",
+            get_type_name(left_type), get_type_name(right_type));
+    }
+    aot_release(left);
+    aot_release(right);
+    return (monkey_object_t *) create_monkey_bool(result);
+}
+
+monkey_object_t *
+aot_minus(monkey_object_t *operand)
+{
+    if (get_monkey_object_type(operand) != MONKEY_INT)
+        aot_error("'-' operator not supported for %s type operands",
+            get_type_name(get_monkey_object_type(operand)));
+    monkey_object_t *result = create_monkey_int_object(-get_monkey_int_value(operand));
+    aot_release(operand);
+    return result;
+}
+
+monkey_object_t *
+aot_bang(monkey_object_t *operand)
+{
+    monkey_object_type operand_type = get_monkey_object_type(operand);
+    if (operand_type != MONKEY_BOOL && operand_type != MONKEY_NULL)
+        aot_error("'!' operator not supported for %s type operands",
+            get_type_name(operand_type));
+    return (monkey_object_t *) create_monkey_bool(!aot_is_truthy(operand));
+}
+
+monkey_object_t *
+aot_index(monkey_object_t *left, monkey_object_t *index)
+{
+    monkey_object_type left_type = get_monkey_object_type(left);
+    monkey_object_t *result = NULL;
+    if (left_type == MONKEY_ARRAY) {
+        monkey_array_t *array = (monkey_array_t *) left;
+        if (get_monkey_object_type(index) != MONKEY_INT)
+            aot_error("unsupported index operator type %s for array object",
+                get_type_name(get_monkey_object_type(index)));
+        long i = get_monkey_int_value(index);
+        if (i >= 0 && i < get_monkey_array_length(array))
+            result = aot_retain(get_monkey_array_element(array, i));
+    } else if (left_type == MONKEY_HASH) {
+        result = aot_retain(cm_hash_table_get(((monkey_hash_t *) left)->pairs, index));
+    } else {
+        aot_error("index operator not supported for %s", get_type_name(left_type));
+    }
+    if (result == NULL)
+        result = (monkey_object_t *) create_monkey_null();
+    aot_release(left);
+    aot_release(index);
+    return result;
+}
+
+monkey_object_t *
+aot_slice(monkey_object_t *left, monkey_object_t *start, monkey_object_t *end)
+{
+    monkey_object_t *result = slice_monkey_object(left, start, end);
+    if (result == NULL)
+        aot_error("slice operator not supported for %s[%s:%s]",
+            get_type_name(get_monkey_object_type(left)),
+            get_type_name(get_monkey_object_type(start)),
+            get_type_name(get_monkey_object_type(end)));
+    aot_release(left);
+    aot_release(start);
+    aot_release(end);
+    return result;
+}
+
+monkey_object_t *
+aot_array(size_t count, monkey_object_t **elements)
+{
+    cm_array_list *list = cm_array_list_init(count, release_monkey_object);
+    for (size_t i = 0; i < count; i++)
+        cm_array_list_add(list, elements[i]);
+    return (monkey_object_t *) create_monkey_array(list);
+}
+
+monkey_object_t *
+aot_hash(size_t count, monkey_object_t **elements)
+{
+    cm_hash_table *table = cm_hash_table_init(monkey_object_hash,
+        monkey_object_equals, release_monkey_object, release_monkey_object);
+    for (size_t i = 0; i < count; i += 2)
+        cm_hash_table_put(table, elements[i], elements[i + 1]);
+    return (monkey_object_t *) create_monkey_hash(table);
+}
+
+/*
+ * Calls callee with the arguments, whose references it consumes. bp is
+ * where the VM would have put the first argument on its stack.
+ */
+monkey_object_t *
+aot_call(monkey_object_t *callee, size_t num_args, monkey_object_t **args, size_t bp)
+{
+    monkey_object_t *result;
+    aot_function_t *fn;
+    cm_list *arg_list;
+
+    switch (get_monkey_object_type(callee)) {
+    case MONKEY_COMPILED_FUNCTION:
+        fn = (aot_function_t *) callee;
+        if (fn->fn.num_args != num_args)
+            aot_error("wrong number of arguments: want=%zu, got=%zu", fn->fn.num_args, num_args);
+        if (frame_count >= MAX_FRAMES)
+            aot_error("Stackoverflow error: exceeded max call depth of %d", MAX_FRAMES);
+        if (bp + fn->fn.num_locals >= STACKSIZE)
+            aot_error("Stackoverflow error: execeeded max stack size of %d", STACKSIZE);
+        frame_count++;
+        result = fn->entry(args, bp);
+        frame_count--;
+        break;
+    case MONKEY_BUILTIN:
+        arg_list = cm_list_init();
+        for (size_t i = 0; i < num_args; i++)
+            cm_list_add(arg_list, args[i]);
+        result = ((monkey_builtin_t *) callee)->function(arg_list);
+        cm_list_free(arg_list, NULL);
+        for (size_t i = 0; i < num_args; i++)
+            aot_release(args[i]);
+        break;
+    default:
+        aot_error("Calling non-function\n");
+    }
+    aot_release(callee);
+    return result;
+}
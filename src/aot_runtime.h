@@ -0,0 +1,158 @@
+#ifndef AOT_RUNTIME_H
+#define AOT_RUNTIME_H
+
+#include <limits.h>
+#include <stdlib.h>
+#include "builtins.h"
+#include "object.h"
+#include "opcode.h"
+#include "vm.h"
+
+/*
+ * Runtime of programs compiled to C by monkeyc. Every compiled function
+ * becomes a C function which keeps the operand stack and its locals in C
+ * variables, the operations below implement the instructions on them with
+ * the same refcounting and errors as vm_run. The fast paths for immediate
+ * ints are inline so that the C compiler can optimise numeric code, the
+ * rest lives in aot_runtime.c. Errors end the program like they end
+ * monkeyvm.
+ */
+
+typedef monkey_object_t *(*aot_entry_t)(monkey_object_t **, size_t);
+
+/*
+ * A compiled function value. Its entry receives the arguments, whose
+ * references it takes over, and the stack position the VM would use as
+ * the frame's base pointer, for the stack overflow checks.
+ */
+typedef struct aot_function_t {
+    monkey_compiled_fn_t fn;
+    aot_entry_t entry;
+} aot_function_t;
+
+#define AOT_FUNCTION(entry, num_locals, num_args) {                         \
+    {{MONKEY_COMPILED_FUNCTION, 0, MONKEY_REFCOUNT_IMMORTAL},               \
+        NULL, (num_locals), (num_args), NULL},                              \
+    (entry)                                                                 \
+}
+
+/* the last popped value, printed at the end like monkeyvm does */
+extern monkey_object_t *aot_top;
+
+void aot_error(const char *, ...) __attribute__((noreturn));
+void aot_stack_overflow(void) __attribute__((noreturn));
+void aot_finish(void) __attribute__((noreturn));
+monkey_object_t *aot_binary_op(opcode_t, monkey_object_t *, monkey_object_t *);
+monkey_object_t *aot_comparison_op(opcode_t, monkey_object_t *, monkey_object_t *);
+monkey_object_t *aot_minus(monkey_object_t *);
+monkey_object_t *aot_bang(monkey_object_t *);
+monkey_object_t *aot_index(monkey_object_t *, monkey_object_t *);
+monkey_object_t *aot_slice(monkey_object_t *, monkey_object_t *, monkey_object_t *);
+monkey_object_t *aot_array(size_t, monkey_object_t **);
+monkey_object_t *aot_hash(size_t, monkey_object_t **);
+monkey_object_t *aot_call(monkey_object_t *, size_t, monkey_object_t **, size_t);
+
+#define AOT_CHECK_STACK(sp) do {            \
+    if ((sp) >= STACKSIZE)                  \
+        aot_stack_overflow();               \
+} while (0)
+
+static inline monkey_object_t *
+aot_retain(monkey_object_t *obj)
+{
+    if (obj != NULL && !is_immediate_int(obj) && obj->refcount != MONKEY_REFCOUNT_IMMORTAL)
+        obj->refcount++;
+    return obj;
+}
+
+static inline void
+aot_release(monkey_object_t *obj)
+{
+    if (obj != NULL && !is_immediate_int(obj) && obj->refcount != MONKEY_REFCOUNT_IMMORTAL)
+        release_monkey_object(obj);
+}
+
+static inline void
+aot_pop_top(monkey_object_t *obj)
+{
+    aot_release(aot_top);
+    aot_top = obj;
+}
+
+static inline _Bool
+aot_is_truthy(monkey_object_t *obj)
+{
+    switch (get_monkey_object_type(obj)) {
+    case MONKEY_BOOL:
+        return ((monkey_bool_t *) obj)->value;
+    case MONKEY_NULL:
+        return false;
+    default:
+        return true;
+    }
+}
+
+static inline monkey_object_t *
+aot_int(long value)
+{
+    if (value >= MONKEY_IMMEDIATE_MIN && value <= MONKEY_IMMEDIATE_MAX)
+        return create_monkey_immediate_int(value);
+    return create_monkey_int_object(value);
+}
+
+#define aot_both_immediate(left, right) \
+    ((((uintptr_t) (left)) & ((uintptr_t) (right)) & MONKEY_IMMEDIATE_TAG) != 0)
+
+/* the sum or difference of two immediates does not overflow a long */
+static inline monkey_object_t *
+aot_add(monkey_object_t *left, monkey_object_t *right)
+{
+    if (aot_both_immediate(left, right))
+        return aot_int(get_monkey_int_value(left) + get_monkey_int_value(right));
+    return aot_binary_op(OPADD, left, right);
+}
+
+static inline monkey_object_t *
+aot_sub(monkey_object_t *left, monkey_object_t *right)
+{
+    if (aot_both_immediate(left, right))
+        return aot_int(get_monkey_int_value(left) - get_monkey_int_value(right));
+    return aot_binary_op(OPSUB, left, right);
+}
+
+/* overflows like the VM's multiplication */
+static inline monkey_object_t *
+aot_mul(monkey_object_t *left, monkey_object_t *right)
+{
+    if (aot_both_immediate(left, right))
+        return aot_int(get_monkey_int_value(left) * get_monkey_int_value(right));
+    return aot_binary_op(OPMUL, left, right);
+}
+
+static inline monkey_object_t *
+aot_greater_than(monkey_object_t *left, monkey_object_t *right)
+{
+    if (aot_both_immediate(left, right))
+        return (monkey_object_t *) create_monkey_bool(
+            (get_monkey_int_value(left) > get_monkey_int_value(right)));
+    return aot_comparison_op(OPGREATERTHAN, left, right);
+}
+
+/* immediates with equal values are identical pointers */
+static inline monkey_object_t *
+aot_equal(monkey_object_t *left, monkey_object_t *right)
+{
+    if (aot_both_immediate(left, right))
+        return (monkey_object_t *) create_monkey_bool((left == right));
+    return aot_comparison_op(OPEQUAL, left, right);
+}
+
+static inline monkey_object_t *
+aot_not_equal(monkey_object_t *left, monkey_object_t *right)
+{
+    if (aot_both_immediate(left, right))
+        return (monkey_object_t *) create_monkey_bool((left != right));
+    return aot_comparison_op(OPNOTEQUAL, left, right);
+}
+
+#endif
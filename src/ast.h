@@ -69,7 +69,8 @@ typedef enum expression_type_t {
     ARRAY_LITERAL,
     INDEX_EXPRESSION,
     HASH_LITERAL,
-    WHILE_EXPRESSION
+    WHILE_EXPRESSION,
+    SLICE_EXPRESSION
 } expression_type_t;
 
 static const char *expression_type_values[] = {
@@ -85,9 +86,29 @@ static const char *expression_type_values[] = {
     "ARRAY_LITERAL",
     "INDEX_EXPRESSION",
     "HASH_LITERAL",
-    "WHILE_EXPRESSION"
+    "WHILE_EXPRESSION",
+    "SLICE_EXPRESSION"
 };
 
+/* the operator of a prefix or infix expression, which the parser sets */
+typedef enum operator_t {
+    OPERATOR_PLUS,
+    OPERATOR_MINUS,
+    OPERATOR_BANG,
+    OPERATOR_MULTIPLY,
+    OPERATOR_DIVIDE,
+    OPERATOR_MODULO,
+    OPERATOR_LESS_THAN,
+    OPERATOR_GREATER_THAN,
+    OPERATOR_EQUAL,
+    OPERATOR_NOT_EQUAL,
+    OPERATOR_AND,
+    OPERATOR_OR
+} operator_t;
+
+/* the text of each operator, by operator_t */
+extern const char *operator_values[];
+
 typedef struct node_t {
     node_type_t type;
     char * (*token_literal) (void *); // return token literal for the node
@@ -115,6 +136,8 @@ typedef struct identifier_t {
     expression_t expression;
     token_t *token;
     char *value;
+    size_t depth;   // environments out from the current one, set by the resolver
+    size_t slot;    // in that environment, set by the resolver
 } identifier_t;
 
 typedef struct integer_t {
@@ -135,6 +158,7 @@ typedef struct prefix_expression_t {
     token_t *token;
     expression_t *right;
     char *operator;
+    operator_t op;
 } prefix_expression_t;
 
 typedef struct infix_expression_t {
@@ -143,6 +167,7 @@ typedef struct infix_expression_t {
     expression_t *left;
     expression_t *right;
     char *operator;
+    operator_t op;
 } infix_expression_t;
 
 typedef struct letstatement_t {
@@ -198,6 +223,7 @@ typedef struct function_literal_t {
     token_t *token;
     cm_list *parameters;
     block_statement_t *body;
+    size_t nslots;  // parameters and lets of the function, set by the resolver
 } function_literal_t;
 
 typedef struct call_expression_t {
@@ -220,6 +246,15 @@ typedef struct index_expression_t {
     expression_t *index;
 } index_expression_t;
 
+/* left[start:end], either bound may be left out and is NULL then */
+typedef struct slice_expression_t {
+    expression_t expression;
+    token_t *token;
+    expression_t *left;
+    expression_t *start;
+    expression_t *end;
+} slice_expression_t;
+
 typedef struct hash_literal_t {
     expression_t expression;
     token_t *token;
@@ -49,21 +49,14 @@ static monkey_object_t *rest(cm_list *);
 static monkey_object_t *push(cm_list *);
 static monkey_object_t *monkey_puts(cm_list *); //puts is a C function
 static monkey_object_t *type(cm_list *);
-static char * builtin_inspect(monkey_object_t *);
 
-const monkey_builtin_t BUILTIN_LEN = {{MONKEY_BUILTIN, builtin_inspect}, len};
-const monkey_builtin_t BUILTIN_FIRST = {{MONKEY_BUILTIN, builtin_inspect}, first};
-const monkey_builtin_t BUILTIN_LAST = {{MONKEY_BUILTIN, builtin_inspect}, last};
-const monkey_builtin_t BUILTIN_REST = {{MONKEY_BUILTIN, builtin_inspect}, rest};
-const monkey_builtin_t BUILTIN_PUSH = {{MONKEY_BUILTIN, builtin_inspect}, push};
-const monkey_builtin_t BUILTIN_PUTS = {{MONKEY_BUILTIN, builtin_inspect}, monkey_puts};
-const monkey_builtin_t BUILTIN_TYPE = {{MONKEY_BUILTIN, builtin_inspect}, type};
-
-static char *
-builtin_inspect(monkey_object_t *object)
-{
-    return "builtin function";
-}
+const monkey_builtin_t BUILTIN_LEN = {{MONKEY_BUILTIN, 0, MONKEY_REFCOUNT_IMMORTAL}, len};
+const monkey_builtin_t BUILTIN_FIRST = {{MONKEY_BUILTIN, 0, MONKEY_REFCOUNT_IMMORTAL}, first};
+const monkey_builtin_t BUILTIN_LAST = {{MONKEY_BUILTIN, 0, MONKEY_REFCOUNT_IMMORTAL}, last};
+const monkey_builtin_t BUILTIN_REST = {{MONKEY_BUILTIN, 0, MONKEY_REFCOUNT_IMMORTAL}, rest};
+const monkey_builtin_t BUILTIN_PUSH = {{MONKEY_BUILTIN, 0, MONKEY_REFCOUNT_IMMORTAL}, push};
+const monkey_builtin_t BUILTIN_PUTS = {{MONKEY_BUILTIN, 0, MONKEY_REFCOUNT_IMMORTAL}, monkey_puts};
+const monkey_builtin_t BUILTIN_TYPE = {{MONKEY_BUILTIN, 0, MONKEY_REFCOUNT_IMMORTAL}, type};
 
 static monkey_object_t *
 monkey_puts(cm_list *arguments)
@@ -74,7 +67,7 @@ monkey_puts(cm_list *arguments)
     while (node != NULL) {
         arg = (monkey_object_t *) node->data;
         node = node->next;
-        s = arg->inspect(arg);
+        s = inspect(arg);
         printf("%s\n", s);
         free(s);
     }
@@ -92,7 +85,7 @@ type(cm_list *arguments)
     }
 
     arg = (monkey_object_t *) arguments->head->data;
-    const char *typename = get_type_name(arg->type);
+    const char *typename = get_type_name(get_monkey_object_type(arg));
     return (monkey_object_t *) create_monkey_string(typename, strlen(typename));
 }
 
@@ -108,19 +101,20 @@ len(cm_list *arguments)
     }
 
     monkey_object_t *arg = (monkey_object_t *) arguments->head->data;
-    switch (arg->type) {
+    switch (get_monkey_object_type(arg)) {
         case MONKEY_STRING:
             str = (monkey_string_t *) arg;
             return (monkey_object_t *) create_monkey_int(str->length);
         case MONKEY_ARRAY:
             array = (monkey_array_t *) arg;
-            return (monkey_object_t *) create_monkey_int(array->elements->length);
+            return (monkey_object_t *) create_monkey_int(get_monkey_array_length(array));
         case MONKEY_HASH:
             hash_obj = (monkey_hash_t *) arg;
             return (monkey_object_t *) create_monkey_int(hash_obj->pairs->nkeys);
         default:
             return (monkey_object_t *) create_monkey_error(
-                "argument to `len` not supported, got %s", get_type_name(arg->type));
+                "argument to `len` not supported, got %s",
+                get_type_name(get_monkey_object_type(arg)));
     }
 }
 
@@ -135,13 +129,14 @@ first(cm_list *arguments)
     }
 
     monkey_object_t *arg = (monkey_object_t *) arguments->head->data;
-    if (arg->type != MONKEY_ARRAY) {
+    if (get_monkey_object_type(arg) != MONKEY_ARRAY) {
         return (monkey_object_t *) create_monkey_error(
-            "argument to `first` must be ARRAY, got %s", get_type_name(arg->type));
+            "argument to `first` must be ARRAY, got %s",
+            get_type_name(get_monkey_object_type(arg)));
     }
     array = (monkey_array_t *) arg;
-    if (array->elements->length > 0)
-        return copy_monkey_object(array->elements->array[0]);
+    if (get_monkey_array_length(array) > 0)
+        return retain_monkey_object(get_monkey_array_element(array, 0));
     else
         return (monkey_object_t *) create_monkey_null();
 }
@@ -157,25 +152,27 @@ last(cm_list *arguments)
     }
 
     monkey_object_t *arg = (monkey_object_t *) arguments->head->data;
-    if (arg->type != MONKEY_ARRAY) {
+    if (get_monkey_object_type(arg) != MONKEY_ARRAY) {
         return (monkey_object_t *) create_monkey_error(
-            "argument to `last` must be ARRAY, got %s", get_type_name(arg->type)
+            "argument to `last` must be ARRAY, got %s", get_type_name(get_monkey_object_type(arg))
         );
     }
 
     array = (monkey_array_t *) arg;
-    if (array->elements->length > 0)
-        return (monkey_object_t *) copy_monkey_object(cm_array_list_last(array->elements));
+    if (get_monkey_array_length(array) > 0)
+        return retain_monkey_object(
+            get_monkey_array_element(array, get_monkey_array_length(array) - 1));
     else
         return (monkey_object_t *) create_monkey_null();
 
 }
 
+/* a slice sharing the elements or bytes of its argument, not a copy */
 static monkey_object_t *
 rest(cm_list *arguments)
 {
     monkey_array_t *array;
-    cm_array_list *rest_elements;
+    monkey_string_t *str;
 
     if (arguments->length != 1) {
         return (monkey_object_t *)
@@ -184,32 +181,30 @@ rest(cm_list *arguments)
     }
 
     monkey_object_t *arg = (monkey_object_t *) arguments->head->data;
-    if (arg->type != MONKEY_ARRAY) {
-        return (monkey_object_t *) create_monkey_error("argument to `rest` must be ARRAY, got %s",
-        get_type_name(arg->type));
-    }
-
-    array = (monkey_array_t *) arg;
-
-    if (array->elements->length == 0) {
-        return (monkey_object_t *) create_monkey_null();
-    }
-
-    rest_elements = cm_array_list_init(array->elements->length, &free_monkey_object);
-    for (size_t i = 1; i < array->elements->length; i++) {
-        monkey_object_t *obj = copy_monkey_object(array->elements->array[i]);
-        cm_array_list_add(rest_elements, obj);
+    switch (get_monkey_object_type(arg)) {
+        case MONKEY_ARRAY:
+            array = (monkey_array_t *) arg;
+            if (get_monkey_array_length(array) == 0)
+                return (monkey_object_t *) create_monkey_null();
+            return (monkey_object_t *) create_monkey_array_slice(array, 1,
+                get_monkey_array_length(array));
+        case MONKEY_STRING:
+            str = (monkey_string_t *) arg;
+            if (str->length == 0)
+                return (monkey_object_t *) create_monkey_null();
+            return (monkey_object_t *) create_monkey_string_slice(str, 1, str->length);
+        default:
+            return (monkey_object_t *) create_monkey_error(
+                "argument to `rest` must be ARRAY or STRING, got %s",
+                get_type_name(get_monkey_object_type(arg)));
     }
-    monkey_array_t *rest_array = create_monkey_array(rest_elements);
-    return (monkey_object_t *) rest_array;
 }
 
+/* a new array sharing the elements of its argument, see push_monkey_array() */
 static monkey_object_t *
 push(cm_list *arguments)
 {
     monkey_array_t *array;
-    monkey_array_t *new_array;
-    cm_array_list *new_list_elements;
     monkey_object_t *obj;
 
     if (arguments->length != 2) {
@@ -219,23 +214,15 @@ push(cm_list *arguments)
     }
 
     monkey_object_t *arg = (monkey_object_t *) arguments->head->data;
-    if (arg->type != MONKEY_ARRAY) {
+    if (get_monkey_object_type(arg) != MONKEY_ARRAY) {
         return (monkey_object_t *)
             create_monkey_error("argument to `push` must be ARRAY, got %s",
-            get_type_name(arg->type));
+            get_type_name(get_monkey_object_type(arg)));
     }
 
     array = (monkey_array_t *) arg;
-    new_list_elements = cm_array_list_init(arguments->length + 1, free_monkey_object);
-    for (size_t i = 0; i < array->elements->length; i++) {
-        obj = copy_monkey_object(array->elements->array[i]);
-        cm_array_list_add(new_list_elements, obj);
-    }
-
     obj = (monkey_object_t *) arguments->head->next->data;
-    cm_array_list_add(new_list_elements, copy_monkey_object(obj));
-    new_array = create_monkey_array(new_list_elements);
-    return (monkey_object_t *) new_array;
+    return (monkey_object_t *) push_monkey_array(array, obj);
 }
 
 monkey_builtin_t *
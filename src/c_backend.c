@@ -0,0 +1,652 @@
+#include <err.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtins.h"
+#include "c_backend.h"
+#include "object.h"
+#include "opcode.h"
+
+#define UNKNOWN_DEPTH SIZE_MAX
+#define MAIN_FUNCTION SIZE_MAX
+
+/*
+ * The top level of a program is split into functions of about this many
+ * instructions. C compilers take much longer than linear time to optimise
+ * one long function, so long programs would otherwise take minutes to build.
+ */
+#define MAIN_CHUNK_LENGTH 128
+
+/*
+ * The bytecode compiler produces code in which the operand stack has the
+ * same depth whenever an instruction executes, however it was reached. So
+ * every stack slot can become a C variable: s0 is the bottom of the
+ * function's operand stack, the locals are l0, l1, ...
+ */
+typedef struct c_function_t {
+    decoded_instructions_t *code;
+    size_t *depths;     // operand stack depth before each instruction
+    _Bool *targets;     // instructions which need a label
+    size_t max_depth;
+    size_t num_locals;
+    size_t num_args;
+    size_t index;       // in the constants pool or MAIN_FUNCTION
+} c_function_t;
+
+static size_t
+get_operand_count(size_t op)
+{
+    size_t count = 0;
+    opcode_definition_t op_def = opcode_definition_lookup(op);
+    while (count < MAX_OPERANDS && op_def.operand_widths[count] != 0)
+        count++;
+    return count;
+}
+
+/* how many values the instruction pops and pushes */
+static void
+get_stack_effect(size_t *words, size_t *npop, size_t *npush)
+{
+    *npop = 0;
+    *npush = 0;
+    switch (words[0]) {
+    case OPCONSTANT:
+    case OPTRUE:
+    case OPFALSE:
+    case OPNULL:
+    case OPGETGLOBAL:
+    case OPGETLOCAL:
+    case OPGETBUILTIN:
+    case OPADDLOCALS:
+    case OPADDLOCALCONSTANT:
+    case OPSUBLOCALCONSTANT:
+        *npush = 1;
+        break;
+    case OPGETLOCAL2:
+    case OPGETLOCALCONSTANT:
+        *npush = 2;
+        break;
+    case OPADD:
+    case OPSUB:
+    case OPMUL:
+    case OPDIV:
+    case OPEQUAL:
+    case OPNOTEQUAL:
+    case OPGREATERTHAN:
+    case OPINDEX:
+        *npop = 2;
+        *npush = 1;
+        break;
+    case OPMINUS:
+    case OPBANG:
+        *npop = 1;
+        *npush = 1;
+        break;
+    case OPSLICE:
+        *npop = 3;
+        *npush = 1;
+        break;
+    case OPPOP:
+    case OPJMPFALSE:
+    case OPSETGLOBAL:
+    case OPSETLOCAL:
+    case OPRETURNVALUE:
+        *npop = 1;
+        break;
+    case OPGREATERTHANJMPFALSE:
+    case OPEQUALJMPFALSE:
+        *npop = 2;
+        break;
+    case OPARRAY:
+    case OPHASH:
+        *npop = words[1];
+        *npush = 1;
+        break;
+    case OPCALL:
+        *npop = words[1] + 1;
+        *npush = 1;
+        break;
+    }
+}
+
+static _Bool
+falls_through(size_t op)
+{
+    return op != OPJMP && op != OPRETURNVALUE && op != OPRETURN;
+}
+
+static void
+set_depth(c_function_t *function, size_t ip, size_t depth, size_t *worklist, size_t *nwork)
+{
+    if (function->depths[ip] == UNKNOWN_DEPTH) {
+        function->depths[ip] = depth;
+        worklist[(*nwork)++] = ip;
+    } else if (function->depths[ip] != depth) {
+        errx(EXIT_FAILURE, "inconsistent stack depth at instruction %zu", ip);
+    }
+}
+
+/* computes the stack depth at every reachable instruction */
+static void
+analyze_function(c_function_t *function)
+{
+    size_t length = function->code->length;
+    size_t *words = function->code->words;
+    size_t *worklist, nwork = 0;
+    size_t ip, depth, npop, npush, next_ip;
+
+    function->depths = malloc(sizeof(*function->depths) * (length + 1));
+    function->targets = calloc(length + 1, sizeof(*function->targets));
+    worklist = malloc(sizeof(*worklist) * (length + 1));
+    if (function->depths == NULL || function->targets == NULL || worklist == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    for (ip = 0; ip <= length; ip++)
+        function->depths[ip] = UNKNOWN_DEPTH;
+    function->max_depth = 0;
+    set_depth(function, 0, 0, worklist, &nwork);
+    while (nwork > 0) {
+        ip = worklist[--nwork];
+        depth = function->depths[ip];
+        if (ip == length)
+            continue;
+        get_stack_effect(words + ip, &npop, &npush);
+        if (npop > depth)
+            errx(EXIT_FAILURE, "stack underflow at instruction %zu", ip);
+        depth = depth - npop + npush;
+        if (depth > function->max_depth)
+            function->max_depth = depth;
+        next_ip = ip + 1 + get_operand_count(words[ip]);
+        switch (words[ip]) {
+        case OPJMP:
+        case OPJMPFALSE:
+        case OPGREATERTHANJMPFALSE:
+        case OPEQUALJMPFALSE:
+            function->targets[words[ip + 1]] = true;
+            set_depth(function, words[ip + 1], depth, worklist, &nwork);
+            break;
+        }
+        if (falls_through(words[ip]))
+            set_depth(function, next_ip, depth, worklist, &nwork);
+    }
+    free(worklist);
+}
+
+static void
+print_string_literal(FILE *out, const char *s, size_t length)
+{
+    fputc('"', out);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c >= ' ' && c <= '~')
+            fputc(c, out);
+        else
+            fprintf(out, "\\%03o", c);
+    }
+    fputc('"', out);
+}
+
+static void
+print_long(FILE *out, long value)
+{
+    if (value == LONG_MIN)
+        fprintf(out, "LONG_MIN");
+    else
+        fprintf(out, "%ldL", value);
+}
+
+/* prints an expression for a new reference to the constant */
+static void
+print_constant(FILE *out, cm_array_list *constants, size_t index)
+{
+    monkey_object_t *constant = cm_array_list_get(constants, index);
+    if (is_immediate_int(constant)) {
+        fprintf(out, "create_monkey_immediate_int(");
+        print_long(out, get_monkey_int_value(constant));
+        fprintf(out, ")");
+    } else if (constant->type == MONKEY_COMPILED_FUNCTION) {
+        fprintf(out, "(monkey_object_t *) &fn_obj_%zu", index);
+    } else {
+        fprintf(out, "aot_retain(constants[%zu])", index);
+    }
+}
+
+static void
+print_stack_check(FILE *out, c_function_t *function, size_t depth)
+{
+    fprintf(out, "    AOT_CHECK_STACK(bp + %zu);\n", function->num_locals + depth);
+}
+
+static void
+print_slot_list(FILE *out, size_t first, size_t count)
+{
+    if (count == 0) {
+        fprintf(out, "NULL");
+        return;
+    }
+    fprintf(out, "(monkey_object_t *[]) {");
+    for (size_t i = 0; i < count; i++)
+        fprintf(out, "%ss%zu", i == 0? "": ", ", first + i);
+    fprintf(out, "}");
+}
+
+/* the main program may be split into chunks, so a return ends the process */
+static void
+print_return(FILE *out, c_function_t *function, size_t depth, const char *value)
+{
+    if (function->index == MAIN_FUNCTION) {
+        fprintf(out, "    aot_pop_top(%s);\n    aot_finish();\n", value);
+        return;
+    }
+    fprintf(out, "    result = %s;\n", value);
+    for (size_t i = 0; i < depth; i++)
+        fprintf(out, "    aot_release(s%zu);\n", i);
+    for (size_t i = 0; i < function->num_locals; i++)
+        fprintf(out, "    aot_release(l%zu);\n", i);
+    fprintf(out, "    return result;\n");
+}
+
+static void
+print_store(FILE *out, const char *variable, size_t depth)
+{
+    fprintf(out, "    aot_pop_top(s%zu);\n", depth - 1);
+    fprintf(out, "    old = %s;\n", variable);
+    fprintf(out, "    %s = aot_retain(aot_top);\n", variable);
+    fprintf(out, "    aot_release(old);\n");
+}
+
+static void
+print_compare_and_jump(FILE *out, size_t op, size_t depth, size_t target)
+{
+    size_t left = depth - 2, right = depth - 1;
+    fprintf(out, "    if (aot_both_immediate(s%zu, s%zu)) {\n", left, right);
+    if (op == OPGREATERTHAN)
+        fprintf(out, "        if (get_monkey_int_value(s%zu) <= get_monkey_int_value(s%zu))\n",
+            left, right);
+    else
+        fprintf(out, "        if (s%zu != s%zu)\n", left, right);
+    fprintf(out, "            goto L%zu;\n", target);
+    fprintf(out, "    } else {\n");
+    fprintf(out, "        aot_pop_top(aot_comparison_op(%s, s%zu, s%zu));\n",
+        op == OPGREATERTHAN? "OPGREATERTHAN": "OPEQUAL", left, right);
+    fprintf(out, "        if (!aot_is_truthy(aot_top))\n");
+    fprintf(out, "            goto L%zu;\n", target);
+    fprintf(out, "    }\n");
+}
+
+static void
+print_instruction(FILE *out, c_function_t *function, cm_array_list *constants, size_t ip)
+{
+    size_t *words = function->code->words + ip;
+    size_t depth = function->depths[ip];
+    size_t count;
+    char local[32];
+
+    switch (words[0]) {
+    case OPCONSTANT:
+        print_stack_check(out, function, depth);
+        fprintf(out, "    s%zu = ", depth);
+        print_constant(out, constants, words[1]);
+        fprintf(out, ";\n");
+        break;
+    case OPTRUE:
+    case OPFALSE:
+    case OPNULL:
+        print_stack_check(out, function, depth);
+        fprintf(out, "    s%zu = (monkey_object_t *) %s;\n", depth,
+            words[0] == OPTRUE? "&MONKEY_TRUE_OBJ":
+            words[0] == OPFALSE? "&MONKEY_FALSE_OBJ": "&MONKEY_NULL_OBJ");
+        break;
+    case OPADD:
+    case OPSUB:
+    case OPMUL:
+    case OPEQUAL:
+    case OPNOTEQUAL:
+    case OPGREATERTHAN:
+        fprintf(out, "    s%zu = %s(s%zu, s%zu);\n", depth - 2,
+            words[0] == OPADD? "aot_add": words[0] == OPSUB? "aot_sub":
+            words[0] == OPMUL? "aot_mul": words[0] == OPEQUAL? "aot_equal":
+            words[0] == OPNOTEQUAL? "aot_not_equal": "aot_greater_than",
+            depth - 2, depth - 1);
+        break;
+    case OPDIV:
+        fprintf(out, "    s%zu = aot_binary_op(OPDIV, s%zu, s%zu);\n", depth - 2,
+            depth - 2, depth - 1);
+        break;
+    case OPMINUS:
+        fprintf(out, "    s%zu = aot_minus(s%zu);\n", depth - 1, depth - 1);
+        break;
+    case OPBANG:
+        fprintf(out, "    s%zu = aot_bang(s%zu);\n", depth - 1, depth - 1);
+        break;
+    case OPPOP:
+        fprintf(out, "    aot_pop_top(s%zu);\n", depth - 1);
+        break;
+    case OPJMP:
+        fprintf(out, "    goto L%zu;\n", words[1]);
+        break;
+    case OPJMPFALSE:
+        fprintf(out, "    aot_pop_top(s%zu);\n", depth - 1);
+        fprintf(out, "    if (!aot_is_truthy(aot_top))\n        goto L%zu;\n", words[1]);
+        break;
+    case OPGREATERTHANJMPFALSE:
+        print_compare_and_jump(out, OPGREATERTHAN, depth, words[1]);
+        break;
+    case OPEQUALJMPFALSE:
+        print_compare_and_jump(out, OPEQUAL, depth, words[1]);
+        break;
+    case OPSETGLOBAL:
+        snprintf(local, sizeof(local), "globals[%zu]", words[1]);
+        print_store(out, local, depth);
+        break;
+    case OPGETGLOBAL:
+        print_stack_check(out, function, depth);
+        fprintf(out, "    s%zu = aot_retain(globals[%zu]);\n", depth, words[1]);
+        break;
+    case OPSETLOCAL:
+        snprintf(local, sizeof(local), "l%zu", words[1]);
+        print_store(out, local, depth);
+        break;
+    case OPGETLOCAL:
+        print_stack_check(out, function, depth);
+        fprintf(out, "    s%zu = aot_retain(l%zu);\n", depth, words[1]);
+        break;
+    case OPGETLOCAL2:
+        print_stack_check(out, function, depth + 1);
+        fprintf(out, "    s%zu = aot_retain(l%zu);\n", depth, words[1]);
+        fprintf(out, "    s%zu = aot_retain(l%zu);\n", depth + 1, words[2]);
+        break;
+    case OPGETLOCALCONSTANT:
+        print_stack_check(out, function, depth + 1);
+        fprintf(out, "    s%zu = aot_retain(l%zu);\n", depth, words[1]);
+        fprintf(out, "    s%zu = ", depth + 1);
+        print_constant(out, constants, words[2]);
+        fprintf(out, ";\n");
+        break;
+    case OPADDLOCALS:
+        print_stack_check(out, function, depth);
+        fprintf(out, "    s%zu = aot_add(aot_retain(l%zu), aot_retain(l%zu));\n", depth,
+            words[1], words[2]);
+        break;
+    case OPADDLOCALCONSTANT:
+    case OPSUBLOCALCONSTANT:
+        print_stack_check(out, function, depth);
+        fprintf(out, "    s%zu = %s(aot_retain(l%zu), ", depth,
+            words[0] == OPADDLOCALCONSTANT? "aot_add": "aot_sub", words[1]);
+        print_constant(out, constants, words[2]);
+        fprintf(out, ");\n");
+        break;
+    case OPARRAY:
+    case OPHASH:
+        count = words[1];
+        fprintf(out, "    s%zu = %s(%zu, ", depth - count,
+            words[0] == OPARRAY? "aot_array": "aot_hash", count);
+        print_slot_list(out, depth - count, count);
+        fprintf(out, ");\n");
+        break;
+    case OPINDEX:
+        fprintf(out, "    s%zu = aot_index(s%zu, s%zu);\n", depth - 2, depth - 2, depth - 1);
+        break;
+    case OPSLICE:
+        fprintf(out, "    s%zu = aot_slice(s%zu, s%zu, s%zu);\n", depth - 3, depth - 3,
+            depth - 2, depth - 1);
+        break;
+    case OPCALL:
+        count = words[1];
+        fprintf(out, "    s%zu = aot_call(s%zu, %zu, ", depth - count - 1, depth - count - 1,
+            count);
+        print_slot_list(out, depth - count, count);
+        fprintf(out, ", bp + %zu);\n", function->num_locals + depth - count);
+        break;
+    case OPRETURNVALUE:
+        snprintf(local, sizeof(local), "s%zu", depth - 1);
+        print_return(out, function, depth - 1, local);
+        break;
+    case OPRETURN:
+        print_return(out, function, depth, "(monkey_object_t *) &MONKEY_NULL_OBJ");
+        break;
+    case OPGETBUILTIN:
+        print_stack_check(out, function, depth);
+        fprintf(out, "    s%zu = builtins[%zu];\n", depth, words[1]);
+        break;
+    default:
+        errx(EXIT_FAILURE, "unsupported opcode %zu", words[0]);
+    }
+}
+
+/*
+ * The number of jumps which pass each instruction boundary, the main
+ * program can only be split where none does and its operand stack is
+ * empty.
+ */
+static size_t *
+count_jumps_across(c_function_t *function)
+{
+    size_t length = function->code->length;
+    size_t *words = function->code->words;
+    size_t *jumps, from, to, ip;
+
+    jumps = calloc(length + 2, sizeof(*jumps));
+    if (jumps == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    for (ip = 0; ip < length; ip += 1 + get_operand_count(words[ip])) {
+        switch (words[ip]) {
+        case OPJMP:
+        case OPJMPFALSE:
+        case OPGREATERTHANJMPFALSE:
+        case OPEQUALJMPFALSE:
+            from = ip < words[ip + 1]? ip: words[ip + 1];
+            to = ip < words[ip + 1]? words[ip + 1]: ip;
+            jumps[from + 1]++;
+            jumps[to + 1]--;
+            break;
+        }
+    }
+    for (ip = 1; ip <= length; ip++)
+        jumps[ip] += jumps[ip - 1];
+    return jumps;
+}
+
+static void
+print_locals(FILE *out, c_function_t *function)
+{
+    fprintf(out, "    monkey_object_t *old;\n");
+    for (size_t i = 0; i < function->max_depth; i++)
+        fprintf(out, "    monkey_object_t *s%zu;\n", i);
+    fprintf(out, "\n");
+}
+
+static void
+print_chunk_header(FILE *out, c_function_t *function, size_t chunk)
+{
+    if (chunk > 0)
+        fprintf(out, "}\n\n");
+    fprintf(out, "static void\nrun_program_%zu(void)\n{\n", chunk);
+    fprintf(out, "    const size_t bp = 0;\n");
+    print_locals(out, function);
+}
+
+/*
+ * Prints the function, the main program as run_program_0, run_program_1,
+ * ... which run_program calls in turn.
+ */
+static void
+print_function(FILE *out, c_function_t *function, cm_array_list *constants)
+{
+    _Bool is_main = function->index == MAIN_FUNCTION;
+    size_t length = function->code->length;
+    size_t *jumps = NULL;
+    size_t ip, nchunks = 0, chunk_length = 0;
+
+    if (is_main) {
+        jumps = count_jumps_across(function);
+        print_chunk_header(out, function, nchunks++);
+    } else {
+        fprintf(out, "static monkey_object_t *\nfn_%zu(monkey_object_t **args, size_t bp)\n{\n",
+            function->index);
+        fprintf(out, "    monkey_object_t *result;\n");
+        for (size_t i = 0; i < function->num_locals; i++) {
+            if (i < function->num_args)
+                fprintf(out, "    monkey_object_t *l%zu = args[%zu];\n", i, i);
+            else
+                fprintf(out, "    monkey_object_t *l%zu = NULL;\n", i);
+        }
+        print_locals(out, function);
+    }
+
+    for (ip = 0; ip < length; ip += 1 + get_operand_count(function->code->words[ip])) {
+        if (function->depths[ip] == UNKNOWN_DEPTH)
+            continue;
+        if (is_main && chunk_length >= MAIN_CHUNK_LENGTH && function->depths[ip] == 0 &&
+            jumps[ip] == 0) {
+            print_chunk_header(out, function, nchunks++);
+            chunk_length = 0;
+        }
+        if (function->targets[ip])
+            fprintf(out, "L%zu:\n", ip);
+        print_instruction(out, function, constants, ip);
+        chunk_length++;
+    }
+    /* running off the end halts the program, as in the VM */
+    if (function->targets[length])
+        fprintf(out, "L%zu:\n", length);
+    if (function->depths[length] != UNKNOWN_DEPTH) {
+        if (is_main)
+            fprintf(out, "    return;\n");
+        else
+            fprintf(out, "    aot_finish();\n");
+    }
+    fprintf(out, "}\n\n");
+
+    if (is_main) {
+        fprintf(out, "static void\nrun_program(void)\n{\n");
+        for (size_t i = 0; i < nchunks; i++)
+            fprintf(out, "    run_program_%zu();\n", i);
+        fprintf(out, "}\n\n");
+        free(jumps);
+    }
+}
+
+static c_function_t *
+create_c_function(instructions_t *instructions, size_t num_locals, size_t num_args, size_t index)
+{
+    c_function_t *function = malloc(sizeof(*function));
+    if (function == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    function->code = decode_instructions(instructions);
+    function->num_locals = num_locals;
+    function->num_args = num_args;
+    function->index = index;
+    analyze_function(function);
+    return function;
+}
+
+static void
+c_function_free(c_function_t *function)
+{
+    decoded_instructions_free(function->code);
+    free(function->depths);
+    free(function->targets);
+    free(function);
+}
+
+/* the number of globals the program uses */
+static size_t
+count_globals(c_function_t *function, size_t count)
+{
+    size_t *words = function->code->words;
+    for (size_t ip = 0; ip < function->code->length; ip += 1 + get_operand_count(words[ip])) {
+        if ((words[ip] == OPSETGLOBAL || words[ip] == OPGETGLOBAL) && words[ip + 1] >= count)
+            count = words[ip + 1] + 1;
+    }
+    return count;
+}
+
+char *
+c_backend_generate(bytecode_t *bytecode)
+{
+    cm_array_list *constants = bytecode->constants_pool;
+    c_function_t **functions;
+    c_function_t *main_function;
+    monkey_compiled_fn_t *fn;
+    monkey_object_t *constant;
+    monkey_string_t *str;
+    size_t nglobals, i;
+    char *string = NULL;
+    size_t string_length = 0;
+
+    FILE *out = open_memstream(&string, &string_length);
+    if (out == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    functions = calloc(constants->length + 1, sizeof(*functions));
+    if (functions == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    main_function = create_c_function(bytecode->instructions, 0, 0, MAIN_FUNCTION);
+    nglobals = count_globals(main_function, 0);
+    for (i = 0; i < constants->length; i++) {
+        fn = cm_array_list_get(constants, i);
+        if (is_immediate_int(fn) || fn->object.type != MONKEY_COMPILED_FUNCTION)
+            continue;
+        functions[i] = create_c_function(fn->instructions, fn->num_locals, fn->num_args, i);
+        nglobals = count_globals(functions[i], nglobals);
+    }
+
+    fprintf(out, "/* generated by monkeyc */\n");
+    fprintf(out, "#include \"aot_runtime.h\"\n\n");
+    fprintf(out, "static monkey_object_t *constants[%zu];\n", constants->length + 1);
+    fprintf(out, "static monkey_object_t *globals[%zu];\n", nglobals + 1);
+    fprintf(out, "static monkey_object_t *builtins[%d];\n\n", MAX_BUILTINS);
+    for (i = 0; i < constants->length; i++) {
+        if (functions[i] == NULL)
+            continue;
+        fprintf(out, "static monkey_object_t *fn_%zu(monkey_object_t **, size_t);\n", i);
+        fprintf(out, "static aot_function_t fn_obj_%zu = AOT_FUNCTION(fn_%zu, %zu, %zu);\n",
+            i, i, functions[i]->num_locals, functions[i]->num_args);
+    }
+    fprintf(out, "\n");
+
+    for (i = 0; i < constants->length; i++) {
+        if (functions[i] != NULL)
+            print_function(out, functions[i], constants);
+    }
+    print_function(out, main_function, constants);
+
+    fprintf(out, "static void\ninit_program(void)\n{\n");
+    for (i = 0; i < constants->length; i++) {
+        constant = cm_array_list_get(constants, i);
+        if (is_immediate_int(constant) || constant->type == MONKEY_COMPILED_FUNCTION)
+            continue;
+        fprintf(out, "    constants[%zu] = ", i);
+        if (constant->type == MONKEY_STRING) {
+            str = (monkey_string_t *) constant;
+            fprintf(out, "(monkey_object_t *) intern_monkey_string(");
+            print_string_literal(out, str->value, str->length);
+            fprintf(out, ", %zu);\n", str->length);
+        } else {
+            fprintf(out, "create_monkey_int_object(");
+            print_long(out, get_monkey_int_value(constant));
+            fprintf(out, ");\n");
+        }
+    }
+    fprintf(out, "    for (size_t i = 0; i < %d && BUILTINS[i] != NULL; i++)\n", MAX_BUILTINS);
+    fprintf(out, "        builtins[i] = (monkey_object_t *) get_builtins(BUILTINS[i]);\n");
+    fprintf(out, "}\n\n");
+
+    fprintf(out, "int\nmain(int argc, char **argv)\n{\n");
+    fprintf(out, "    init_program();\n");
+    fprintf(out, "    run_program();\n");
+    fprintf(out, "    aot_finish();\n");
+    fprintf(out, "}\n");
+    fclose(out);
+
+    for (i = 0; i < constants->length; i++) {
+        if (functions[i] != NULL)
+            c_function_free(functions[i]);
+    }
+    free(functions);
+    c_function_free(main_function);
+    return string;
+}
@@ -0,0 +1,13 @@
+#ifndef C_BACKEND_H
+#define C_BACKEND_H
+
+#include "compiler.h"
+
+/*
+ * Lowers compiled bytecode into a C translation unit which runs the
+ * program when linked against the runtime (aot_runtime.c, object.c,
+ * builtins.c and their dependencies). Used by monkeyc.
+ */
+char *c_backend_generate(bytecode_t *);
+
+#endif
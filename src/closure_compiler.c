@@ -0,0 +1,786 @@
+#include <err.h>
+#include <stdlib.h>
+
+#include "builtins.h"
+#include "closure_compiler.h"
+#include "evaluator.h"
+
+typedef struct constant_closure_t {
+    closure_t closure;
+    monkey_object_t *value;
+} constant_closure_t;
+
+typedef struct identifier_closure_t {
+    closure_t closure;
+    identifier_t *ident;
+    monkey_builtin_t *builtin;  // the value when nothing set the slot
+} identifier_closure_t;
+
+/* prefix expressions and return statements */
+typedef struct unary_closure_t {
+    closure_t closure;
+    operator_t op;
+    closure_t *right;
+} unary_closure_t;
+
+/* infix and index expressions */
+typedef struct binary_closure_t {
+    closure_t closure;
+    operator_t op;
+    closure_t *left;
+    closure_t *right;
+} binary_closure_t;
+
+typedef struct let_closure_t {
+    closure_t closure;
+    size_t slot;
+    closure_t *value;
+} let_closure_t;
+
+typedef struct if_closure_t {
+    closure_t closure;
+    closure_t *condition;
+    closure_t *consequence;
+    closure_t *alternative;
+} if_closure_t;
+
+typedef struct while_closure_t {
+    closure_t closure;
+    closure_t *condition;
+    closure_t *body;
+} while_closure_t;
+
+typedef struct slice_closure_t {
+    closure_t closure;
+    closure_t *left;
+    closure_t *bounds[2];   // NULL for a bound left out
+} slice_closure_t;
+
+typedef struct call_closure_t {
+    closure_t closure;
+    closure_t *function;
+    size_t nargs;
+    closure_t *args[];
+} call_closure_t;
+
+/* blocks, programs and array literals, and hash literals with keys and values in turn */
+typedef struct list_closure_t {
+    closure_t closure;
+    size_t length;
+    closure_t *items[];
+} list_closure_t;
+
+typedef struct closure_compiler_t {
+    cm_array_list *closures;
+    cm_array_list *constants;
+} closure_compiler_t;
+
+static closure_t *compile_expression(closure_compiler_t *, expression_t *);
+static closure_t *compile_statement(closure_compiler_t *, statement_t *);
+
+#define is_error(obj) ((obj) != NULL && get_monkey_object_type(obj) == MONKEY_ERROR)
+
+#define both_immediate(left, right) \
+    ((((uintptr_t) (left)) & ((uintptr_t) (right)) & MONKEY_IMMEDIATE_TAG) != 0)
+
+static monkey_object_t *
+run_constant(closure_t *closure, environment_t *env)
+{
+    return retain_monkey_object(((constant_closure_t *) closure)->value);
+}
+
+static monkey_object_t *
+lookup_unset_identifier(identifier_closure_t *ident)
+{
+    if (ident->builtin == NULL)
+        return (monkey_object_t *) create_monkey_error("identifier not found: %s",
+            ident->ident->value);
+    return retain_monkey_object((monkey_object_t *) ident->builtin);
+}
+
+/* a variable of the current function, or a global outside of functions */
+static monkey_object_t *
+run_local(closure_t *closure, environment_t *env)
+{
+    identifier_closure_t *ident = (identifier_closure_t *) closure;
+    monkey_object_t *value = env_get(env, 0, ident->ident->slot);
+    if (value == NULL)
+        return lookup_unset_identifier(ident);
+    return retain_monkey_object(value);
+}
+
+static monkey_object_t *
+run_identifier(closure_t *closure, environment_t *env)
+{
+    identifier_closure_t *ident = (identifier_closure_t *) closure;
+    monkey_object_t *value = env_get(env, ident->ident->depth, ident->ident->slot);
+    if (value == NULL)
+        return lookup_unset_identifier(ident);
+    return retain_monkey_object(value);
+}
+
+static monkey_object_t *
+run_prefix(closure_t *closure, environment_t *env)
+{
+    unary_closure_t *prefix = (unary_closure_t *) closure;
+    monkey_object_t *right = prefix->right->run(prefix->right, env);
+    if (is_error(right))
+        return right;
+    monkey_object_t *result = eval_prefix_expression(prefix->op, right);
+    release_monkey_object(right);
+    return result;
+}
+
+static monkey_object_t *
+run_minus(closure_t *closure, environment_t *env)
+{
+    unary_closure_t *prefix = (unary_closure_t *) closure;
+    monkey_object_t *right = prefix->right->run(prefix->right, env);
+    if (is_immediate_int(right))
+        return create_monkey_int_object(-get_monkey_int_value(right));
+    if (is_error(right))
+        return right;
+    monkey_object_t *result = eval_prefix_expression(prefix->op, right);
+    release_monkey_object(right);
+    return result;
+}
+
+/* false with the error in *left when either operand fails */
+static _Bool
+run_operands(binary_closure_t *binary, environment_t *env,
+    monkey_object_t **left, monkey_object_t **right)
+{
+    *left = binary->left->run(binary->left, env);
+    if (is_error(*left))
+        return false;
+    *right = binary->right->run(binary->right, env);
+    if (is_error(*right)) {
+        release_monkey_object(*left);
+        *left = *right;
+        return false;
+    }
+    return true;
+}
+
+static monkey_object_t *
+run_infix(closure_t *closure, environment_t *env)
+{
+    binary_closure_t *infix = (binary_closure_t *) closure;
+    monkey_object_t *left, *right, *result;
+    if (!run_operands(infix, env, &left, &right))
+        return left;
+    result = eval_infix_expression(infix->op, left, right);
+    release_monkey_object(left);
+    release_monkey_object(right);
+    return result;
+}
+
+/*
+ * The operators with a fast path for two immediate ints, which need no
+ * release. The sum or difference of two immediates does not overflow a
+ * long, the product overflows like the AST walker's.
+ */
+#define INT_INFIX_CLOSURE(name, result_expression)                          \
+static monkey_object_t *                                                    \
+name(closure_t *closure, environment_t *env)                                \
+{                                                                           \
+    binary_closure_t *infix = (binary_closure_t *) closure;                 \
+    monkey_object_t *left, *right, *result;                                 \
+    if (!run_operands(infix, env, &left, &right))                           \
+        return left;                                                        \
+    if (both_immediate(left, right)) {                                      \
+        long l = get_monkey_int_value(left);                                \
+        long r = get_monkey_int_value(right);                               \
+        return (monkey_object_t *) (result_expression);                     \
+    }                                                                       \
+    result = eval_infix_expression(infix->op, left, right);                 \
+    release_monkey_object(left);                                            \
+    release_monkey_object(right);                                           \
+    return result;                                                          \
+}
+
+INT_INFIX_CLOSURE(run_add, create_monkey_int_object(l + r))
+INT_INFIX_CLOSURE(run_sub, create_monkey_int_object(l - r))
+INT_INFIX_CLOSURE(run_mul, create_monkey_int_object(l * r))
+INT_INFIX_CLOSURE(run_less_than, create_monkey_bool((l < r)))
+INT_INFIX_CLOSURE(run_greater_than, create_monkey_bool((l > r)))
+INT_INFIX_CLOSURE(run_equal, create_monkey_bool((l == r)))
+INT_INFIX_CLOSURE(run_not_equal, create_monkey_bool((l != r)))
+
+static monkey_object_t *
+run_index(closure_t *closure, environment_t *env)
+{
+    binary_closure_t *index = (binary_closure_t *) closure;
+    monkey_object_t *left, *right, *result;
+    if (!run_operands(index, env, &left, &right))
+        return left;
+    result = eval_index_expression(left, right);
+    release_monkey_object(left);
+    release_monkey_object(right);
+    return result;
+}
+
+static monkey_object_t *
+run_slice(closure_t *closure, environment_t *env)
+{
+    slice_closure_t *slice = (slice_closure_t *) closure;
+    monkey_object_t *bounds[2];
+    monkey_object_t *result;
+    monkey_object_t *left = slice->left->run(slice->left, env);
+    if (is_error(left))
+        return left;
+    for (size_t i = 0; i < 2; i++) {
+        if (slice->bounds[i] == NULL) {
+            bounds[i] = (monkey_object_t *) create_monkey_null();
+            continue;
+        }
+        bounds[i] = slice->bounds[i]->run(slice->bounds[i], env);
+        if (is_error(bounds[i])) {
+            result = bounds[i];
+            if (i > 0)
+                release_monkey_object(bounds[0]);
+            release_monkey_object(left);
+            return result;
+        }
+    }
+    result = eval_slice(left, bounds[0], bounds[1]);
+    release_monkey_object(left);
+    release_monkey_object(bounds[0]);
+    release_monkey_object(bounds[1]);
+    return result;
+}
+
+static monkey_object_t *
+run_if(closure_t *closure, environment_t *env)
+{
+    if_closure_t *if_closure = (if_closure_t *) closure;
+    monkey_object_t *result;
+    monkey_object_t *condition = if_closure->condition->run(if_closure->condition, env);
+    if (is_error(condition))
+        return condition;
+    if (is_truthy(condition))
+        result = if_closure->consequence->run(if_closure->consequence, env);
+    else if (if_closure->alternative != NULL)
+        result = if_closure->alternative->run(if_closure->alternative, env);
+    else
+        result = (monkey_object_t *) create_monkey_null();
+    release_monkey_object(condition);
+    return result;
+}
+
+/* like eval_while_expression, the value is the one of the last iteration */
+static monkey_object_t *
+run_while(closure_t *closure, environment_t *env)
+{
+    while_closure_t *while_closure = (while_closure_t *) closure;
+    closure_t *body = while_closure->body;
+    closure_t *condition_closure = while_closure->condition;
+    monkey_object_t *result = NULL;
+    monkey_object_t *condition = condition_closure->run(condition_closure, env);
+    if (is_error(condition))
+        return condition;
+    while (is_truthy(condition)) {
+        result = body->run(body, env);
+        if (is_error(result)) {
+            release_monkey_object(condition);
+            return result;
+        }
+        release_monkey_object(condition);
+        condition = condition_closure->run(condition_closure, env);
+        if (is_truthy(condition))
+            release_monkey_object(result);
+    }
+    if (result == NULL)
+        return (monkey_object_t *) create_monkey_null();
+    return result;
+}
+
+static monkey_object_t *
+run_function_literal(closure_t *closure, environment_t *env)
+{
+    closure_function_t *code = (closure_function_t *) closure;
+    monkey_function_t *function = create_monkey_function(code->literal->parameters,
+        code->literal->body, code->literal->nslots, env);
+    function->code = code;
+    return (monkey_object_t *) function;
+}
+
+/* takes over the references to the arguments */
+static monkey_object_t *
+call_function(monkey_function_t *function, monkey_object_t **args, size_t nargs)
+{
+    monkey_object_t *result;
+    monkey_return_value_t *return_value;
+    cm_list_node *param_node;
+    closure_function_t *code = function->code;
+
+    if (function->parameters->length != nargs) {
+        for (size_t i = 0; i < nargs; i++)
+            release_monkey_object(args[i]);
+        return (monkey_object_t *) create_monkey_error(
+            "wrong number of arguments: want=%zu, got=%zu", function->parameters->length, nargs);
+    }
+    environment_t *env = create_enclosed_env(function->env, function->nslots);
+    if (code != NULL) {
+        for (size_t i = 0; i < nargs; i++)
+            env_put(env, code->param_slots[i], args[i]);
+        result = code->body->run(code->body, env);
+    } else {
+        /* a function the AST walker created, in the REPL */
+        param_node = function->parameters->head;
+        for (size_t i = 0; i < nargs; i++, param_node = param_node->next)
+            env_put(env, ((identifier_t *) param_node->data)->slot, args[i]);
+        result = monkey_eval((node_t *) function->body, env);
+    }
+    env_free(env);
+    if (get_monkey_object_type(result) == MONKEY_RETURN_VALUE) {
+        return_value = (monkey_return_value_t *) result;
+        result = retain_monkey_object(return_value->value);
+        release_monkey_object(return_value);
+    }
+    return result;
+}
+
+static monkey_object_t *
+call_builtin(monkey_builtin_t *builtin, monkey_object_t **args, size_t nargs)
+{
+    cm_list *arguments = cm_list_init();
+    for (size_t i = 0; i < nargs; i++)
+        cm_list_add(arguments, args[i]);
+    monkey_object_t *result = builtin->function(arguments);
+    cm_list_free(arguments, release_monkey_object);
+    return result;
+}
+
+static monkey_object_t *
+run_call(closure_t *closure, environment_t *env)
+{
+    call_closure_t *call = (call_closure_t *) closure;
+    monkey_object_t *args[call->nargs + 1];
+    monkey_object_t *result;
+    monkey_object_t *function = call->function->run(call->function, env);
+    if (is_error(function))
+        return function;
+    for (size_t i = 0; i < call->nargs; i++) {
+        args[i] = call->args[i]->run(call->args[i], env);
+        if (is_error(args[i])) {
+            result = args[i];
+            while (i-- > 0)
+                release_monkey_object(args[i]);
+            release_monkey_object(function);
+            return result;
+        }
+    }
+    switch (get_monkey_object_type(function)) {
+    case MONKEY_FUNCTION:
+        result = call_function((monkey_function_t *) function, args, call->nargs);
+        break;
+    case MONKEY_BUILTIN:
+        result = call_builtin((monkey_builtin_t *) function, args, call->nargs);
+        break;
+    default:
+        for (size_t i = 0; i < call->nargs; i++)
+            release_monkey_object(args[i]);
+        result = (monkey_object_t *) create_monkey_error("not a function: %s",
+            get_type_name(get_monkey_object_type(function)));
+        break;
+    }
+    release_monkey_object(function);
+    return result;
+}
+
+static monkey_object_t *
+run_array_literal(closure_t *closure, environment_t *env)
+{
+    list_closure_t *array = (list_closure_t *) closure;
+    cm_array_list *elements = cm_array_list_init(array->length, release_monkey_object);
+    for (size_t i = 0; i < array->length; i++) {
+        monkey_object_t *element = array->items[i]->run(array->items[i], env);
+        if (is_error(element)) {
+            cm_array_list_free(elements);
+            return element;
+        }
+        cm_array_list_add(elements, element);
+    }
+    return (monkey_object_t *) create_monkey_array(elements);
+}
+
+static monkey_object_t *
+run_hash_literal(closure_t *closure, environment_t *env)
+{
+    list_closure_t *hash = (list_closure_t *) closure;
+    monkey_object_t *key, *value;
+    cm_hash_table *pairs = cm_hash_table_init(monkey_object_hash,
+        monkey_object_equals, release_monkey_object, release_monkey_object);
+    for (size_t i = 0; i < hash->length; i += 2) {
+        key = hash->items[i]->run(hash->items[i], env);
+        if (is_error(key)) {
+            cm_hash_table_free(pairs);
+            return key;
+        }
+        if (!is_hashable_monkey_object(key)) {
+            cm_hash_table_free(pairs);
+            value = (monkey_object_t *) create_monkey_error("unusable as a hash key: %s",
+                get_type_name(get_monkey_object_type(key)));
+            release_monkey_object(key);
+            return value;
+        }
+        value = hash->items[i + 1]->run(hash->items[i + 1], env);
+        if (is_error(value)) {
+            release_monkey_object(key);
+            cm_hash_table_free(pairs);
+            return value;
+        }
+        cm_hash_table_put(pairs, key, value);
+    }
+    return (monkey_object_t *) create_monkey_hash(pairs);
+}
+
+static monkey_object_t *
+run_let(closure_t *closure, environment_t *env)
+{
+    let_closure_t *let = (let_closure_t *) closure;
+    monkey_object_t *value = let->value->run(let->value, env);
+    if (is_error(value))
+        return value;
+    if (value == NULL)
+        value = (monkey_object_t *) create_monkey_null();
+    env_put(env, let->slot, value);
+    return NULL;
+}
+
+static monkey_object_t *
+run_return(closure_t *closure, environment_t *env)
+{
+    unary_closure_t *ret = (unary_closure_t *) closure;
+    monkey_object_t *value = ret->right->run(ret->right, env);
+    if (is_error(value))
+        return value;
+    return (monkey_object_t *) create_monkey_return_value(value);
+}
+
+static monkey_object_t *
+run_block(closure_t *closure, environment_t *env)
+{
+    list_closure_t *block = (list_closure_t *) closure;
+    monkey_object_t *object = NULL;
+    for (size_t i = 0; i < block->length; i++) {
+        if (object)
+            release_monkey_object(object);
+        object = block->items[i]->run(block->items[i], env);
+        if (object != NULL &&
+            (get_monkey_object_type(object) == MONKEY_RETURN_VALUE ||
+            get_monkey_object_type(object) == MONKEY_ERROR))
+            return object;
+    }
+    return object;
+}
+
+static monkey_object_t *
+run_program(closure_t *closure, environment_t *env)
+{
+    list_closure_t *program = (list_closure_t *) closure;
+    monkey_object_t *object = NULL;
+    monkey_return_value_t *return_value;
+    for (size_t i = 0; i < program->length; i++) {
+        if (object)
+            release_monkey_object(object);
+        object = program->items[i]->run(program->items[i], env);
+        if (object == NULL)
+            continue;
+        if (get_monkey_object_type(object) == MONKEY_RETURN_VALUE) {
+            return_value = (monkey_return_value_t *) object;
+            object = retain_monkey_object(return_value->value);
+            release_monkey_object(return_value);
+            return object;
+        } else if (get_monkey_object_type(object) == MONKEY_ERROR) {
+            return object;
+        }
+    }
+    return object;
+}
+
+static monkey_object_t *
+run_nothing(closure_t *closure, environment_t *env)
+{
+    return NULL;
+}
+
+static void *
+new_closure(closure_compiler_t *compiler, size_t size, closure_fn_t run)
+{
+    closure_t *closure = malloc(size);
+    if (closure == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    closure->run = run;
+    cm_array_list_add(compiler->closures, closure);
+    return closure;
+}
+
+static list_closure_t *
+new_list_closure(closure_compiler_t *compiler, size_t length, closure_fn_t run)
+{
+    list_closure_t *list = new_closure(compiler,
+        sizeof(*list) + length * sizeof(*list->items), run);
+    list->length = length;
+    return list;
+}
+
+/* takes over the reference to value */
+static closure_t *
+compile_constant(closure_compiler_t *compiler, monkey_object_t *value)
+{
+    constant_closure_t *constant = new_closure(compiler, sizeof(*constant), run_constant);
+    constant->value = value;
+    cm_array_list_add(compiler->constants, value);
+    return (closure_t *) constant;
+}
+
+static closure_t *
+compile_block(closure_compiler_t *compiler, block_statement_t *block)
+{
+    list_closure_t *list = new_list_closure(compiler, block->nstatements, run_block);
+    for (size_t i = 0; i < block->nstatements; i++)
+        list->items[i] = compile_statement(compiler, block->statements[i]);
+    return (closure_t *) list;
+}
+
+static closure_t *
+compile_identifier(closure_compiler_t *compiler, identifier_t *ident)
+{
+    identifier_closure_t *closure = new_closure(compiler, sizeof(*closure),
+        ident->depth == 0? run_local: run_identifier);
+    closure->ident = ident;
+    closure->builtin = get_builtins(ident->value);
+    return (closure_t *) closure;
+}
+
+static closure_t *
+compile_prefix(closure_compiler_t *compiler, prefix_expression_t *prefix_exp)
+{
+    closure_fn_t run = prefix_exp->op == OPERATOR_MINUS? run_minus: run_prefix;
+    unary_closure_t *prefix = new_closure(compiler, sizeof(*prefix), run);
+    prefix->op = prefix_exp->op;
+    prefix->right = compile_expression(compiler, prefix_exp->right);
+    return (closure_t *) prefix;
+}
+
+static closure_t *
+compile_infix(closure_compiler_t *compiler, infix_expression_t *infix_exp)
+{
+    closure_fn_t run;
+    switch (infix_exp->op) {
+    case OPERATOR_PLUS:
+        run = run_add;
+        break;
+    case OPERATOR_MINUS:
+        run = run_sub;
+        break;
+    case OPERATOR_MULTIPLY:
+        run = run_mul;
+        break;
+    case OPERATOR_LESS_THAN:
+        run = run_less_than;
+        break;
+    case OPERATOR_GREATER_THAN:
+        run = run_greater_than;
+        break;
+    case OPERATOR_EQUAL:
+        run = run_equal;
+        break;
+    case OPERATOR_NOT_EQUAL:
+        run = run_not_equal;
+        break;
+    default:
+        run = run_infix;
+        break;
+    }
+    binary_closure_t *infix = new_closure(compiler, sizeof(*infix), run);
+    infix->op = infix_exp->op;
+    infix->left = compile_expression(compiler, infix_exp->left);
+    infix->right = compile_expression(compiler, infix_exp->right);
+    return (closure_t *) infix;
+}
+
+static closure_t *
+compile_function_literal(closure_compiler_t *compiler, function_literal_t *literal)
+{
+    size_t nparams = literal->parameters->length;
+    closure_function_t *function = new_closure(compiler,
+        sizeof(*function) + nparams * sizeof(*function->param_slots), run_function_literal);
+    function->literal = literal;
+    cm_list_node *param_node = literal->parameters->head;
+    for (size_t i = 0; i < nparams; i++, param_node = param_node->next)
+        function->param_slots[i] = ((identifier_t *) param_node->data)->slot;
+    function->body = compile_block(compiler, literal->body);
+    return (closure_t *) function;
+}
+
+static closure_t *
+compile_call(closure_compiler_t *compiler, call_expression_t *call_exp)
+{
+    size_t nargs = call_exp->arguments->length;
+    call_closure_t *call = new_closure(compiler,
+        sizeof(*call) + nargs * sizeof(*call->args), run_call);
+    call->nargs = nargs;
+    call->function = compile_expression(compiler, call_exp->function);
+    cm_list_node *arg_node = call_exp->arguments->head;
+    for (size_t i = 0; i < nargs; i++, arg_node = arg_node->next)
+        call->args[i] = compile_expression(compiler, arg_node->data);
+    return (closure_t *) call;
+}
+
+static closure_t *
+compile_hash_literal(closure_compiler_t *compiler, hash_literal_t *hash_exp)
+{
+    cm_array_list *keys = cm_hash_table_get_keys(hash_exp->pairs);
+    size_t npairs = keys != NULL? keys->length: 0;
+    list_closure_t *hash = new_list_closure(compiler, 2 * npairs, run_hash_literal);
+    for (size_t i = 0; i < npairs; i++) {
+        expression_t *key = cm_array_list_get(keys, i);
+        hash->items[2 * i] = compile_expression(compiler, key);
+        hash->items[2 * i + 1] = compile_expression(compiler,
+            cm_hash_table_get(hash_exp->pairs, key));
+    }
+    if (keys != NULL)
+        cm_array_list_free(keys);
+    return (closure_t *) hash;
+}
+
+static closure_t *
+compile_expression(closure_compiler_t *compiler, expression_t *exp)
+{
+    string_t *string_exp;
+    array_literal_t *array_exp;
+    index_expression_t *index_exp;
+    slice_expression_t *slice_exp;
+    if_expression_t *if_exp;
+    while_expression_t *while_exp;
+    binary_closure_t *binary;
+    slice_closure_t *slice;
+    if_closure_t *if_closure;
+    while_closure_t *while_closure;
+    list_closure_t *array;
+
+    switch (exp->expression_type) {
+    case INTEGER_EXPRESSION:
+        return compile_constant(compiler,
+            create_monkey_int_object(((integer_t *) exp)->value));
+    case BOOLEAN_EXPRESSION:
+        return compile_constant(compiler,
+            (monkey_object_t *) create_monkey_bool(((boolean_expression_t *) exp)->value));
+    case STRING_EXPRESSION:
+        string_exp = (string_t *) exp;
+        return compile_constant(compiler,
+            (monkey_object_t *) intern_monkey_string(string_exp->value, string_exp->length));
+    case IDENTIFIER_EXPRESSION:
+        return compile_identifier(compiler, (identifier_t *) exp);
+    case PREFIX_EXPRESSION:
+        return compile_prefix(compiler, (prefix_expression_t *) exp);
+    case INFIX_EXPRESSION:
+        return compile_infix(compiler, (infix_expression_t *) exp);
+    case IF_EXPRESSION:
+        if_exp = (if_expression_t *) exp;
+        if_closure = new_closure(compiler, sizeof(*if_closure), run_if);
+        if_closure->condition = compile_expression(compiler, if_exp->condition);
+        if_closure->consequence = compile_block(compiler, if_exp->consequence);
+        if_closure->alternative = if_exp->alternative != NULL?
+            compile_block(compiler, if_exp->alternative): NULL;
+        return (closure_t *) if_closure;
+    case WHILE_EXPRESSION:
+        while_exp = (while_expression_t *) exp;
+        while_closure = new_closure(compiler, sizeof(*while_closure), run_while);
+        while_closure->condition = compile_expression(compiler, while_exp->condition);
+        while_closure->body = compile_block(compiler, while_exp->body);
+        return (closure_t *) while_closure;
+    case FUNCTION_LITERAL:
+        return compile_function_literal(compiler, (function_literal_t *) exp);
+    case CALL_EXPRESSION:
+        return compile_call(compiler, (call_expression_t *) exp);
+    case ARRAY_LITERAL:
+        array_exp = (array_literal_t *) exp;
+        array = new_list_closure(compiler, array_exp->elements->length, run_array_literal);
+        for (size_t i = 0; i < array_exp->elements->length; i++)
+            array->items[i] = compile_expression(compiler, array_exp->elements->array[i]);
+        return (closure_t *) array;
+    case INDEX_EXPRESSION:
+        index_exp = (index_expression_t *) exp;
+        binary = new_closure(compiler, sizeof(*binary), run_index);
+        binary->left = compile_expression(compiler, index_exp->left);
+        binary->right = compile_expression(compiler, index_exp->index);
+        return (closure_t *) binary;
+    case SLICE_EXPRESSION:
+        slice_exp = (slice_expression_t *) exp;
+        slice = new_closure(compiler, sizeof(*slice), run_slice);
+        slice->left = compile_expression(compiler, slice_exp->left);
+        slice->bounds[0] = slice_exp->start != NULL?
+            compile_expression(compiler, slice_exp->start): NULL;
+        slice->bounds[1] = slice_exp->end != NULL?
+            compile_expression(compiler, slice_exp->end): NULL;
+        return (closure_t *) slice;
+    case HASH_LITERAL:
+        return compile_hash_literal(compiler, (hash_literal_t *) exp);
+    default:
+        return new_closure(compiler, sizeof(closure_t), run_nothing);
+    }
+}
+
+static closure_t *
+compile_statement(closure_compiler_t *compiler, statement_t *statement)
+{
+    letstatement_t *let_stmt;
+    let_closure_t *let;
+    unary_closure_t *ret;
+
+    switch (statement->statement_type) {
+    case EXPRESSION_STATEMENT:
+        return compile_expression(compiler, ((expression_statement_t *) statement)->expression);
+    case BLOCK_STATEMENT:
+        return compile_block(compiler, (block_statement_t *) statement);
+    case RETURN_STATEMENT:
+        ret = new_closure(compiler, sizeof(*ret), run_return);
+        ret->right = compile_expression(compiler,
+            ((return_statement_t *) statement)->return_value);
+        return (closure_t *) ret;
+    case LET_STATEMENT:
+        let_stmt = (letstatement_t *) statement;
+        let = new_closure(compiler, sizeof(*let), run_let);
+        let->slot = let_stmt->name->slot;
+        let->value = compile_expression(compiler, let_stmt->value);
+        return (closure_t *) let;
+    default:
+        return new_closure(compiler, sizeof(closure_t), run_nothing);
+    }
+}
+
+closure_program_t *
+compile_closures(program_t *program)
+{
+    closure_compiler_t compiler;
+    closure_program_t *closure_program = malloc(sizeof(*closure_program));
+    if (closure_program == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    compiler.closures = cm_array_list_init(64, free);
+    compiler.constants = cm_array_list_init(16, release_monkey_object);
+    list_closure_t *body = new_list_closure(&compiler, program->nstatements, run_program);
+    for (size_t i = 0; i < program->nstatements; i++)
+        body->items[i] = compile_statement(&compiler, program->statements[i]);
+    closure_program->body = (closure_t *) body;
+    closure_program->closures = compiler.closures;
+    closure_program->constants = compiler.constants;
+    return closure_program;
+}
+
+monkey_object_t *
+run_closures(closure_program_t *program, environment_t *env)
+{
+    return program->body->run(program->body, env);
+}
+
+void
+closure_program_free(closure_program_t *program)
+{
+    cm_array_list_free(program->closures);
+    cm_array_list_free(program->constants);
+    free(program);
+}
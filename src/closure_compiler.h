@@ -0,0 +1,47 @@
+#ifndef CLOSURE_COMPILER_H
+#define CLOSURE_COMPILER_H
+
+#include "ast.h"
+#include "cmonkey_utils.h"
+#include "environment.h"
+#include "object.h"
+
+/*
+ * An alternative to the AST walker of the evaluator. The program is
+ * compiled once into a tree of closures, each a C function specialised for
+ * one kind of node, and sometimes for its operator or the types it
+ * expects, with its children and constants already in place. Running a
+ * closure calls its children directly instead of dispatching on the type
+ * of every node each time it is evaluated. The results, errors and
+ * refcounting are the same as monkey_eval's.
+ *
+ * The program must be resolved first. The closures point into the program
+ * and the functions they create point into the closures, so both must
+ * outlive the values of the run.
+ */
+typedef struct closure_t closure_t;
+typedef monkey_object_t *(*closure_fn_t)(closure_t *, environment_t *);
+
+struct closure_t {
+    closure_fn_t run;
+};
+
+/* a function literal, the code of the functions it evaluates to */
+typedef struct closure_function_t {
+    closure_t closure;
+    function_literal_t *literal;
+    closure_t *body;
+    size_t param_slots[];
+} closure_function_t;
+
+typedef struct closure_program_t {
+    closure_t *body;
+    cm_array_list *closures;    // every allocation of the program, to free it
+    cm_array_list *constants;   // the values of the literals
+} closure_program_t;
+
+closure_program_t *compile_closures(program_t *);
+monkey_object_t *run_closures(closure_program_t *, environment_t *);
+void closure_program_free(closure_program_t *);
+
+#endif
@@ -35,9 +35,216 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "cmonkey_utils.h"
 
+_Thread_local cm_region *cm_slab_region;
+
+#ifdef CM_NO_SLAB
+void *
+cm_slab_alloc(size_t size)
+{
+    void *ptr = malloc(size);
+    if (ptr == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    return ptr;
+}
+
+void
+cm_slab_free(void *ptr, size_t size)
+{
+    free(ptr);
+}
+
+cm_region *
+cm_region_init(_Bool huge_pages)
+{
+    cm_region *region = calloc(1, sizeof(*region));
+    if (region == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    return region;
+}
+
+void
+cm_region_enter(cm_region *region)
+{
+    cm_slab_region = region;
+}
+
+void
+cm_region_leave(cm_region *region)
+{
+    cm_slab_region = NULL;
+}
+
+void
+cm_region_free(cm_region *region)
+{
+    free(region);
+}
+#else
+_Thread_local cm_slab_block *cm_slab_free_lists[CM_SLAB_NCLASSES];
+
+/* the region grows by this much and its start is aligned to it, a huge page */
+#define CM_REGION_COMMIT_SIZE ((size_t) 2 * 1024 * 1024)
+/* the address space reserved for a region, halved until the reservation succeeds */
+#define CM_REGION_MAX_RESERVE ((size_t) 1 << (sizeof(void *) == 8? 36: 28))
+#define CM_REGION_MIN_RESERVE ((size_t) 64 * CM_REGION_COMMIT_SIZE)
+
+cm_region *
+cm_region_init(_Bool huge_pages)
+{
+    cm_region *region = calloc(1, sizeof(*region));
+    if (region == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    for (size_t size = CM_REGION_MAX_RESERVE; size >= CM_REGION_MIN_RESERVE; size /= 2) {
+        region->mapping_size = size + CM_REGION_COMMIT_SIZE;
+        region->mapping = mmap(NULL, region->mapping_size, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (region->mapping != MAP_FAILED) {
+            region->reserved = size;
+            break;
+        }
+    }
+    if (region->reserved == 0)
+        err(EXIT_FAILURE, "Failed to reserve memory for a region");
+    region->base = (char *) (((uintptr_t) region->mapping + CM_REGION_COMMIT_SIZE - 1) &
+        ~(uintptr_t) (CM_REGION_COMMIT_SIZE - 1));
+#ifdef MADV_HUGEPAGE
+    /* only a hint, the kernel may not support transparent huge pages */
+    if (huge_pages)
+        madvise(region->base, region->reserved, MADV_HUGEPAGE);
+#endif
+    return region;
+}
+
+void
+cm_region_enter(cm_region *region)
+{
+    memcpy(region->saved_lists, cm_slab_free_lists, sizeof(cm_slab_free_lists));
+    memcpy(cm_slab_free_lists, region->free_lists, sizeof(cm_slab_free_lists));
+    cm_slab_region = region;
+}
+
+void
+cm_region_leave(cm_region *region)
+{
+    memcpy(region->free_lists, cm_slab_free_lists, sizeof(cm_slab_free_lists));
+    memcpy(cm_slab_free_lists, region->saved_lists, sizeof(cm_slab_free_lists));
+    cm_slab_region = NULL;
+}
+
+/* the region must not be entered */
+void
+cm_region_free(cm_region *region)
+{
+    if (munmap(region->mapping, region->mapping_size) == -1)
+        err(EXIT_FAILURE, "munmap failed");
+    free(region);
+}
+
+static void *
+region_alloc(cm_region *region, size_t size)
+{
+    size_t grow;
+    void *ptr;
+    size = (size + CM_SLAB_ALIGN - 1) & ~(size_t) (CM_SLAB_ALIGN - 1);
+    if (size > region->committed - region->used) {
+        grow = (size - (region->committed - region->used) + CM_REGION_COMMIT_SIZE - 1) &
+            ~(CM_REGION_COMMIT_SIZE - 1);
+        if (grow > region->reserved - region->committed)
+            errx(EXIT_FAILURE, "Region of %zu bytes exhausted", region->reserved);
+        if (mprotect(region->base + region->committed, grow, PROT_READ | PROT_WRITE) == -1)
+            err(EXIT_FAILURE, "mprotect failed");
+        region->committed += grow;
+    }
+    ptr = region->base + region->used;
+    region->used += size;
+    return ptr;
+}
+
+/* a large block, or a block of a class whose free list is empty */
+void *
+cm_slab_alloc_slow(size_t size)
+{
+    size_t class = (size - 1) / CM_SLAB_ALIGN;
+    size_t block_size = (class + 1) * CM_SLAB_ALIGN;
+    cm_region *region = cm_slab_region;
+    char *page;
+    if (size > CM_SLAB_MAX_SIZE) {
+        if (region != NULL)
+            return region_alloc(region, size);
+        page = malloc(size);
+        if (page == NULL)
+            err(EXIT_FAILURE, "malloc failed");
+        return page;
+    }
+    if (region != NULL) {
+        page = region_alloc(region, CM_SLAB_PAGE_SIZE);
+    } else {
+        page = malloc(CM_SLAB_PAGE_SIZE);
+        if (page == NULL)
+            err(EXIT_FAILURE, "malloc failed");
+    }
+    /* the first block is returned, the others make up the free list */
+    for (size_t offset = CM_SLAB_PAGE_SIZE / block_size * block_size;
+        offset > block_size; ) {
+        offset -= block_size;
+        cm_slab_block *block = (cm_slab_block *) (page + offset);
+        block->next = cm_slab_free_lists[class];
+        cm_slab_free_lists[class] = block;
+    }
+    return page;
+}
+
+/* a large block, or any block while inside a region */
+void
+cm_slab_free_slow(void *ptr, size_t size)
+{
+    cm_region *region = cm_slab_region;
+    cm_slab_block *block = ptr;
+    size_t class = (size - 1) / CM_SLAB_ALIGN;
+    if (region != NULL && cm_region_contains(region, ptr)) {
+        /* large blocks of a region are only released with it */
+        if (size <= CM_SLAB_MAX_SIZE) {
+            block->next = cm_slab_free_lists[class];
+            cm_slab_free_lists[class] = block;
+        }
+        return;
+    }
+    if (size > CM_SLAB_MAX_SIZE) {
+        free(ptr);
+        return;
+    }
+    block->next = region->saved_lists[class];
+    region->saved_lists[class] = block;
+}
+#endif
+
+/* like realloc, ptr may be NULL with old_size 0 */
+void *
+cm_slab_realloc(void *ptr, size_t old_size, size_t new_size)
+{
+    void *new_ptr;
+    if (old_size > CM_SLAB_MAX_SIZE && new_size > CM_SLAB_MAX_SIZE &&
+        (cm_slab_region == NULL || !cm_region_contains(cm_slab_region, ptr))) {
+        new_ptr = realloc(ptr, new_size);
+        if (new_ptr == NULL)
+            err(EXIT_FAILURE, "malloc failed");
+        return new_ptr;
+    }
+    new_ptr = cm_slab_alloc(new_size);
+    if (ptr != NULL) {
+        memcpy(new_ptr, ptr, old_size < new_size? old_size: new_size);
+        cm_slab_free(ptr, old_size);
+    }
+    return new_ptr;
+}
+
 void *
 cm_list_get_at(cm_list *list, size_t index)
 {
@@ -55,10 +262,7 @@ cm_list_get_at(cm_list *list, size_t index)
 cm_list *
 cm_list_init(void)
 {
-    cm_list *list;
-    list = malloc(sizeof(*list));
-    if (list == NULL)
-        errx(EXIT_FAILURE, "malloc failed");
+    cm_list *list = cm_slab_alloc(sizeof(*list));
     list->head = NULL;
     list->tail = NULL;
     list->length = 0;
@@ -68,9 +272,7 @@ cm_list_init(void)
 int
 cm_list_add(cm_list *list, void *data)
 {
-    cm_list_node *node = malloc(sizeof(*node));
-    if (node == NULL)
-        return 0;
+    cm_list_node *node = cm_slab_alloc(sizeof(*node));
     node->data = data;
     node->next = NULL;
     list->length++;
@@ -98,10 +300,10 @@ cm_list_free(cm_list *list, void (*free_data) (void *))
         // else
             // free(list_node->data);
         temp_node = list_node->next;
-        free(list_node);
+        cm_slab_free(list_node, sizeof(*list_node));
         list_node = temp_node;
     }
-    free(list);
+    cm_slab_free(list, sizeof(*list));
 }
 
 void *
@@ -162,97 +364,244 @@ bool_to_string(_Bool value)
     return "false";
 }
 
-cm_hash_table *
-cm_hash_table_init(size_t (*hash_func)(void *),
+/*
+ * cm_hash_table is a compact dictionary: the entries live in a dense
+ * array in insertion order, and a sparse open addressing index in the
+ * style of SwissTable maps keys to their position in it. Every slot of
+ * the index has a control byte, which is CTRL_EMPTY for a free slot, or
+ * the low 7 bits of the key's hash for a used slot, and the position of
+ * its entry. Lookups probe a group of GROUP_WIDTH control bytes at once,
+ * with SSE2 where available, and only call keyequals for the slots whose
+ * control byte matches. The control array has GROUP_WIDTH extra bytes
+ * mirroring the first group so that a group can be loaded at any slot.
+ * The index doubles when it is 7/8 full, the entries array grows on its
+ * own so that small tables stay small. Iterating, copying and freeing
+ * walk the entries array only.
+ */
+#define GROUP_WIDTH 16
+#define CTRL_EMPTY ((uint8_t) 0x80)
+
+static inline size_t
+hash_key(cm_hash_table *table, void *key)
+{
+    /* the hash functions have weak low bits, mix them up */
+    uint64_t hash = (uint64_t) table->hash_func(key) * 0x9e3779b97f4a7c15ULL;
+    return hash ^ (hash >> 32);
+}
+
+#define H1(hash) ((hash) >> 7)
+#define H2(hash) ((uint8_t) ((hash) & 0x7f))
+
+static inline uint32_t
+group_match(const uint8_t *ctrl, uint8_t h2)
+{
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *) ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < GROUP_WIDTH; i++)
+        if (ctrl[i] == h2)
+            mask |= 1u << i;
+    return mask;
+#endif
+}
+
+/* used slots have the high bit clear, so the empty ones are the sign bits */
+static inline uint32_t
+group_match_empty(const uint8_t *ctrl)
+{
+#ifdef __SSE2__
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+#else
+    return group_match(ctrl, CTRL_EMPTY);
+#endif
+}
+
+static void
+set_ctrl(cm_hash_table *table, size_t index, uint8_t h2)
+{
+    size_t mask = table->table_size - 1;
+    table->ctrl[index] = h2;
+    table->ctrl[((index - GROUP_WIDTH) & mask) + GROUP_WIDTH] = h2;
+}
+
+/* the slots array follows the control bytes in the same allocation */
+#define SLOTS_ALLOC_SIZE(table_size) \
+    ((table_size) + GROUP_WIDTH + (table_size) * sizeof(uint32_t))
+
+static void
+alloc_slots(cm_hash_table *table, size_t table_size)
+{
+    table->table_size = table_size;
+    table->growth_left = table_size - table_size / 8;
+    table->ctrl = cm_slab_alloc(SLOTS_ALLOC_SIZE(table_size));
+    table->slots = (uint32_t *) (table->ctrl + table_size + GROUP_WIDTH);
+    memset(table->ctrl, CTRL_EMPTY, table_size + GROUP_WIDTH);
+}
+
+/* the key at an index slot */
+#define SLOT_KEY(table, index) ((table)->entries[(table)->slots[(index)]].key)
+
+/*
+ * Returns the slot holding key, or the empty slot where it should be
+ * inserted with *found set to false. The probe sequence visits every group
+ * because the table size is a power of two, and it always ends because
+ * the table is never full.
+ */
+static size_t
+find_slot(cm_hash_table *table, void *key, size_t hash, _Bool *found)
+{
+    size_t mask = table->table_size - 1;
+    size_t pos = H1(hash) & mask;
+    size_t stride = 0;
+    uint8_t h2 = H2(hash);
+    for (;;) {
+        const uint8_t *group = table->ctrl + pos;
+        uint32_t matches = group_match(group, h2);
+        while (matches != 0) {
+            size_t index = (pos + __builtin_ctz(matches)) & mask;
+            if (table->keyequals(SLOT_KEY(table, index), key)) {
+                *found = true;
+                return index;
+            }
+            matches &= matches - 1;
+        }
+        uint32_t empty = group_match_empty(group);
+        if (empty != 0) {
+            *found = false;
+            return (pos + __builtin_ctz(empty)) & mask;
+        }
+        stride += GROUP_WIDTH;
+        pos = (pos + stride) & mask;
+    }
+}
+
+/* slot for a key which is known not to be in the table */
+static size_t
+find_empty_slot(cm_hash_table *table, size_t hash)
+{
+    size_t mask = table->table_size - 1;
+    size_t pos = H1(hash) & mask;
+    size_t stride = 0;
+    uint32_t empty;
+    while ((empty = group_match_empty(table->ctrl + pos)) == 0) {
+        stride += GROUP_WIDTH;
+        pos = (pos + stride) & mask;
+    }
+    return (pos + __builtin_ctz(empty)) & mask;
+}
+
+/* rebuilds the index for the entries, the entries do not move */
+static void
+resize(cm_hash_table *table, size_t table_size)
+{
+    cm_slab_free(table->ctrl, SLOTS_ALLOC_SIZE(table->table_size));
+    alloc_slots(table, table_size);
+    for (size_t i = 0; i < table->nkeys; i++) {
+        size_t hash = hash_key(table, table->entries[i].key);
+        size_t index = find_empty_slot(table, hash);
+        set_ctrl(table, index, H2(hash));
+        table->slots[index] = i;
+    }
+    table->growth_left -= table->nkeys;
+}
+
+static void
+alloc_entries(cm_hash_table *table, size_t entries_size)
+{
+    table->entries = cm_slab_realloc(table->entries,
+        table->entries_size * sizeof(*table->entries), entries_size * sizeof(*table->entries));
+    table->entries_size = entries_size;
+}
+
+static cm_hash_table *
+hash_table_init_size(size_t (*hash_func)(void *),
     _Bool (*keyequals) (void *, void *),
     void (*free_key) (void *),
-    void (*free_value) (void *))
+    void (*free_value) (void *),
+    size_t nkeys)
 {
     cm_hash_table *table;
-    table = malloc(sizeof(*table));
-    if (table == NULL)
-        errx(EXIT_FAILURE, "malloc failed");
+    size_t table_size = INITIAL_HASHTABLE_SIZE;
+    table = cm_slab_alloc(sizeof(*table));
     table->hash_func = hash_func;
     table->keyequals = keyequals;
     table->free_key = free_key;
     table->free_value = free_value;
-    table->table_size = INITIAL_HASHTABLE_SIZE;
-    table->table = calloc(table->table_size, sizeof(*table->table));
-    table->used_slots = cm_array_list_init(table->table_size, free);
-    if (table->table == NULL)
-        errx(EXIT_FAILURE, "malloc failed");
+    while (table_size - table_size / 8 < nkeys)
+        table_size *= 2;
+    alloc_slots(table, table_size);
+    table->entries = NULL;
+    table->entries_size = 0;
+    alloc_entries(table, nkeys > INITIAL_ENTRIES_SIZE? nkeys: INITIAL_ENTRIES_SIZE);
     table->nkeys = 0;
     return table;
 }
 
-static cm_hash_entry *
-find_entry(cm_list *list, cm_hash_entry *other_entry, _Bool (*keyequals) (void *, void *))
+cm_hash_table *
+cm_hash_table_init(size_t (*hash_func)(void *),
+    _Bool (*keyequals) (void *, void *),
+    void (*free_key) (void *),
+    void (*free_value) (void *))
 {
-    cm_list_node *node = list->head;
-    while (node) {
-        cm_hash_entry *entry = (node->data);
-        if (keyequals(entry->key, other_entry->key))
-            return entry;
-        node = node->next;
-    }
-    return NULL;
+    return hash_table_init_size(hash_func, keyequals, free_key, free_value, 0);
 }
 
-
 void
 cm_hash_table_put(cm_hash_table *hash_table, void *key, void *value)
 {
-    cm_hash_entry *entry = NULL;
-    size_t index = hash_table->hash_func(key) % hash_table->table_size;
-    cm_list *entry_list = hash_table->table[index];
-    if (entry_list == NULL) {
-        entry_list = cm_list_init();
-        hash_table->table[index] = entry_list;
-        size_t *used_slot = malloc(sizeof(*used_slot));
-        if (used_slot == NULL)
-            errx(EXIT_FAILURE, "malloc failed");
-        *used_slot = index;
-        cm_array_list_add(hash_table->used_slots, used_slot);
-        //TODO: resize when nentries == table size
-    } else {
-        cm_hash_entry temp_entry = {key, NULL};
-        entry = find_entry(entry_list, &temp_entry, hash_table->keyequals);
-    }
-
-    if (entry == NULL) {
-        entry = malloc(sizeof*entry);
-        if (entry == NULL)
-            errx(EXIT_FAILURE, "malloc failed");
-        entry->key = key;
-        entry->value = value;
-        hash_table->nkeys++;
-        cm_list_add(entry_list, entry);
-    } else {
+    _Bool found;
+    size_t hash = hash_key(hash_table, key);
+    size_t index = find_slot(hash_table, key, hash, &found);
+    cm_hash_entry *entry;
+    if (found) {
+        entry = &hash_table->entries[hash_table->slots[index]];
         if (hash_table->free_value)
             hash_table->free_value(entry->value);
         if (hash_table->free_key)
             hash_table->free_key(entry->key);
         entry->value = value;
         entry->key = key;
+        return;
     }
+    if (hash_table->growth_left == 0) {
+        resize(hash_table, hash_table->table_size * 2);
+        index = find_empty_slot(hash_table, hash);
+    }
+    if (hash_table->nkeys == hash_table->entries_size)
+        alloc_entries(hash_table, hash_table->entries_size * 2);
+    set_ctrl(hash_table, index, H2(hash));
+    hash_table->slots[index] = hash_table->nkeys;
+    entry = &hash_table->entries[hash_table->nkeys];
+    entry->key = key;
+    entry->value = value;
+    hash_table->growth_left--;
+    hash_table->nkeys++;
 }
 
 void *
 cm_hash_table_get(cm_hash_table *hash_table, void *key)
 {
-    size_t index = hash_table->hash_func(key) % hash_table->table_size;
-    cm_list *entry_list = hash_table->table[index];
-    cm_hash_entry *entry;
-    if (entry_list == NULL)
+    _Bool found;
+    size_t index = find_slot(hash_table, key, hash_key(hash_table, key), &found);
+    return found? hash_table->entries[hash_table->slots[index]].value: NULL;
+}
+
+void
+cm_hash_table_iterator_init(cm_hash_table_iterator *iterator, cm_hash_table *table)
+{
+    iterator->table = table;
+    iterator->index = 0;
+}
+
+cm_hash_entry *
+cm_hash_table_iterator_next(cm_hash_table_iterator *iterator)
+{
+    cm_hash_table *table = iterator->table;
+    if (iterator->index == table->nkeys)
         return NULL;
-    cm_list_node *list_node = entry_list->head;
-    while (list_node) {
-        entry = (cm_hash_entry *) list_node->data;
-        if (hash_table->keyequals(entry->key, key))
-            return entry->value;
-        list_node = list_node->next;
-    }
-    return NULL;
+    return &table->entries[iterator->index++];
 }
 
 cm_array_list *
@@ -261,17 +610,11 @@ cm_hash_table_get_keys(cm_hash_table *hash_table)
     if (hash_table->nkeys == 0)
         return NULL;
     cm_array_list *keys_list = cm_array_list_init(hash_table->nkeys, NULL);
-    for (size_t i = 0; i < hash_table->table_size; i++) {
-        cm_list *bucket = hash_table->table[i];
-        if (bucket == NULL)
-            continue;
-        cm_list_node *node = bucket->head;
-        while (node != NULL) {
-            cm_hash_entry *entry = (cm_hash_entry *) node->data;
-            node = node->next;
-            cm_array_list_add(keys_list, (void *) entry->key);
-        }
-    }
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_hash_table_iterator_init(&iterator, hash_table);
+    while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL)
+        cm_array_list_add(keys_list, entry->key);
     return keys_list;
 }
 
@@ -279,37 +622,24 @@ cm_array_list *
 cm_hash_table_get_values(cm_hash_table *hash_table)
 {
     cm_array_list *values_list = cm_array_list_init(hash_table->nkeys, NULL);
-    for (size_t i = 0; i < hash_table->table_size; i++) {
-        cm_list *bucket = hash_table->table[i];
-        if (bucket == NULL)
-            continue;
-        cm_list_node *node = bucket->head;
-        while (node != NULL) {
-            cm_hash_entry *entry = (cm_hash_entry *) node->data;
-            node = node->next;
-            cm_array_list_add(values_list, (void *) entry->value);
-        }
-    }
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_hash_table_iterator_init(&iterator, hash_table);
+    while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL)
+        cm_array_list_add(values_list, entry->value);
     return values_list;
 }
 
 cm_hash_table *
 cm_hash_table_copy(cm_hash_table *src, void * (*key_copy) (void *), void * (*value_copy) (void *))
 {
-    cm_hash_table *copy = cm_hash_table_init(src->hash_func,
-        src->keyequals, src->free_key, src->free_value);
-    for (size_t i = 0; i < src->used_slots->length; i++) {
-        size_t *index = (size_t *) src->used_slots->array[i];
-        cm_list *entry_list = src->table[*index];
-        cm_list_node *entry_node = entry_list->head;
-        while (entry_node != NULL) {
-            cm_hash_entry *entry = (cm_hash_entry *) entry_node->data;
-            void *key = entry->key;
-            void *value = entry->value;
-            cm_hash_table_put(copy, key_copy(key), value_copy(value));
-            entry_node = entry_node->next;
-        }
-    }
+    cm_hash_table *copy = hash_table_init_size(src->hash_func,
+        src->keyequals, src->free_key, src->free_value, src->nkeys);
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_hash_table_iterator_init(&iterator, src);
+    while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL)
+        cm_hash_table_put(copy, key_copy(entry->key), value_copy(entry->value));
     return copy;
 }
 
@@ -332,39 +662,18 @@ string_equals(void *key1, void *key2)
     return strcmp(strkey1, strkey2) == 0;
 }
 
-static void
-free_entry_list(cm_hash_table *table, cm_list *entry_list)
-{
-    cm_list_node *node = entry_list->head;
-    cm_list_node *temp;
-    while (node != NULL) {
-        cm_hash_entry *entry = (cm_hash_entry *) node->data;
-        if (table->free_key != NULL) {
-            table->free_key(entry->key);
-        }
-        if (table->free_value != NULL) {
-            table->free_value(entry->value);
-        }
-        free(entry);
-        temp = node->next;
-        free(node);
-        node = temp;
-    }
-    free(entry_list);
-}
-
 void
 cm_hash_table_free(cm_hash_table *table)
 {
-    for (size_t i = 0; i < table->table_size; i++) {
-        cm_list *entry_list = table->table[i];
-        if (entry_list != NULL) {
-            free_entry_list(table, entry_list);
-        }
+    for (size_t i = 0; i < table->nkeys; i++) {
+        if (table->free_key != NULL)
+            table->free_key(table->entries[i].key);
+        if (table->free_value != NULL)
+            table->free_value(table->entries[i].value);
     }
-    free(table->table);
-    cm_array_list_free(table->used_slots);
-    free(table);
+    cm_slab_free(table->ctrl, SLOTS_ALLOC_SIZE(table->table_size));
+    cm_slab_free(table->entries, table->entries_size * sizeof(*table->entries));
+    cm_slab_free(table, sizeof(*table));
 }
 
 cm_array_list *
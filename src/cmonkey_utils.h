@@ -34,7 +34,95 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-#define INITIAL_HASHTABLE_SIZE 64
+#define INITIAL_HASHTABLE_SIZE 16
+#define INITIAL_ENTRIES_SIZE 8
+
+/*
+ * Allocator for the small objects which the interpreters create and free
+ * all the time: monkey objects, vector nodes, list nodes and small hash
+ * tables. Sizes are rounded up to a multiple of CM_SLAB_ALIGN and every
+ * such size class has a free list per thread, refilled by carving up a
+ * CM_SLAB_PAGE_SIZE block. Freed blocks go to the list of the freeing
+ * thread and pages are never given back. The caller passes the size to
+ * cm_slab_free(), there is no header. Larger sizes go to malloc. Build
+ * with -DCM_NO_SLAB to use malloc for everything, e.g. for ASan.
+ */
+#define CM_SLAB_ALIGN 16
+#define CM_SLAB_MAX_SIZE 320
+#define CM_SLAB_NCLASSES (CM_SLAB_MAX_SIZE / CM_SLAB_ALIGN)
+#define CM_SLAB_PAGE_SIZE (64 * 1024)
+
+typedef struct cm_slab_block {
+    struct cm_slab_block *next;
+} cm_slab_block;
+
+/*
+ * While a thread is inside a region, between cm_region_enter() and
+ * cm_region_leave(), its slab allocations of any size are carved from the
+ * region: a range of address space reserved up front and committed as it
+ * fills, so that cm_region_free() releases all of it at once. Blocks of the
+ * region freed meanwhile are reused by the region, blocks from outside go
+ * back to the thread's own free lists. Nothing allocated inside may be
+ * used after the region is freed. With CM_NO_SLAB regions stay empty and
+ * every allocation goes to malloc as usual.
+ */
+typedef struct cm_region {
+    char *mapping;
+    size_t mapping_size;
+    char *base;         // aligned start of the usable range
+    size_t reserved;    // bytes of address space from base
+    size_t committed;   // bytes from base which are readable and writable
+    size_t used;
+    cm_slab_block *free_lists[CM_SLAB_NCLASSES];    // the region's while outside
+    cm_slab_block *saved_lists[CM_SLAB_NCLASSES];   // the thread's while inside
+} cm_region;
+
+extern _Thread_local cm_region *cm_slab_region;
+
+#define cm_region_contains(region, ptr) \
+    ((uintptr_t) (ptr) - (uintptr_t) (region)->base < (region)->reserved)
+
+cm_region *cm_region_init(_Bool);
+void cm_region_enter(cm_region *);
+void cm_region_leave(cm_region *);
+void cm_region_free(cm_region *);
+
+#ifdef CM_NO_SLAB
+void *cm_slab_alloc(size_t);
+void cm_slab_free(void *, size_t);
+#else
+extern _Thread_local cm_slab_block *cm_slab_free_lists[CM_SLAB_NCLASSES];
+void *cm_slab_alloc_slow(size_t);
+void cm_slab_free_slow(void *, size_t);
+
+/* size must not be 0 */
+static inline void *
+cm_slab_alloc(size_t size)
+{
+    size_t class = (size - 1) / CM_SLAB_ALIGN;
+    cm_slab_block *block;
+    if (size > CM_SLAB_MAX_SIZE || (block = cm_slab_free_lists[class]) == NULL)
+        return cm_slab_alloc_slow(size);
+    cm_slab_free_lists[class] = block->next;
+    return block;
+}
+
+static inline void
+cm_slab_free(void *ptr, size_t size)
+{
+    cm_slab_block *block = ptr;
+    size_t class = (size - 1) / CM_SLAB_ALIGN;
+    if (ptr == NULL)
+        return;
+    if (size > CM_SLAB_MAX_SIZE || cm_slab_region != NULL) {
+        cm_slab_free_slow(ptr, size);
+        return;
+    }
+    block->next = cm_slab_free_lists[class];
+    cm_slab_free_lists[class] = block;
+}
+#endif
+void *cm_slab_realloc(void *, size_t, size_t);
 
 typedef struct cm_list_node {
     void *data;
@@ -60,16 +148,25 @@ typedef struct cm_hash_entry {
 } cm_hash_entry;
 
 typedef struct cm_hash_table {
-    cm_list **table;
-    cm_array_list *used_slots;
-    size_t table_size;
+    uint8_t *ctrl; // control byte of each slot, see cmonkey_utils.c
+    uint32_t *slots; // position in entries of each used slot
+    cm_hash_entry *entries; // in insertion order
+    size_t table_size; // number of slots, always a power of 2
+    size_t entries_size; // allocated size of entries
     size_t nkeys; // actual number of keys stored
+    size_t growth_left; // keys which can be added before resizing
     size_t (*hash_func) (void *);
     _Bool (*keyequals) (void *, void *);
     void (*free_key) (void *);
     void (*free_value) (void *);
 } cm_hash_table;
 
+/* visits the entries of a table in insertion order */
+typedef struct cm_hash_table_iterator {
+    cm_hash_table *table;
+    size_t index;
+} cm_hash_table_iterator;
+
 typedef struct cm_stack {
     cm_list *list;
 } cm_stack;
@@ -107,6 +204,8 @@ void *cm_hash_table_get(cm_hash_table *, void *);
 void cm_hash_table_free(cm_hash_table *);
 cm_array_list *cm_hash_table_get_values(cm_hash_table *);
 cm_array_list *cm_hash_table_get_keys(cm_hash_table *);
+void cm_hash_table_iterator_init(cm_hash_table_iterator *, cm_hash_table *);
+cm_hash_entry *cm_hash_table_iterator_next(cm_hash_table_iterator *);
 cm_hash_table *cm_hash_table_copy(cm_hash_table *, void * (*key_copy) (void *), void * (*value_copy) (void *));
 size_t string_hash_function(void *);
 _Bool string_equals(void *, void *);
@@ -27,6 +27,7 @@
  * SUCH DAMAGE.
  */
 
+#include <err.h>
 #include <string.h>
 
 #include "cmonkey_utils.h"
@@ -43,12 +44,10 @@ test_hash_table_init(void)
     test(table->table_size == INITIAL_HASHTABLE_SIZE,
         "Expected hash table to initialize to size %d, found size %zu\n",
         INITIAL_HASHTABLE_SIZE, table->table_size);
-    for (size_t i = 0; i < INITIAL_HASHTABLE_SIZE; i++)
-        test(table->table[i] == NULL,
-            "Expected all entries of the table to be NULL, %zu entry is not null\n",
-            i);
-    test(table->used_slots->length == 0, "Expected nentries field to be 0, found %zu\n",
-        table->used_slots->length);
+    cm_hash_table_iterator iterator;
+    cm_hash_table_iterator_init(&iterator, table);
+    test(cm_hash_table_iterator_next(&iterator) == NULL,
+        "Expected no entries in a new table\n");
     test(table->nkeys == 0, "Expected nkeys to be 0, found %zu\n", table->nkeys);
     cm_hash_table_free(table);
 }
@@ -93,6 +92,47 @@ test_hash_table_put(void)
     cm_hash_table_free(table);
 }
 
+static void
+test_hash_table_resize(void)
+{
+    const size_t nkeys = 100000;
+    long *keys = malloc(nkeys * sizeof(*keys));
+    long *value;
+    size_t count = 0;
+    print_test_separator_line();
+    printf("Testing hash table growth and iteration order with %zu keys\n", nkeys);
+    test(keys != NULL, "malloc failed\n");
+    cm_hash_table *table = cm_hash_table_init(int_hash_function, int_equals, NULL, NULL);
+    for (size_t i = 0; i < nkeys; i++) {
+        keys[i] = (long) i * 64;
+        cm_hash_table_put(table, &keys[i], &keys[i]);
+    }
+    /* replacing the value of a key must not add an entry */
+    cm_hash_table_put(table, &keys[7], &keys[8]);
+    test(table->nkeys == nkeys, "Expected nkeys to be %zu, found %zu\n", nkeys, table->nkeys);
+    test(table->table_size >= nkeys, "Expected the table to grow, size is %zu\n",
+        table->table_size);
+    for (size_t i = 0; i < nkeys; i++) {
+        long key = (long) i * 64;
+        value = cm_hash_table_get(table, &key);
+        test(value == &keys[i == 7? 8: i], "Wrong value for key %ld\n", key);
+        key++;
+        test(cm_hash_table_get(table, &key) == NULL, "Found a value for missing key %ld\n", key);
+    }
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_hash_table_iterator_init(&iterator, table);
+    while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL) {
+        test(entry->key == &keys[count],
+            "Expected entry %zu in insertion order to have key %ld, found %ld\n",
+            count, keys[count], *(long *) entry->key);
+        count++;
+    }
+    test(count == nkeys, "Expected to iterate over %zu entries, got %zu\n", nkeys, count);
+    cm_hash_table_free(table);
+    free(keys);
+}
+
 static void
 test_cm_array_list_init(void)
 {
@@ -201,13 +241,97 @@ test_be_to_size_t(void)
     print_test_separator_line();
 }
 
+static void
+test_slab_alloc(void)
+{
+    const size_t sizes[] = {1, 16, 17, 88, CM_SLAB_MAX_SIZE, CM_SLAB_MAX_SIZE + 1, 4096};
+    const size_t nblocks = 10000;
+    size_t nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    unsigned char **blocks = malloc(nsizes * nblocks * sizeof(*blocks));
+    print_test_separator_line();
+    printf("Testing slab allocation\n");
+    if (blocks == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    /* enough blocks of each size to need several pages, all distinct and usable */
+    for (size_t i = 0; i < nsizes * nblocks; i++) {
+        size_t size = sizes[i % nsizes];
+        blocks[i] = cm_slab_alloc(size);
+        test(((uintptr_t) blocks[i] & (CM_SLAB_ALIGN - 1)) == 0,
+            "Expected a block of %zu bytes to be aligned\n", size);
+        memset(blocks[i], (int) (i & 0xff), size);
+    }
+    for (size_t i = 0; i < nsizes * nblocks; i++) {
+        size_t size = sizes[i % nsizes];
+        test(blocks[i][0] == (i & 0xff) && blocks[i][size - 1] == (i & 0xff),
+            "Expected block %zu to keep its contents\n", i);
+    }
+    for (size_t i = 0; i < nsizes * nblocks; i++)
+        cm_slab_free(blocks[i], sizes[i % nsizes]);
+
+    unsigned char *block = cm_slab_alloc(8);
+    memcpy(block, "slab", 5);
+    block = cm_slab_realloc(block, 8, 1000);
+    test(strcmp((char *) block, "slab") == 0, "Expected realloc to keep the contents\n");
+    block = cm_slab_realloc(block, 1000, 32);
+    test(strcmp((char *) block, "slab") == 0, "Expected shrinking to keep the contents\n");
+    cm_slab_free(block, 32);
+    free(blocks);
+}
+
+static void
+test_region(void)
+{
+    const size_t sizes[] = {8, 48, CM_SLAB_MAX_SIZE, 1000, 100000};
+    size_t nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    char *blocks[5 * 1000];
+    print_test_separator_line();
+    printf("Testing regions\n");
+    char *outside = cm_slab_alloc(32);
+    memcpy(outside, "outside", 8);
+    cm_region *region = cm_region_init(false);
+    cm_region_enter(region);
+    test(cm_slab_region == region, "Expected the region to be active\n");
+    for (size_t i = 0; i < nsizes * 1000; i++) {
+        size_t size = sizes[i % nsizes];
+        blocks[i] = cm_slab_alloc(size);
+        memset(blocks[i], (int) (i & 0xff), size);
+#ifndef CM_NO_SLAB
+        test(cm_region_contains(region, blocks[i]), "Expected block %zu in the region\n", i);
+#endif
+    }
+    for (size_t i = 0; i < nsizes * 1000; i++) {
+        size_t size = sizes[i % nsizes];
+        test(blocks[i][0] == (char) (i & 0xff) && blocks[i][size - 1] == (char) (i & 0xff),
+            "Expected block %zu to keep its contents\n", i);
+    }
+    /* blocks from inside and outside may be freed while the region is active */
+    cm_slab_free(blocks[0], sizes[0]);
+    test(!cm_region_contains(region, outside), "Expected the outside block not in the region\n");
+    test(strcmp(outside, "outside") == 0, "Expected the outside block to keep its contents\n");
+    cm_slab_free(outside, 32);
+    cm_region_leave(region);
+    test(cm_slab_region == NULL, "Expected no active region\n");
+    outside = cm_slab_alloc(32);
+    test(!cm_region_contains(region, outside), "Expected allocations outside the region\n");
+    cm_slab_free(outside, 32);
+#ifdef CM_NO_SLAB
+    /* the region does not own them without slabs */
+    for (size_t i = 1; i < nsizes * 1000; i++)
+        cm_slab_free(blocks[i], sizes[i % nsizes]);
+#endif
+    cm_region_free(region);
+}
+
 int
 main(int argc, char **argv)
 {
     test_hash_table_init();
     test_hash_table_put();
+    test_hash_table_resize();
     test_cm_array_list_init();
     test_cm_array_list();
     test_cm_array_list_init_size_t();
     test_be_to_size_t();
+    test_slab_alloc();
+    test_region();
 }
@@ -11,6 +11,30 @@
 
 #define CONSTANTS_POOL_INIT_SIZE 16
 
+/*
+ * Peephole table for superinstructions. When an instruction is emitted
+ * right after the first opcode of a pair, the two are merged in place into
+ * the fused opcode. Longer sequences are built up one pair at a time, e.g.
+ * OPGETLOCAL, OPGETLOCAL, OPADD becomes OPGETLOCAL2 and then OPADDLOCALS.
+ * The pairs were picked from the opcode pair counts reported by a VM built
+ * with -DVM_OPCODE_STATS.
+ */
+typedef struct superinstruction_t {
+    opcode_t first;
+    opcode_t second;
+    opcode_t fused;
+} superinstruction_t;
+
+static const superinstruction_t superinstructions[] = {
+    {OPGETLOCAL, OPGETLOCAL, OPGETLOCAL2},
+    {OPGETLOCAL, OPCONSTANT, OPGETLOCALCONSTANT},
+    {OPGETLOCAL2, OPADD, OPADDLOCALS},
+    {OPGETLOCALCONSTANT, OPADD, OPADDLOCALCONSTANT},
+    {OPGETLOCALCONSTANT, OPSUB, OPSUBLOCALCONSTANT},
+    {OPGREATERTHAN, OPJMPFALSE, OPGREATERTHANJMPFALSE},
+    {OPEQUAL, OPJMPFALSE, OPEQUALJMPFALSE}
+};
+
 static instructions_t *
 get_current_instructions(compiler_t *compiler)
 {
@@ -78,14 +102,48 @@ change_operand(compiler_t *compiler, size_t op_pos, size_t operand)
     instructions_free(new_ins);
 }
 
+/*
+ * Merges the instruction about to be emitted into the last emitted one if
+ * the pair has a superinstruction. An instruction that is the target of a
+ * jump must stay addressable, so it is never merged into its predecessor.
+ */
+static _Bool
+fuse_instruction(compiler_t *compiler, opcode_t op, instructions_t *ins)
+{
+    compilation_scope_t *scope = get_top_scope(compiler);
+    instructions_t operands;
+    size_t i, nfused = sizeof(superinstructions) / sizeof(superinstructions[0]);
+    if (scope->instructions->length == 0 ||
+        scope->instructions->length == scope->jump_target)
+        return false;
+    for (i = 0; i < nfused; i++) {
+        if (superinstructions[i].first == scope->last_instruction.opcode &&
+            superinstructions[i].second == op)
+            break;
+    }
+    if (i == nfused)
+        return false;
+    scope->instructions->bytes[scope->last_instruction.position] = superinstructions[i].fused;
+    operands.bytes = ins->bytes + 1;
+    operands.length = ins->length - 1;
+    operands.size = operands.length;
+    concat_instructions(scope->instructions, &operands);
+    scope->last_instruction.opcode = superinstructions[i].fused;
+    return true;
+}
+
 size_t
 emit(compiler_t *compiler, opcode_t op, ...)
 {
     va_list ap;
     va_start(ap, op);
     instructions_t *ins = vinstruction_init(op, ap);
-    size_t new_ins_pos = add_instructions(compiler, ins);
     va_end(ap);
+    if (fuse_instruction(compiler, op, ins)) {
+        instructions_free(ins);
+        return get_top_scope(compiler)->last_instruction.position;
+    }
+    size_t new_ins_pos = add_instructions(compiler, ins);
     set_last_instruction(compiler, op, new_ins_pos);
     return new_ins_pos;
 }
@@ -104,6 +162,10 @@ scope_init()
     scope->instructions->bytes = NULL;
     scope->instructions->length = 0;
     scope->instructions->size = 0;
+    scope->last_instruction.opcode = 0;
+    scope->last_instruction.position = 0;
+    scope->prev_instruction = scope->last_instruction;
+    scope->jump_target = 0;
     return scope;
 }
 
@@ -152,9 +214,9 @@ _strdup(void *s)
 }
 
 static void *
-_copy_monkey_object(void *obj)
+_retain_monkey_object(void *obj)
 {
-    return copy_monkey_object((monkey_object_t *) obj);
+    return retain_monkey_object((monkey_object_t *) obj);
 }
 
 static void *
@@ -181,7 +243,7 @@ compiler_init_with_state(symbol_table_t *symbol_table, cm_array_list *constants)
     compiler_t *compiler = compiler_init();
     free_symbol_table(compiler->symbol_table);
     compiler->symbol_table = symbol_table_copy(symbol_table);
-    compiler->constants_pool = cm_array_list_copy(constants, _copy_monkey_object);
+    compiler->constants_pool = cm_array_list_copy(constants, _retain_monkey_object);
     return compiler;
 }
 
@@ -205,7 +267,7 @@ static size_t
 add_constant(compiler_t *compiler, monkey_object_t *obj)
 {
     if (compiler->constants_pool == NULL)
-        compiler->constants_pool = cm_array_list_init(CONSTANTS_POOL_INIT_SIZE, free_monkey_object);
+        compiler->constants_pool = cm_array_list_init(CONSTANTS_POOL_INIT_SIZE, release_monkey_object);
     cm_array_list_add(compiler->constants_pool, obj);
     return compiler->constants_pool->length - 1;
 }
@@ -223,19 +285,6 @@ get_err_msg(const char *s, ...)
     return msg;
 }
 
-static int
-compare_monkey_hash_keys(const void *v1, const void *v2)
-{
-    node_t *n1 = (node_t *) v1;
-    node_t *n2 = (node_t *) v2;
-    char *s1 = n1->string(n1);
-    char *s2 = n2->string(n2);
-    int ret = strcmp(s1, s2);
-    free(s1);
-    free(s2);
-    return ret;
-}
-
 static void
 replace_last_pop_with_return(compiler_t *compiler)
 {
@@ -258,13 +307,14 @@ compile_expression_node(compiler_t *compiler, expression_t *expression_node)
     boolean_expression_t *bool_exp;
     identifier_t *ident_exp;
     if_expression_t *if_exp;
-    monkey_int_t *int_obj;
+    monkey_object_t *int_obj;
     monkey_bool_t *bool_obj;
     string_t *str_exp;
     monkey_string_t *str_obj;
     array_literal_t *array_exp;
     hash_literal_t *hash_exp;
     index_expression_t *index_exp;
+    slice_expression_t *slice_exp;
     function_literal_t *func_exp;
     call_expression_t *call_exp;
     size_t constant_idx;
@@ -273,7 +323,7 @@ compile_expression_node(compiler_t *compiler, expression_t *expression_node)
     switch (expression_node->expression_type) {
     case INFIX_EXPRESSION:
         infix_exp = (infix_expression_t *) expression_node;
-        if (strcmp(infix_exp->operator, "<") == 0) {
+        if (infix_exp->op == OPERATOR_LESS_THAN) {
             error = compile(compiler, (node_t *) infix_exp->right);
             if (error.code != COMPILER_ERROR_NONE)
                 return error;
@@ -289,21 +339,29 @@ compile_expression_node(compiler_t *compiler, expression_t *expression_node)
         error = compile(compiler, (node_t *) infix_exp->right);
         if (error.code != COMPILER_ERROR_NONE)
             return error;
-        if (strcmp(infix_exp->operator, "+") == 0)
+        switch (infix_exp->op) {
+        case OPERATOR_PLUS:
             emit(compiler, OPADD);
-        else if (strcmp(infix_exp->operator, "-") == 0)
+            break;
+        case OPERATOR_MINUS:
             emit(compiler, OPSUB);
-        else if (strcmp(infix_exp->operator, "*") == 0)
+            break;
+        case OPERATOR_MULTIPLY:
             emit(compiler, OPMUL);
-        else if(strcmp(infix_exp->operator, "/") == 0)
+            break;
+        case OPERATOR_DIVIDE:
             emit(compiler, OPDIV);
-        else if (strcmp(infix_exp->operator, ">") == 0)
+            break;
+        case OPERATOR_GREATER_THAN:
             emit(compiler, OPGREATERTHAN);
-        else if (strcmp(infix_exp->operator, "==") == 0)
+            break;
+        case OPERATOR_EQUAL:
             emit(compiler, OPEQUAL);
-        else if (strcmp(infix_exp->operator, "!=") == 0)
+            break;
+        case OPERATOR_NOT_EQUAL:
             emit(compiler, OPNOTEQUAL);
-        else {
+            break;
+        default:
             error.code = COMPILER_UNKNOWN_OPERATOR;
             error.msg = get_err_msg("Unknown operator %s", infix_exp->operator);
             return error;
@@ -314,11 +372,14 @@ compile_expression_node(compiler_t *compiler, expression_t *expression_node)
         error = compile(compiler, (node_t *) prefix_exp->right);
         if (error.code != COMPILER_ERROR_NONE)
             return error;
-        if (strcmp(prefix_exp->operator, "-") == 0)
+        switch (prefix_exp->op) {
+        case OPERATOR_MINUS:
             emit(compiler, OPMINUS);
-        else if (strcmp(prefix_exp->operator, "!") == 0)
+            break;
+        case OPERATOR_BANG:
             emit(compiler, OPBANG);
-        else {
+            break;
+        default:
             error.code = COMPILER_UNKNOWN_OPERATOR;
             error.msg = get_err_msg("Unknown operator %s", prefix_exp->operator);
             return error;
@@ -326,8 +387,8 @@ compile_expression_node(compiler_t *compiler, expression_t *expression_node)
         break;
     case INTEGER_EXPRESSION:
         int_exp = (integer_t *) expression_node;
-        int_obj = create_monkey_int(int_exp->value);
-        constant_idx = add_constant(compiler, (monkey_object_t *) int_obj);
+        int_obj = create_monkey_int_object(int_exp->value);
+        constant_idx = add_constant(compiler, int_obj);
         emit(compiler, OPCONSTANT, constant_idx);
         break;
     case BOOLEAN_EXPRESSION:
@@ -340,7 +401,7 @@ compile_expression_node(compiler_t *compiler, expression_t *expression_node)
         break;
     case STRING_EXPRESSION:
         str_exp = (string_t *) expression_node;
-        str_obj = create_monkey_string(str_exp->value, strlen(str_exp->value));
+        str_obj = intern_monkey_string(str_exp->value, strlen(str_exp->value));
         size_t constant_idx = add_constant(compiler, (monkey_object_t *) str_obj);
         emit(compiler, OPCONSTANT, constant_idx);
         break;
@@ -359,6 +420,7 @@ compile_expression_node(compiler_t *compiler, expression_t *expression_node)
         scope = get_top_scope(compiler);
         after_consequence_pos = scope->instructions->length;
         change_operand(compiler, opjmpfalse_pos, after_consequence_pos);
+        scope->jump_target = after_consequence_pos;
         if (if_exp->alternative == NULL) {
             emit(compiler, OPNULL);
         } else {
@@ -370,6 +432,7 @@ compile_expression_node(compiler_t *compiler, expression_t *expression_node)
         }
         after_alternative_pos = scope->instructions->length;
         change_operand(compiler, jmp_pos, after_alternative_pos);
+        scope->jump_target = after_alternative_pos;
         break;
     case IDENTIFIER_EXPRESSION:
         ident_exp = (identifier_t *) expression_node;
@@ -394,7 +457,6 @@ compile_expression_node(compiler_t *compiler, expression_t *expression_node)
         hash_exp = (hash_literal_t *) expression_node;
         cm_array_list *keys = cm_hash_table_get_keys(hash_exp->pairs);
         if (keys != NULL) {
-           cm_array_list_sort(keys, sizeof(node_t *), compare_monkey_hash_keys);
             for (size_t i = 0; i < keys->length; i++) {
                 node_t *key = (node_t *) cm_array_list_get(keys, i);
                 node_t *value = (node_t *) cm_hash_table_get(hash_exp->pairs, key);
@@ -419,6 +481,24 @@ compile_expression_node(compiler_t *compiler, expression_t *expression_node)
             return error;
         emit(compiler, OPINDEX);
         break;
+    case SLICE_EXPRESSION:
+        /* a missing bound is pushed as null */
+        slice_exp = (slice_expression_t *) expression_node;
+        error = compile(compiler, (node_t *) slice_exp->left);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+        expression_t *bounds[] = {slice_exp->start, slice_exp->end};
+        for (size_t i = 0; i < 2; i++) {
+            if (bounds[i] == NULL) {
+                emit(compiler, OPNULL);
+                continue;
+            }
+            error = compile(compiler, (node_t *) bounds[i]);
+            if (error.code != COMPILER_ERROR_NONE)
+                return error;
+        }
+        emit(compiler, OPSLICE);
+        break;
     case FUNCTION_LITERAL:
         func_exp = (function_literal_t *) expression_node;
         compiler_enter_scope(compiler);
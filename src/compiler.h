@@ -16,6 +16,7 @@ typedef struct compilation_scope_t {
     instructions_t *instructions;
     emitted_instrucion_t last_instruction;
     emitted_instrucion_t prev_instruction;
+    size_t jump_target; // position most recently patched into a jump
 } compilation_scope_t;
 
 
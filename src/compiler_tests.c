@@ -16,7 +16,7 @@ create_constant_pool(size_t count, ...)
 {
     va_list ap;
     va_start(ap, count);
-    cm_array_list *list = cm_array_list_init(count, free_monkey_object);
+    cm_array_list *list = cm_array_list_init(count, release_monkey_object);
     for (size_t i = 0; i < count; i++) {
         monkey_object_t *obj = (monkey_object_t *) va_arg(ap, monkey_object_t *);
         cm_array_list_add(list, obj);
@@ -60,9 +60,10 @@ test_constant_pool(cm_array_list *expected, cm_array_list *actual)
         for (size_t i = 0; i < expected->length; i++) {
             monkey_object_t *expected_obj = (monkey_object_t *) cm_array_list_get(expected, i);
             monkey_object_t *actual_obj = (monkey_object_t *) cm_array_list_get(actual, i);
-            test(expected_obj->type == actual_obj->type,
+            test(get_monkey_object_type(expected_obj) == get_monkey_object_type(actual_obj),
                 "Expected constant type %s at index %zu, found %s\n",
-                get_type_name(expected_obj->type), i, get_type_name(actual_obj->type));
+                get_type_name(get_monkey_object_type(expected_obj)), i,
+                get_type_name(get_monkey_object_type(actual_obj)));
             test_monkey_object(actual_obj, expected_obj);
         }
         cm_array_list_free(expected);
@@ -525,6 +526,23 @@ test_index_expressions(void)
                 (monkey_object_t *) create_monkey_int(2),
                 (monkey_object_t *) create_monkey_int(2),
                 (monkey_object_t *) create_monkey_int(1))
+        },
+        {
+            "[1, 2][1:]",
+            7,
+            {
+                instruction_init(OPCONSTANT, 0),
+                instruction_init(OPCONSTANT, 1),
+                instruction_init(OPARRAY, 2),
+                instruction_init(OPCONSTANT, 2),
+                instruction_init(OPNULL),
+                instruction_init(OPSLICE),
+                instruction_init(OPPOP)
+            },
+            create_constant_pool(3,
+                (monkey_object_t *) create_monkey_int(1),
+                (monkey_object_t *) create_monkey_int(2),
+                (monkey_object_t *) create_monkey_int(1))
         }
     };
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
@@ -759,14 +777,12 @@ test_let_statement_scope(void)
             create_constant_pool(3,
                 (monkey_object_t *) create_monkey_int(55),
                 (monkey_object_t *) create_monkey_int(77),
-                (monkey_object_t *) create_monkey_compiled_fn(create_compiled_fn_instructions(8,
+                (monkey_object_t *) create_monkey_compiled_fn(create_compiled_fn_instructions(6,
                     instruction_init(OPCONSTANT, 0),
                     instruction_init(OPSETLOCAL, 0),
                     instruction_init(OPCONSTANT, 1),
                     instruction_init(OPSETLOCAL, 1),
-                    instruction_init(OPGETLOCAL, 0),
-                    instruction_init(OPGETLOCAL, 1),
-                    instruction_init(OPADD),
+                    instruction_init(OPADDLOCALS, 0, 1),
                     instruction_init(OPRETURNVALUE)), 2, 0))
         }
     };
@@ -820,6 +836,88 @@ test_builtins(void)
     run_compiler_tests(ntests, tests);
 }
 
+static void
+test_superinstructions(void)
+{
+    compiler_test tests[] = {
+        {
+            "if (1 > 2) {10}; 3333;",
+            9,
+            {
+                instruction_init(OPCONSTANT, 0),
+                instruction_init(OPCONSTANT, 1),
+                instruction_init(OPGREATERTHANJMPFALSE, 15),
+                instruction_init(OPCONSTANT, 2),
+                instruction_init(OPJMP, 16),
+                instruction_init(OPNULL),
+                instruction_init(OPPOP),
+                instruction_init(OPCONSTANT, 3),
+                instruction_init(OPPOP)
+            },
+            create_constant_pool(4, (monkey_object_t *) create_monkey_int(1),
+                (monkey_object_t *) create_monkey_int(2),
+                (monkey_object_t *) create_monkey_int(10),
+                (monkey_object_t *) create_monkey_int(3333))
+        },
+        {
+            "fn(n) { n - 1 };",
+            2,
+            {
+                instruction_init(OPCONSTANT, 1),
+                instruction_init(OPPOP)
+            },
+            create_constant_pool(2,
+                (monkey_object_t *) create_monkey_int(1),
+                (monkey_object_t *) create_monkey_compiled_fn(
+                    create_compiled_fn_instructions(2,
+                    instruction_init(OPSUBLOCALCONSTANT, 0, 0),
+                    instruction_init(OPRETURNVALUE)), 1, 1))
+        },
+        {
+            "fn(a, b) { if (a == b) { a } };",
+            2,
+            {
+                instruction_init(OPCONSTANT, 0),
+                instruction_init(OPPOP)
+            },
+            create_constant_pool(1,
+                (monkey_object_t *) create_monkey_compiled_fn(
+                    create_compiled_fn_instructions(6,
+                    instruction_init(OPGETLOCAL2, 0, 1),
+                    instruction_init(OPEQUALJMPFALSE, 11),
+                    instruction_init(OPGETLOCAL, 0),
+                    instruction_init(OPJMP, 12),
+                    instruction_init(OPNULL),
+                    instruction_init(OPRETURNVALUE)), 2, 2))
+        },
+        {
+            // the jump target must not be fused into the end of the alternative
+            "fn(a, b) { (if (a) { b } else { a }) + b };",
+            2,
+            {
+                instruction_init(OPCONSTANT, 0),
+                instruction_init(OPPOP)
+            },
+            create_constant_pool(1,
+                (monkey_object_t *) create_monkey_compiled_fn(
+                    create_compiled_fn_instructions(8,
+                    instruction_init(OPGETLOCAL, 0),
+                    instruction_init(OPJMPFALSE, 10),
+                    instruction_init(OPGETLOCAL, 1),
+                    instruction_init(OPJMP, 12),
+                    instruction_init(OPGETLOCAL, 0),
+                    instruction_init(OPGETLOCAL, 1),
+                    instruction_init(OPADD),
+                    instruction_init(OPRETURNVALUE)), 2, 2))
+        }
+    };
+
+    print_test_separator_line();
+    printf("Testing superinstruction selection\n");
+    size_t ntests = sizeof(tests) / sizeof(tests[0]);
+    run_compiler_tests(ntests, tests);
+}
+
 static void
 test_integer_arithmetic(void)
 {
@@ -912,4 +1010,5 @@ main(int argc, char **argv)
     test_function_calls();
     test_let_statement_scope();
     test_builtins();
+    test_superinstructions();
 }
\ No newline at end of file
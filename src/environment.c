@@ -35,83 +35,116 @@
 #include "environment.h"
 #include "object.h"
 
-static void
-free_value(void *value)
-{
-    monkey_object_t *obj = (monkey_object_t *) value;
-    free_monkey_object(obj);
-}
+#define is_global_env(env) ((env)->values != (void **) ((env) + 1))
+
+#define is_closure_of(env, value) (get_monkey_object_type(value) == MONKEY_FUNCTION && \
+    ((monkey_function_t *) (value))->env == (env))
 
 environment_t *
 create_env(void)
 {
-    cm_hash_table *table = cm_hash_table_init(
-        string_hash_function,
-        string_equals,
-        free,
-        free_value);
-    environment_t *env;
-    env = malloc(sizeof(*env));
-    if (env == NULL)
-        errx(EXIT_FAILURE, "malloc failed");
-    env->table = table;
+    environment_t *env = cm_slab_alloc(sizeof(*env));
     env->outer = NULL;
+    env->refcount = 1;
+    env->nclosures = 0;
+    env->size = 0;
+    env->values = NULL;
     return env;
 }
 
 environment_t *
-create_enclosed_env(environment_t *outer)
+create_enclosed_env(environment_t *outer, size_t size)
 {
-    environment_t *env = create_env();
-    env->outer = copy_env(outer);
+    environment_t *env = cm_slab_alloc(sizeof(*env) + size * sizeof(*env->values));
+    env->outer = env_retain(outer);
+    env->refcount = 1;
+    env->nclosures = 0;
+    env->size = size;
+    env->values = (void **) (env + 1);
+    memset(env->values, 0, size * sizeof(*env->values));
     return env;
 }
 
+/* takes over the reference to value and releases the one in the slot */
 void
-env_put(environment_t *env, char *name, void *value)
+env_put(environment_t *env, size_t slot, void *value)
 {
-    cm_hash_table_put(env->table, (void *) name, value);
+    size_t size;
+    void **values;
+    if (slot >= env->size) {
+        if (!is_global_env(env))
+            errx(EXIT_FAILURE, "slot %zu out of the %zu of the environment", slot, env->size);
+        size = env->size == 0? 8: env->size;
+        while (size <= slot)
+            size *= 2;
+        values = cm_slab_realloc(env->values, env->size * sizeof(*values),
+            size * sizeof(*values));
+        memset(values + env->size, 0, (size - env->size) * sizeof(*values));
+        env->values = values;
+        env->size = size;
+    }
+    if (env->values[slot] != NULL && is_closure_of(env, env->values[slot]))
+        env->nclosures--;
+    if (value != NULL && is_closure_of(env, value))
+        env->nclosures++;
+    release_monkey_object(env->values[slot]);
+    env->values[slot] = value;
 }
 
-void *
-env_get(environment_t *env, char *name)
+environment_t *
+env_retain(environment_t *env)
 {
-    void *value;
-    value = cm_hash_table_get(env->table, (void *) name);
-    if (value != NULL)
-        return value;
-    
-    if (env->outer != NULL)
-        return env_get(env->outer, name);
-    return NULL;
+    if (env != NULL)
+        env->refcount++;
+    return env;
 }
 
+/* a closure of env in one of its slots which nothing else references */
+#define is_owned_closure(env, value) ((value) != NULL && is_closure_of(env, value) && \
+    ((monkey_object_t *) (value))->refcount == 1)
+
+/*
+ * Frees the environment once only functions in its own slots reference it.
+ * Counting them is only needed when every reference could be one of them,
+ * the reference of a running call or of the REPL rules that out at once.
+ */
 void
-env_free(environment_t *env)
+env_collect(environment_t *env)
 {
-    if (env->outer != NULL) {
-        env_free(env->outer);
+    size_t owned = 0;
+    environment_t *outer = env->outer;
+    if (env->refcount > 0) {
+        if (env->refcount > env->nclosures)
+            return;
+        for (size_t i = 0; i < env->size; i++) {
+            if (is_owned_closure(env, env->values[i]))
+                owned++;
+        }
+        if (owned < env->refcount)
+            return;
+        /* the functions let go of the environment without freeing it again */
+        for (size_t i = 0; i < env->size; i++) {
+            if (is_owned_closure(env, env->values[i]))
+                ((monkey_function_t *) env->values[i])->env = NULL;
+        }
+        env->refcount = 0;
     }
-    cm_hash_table_free(env->table);
-    free(env);
+    for (size_t i = 0; i < env->size; i++)
+        release_monkey_object(env->values[i]);
+    if (is_global_env(env)) {
+        cm_slab_free(env->values, env->size * sizeof(*env->values));
+        cm_slab_free(env, sizeof(*env));
+    } else {
+        cm_slab_free(env, sizeof(*env) + env->size * sizeof(*env->values));
+    }
+    if (outer != NULL)
+        env_free(outer);
 }
 
-environment_t *
-copy_env(environment_t *env)
+/* drops a reference to the environment */
+void
+env_free(environment_t *env)
 {
-    environment_t *new_env = create_env();
-    for (size_t i = 0; i < env->table->table_size; i++) {
-        cm_list *entry_list = env->table->table[i];
-        if (entry_list == NULL)
-            continue;
-        cm_list_node *node = entry_list->head;
-        while (node != NULL) {
-            cm_hash_entry *entry = (cm_hash_entry *) node->data;
-            char *key = (char *) entry->key;
-            monkey_object_t *value = (monkey_object_t *) entry->value;
-            env_put(new_env, strdup(key), copy_monkey_object(value));
-            node = node->next;
-        }
-    }
-    return new_env;
+    env->refcount--;
+    env_collect(env);
 }
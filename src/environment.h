@@ -30,17 +30,43 @@
 #ifndef ENVIRONMENT_H
 #define ENVIRONMENT_H
 
-#include "cmonkey_utils.h"
+#include <stddef.h>
 
+/*
+ * The variables of a function call, or of the program for the global
+ * environment, in the slots the resolver gave them. A slot is NULL until
+ * its let or parameter sets it. Only the global environment grows, the
+ * REPL keeps adding globals to it; the slots of the others follow the
+ * environment in the same allocation.
+ *
+ * Environments are counted references shared by the calls and functions
+ * they enclose, a function keeps the environment it was defined in. A
+ * function stored in the environment it encloses, like any function
+ * defined with let, makes a cycle, so an environment is also freed when
+ * the only references left are from such functions which nothing else
+ * references.
+ */
 typedef struct environment_t {
-    cm_hash_table *table;
     struct environment_t *outer;
+    size_t refcount;
+    size_t nclosures;   // slots holding functions which enclose the environment
+    size_t size;
+    void **values;
 } environment_t;
 
-void *env_get(environment_t *, char *);
-void env_put(environment_t *, char *, void *);
+/* the value in the slot of the environment depth levels out from env */
+static inline void *
+env_get(environment_t *env, size_t depth, size_t slot)
+{
+    while (depth-- > 0)
+        env = env->outer;
+    return slot < env->size? env->values[slot]: NULL;
+}
+
+void env_put(environment_t *, size_t, void *);
 environment_t *create_env(void);
-environment_t *create_enclosed_env(environment_t *);
+environment_t *create_enclosed_env(environment_t *, size_t);
+environment_t *env_retain(environment_t *);
 void env_free(environment_t *);
-environment_t *copy_env(environment_t *);
-#endif
\ No newline at end of file
+void env_collect(environment_t *);
+#endif
@@ -40,123 +40,111 @@
 static _Bool
 is_error(monkey_object_t *obj)
 {
-    return obj != NULL && obj->type == MONKEY_ERROR;
+    return obj != NULL && get_monkey_object_type(obj) == MONKEY_ERROR;
 }
 
 static monkey_object_t *
-eval_boolean_infix_expression(const char *operator,
+eval_boolean_infix_expression(operator_t op,
     monkey_bool_t *left_value, monkey_bool_t *right_value)
 {
     _Bool result;
-    if (strcmp(operator, "&&") == 0)
+    switch (op) {
+    case OPERATOR_AND:
         result = left_value->value && right_value->value;
-    else if (strcmp(operator, "||") == 0)
+        break;
+    case OPERATOR_OR:
         result = left_value->value || right_value->value;
-    else if (strcmp(operator, "==") == 0)
+        break;
+    case OPERATOR_EQUAL:
         result = left_value->value == right_value->value;
-    else if (strcmp(operator, "!=") == 0)
+        break;
+    case OPERATOR_NOT_EQUAL:
         result = left_value->value != right_value->value;
-    else
+        break;
+    default:
         return (monkey_object_t *) create_monkey_error("unknown operator: %s %s %s",
-            get_type_name(left_value->object.type), operator,
+            get_type_name(left_value->object.type), operator_values[op],
             get_type_name(right_value->object.type));
+    }
     return (monkey_object_t *) create_monkey_bool(result);
 }
 
 static monkey_object_t *
-eval_integer_infix_expression(const char *operator,
-    monkey_int_t *left_value,
-    monkey_int_t *right_value)
+eval_integer_infix_expression(operator_t op,
+    long left_value,
+    long right_value)
 {
     long result;
-    if (strcmp(operator, "+") == 0)
-        result = left_value->value + right_value->value;
-    else if (strcmp(operator, "-") == 0)
-        result = left_value->value - right_value->value;
-    else if (strcmp(operator, "*") == 0)
-        result = left_value->value * right_value->value;
-    else if (strcmp(operator, "/") == 0)
-        if (right_value->value != 0)
-            result = left_value->value / right_value->value;
-        else
+    switch (op) {
+    case OPERATOR_PLUS:
+        result = left_value + right_value;
+        break;
+    case OPERATOR_MINUS:
+        result = left_value - right_value;
+        break;
+    case OPERATOR_MULTIPLY:
+        result = left_value * right_value;
+        break;
+    case OPERATOR_DIVIDE:
+        if (right_value == 0)
             return (monkey_object_t *) create_monkey_error("division by 0 not allowed");
-    else if (strcmp(operator, "<") == 0)
-        return (monkey_object_t *)
-            create_monkey_bool(left_value->value < right_value->value);
-    else if (strcmp(operator, ">") == 0)
-        return (monkey_object_t *)
-            create_monkey_bool(left_value->value > right_value->value);
-    else if (strcmp(operator, "==") == 0)
-        return (monkey_object_t *)
-            (monkey_object_t *) create_monkey_bool(left_value->value == right_value->value);
-    else if (strcmp(operator, "!=") == 0)
-        return (monkey_object_t *)
-            create_monkey_bool(left_value->value != right_value->value);
-    else if (strcmp(operator, "%") == 0)
-    if (right_value->value != 0)
-        result = left_value->value % right_value->value;
-    else
-        return (monkey_object_t *) create_monkey_error("division by 0 not allowed");
-    else
+        result = left_value / right_value;
+        break;
+    case OPERATOR_MODULO:
+        if (right_value == 0)
+            return (monkey_object_t *) create_monkey_error("division by 0 not allowed");
+        result = left_value % right_value;
+        break;
+    case OPERATOR_LESS_THAN:
+        return (monkey_object_t *) create_monkey_bool((left_value < right_value));
+    case OPERATOR_GREATER_THAN:
+        return (monkey_object_t *) create_monkey_bool((left_value > right_value));
+    case OPERATOR_EQUAL:
+        return (monkey_object_t *) create_monkey_bool((left_value == right_value));
+    case OPERATOR_NOT_EQUAL:
+        return (monkey_object_t *) create_monkey_bool((left_value != right_value));
+    default:
         return (monkey_object_t *) create_monkey_error("unknown operator: %s %s %s",
-            get_type_name(left_value->object.type), operator,
-            get_type_name(right_value->object.type));
+            get_type_name(MONKEY_INT), operator_values[op], get_type_name(MONKEY_INT));
+    }
     return (monkey_object_t *) create_monkey_int(result);
 }
 
 static monkey_object_t *
-eval_string_infix_expression(const char *operator,
+eval_string_infix_expression(operator_t op,
     monkey_string_t *left_value,
     monkey_string_t *right_value)
 {
-    if (strcmp(operator, "+") == 0) {
-        size_t new_len = left_value->length + right_value->length;
-        char *new_string = malloc(new_len + 1);
-        memcpy(new_string, left_value->value, left_value->length);
-        memcpy(new_string + left_value->length, right_value->value, right_value->length);
-        new_string[new_len] = 0;
-        monkey_string_t *new_string_obj = create_monkey_string(NULL, 0);
-        new_string_obj->value = new_string;
-        new_string_obj->length = new_len;
-        return (monkey_object_t *) new_string_obj;
-    }
-
-    if (strcmp(operator, "==") == 0) {
-        if (strcmp(left_value->value, right_value->value) == 0)
-            return (monkey_object_t *) create_monkey_bool(true);
-        else
-            return (monkey_object_t *) create_monkey_bool(false);
-    }
-
-    if (strcmp(operator, "!=") == 0) {
-        if (strcmp(left_value->value, right_value->value) == 0)
-            return (monkey_object_t *) create_monkey_bool(false);
-        else
-            return (monkey_object_t *) create_monkey_bool(true);
-    }
-
-    return (monkey_object_t *) create_monkey_error("unknown operator: %s %s %s",
+    switch (op) {
+    case OPERATOR_PLUS:
+        return (monkey_object_t *) concat_monkey_strings(left_value, right_value);
+    case OPERATOR_EQUAL:
+        return (monkey_object_t *) create_monkey_bool(monkey_object_equals(left_value, right_value));
+    case OPERATOR_NOT_EQUAL:
+        return (monkey_object_t *) create_monkey_bool(!monkey_object_equals(left_value, right_value));
+    default:
+        return (monkey_object_t *) create_monkey_error("unknown operator: %s %s %s",
             get_type_name(left_value->object.type),
-            operator,
+            operator_values[op],
             get_type_name(right_value->object.type));
+    }
 }
 
 static monkey_object_t *
 eval_minus_prefix_expression(monkey_object_t *right_value)
 {
-    if (right_value->type != MONKEY_INT)
+    if (get_monkey_object_type(right_value) != MONKEY_INT)
         return (monkey_object_t *) create_monkey_error("unknown operator: -%s",
-            get_type_name(right_value->type));
-    monkey_int_t *int_obj = (monkey_int_t *) right_value;
-    return (monkey_object_t *) create_monkey_int(-(int_obj->value));
+            get_type_name(get_monkey_object_type(right_value)));
+    return (monkey_object_t *) create_monkey_int(-get_monkey_int_value(right_value));
 }
 
 static monkey_object_t *
 eval_bang_expression(monkey_object_t *right_value)
 {
-    if (right_value->type == MONKEY_NULL)
+    if (get_monkey_object_type(right_value) == MONKEY_NULL)
         return (monkey_object_t *) create_monkey_null();
-    else if (right_value->type == MONKEY_BOOL) {
+    else if (get_monkey_object_type(right_value) == MONKEY_BOOL) {
         monkey_bool_t *value = (monkey_bool_t *) right_value;
         if (value->value)
             return (monkey_object_t *) create_monkey_bool(false);
@@ -166,53 +154,57 @@ eval_bang_expression(monkey_object_t *right_value)
         return (monkey_object_t *) create_monkey_bool(false);
 }
 
-static monkey_object_t *
-eval_prefix_epxression(const char *operator, monkey_object_t *right_value)
+monkey_object_t *
+eval_prefix_expression(operator_t op, monkey_object_t *right_value)
 {
-    if (strcmp(operator, "!") == 0) {
+    switch (op) {
+    case OPERATOR_BANG:
         return eval_bang_expression(right_value);
-    } else if (strcmp(operator, "-") == 0) {
+    case OPERATOR_MINUS:
         return eval_minus_prefix_expression(right_value);
+    default:
+        return (monkey_object_t *) create_monkey_error("unknown operator: %s%s",
+            operator_values[op], get_type_name(get_monkey_object_type(right_value)));
     }
-    return (monkey_object_t *) create_monkey_error("unknown operator: %s%s",
-        operator, get_type_name(right_value->type));
 }
 
-static monkey_object_t *
-eval_infix_expression(const char *operator,
+monkey_object_t *
+eval_infix_expression(operator_t op,
     monkey_object_t *left_value,
     monkey_object_t *right_value)
 {
-    if (left_value->type == MONKEY_INT && right_value->type == MONKEY_INT)
-        return eval_integer_infix_expression(operator,
-            (monkey_int_t *) left_value,
-            (monkey_int_t *) right_value);
-    if (left_value->type == MONKEY_STRING && right_value->type == MONKEY_STRING)
-        return eval_string_infix_expression(operator,
+    monkey_object_type left_type = get_monkey_object_type(left_value);
+    monkey_object_type right_type = get_monkey_object_type(right_value);
+    if (left_type == MONKEY_INT && right_type == MONKEY_INT)
+        return eval_integer_infix_expression(op,
+            get_monkey_int_value(left_value),
+            get_monkey_int_value(right_value));
+    if (left_type == MONKEY_STRING && right_type == MONKEY_STRING)
+        return eval_string_infix_expression(op,
             (monkey_string_t *) left_value,
             (monkey_string_t *) right_value);
-    if (left_value->type == MONKEY_BOOL && right_value->type == MONKEY_BOOL)
-        return eval_boolean_infix_expression(operator,
+    if (left_type == MONKEY_BOOL && right_type == MONKEY_BOOL)
+        return eval_boolean_infix_expression(op,
             (monkey_bool_t *) left_value,
             (monkey_bool_t *) right_value);
-    if (strcmp(operator, "==") == 0)
+    if (op == OPERATOR_EQUAL)
         return (monkey_object_t *)
             create_monkey_bool(left_value == right_value);
-    if (strcmp(operator, "!=") == 0)
+    if (op == OPERATOR_NOT_EQUAL)
         return (monkey_object_t *)
             create_monkey_bool(left_value != right_value);
-    if (left_value->type != right_value->type)
+    if (left_type != right_type)
         return (monkey_object_t *) create_monkey_error("type mismatch: %s %s %s",
-            get_type_name(left_value->type), operator, get_type_name(right_value->type));
+            get_type_name(left_type), operator_values[op], get_type_name(right_type));
     else
         return (monkey_object_t *) create_monkey_error("unknown operator: %s %s %s",
-            get_type_name(left_value->type), operator, get_type_name(right_value->type));
+            get_type_name(left_type), operator_values[op], get_type_name(right_type));
 }
 
-static _Bool
+_Bool
 is_truthy(monkey_object_t *value)
 {
-    switch (value->type) {
+    switch (get_monkey_object_type(value)) {
         case MONKEY_NULL:
             return false;
         case MONKEY_BOOL:
@@ -236,7 +228,7 @@ eval_if_expression(expression_t *exp, environment_t *env)
         result = monkey_eval((node_t *) if_exp->alternative, env);
     else
         result = (monkey_object_t *) create_monkey_null();
-    free_monkey_object(condition_value);
+    release_monkey_object(condition_value);
     return result;
 }
 
@@ -244,25 +236,25 @@ static monkey_object_t *
 eval_identifier_expression(expression_t *exp, environment_t *env)
 {
     identifier_t *ident_exp = (identifier_t *) exp;
-    void *value_obj = env_get(env, ident_exp->value);
+    void *value_obj = env_get(env, ident_exp->depth, ident_exp->slot);
     if (value_obj == NULL)
         value_obj = (void *) get_builtins(ident_exp->value);
     if (value_obj == NULL)
         return (monkey_object_t *) create_monkey_error("identifier not found: %s", ident_exp->value);
-    // return a copy of the value, we don't want anyone else to a value stored in the hash table
-    return copy_monkey_object((monkey_object_t *) value_obj);
+    // the caller owns the returned reference, the environment keeps its own
+    return retain_monkey_object((monkey_object_t *) value_obj);
 }
 
 static cm_array_list *
 eval_expressions_to_array_list(cm_array_list *expression_list, environment_t *env)
 {
-    cm_array_list *values = cm_array_list_init(expression_list->length, free_monkey_object);
+    cm_array_list *values = cm_array_list_init(expression_list->length, release_monkey_object);
     monkey_object_t *value;
     for (size_t i = 0; i < expression_list->length; i++) {
         value = monkey_eval((node_t *) expression_list->array[i], env);
         if (is_error(value)) {
             cm_array_list_free(values);
-            values = cm_array_list_init(1, free_monkey_object);
+            values = cm_array_list_init(1, release_monkey_object);
             cm_array_list_add(values, value);
             return values;
         }
@@ -280,7 +272,7 @@ eval_expressions_to_linked_list(cm_list *expression_list, environment_t *env)
     while (exp_node != NULL) {
         value = monkey_eval((node_t *) exp_node->data, env);
         if (is_error(value)) {
-            cm_list_free(values, free_monkey_object);
+            cm_list_free(values, release_monkey_object);
             values = cm_list_init();
             cm_list_add(values, value);
             return values;
@@ -306,22 +298,22 @@ apply_function(monkey_object_t *function_obj, cm_list *arguments_list)
     switch (function_obj->type) {
         case MONKEY_FUNCTION:
             function = (monkey_function_t *) function_obj;
-            extended_env = create_enclosed_env(function->env);
+            extended_env = create_enclosed_env(function->env, function->nslots);
             arg_node = arguments_list->head;
             param_node = function->parameters->head;
             assert(function->parameters->length == arguments_list->length);
             while (arg_node != NULL) {
                 identifier_t *param = (identifier_t *) param_node->data;
-                env_put(extended_env, strdup(param->value), copy_monkey_object(arg_node->data));
+                env_put(extended_env, param->slot, retain_monkey_object(arg_node->data));
                 arg_node = arg_node->next;
                 param_node = param_node->next;
             }
             function_value = monkey_eval((node_t *) function->body, extended_env);
             env_free(extended_env);
-            if (function_value->type == MONKEY_RETURN_VALUE) {
+            if (get_monkey_object_type(function_value) == MONKEY_RETURN_VALUE) {
                 ret_value = (monkey_return_value_t *) function_value;
-                ret = copy_monkey_object(ret_value->value);
-                free_monkey_object(ret_value);
+                ret = retain_monkey_object(ret_value->value);
+                release_monkey_object(ret_value);
                 return ret;
             }
             return function_value;
@@ -339,52 +331,99 @@ static monkey_object_t *
 eval_array_index_expression(monkey_object_t *left_value, monkey_object_t *index_value)
 {
     monkey_array_t *array_obj = (monkey_array_t *) left_value;
-    monkey_int_t *index_obj = (monkey_int_t *) index_value;
-    if (index_obj->value < 0 || index_obj->value > array_obj->elements->length - 1) {
+    long index = get_monkey_int_value(index_value);
+    if (index < 0 || index >= get_monkey_array_length(array_obj)) {
         return (monkey_object_t *) create_monkey_null();
     }
 
-    /* we need to copy the return value because the left_value and index_value objects need to be freed */
-    return (monkey_object_t *) copy_monkey_object(array_obj->elements->array[index_obj->value]);
+    /* take a reference because the left_value and index_value objects are released by the caller */
+    return (monkey_object_t *) retain_monkey_object(get_monkey_array_element(array_obj, index));
 }
 
 static monkey_object_t *
 eval_string_index_expression(monkey_object_t *left_value, monkey_object_t *index_value)
 {
     monkey_string_t *string = (monkey_string_t *) left_value;
-    monkey_int_t *index = (monkey_int_t *) index_value;
-    if (index->value < 0 || index->value > string->length - 1) {
+    long index = get_monkey_int_value(index_value);
+    if (index < 0 || index > string->length - 1) {
         return (monkey_object_t *) create_monkey_null();
     }
-    return (monkey_object_t *) create_monkey_string(&string->value[index->value], 1);
+    return (monkey_object_t *) create_monkey_string(&get_monkey_string_value(string)[index], 1);
 }
 
 static monkey_object_t *
 eval_hash_index_expression(monkey_object_t *left_value, monkey_object_t *index_value)
 {
     monkey_hash_t *hash_obj = (monkey_hash_t *) left_value;
-    if (index_value->hash == NULL) {
+    if (!is_hashable_monkey_object(index_value)) {
         return (monkey_object_t *) create_monkey_error("unusable as a hash key: %s",
-            get_type_name(index_value->type));
+            get_type_name(get_monkey_object_type(index_value)));
     }
-    return copy_monkey_object(cm_hash_table_get(hash_obj->pairs, index_value));
+    monkey_object_t *value = cm_hash_table_get(hash_obj->pairs, index_value);
+    if (value == NULL)
+        return (monkey_object_t *) create_monkey_null();
+    return retain_monkey_object(value);
 }
 
-static monkey_object_t *
+monkey_object_t *
 eval_index_expression(monkey_object_t *left_value, monkey_object_t *index_value)
 {
-    if (left_value->type == MONKEY_ARRAY && index_value->type == MONKEY_INT) {
+    if (get_monkey_object_type(left_value) == MONKEY_ARRAY && get_monkey_object_type(index_value) == MONKEY_INT) {
         return eval_array_index_expression(left_value, index_value);
-    } else if (left_value->type == MONKEY_HASH) {
+    } else if (get_monkey_object_type(left_value) == MONKEY_HASH) {
         return eval_hash_index_expression(left_value, index_value);
-    } else if(left_value->type == MONKEY_STRING && index_value->type == MONKEY_INT) {
+    } else if(get_monkey_object_type(left_value) == MONKEY_STRING && get_monkey_object_type(index_value) == MONKEY_INT) {
         return eval_string_index_expression(left_value, index_value);
     } else {
         return (monkey_object_t *) create_monkey_error("index operator not supported: %s",
-            get_type_name(left_value->type));
+            get_type_name(get_monkey_object_type(left_value)));
     }
 }
 
+/* the slice of left_value from start to end, which may be null */
+monkey_object_t *
+eval_slice(monkey_object_t *left_value, monkey_object_t *start, monkey_object_t *end)
+{
+    monkey_object_t *result = slice_monkey_object(left_value, start, end);
+    if (result == NULL)
+        result = (monkey_object_t *) create_monkey_error(
+            "slice operator not supported: %s[%s:%s]",
+            get_type_name(get_monkey_object_type(left_value)),
+            get_type_name(get_monkey_object_type(start)),
+            get_type_name(get_monkey_object_type(end)));
+    return result;
+}
+
+static monkey_object_t *
+eval_slice_expression(slice_expression_t *slice_exp, environment_t *env)
+{
+    expression_t *bound_exps[] = {slice_exp->start, slice_exp->end};
+    monkey_object_t *bounds[2] = {NULL, NULL};
+    monkey_object_t *result;
+    monkey_object_t *left_value = monkey_eval((node_t *) slice_exp->left, env);
+    if (is_error(left_value))
+        return left_value;
+    for (size_t i = 0; i < 2; i++) {
+        if (bound_exps[i] == NULL) {
+            bounds[i] = (monkey_object_t *) create_monkey_null();
+            continue;
+        }
+        bounds[i] = monkey_eval((node_t *) bound_exps[i], env);
+        if (is_error(bounds[i])) {
+            result = bounds[i];
+            if (i > 0)
+                release_monkey_object(bounds[0]);
+            release_monkey_object(left_value);
+            return result;
+        }
+    }
+    result = eval_slice(left_value, bounds[0], bounds[1]);
+    release_monkey_object(left_value);
+    release_monkey_object(bounds[0]);
+    release_monkey_object(bounds[1]);
+    return result;
+}
+
 static monkey_object_t *
 eval_while_expression(while_expression_t *while_exp, environment_t *env)
 {
@@ -395,13 +434,13 @@ eval_while_expression(while_expression_t *while_exp, environment_t *env)
     while (is_truthy(condition)) {
         result = monkey_eval((node_t *) while_exp->body, env);
         if (is_error(result)) {
-            free_monkey_object(condition);
+            release_monkey_object(condition);
             return result;
         }
-        free_monkey_object(condition);
+        release_monkey_object(condition);
         condition = monkey_eval((node_t *) while_exp->condition, env);
         if (is_truthy(condition))
-            free_monkey_object(result);
+            release_monkey_object(result);
     }
     if (result == NULL)
         return (monkey_object_t *) create_monkey_null();
@@ -412,7 +451,7 @@ static monkey_object_t *
 eval_hash_literal(hash_literal_t *hash_exp, environment_t *env)
 {
     cm_hash_table *pairs = cm_hash_table_init(monkey_object_hash,
-    monkey_object_equals, free_monkey_object, free_monkey_object);
+    monkey_object_equals, release_monkey_object, release_monkey_object);
     cm_array_list *keys = cm_hash_table_get_keys(hash_exp->pairs);
     if (keys != NULL) {
         for (size_t i = 0; i < keys->length; i++) {
@@ -423,15 +462,15 @@ eval_hash_literal(hash_literal_t *hash_exp, environment_t *env)
                 cm_hash_table_free(pairs);
                 return key;
             }
-            if (key->hash == NULL) {
+            if (!is_hashable_monkey_object(key)) {
                 cm_hash_table_free(pairs);
                 return (monkey_object_t *)
                     create_monkey_error("unusable as a hash key: %s",
-                    get_type_name(key->type));
+                    get_type_name(get_monkey_object_type(key)));
             }
             monkey_object_t *value = monkey_eval((node_t *) exp_value, env);
             if (is_error(value)) {
-                free_monkey_object(key);
+                release_monkey_object(key);
                 cm_hash_table_free(pairs);
                 return value;
             }
@@ -477,8 +516,8 @@ eval_expression(expression_t *exp, environment_t *env)
             right_value = monkey_eval((node_t *) prefix_exp->right, env);
             if (is_error(right_value))
                 return right_value;
-            exp_value = eval_prefix_epxression(prefix_exp->operator, right_value);
-            free_monkey_object(right_value);
+            exp_value = eval_prefix_expression(prefix_exp->op, right_value);
+            release_monkey_object(right_value);
             return exp_value;
         case INFIX_EXPRESSION:
             infix_exp = (infix_expression_t *) exp;
@@ -487,12 +526,12 @@ eval_expression(expression_t *exp, environment_t *env)
                 return left_value;
             right_value = monkey_eval((node_t *) infix_exp->right, env);
             if (is_error(right_value)) {
-                free_monkey_object(left_value);
+                release_monkey_object(left_value);
                 return right_value;
             }
-            exp_value = eval_infix_expression(infix_exp->operator, left_value, right_value);
-            free_monkey_object(left_value);
-            free_monkey_object(right_value);
+            exp_value = eval_infix_expression(infix_exp->op, left_value, right_value);
+            release_monkey_object(left_value);
+            release_monkey_object(right_value);
             return exp_value;
         case IF_EXPRESSION:
             return eval_if_expression(exp, env);
@@ -503,6 +542,7 @@ eval_expression(expression_t *exp, environment_t *env)
             return (monkey_object_t *) create_monkey_function(
                     function_exp->parameters,
                     function_exp->body,
+                    function_exp->nslots,
                     env);
         case CALL_EXPRESSION:
             call_exp = (call_expression_t *) exp;
@@ -513,24 +553,23 @@ eval_expression(expression_t *exp, environment_t *env)
             arguments_value = eval_expressions_to_linked_list(call_exp->arguments, env);
             if (arguments_value->length == 1 &&
                 is_error((monkey_object_t *) arguments_value->head->data)) {
-                    free_monkey_object(function_value);
-                    exp_value = copy_monkey_object((monkey_object_t *) arguments_value->head->data);
-                    cm_list_free(arguments_value, free_monkey_object);
+                    release_monkey_object(function_value);
+                    exp_value = retain_monkey_object((monkey_object_t *) arguments_value->head->data);
+                    cm_list_free(arguments_value, release_monkey_object);
                     return exp_value;
             }
             call_exp_value = apply_function(function_value, arguments_value);
-            free_monkey_object(function_value);
-            cm_list_free(arguments_value, free_monkey_object);
+            release_monkey_object(function_value);
+            cm_list_free(arguments_value, release_monkey_object);
             return call_exp_value;
         case STRING_EXPRESSION:
             string_exp = (string_t *) exp;
-            return (monkey_object_t *) create_monkey_string(string_exp->value, string_exp->length);
+            return (monkey_object_t *) intern_monkey_string(string_exp->value, string_exp->length);
         case ARRAY_LITERAL:
             array_exp = (array_literal_t *) exp;
             cm_array_list *elements = eval_expressions_to_array_list(array_exp->elements, env);
             if (elements->length == 1 && is_error(elements->array[0])) {
-                free_monkey_object(array_exp);
-                exp_value = copy_monkey_object((monkey_object_t *) elements->array[0]);
+                exp_value = retain_monkey_object((monkey_object_t *) elements->array[0]);
                 cm_array_list_free(elements);
                 return exp_value;
             }
@@ -542,12 +581,12 @@ eval_expression(expression_t *exp, environment_t *env)
                 return left_value;
             exp_value = monkey_eval((node_t *) index_exp->index, env);
             if (is_error(exp_value)) {
-                free_monkey_object(left_value);
+                release_monkey_object(left_value);
                 return exp_value;
             }
             index_exp_value = eval_index_expression(left_value, exp_value);
-            free_monkey_object(left_value);
-            free_monkey_object(exp_value);
+            release_monkey_object(left_value);
+            release_monkey_object(exp_value);
             return index_exp_value;
         case HASH_LITERAL:
             hash_exp = (hash_literal_t *) exp;
@@ -555,6 +594,8 @@ eval_expression(expression_t *exp, environment_t *env)
         case WHILE_EXPRESSION:
             while_exp = (while_expression_t *) exp;
             return eval_while_expression(while_exp, env);
+        case SLICE_EXPRESSION:
+            return eval_slice_expression((slice_expression_t *) exp, env);
         default:
             break;
     }
@@ -567,11 +608,11 @@ eval_block_statement(block_statement_t *block_stmt, environment_t *env)
     monkey_object_t *object = NULL;
     for (size_t i = 0; i < block_stmt->nstatements; i++) {
         if (object)
-            free_monkey_object(object);
+            release_monkey_object(object);
         object = monkey_eval((node_t *) block_stmt->statements[i], env);
         if (object != NULL &&
-            (object->type == MONKEY_RETURN_VALUE ||
-            object->type == MONKEY_ERROR))
+            (get_monkey_object_type(object) == MONKEY_RETURN_VALUE ||
+            get_monkey_object_type(object) == MONKEY_ERROR))
             return object;
     }
     return object;
@@ -585,15 +626,15 @@ eval_program(program_t *program, environment_t *env)
     monkey_object_t *ret_value;
     for (size_t i = 0; i < program->nstatements; i++) {
         if (object)
-            free_monkey_object(object);
+            release_monkey_object(object);
         object = monkey_eval((node_t *) program->statements[i], env);
         if (object != NULL) {
-            if (object->type == MONKEY_RETURN_VALUE) {
+            if (get_monkey_object_type(object) == MONKEY_RETURN_VALUE) {
                 return_value_object = (monkey_return_value_t *) object;
-                ret_value = copy_monkey_object(return_value_object->value);
-                free_monkey_object((monkey_object_t *) return_value_object);
+                ret_value = retain_monkey_object(return_value_object->value);
+                release_monkey_object((monkey_object_t *) return_value_object);
                 return ret_value;
-            } else if (object->type == MONKEY_ERROR)
+            } else if (get_monkey_object_type(object) == MONKEY_ERROR)
                 return object;
         }
     }
@@ -629,7 +670,7 @@ eval_statement(statement_t *statement, environment_t *env)
                 return evaluated;
             if (evaluated == NULL)
                 evaluated = (monkey_object_t *) create_monkey_null();
-            env_put(env, strdup(let_stmt->name->value), evaluated);
+            env_put(env, let_stmt->name->slot, evaluated);
         default:
             break;
     }
@@ -35,4 +35,11 @@
 #include "object.h"
 
 monkey_object_t *monkey_eval(node_t *, environment_t *);
+
+/* the operations on evaluated values, shared with the closure compiler */
+monkey_object_t *eval_prefix_expression(operator_t, monkey_object_t *);
+monkey_object_t *eval_infix_expression(operator_t, monkey_object_t *, monkey_object_t *);
+monkey_object_t *eval_index_expression(monkey_object_t *, monkey_object_t *);
+monkey_object_t *eval_slice(monkey_object_t *, monkey_object_t *, monkey_object_t *);
+_Bool is_truthy(monkey_object_t *);
 #endif
\ No newline at end of file
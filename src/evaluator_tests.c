@@ -32,23 +32,54 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "closure_compiler.h"
 #include "cmonkey_utils.h"
 #include "environment.h"
 #include "evaluator.h"
 #include "lexer.h"
 #include "parser.h"
+#include "resolver.h"
 #include "object.h"
 #include "object_test_utils.h"
 #include "test_utils.h"
 
+/* the evaluated programs, which the functions they create point into */
+static cm_array_list *programs;
+static cm_array_list *compiled;
+
+/* every test runs with the AST walker and then with the closure compiler */
+static _Bool use_closures;
+
+static void
+free_program(void *program)
+{
+    program_free(program);
+}
+
+static void
+free_closure_program(void *program)
+{
+    closure_program_free(program);
+}
+
 static monkey_object_t *
 test_eval(const char *input, environment_t *env)
 {
     lexer_t *lexer = lexer_init(input);
     parser_t *parser = parser_init(lexer);
     program_t *program = parse_program(parser);
-    monkey_object_t *obj = monkey_eval((node_t *) program, env);
-    program_free(program);
+    resolver_t *resolver = resolver_init();
+    resolve_program(resolver, program);
+    resolver_free(resolver);
+    monkey_object_t *obj;
+    if (use_closures) {
+        closure_program_t *closures = compile_closures(program);
+        cm_array_list_add(compiled, closures);
+        obj = run_closures(closures, env);
+    } else {
+        obj = monkey_eval((node_t *) program, env);
+    }
+    cm_array_list_add(programs, program);
     parser_free(parser);
     return obj;
 }
@@ -92,7 +123,7 @@ test_eval_integer_expression(void)
         env = create_env();
         monkey_object_t *obj = test_eval(test.input, env);
         test_integer_object(obj, test.expected_value);
-        free_monkey_object(obj);
+        release_monkey_object(obj);
         env_free(env);
     }
     printf("integer expression eval test passed\n");
@@ -144,7 +175,7 @@ test_eval_bool_expression(void)
         env = create_env();
         monkey_object_t *obj = test_eval(test.input, env);
         test_boolean_object(obj, test.expected_value);
-        free_monkey_object(obj);
+        release_monkey_object(obj);
         env_free(env);
     }
     printf("boolean expression eval test passed\n");
@@ -177,7 +208,7 @@ test_bang_operator(void)
         env = create_env();
         monkey_object_t *obj = test_eval(test.input, env);
         test_boolean_object(obj, test.expected);
-        free_monkey_object(obj);
+        release_monkey_object(obj);
         env_free(env);
     }
 }
@@ -216,18 +247,16 @@ test_while_expressions(void)
         printf("Testing while expression evaluation for %s\n", test.input);
         env = create_env();
         monkey_object_t *evaluated = test_eval(test.input, env);
-        test(evaluated->type == test.expected->type,
+        test(get_monkey_object_type(evaluated) == get_monkey_object_type(test.expected),
             "Expected %s, got %s\n",
-            get_type_name(test.expected->type), get_type_name(evaluated->type));
-        if (evaluated->type == MONKEY_INT) {
-            monkey_int_t *actual = (monkey_int_t *) evaluated;
-            monkey_int_t *expected_int = (monkey_int_t *) test.expected;
-            test(actual->value == expected_int->value, "Expected value %ld got %ld\n",
-                expected_int->value, actual->value);
+            get_type_name(get_monkey_object_type(test.expected)),
+            get_type_name(get_monkey_object_type(evaluated)));
+        if (get_monkey_object_type(evaluated) == MONKEY_INT) {
+            test_integer_object(evaluated, get_monkey_int_value(test.expected));
         }
         env_free(env);
-        free_monkey_object(evaluated);
-        free_monkey_object(test.expected);
+        release_monkey_object(evaluated);
+        release_monkey_object(test.expected);
     }
 }
 
@@ -256,14 +285,14 @@ test_if_else_expressions(void)
         printf("Testing if else expression evaluation for \"%s\"\n", test.input);
         env = create_env();
         monkey_object_t *evaluated = test_eval(test.input, env);
-        if (test.expected->type == MONKEY_INT) {
+        if (get_monkey_object_type(test.expected) == MONKEY_INT) {
             monkey_int_t *expected_int = (monkey_int_t *) test.expected;
             test_integer_object(evaluated, expected_int->value);
         } else
             test_null_object(evaluated);
-        free_monkey_object(test.expected);
+        release_monkey_object(test.expected);
         env_free(env);
-        free_monkey_object(evaluated);
+        release_monkey_object(evaluated);
     }
 }
 
@@ -297,8 +326,8 @@ test_return_statements(void)
         env = create_env();
         monkey_object_t *evaluated = test_eval(test.input, env);
         test_monkey_object(evaluated, test.expected);
-        free_monkey_object(test.expected);
-        free_monkey_object(evaluated);
+        release_monkey_object(test.expected);
+        release_monkey_object(evaluated);
         env_free(env);
     }
 }
@@ -384,12 +413,12 @@ test_error_handling(void)
         printf("Test error handling for %s\n", test.input);
         env = create_env();
         monkey_object_t *evaluated = test_eval(test.input, env);
-        test(evaluated->type == MONKEY_ERROR, "Expected MONKEY_ERROR to be returned, found %s\n",
-            get_type_name(evaluated->type));
+        test(get_monkey_object_type(evaluated) == MONKEY_ERROR, "Expected MONKEY_ERROR to be returned, found %s\n",
+            get_type_name(get_monkey_object_type(evaluated)));
         monkey_error_t *err = (monkey_error_t *) evaluated;
         test(strcmp(err->message, test.message) == 0,
             "Expected error message %s, got %s\n", test.message, err->message);
-        free_monkey_object(evaluated);
+        release_monkey_object(evaluated);
         env_free(env);
     }
 }
@@ -426,7 +455,7 @@ test_let_statements(void)
         printf("Testing let statement for %s\n", test.input);
         monkey_object_t *evaluated = test_eval(test.input, env);
         test_integer_object(evaluated, test.expected);
-        free_monkey_object(evaluated);
+        release_monkey_object(evaluated);
         env_free(env);
     }
 }
@@ -439,9 +468,9 @@ test_function_object(void)
     print_test_separator_line();
     printf("Testing function object\n");
     monkey_object_t *evaluated = test_eval(input, env);
-    test(evaluated->type == MONKEY_FUNCTION,
+    test(get_monkey_object_type(evaluated) == MONKEY_FUNCTION,
         "Expected object of type MONKEY_FUNCTION, found %s\n",
-        get_type_name(evaluated->type));
+        get_type_name(get_monkey_object_type(evaluated)));
     monkey_function_t *function_obj = (monkey_function_t *) evaluated;
     test(function_obj->parameters->length == 1,
         "Expected 1 parameters in the function, found %zu\n", function_obj->parameters->length);
@@ -453,7 +482,29 @@ test_function_object(void)
         expected_body, actual_body);
     free(actual_body);
     env_free(env);
-    free_monkey_object(evaluated);
+    release_monkey_object(evaluated);
+}
+
+/* the functions a literal evaluates to share its parameters and body */
+static void
+test_function_object_sharing(void)
+{
+    const char *input = "let make = fn() { fn(x) { x + 2 } }; [make(), make()]";
+    environment_t *env = create_env();
+    print_test_separator_line();
+    printf("Testing function objects sharing the AST of %s\n", input);
+    monkey_object_t *evaluated = test_eval(input, env);
+    test(get_monkey_object_type(evaluated) == MONKEY_ARRAY,
+        "Expected object of type MONKEY_ARRAY, found %s\n",
+        get_type_name(get_monkey_object_type(evaluated)));
+    monkey_array_t *array = (monkey_array_t *) evaluated;
+    monkey_function_t *first = (monkey_function_t *) get_monkey_array_element(array, 0);
+    monkey_function_t *second = (monkey_function_t *) get_monkey_array_element(array, 1);
+    test(first != second, "Expected two function objects\n");
+    test(first->body == second->body && first->parameters == second->parameters,
+        "Expected the function objects to share the body and parameters\n");
+    env_free(env);
+    release_monkey_object(evaluated);
 }
 
 static void
@@ -487,6 +538,31 @@ test_function_application(void)
         {
             "fn(x) { x; }(5)",
             5
+        },
+        {
+            "let fact = fn(n) { if (n == 0) { 1 } else { n * fact(n - 1) } }; fact(5)",
+            120
+        },
+        {
+            "let g = 5; let f = fn(a) { let h = fn(b) { a + b + g }; h(2) }; f(1)",
+            8
+        },
+        {
+            "let f = fn(n) { let even = fn(n) { if (n == 0) { 1 } else { odd(n - 1) } };\n"
+            "let odd = fn(n) { if (n == 0) { 0 } else { even(n - 1) } }; even(n) }; f(7)",
+            0
+        },
+        {
+            "let x = 5; let f = fn() { let x = x + 1; x }; f() + x",
+            11
+        },
+        {
+            "let add = fn(a) { fn(b) { a + b } }; let add2 = add(2); add(1)(1) + add2(3)",
+            7
+        },
+        {
+            "let counter = fn(n) { let next = fn() { n + 1 }; next }; counter(4)()",
+            5
         }
     };
 
@@ -499,7 +575,7 @@ test_function_application(void)
         monkey_object_t *evaluated = test_eval(test.input, env);
         test_integer_object(evaluated, test.expected);
         env_free(env);
-        free_monkey_object(evaluated);
+        release_monkey_object(evaluated);
     }
 }
 
@@ -511,14 +587,14 @@ test_string_literal(void)
     monkey_object_t *evaluated = test_eval(input, env);
     print_test_separator_line();
     printf("Testing string literal evaluation\n");
-    test(evaluated->type == MONKEY_STRING,
+    test(get_monkey_object_type(evaluated) == MONKEY_STRING,
         "Expected object of type MONKEY_STRING, got %s\n",
-        get_type_name(evaluated->type));
+        get_type_name(get_monkey_object_type(evaluated)));
     monkey_string_t *str = (monkey_string_t *) evaluated;
     test(strcmp(str->value, "Hello, world!") == 0,
         "Expected string literal value \"Hello, world!\", found \"%s\"\n",
         str->value);
-    free_monkey_object(str);
+    release_monkey_object(str);
     env_free(env);
 }
 
@@ -530,39 +606,39 @@ test_string_concatenation(void)
     monkey_object_t *evaluated = test_eval(input, env);
     print_test_separator_line();
     printf("Testing string concatenation evaluation\n");
-    test(evaluated->type == MONKEY_STRING,
+    test(get_monkey_object_type(evaluated) == MONKEY_STRING,
         "Expected object of type MONKEY_STRING, got %s\n",
-        get_type_name(evaluated->type));
+        get_type_name(get_monkey_object_type(evaluated)));
     monkey_string_t *str = (monkey_string_t *) evaluated;
-    test(strcmp(str->value, "Hello, world!") == 0,
+    test(strcmp(get_monkey_string_value(str), "Hello, world!") == 0,
         "Expected string literal value \"Hello, world!\", found \"%s\"\n",
         str->value);
-    free_monkey_object(str);
+    release_monkey_object(str);
     env_free(env);
 }
 
 static void
 test_int_array(monkey_array_t *actual, monkey_array_t *expected)
 {
-    test(expected->elements->length == actual->elements->length,
-        "Expected length of array %zu, got %zu\n", expected->elements->length,
-        actual->elements->length);
-    for (size_t i = 0; i < expected->elements->length; i++) {
-        monkey_object_t *obj = (monkey_object_t *) expected->elements->array[i];
-        test(obj->type == MONKEY_INT,
+    test(get_monkey_array_length(expected) == get_monkey_array_length(actual),
+        "Expected length of array %zu, got %zu\n", get_monkey_array_length(expected),
+        get_monkey_array_length(actual));
+    for (size_t i = 0; i < get_monkey_array_length(expected); i++) {
+        monkey_object_t *obj = get_monkey_array_element(actual, i);
+        test(get_monkey_object_type(obj) == MONKEY_INT,
             "Expected element at %zu index to be INTEGER, got %s\n", i,
-            get_type_name(obj->type));
-        monkey_int_t *act_int = (monkey_int_t *) obj;
-        monkey_int_t *exp_int = (monkey_int_t *) expected->elements->array[i];
-        test(act_int->value == exp_int->value,
-            "Expected value %ld at index %zu, got %ld\n", exp_int->value, i, act_int->value);
+            get_type_name(get_monkey_object_type(obj)));
+        long act_int = get_monkey_int_value(obj);
+        long exp_int = get_monkey_int_value(get_monkey_array_element(expected, i));
+        test(act_int == exp_int,
+            "Expected value %ld at index %zu, got %ld\n", exp_int, i, act_int);
     }
 }
 
 static monkey_array_t *
 create_int_array(int *int_arr, size_t length)
 {
-    cm_array_list *array_list = cm_array_list_init(length, free_monkey_object);
+    cm_array_list *array_list = cm_array_list_init(length, release_monkey_object);
     for (size_t i = 0; i < length; i++) {
         cm_array_list_add(array_list, (void *) create_monkey_int(int_arr[i]));
     }
@@ -581,27 +657,26 @@ test_builtins(void)
         {"len(\"\")", (monkey_object_t *) create_monkey_int(0)},
         {"len(\"four\")", (monkey_object_t *) create_monkey_int(4)},
         {"len(\"hello world\")", (monkey_object_t *) create_monkey_int(11)},
-        {"len(1)", (monkey_object_t *) create_monkey_error("argument to len not supported, got INTEGER")},
+        {"len(1)", (monkey_object_t *) create_monkey_error("argument to `len` not supported, got INTEGER")},
         {"len(\"one\", \"two\")", (monkey_object_t *) create_monkey_error("wrong number of arguments. got=2, want=1")},
         {"len([1, 2, 3])", (monkey_object_t *) create_monkey_int(3)},
         {"len([])", (monkey_object_t *) create_monkey_int(0)},
         {"first([1, 2, 3])", (monkey_object_t *) create_monkey_int(1)},
         {"first([])", (monkey_object_t *) create_monkey_null()},
-        {"first(1)", (monkey_object_t *) create_monkey_error("argument to first must be ARRAY, got INTEGER")},
+        {"first(1)", (monkey_object_t *) create_monkey_error("argument to `first` must be ARRAY, got INTEGER")},
         {"last([1, 2, 3])", (monkey_object_t *) create_monkey_int(3)},
         {"last([])", (monkey_object_t *) create_monkey_null()},
-        {"last(1)", (monkey_object_t *) create_monkey_error("argument to last must be ARRAY, got INTEGER")},
+        {"last(1)", (monkey_object_t *) create_monkey_error("argument to `last` must be ARRAY, got INTEGER")},
         {"rest([1, 2, 3])", (monkey_object_t *) create_int_array((int[]) {2, 3}, 2)},
         {"rest([])", (monkey_object_t *) create_monkey_null()},
         {"push([], 1)", (monkey_object_t *) create_int_array((int[]){1}, 1)},
-        {"push(1, 1)", (monkey_object_t *) create_monkey_error("argument to push must be ARRAY, got INTEGER")},
+        {"push(1, 1)", (monkey_object_t *) create_monkey_error("argument to `push` must be ARRAY, got INTEGER")},
         {"type(10)", (monkey_object_t *) create_monkey_string("INTEGER", 7)},
         {"type(10, 1)", (monkey_object_t *) create_monkey_error("wrong number of arguments. got=2, want=1")}
     };
 
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     print_test_separator_line();
-    monkey_int_t *actual_int;
     monkey_array_t *actual_array;
     monkey_array_t *expected_array;
     monkey_error_t *actual_err;
@@ -614,12 +689,11 @@ test_builtins(void)
         printf("Testing builtin function %s\n", test.input);
         environment_t *env = create_env();
         monkey_object_t *evaluated = test_eval(test.input, env);
-        switch (test.expected->type) {
+        switch (get_monkey_object_type(test.expected)) {
             case MONKEY_INT:
-                actual_int = (monkey_int_t *) evaluated;
-                test_integer_object(evaluated, actual_int->value);
-                free_monkey_object(test.expected);
-                free_monkey_object(evaluated);
+                test_integer_object(evaluated, get_monkey_int_value(test.expected));
+                release_monkey_object(test.expected);
+                release_monkey_object(evaluated);
                 break;
             case MONKEY_ERROR:
                 actual_err = (monkey_error_t *) evaluated;
@@ -627,32 +701,32 @@ test_builtins(void)
                 test(strcmp(actual_err->message, expected_err->message) == 0,
                     "Expected error message %s, got %s\n", expected_err->message,
                     actual_err->message);
-                free_monkey_object(test.expected);
-                free_monkey_object(evaluated);
+                release_monkey_object(test.expected);
+                release_monkey_object(evaluated);
                 break;
             case MONKEY_ARRAY:
                 actual_array = (monkey_array_t *) evaluated;
                 expected_array = (monkey_array_t *) test.expected;
                 test_int_array(actual_array, expected_array);
-                free_monkey_object(test.expected);
-                free_monkey_object(evaluated);
+                release_monkey_object(test.expected);
+                release_monkey_object(evaluated);
                 break;
             case MONKEY_NULL:
                 obj = (monkey_object_t *) evaluated;
-                test(obj->type == MONKEY_NULL,
-                    "Expected null object, got %s\n", get_type_name(obj->type));
-                free_monkey_object(evaluated);
+                test(get_monkey_object_type(obj) == MONKEY_NULL,
+                    "Expected null object, got %s\n", get_type_name(get_monkey_object_type(obj)));
+                release_monkey_object(evaluated);
                 break;
             case MONKEY_STRING:
                 expected_str = (monkey_string_t *) test.expected;
                 actual_str = (monkey_string_t *) evaluated;
-                test(strcmp(expected_str->value, actual_str->value) == 0,
+                test(strcmp(expected_str->value, get_monkey_string_value(actual_str)) == 0,
                     "Expected value %s, got %s\n", expected_str->value, actual_str->value);
-                free_monkey_object(test.expected);
-                free_monkey_object(evaluated);
+                release_monkey_object(test.expected);
+                release_monkey_object(evaluated);
                 break;
             default:
-                free_monkey_object(evaluated);
+                release_monkey_object(evaluated);
                 err(EXIT_FAILURE, "Unknown type for expected");
         }
         env_free(env);
@@ -667,17 +741,17 @@ test_array_literals(void)
     printf("Testing array literal evaluation\n");
     environment_t *env = create_env();
     monkey_object_t *evaluated = test_eval(input, env);
-    test(evaluated->type == MONKEY_ARRAY, "Expected MONKEY_ARRAY, got %s\n",
-        get_type_name(evaluated->type));
+    test(get_monkey_object_type(evaluated) == MONKEY_ARRAY, "Expected MONKEY_ARRAY, got %s\n",
+        get_type_name(get_monkey_object_type(evaluated)));
     monkey_array_t *array = (monkey_array_t *) evaluated;
-    test(array->elements->length == 3, "Expected 3 elements in array object, got %zu\n",
-        array->elements->length);
-    test_integer_object(array->elements->array[0], 1);
-    test_integer_object(array->elements->array[1], 4);
-    test_integer_object(array->elements->array[2], 6);
+    test(get_monkey_array_length(array) == 3, "Expected 3 elements in array object, got %zu\n",
+        get_monkey_array_length(array));
+    test_integer_object(get_monkey_array_element(array, 0), 1);
+    test_integer_object(get_monkey_array_element(array, 1), 4);
+    test_integer_object(get_monkey_array_element(array, 2), 6);
     // for (size_t i = 0; i < 3; i++)
-    //     free_monkey_object(array->elements->array[i]);
-    free_monkey_object(evaluated);
+    //     release_monkey_object(array->elements->array[i]);
+    release_monkey_object(evaluated);
     env_free(env);
 }
 
@@ -713,29 +787,67 @@ test_array_index_expressions(void)
         printf("Testing index expression evaluation for %s\n", test.input);
         environment_t *env = create_env();
         monkey_object_t *evaluated = test_eval(test.input, env);
-        test(evaluated->type == test.expected->type, "Expected object %s, got %s\n",
-            get_type_name(test.expected->type), get_type_name(evaluated->type));
-        if (test.expected->type == MONKEY_INT) {
+        test(get_monkey_object_type(evaluated) == get_monkey_object_type(test.expected),
+            "Expected object %s, got %s\n",
+            get_type_name(get_monkey_object_type(test.expected)),
+            get_type_name(get_monkey_object_type(evaluated)));
+        if (get_monkey_object_type(test.expected) == MONKEY_INT) {
             test_integer_object(evaluated, ((monkey_int_t *) test.expected)->value);
-            free_monkey_object(test.expected);
-            free_monkey_object(evaluated);
-        } else if (test.expected->type == MONKEY_STRING) {
-            test(evaluated->type == MONKEY_STRING, "Expected STRING object, got %s\n",
-                get_type_name(evaluated->type));
+            release_monkey_object(test.expected);
+            release_monkey_object(evaluated);
+        } else if (get_monkey_object_type(test.expected) == MONKEY_STRING) {
+            test(get_monkey_object_type(evaluated) == MONKEY_STRING, "Expected STRING object, got %s\n",
+                get_type_name(get_monkey_object_type(evaluated)));
             monkey_string_t *actual_string = (monkey_string_t *) evaluated;
             monkey_string_t *expected_string = (monkey_string_t *) test.expected;
-            test(strcmp(expected_string->value, actual_string->value) == 0,
+            test(strcmp(expected_string->value, get_monkey_string_value(actual_string)) == 0,
                 "Expected string %s, got %s\n", expected_string->value, actual_string->value);
-            free_monkey_object(test.expected);
-            free_monkey_object(evaluated);
+            release_monkey_object(test.expected);
+            release_monkey_object(evaluated);
         } else {
             test_null_object(evaluated);
-            free_monkey_object(evaluated);
+            release_monkey_object(evaluated);
         }
         env_free(env);
     }
 }
 
+static void
+test_slice_expressions(void)
+{
+    typedef struct {
+        const char *input;
+        monkey_object_t *expected;
+    } test_input;
+
+    test_input tests[] = {
+        {"[1, 2, 3, 4][1:3]", (monkey_object_t *) create_int_array((int[]) {2, 3}, 2)},
+        {"[1, 2, 3, 4][:1]", (monkey_object_t *) create_int_array((int[]) {1}, 1)},
+        {"let a = [1, 2, 3, 4]; a[1:][1:][0]", (monkey_object_t *) create_monkey_int(3)},
+        {"let a = [1, 2, 3]; rest(a)[5:]", (monkey_object_t *) create_int_array((int[]) {0}, 0)},
+        {"\"apple\"[1:]", (monkey_object_t *) create_monkey_string("pple", 4)},
+        {"rest(\"apple\")[1:3]", (monkey_object_t *) create_monkey_string("pl", 2)},
+        {"\"apple\"[3:][0]", (monkey_object_t *) create_monkey_string("l", 1)},
+        {"1[0:1]", (monkey_object_t *) create_monkey_error(
+            "slice operator not supported: INTEGER[INTEGER:INTEGER]")},
+        {"[1][true:]", (monkey_object_t *) create_monkey_error(
+            "slice operator not supported: ARRAY[BOOLEAN:NULL]")}
+    };
+
+    print_test_separator_line();
+    size_t ntests = sizeof(tests) / sizeof(tests[0]);
+    for (size_t i = 0; i < ntests; i++) {
+        test_input test = tests[i];
+        printf("Testing slice expression evaluation for %s\n", test.input);
+        environment_t *env = create_env();
+        monkey_object_t *evaluated = test_eval(test.input, env);
+        test_monkey_object(evaluated, test.expected);
+        release_monkey_object(test.expected);
+        release_monkey_object(evaluated);
+        env_free(env);
+    }
+}
+
 static void
 test_enclosing_env(void)
 {
@@ -753,7 +865,7 @@ test_enclosing_env(void)
     monkey_object_t *evaluated = test_eval(input, env);
     printf("Enclosed environment test passed\n");
     test_integer_object(evaluated, 70);
-    free_monkey_object(evaluated);
+    release_monkey_object(evaluated);
     env_free(env);
 }
 
@@ -803,8 +915,8 @@ test_hash_literals(void)
     printf("Testing hash literal evaluation for %s\n", input);
     environment_t *env = create_env();
     monkey_object_t *evaluated = test_eval(input, env);
-    test(evaluated->type == MONKEY_HASH,
-        "Expected a HASH object, got %s\n", get_type_name(evaluated->type));
+    test(get_monkey_object_type(evaluated) == MONKEY_HASH,
+        "Expected a HASH object, got %s\n", get_type_name(get_monkey_object_type(evaluated)));
     monkey_hash_t *hash_obj = (monkey_hash_t *) evaluated;
     size_t expected_objs_count = sizeof(expected) / sizeof(expected[0]);
     test(hash_obj->pairs->nkeys == expected_objs_count,
@@ -812,16 +924,16 @@ test_hash_literals(void)
 
     for (size_t i = 0; i < expected_objs_count; i++) {
         monkey_object_t *key = expected[i].key;
-        char *key_string = key->inspect(key);
+        char *key_string = inspect(key);
         monkey_object_t *expected_value = expected[i].value;
         monkey_object_t *actual_value = (monkey_object_t *) cm_hash_table_get(hash_obj->pairs, key);
         test(actual_value != NULL, "key %s not found in hash object\n", key_string);
         test_monkey_object(actual_value, expected_value);
         free(key_string);
-        free_monkey_object(key);
-        free_monkey_object(expected_value);
+        release_monkey_object(key);
+        release_monkey_object(expected_value);
     }
-    free_monkey_object(evaluated);
+    release_monkey_object(evaluated);
     env_free(env);
 }
 
@@ -872,20 +984,20 @@ test_hash_index_expressions(void)
         printf("Testing hash index expression for %s\n", test.input);
         environment_t *env = create_env();
         monkey_object_t *evaluated = test_eval(test.input, env);
-        switch (test.expected->type) {
+        switch (get_monkey_object_type(test.expected)) {
             case MONKEY_INT:
                 expected_int = (monkey_int_t *) test.expected;
                 test_integer_object(evaluated, expected_int->value);
                 break;
             case MONKEY_NULL:
-                test(evaluated->type == MONKEY_NULL, "Expected null value got %s\n",
-                    get_type_name(evaluated->type));
+                test(get_monkey_object_type(evaluated) == MONKEY_NULL, "Expected null value got %s\n",
+                    get_type_name(get_monkey_object_type(evaluated)));
                 break;
             default:
-                err(EXIT_FAILURE, "Unknown type: %s", get_type_name(test.expected->type));
+                err(EXIT_FAILURE, "Unknown type: %s", get_type_name(get_monkey_object_type(test.expected)));
         }
-        free_monkey_object(test.expected);
-        free_monkey_object(evaluated);
+        release_monkey_object(test.expected);
+        release_monkey_object(evaluated);
         env_free(env);
     }
 }
@@ -919,18 +1031,18 @@ test_string_comparison(void)
         printf("Testing string comparison for %s\n", test.input);
         environment_t *env = create_env();
         monkey_object_t *evaluated = test_eval(test.input, env);
-        test(evaluated->type == MONKEY_BOOL,
-            "Expected a BOOLEAN object, got %s\n", get_type_name(evaluated->type));
+        test(get_monkey_object_type(evaluated) == MONKEY_BOOL,
+            "Expected a BOOLEAN object, got %s\n", get_type_name(get_monkey_object_type(evaluated)));
         monkey_bool_t *actual = (monkey_bool_t *) evaluated;
         test(actual->value == test.expected, "Expected %s, got %s\n",
             bool_to_string(test.expected), bool_to_string(actual->value));
-        free_monkey_object(evaluated);
+        release_monkey_object(evaluated);
         env_free(env);
     }
 }
 
-int
-main(int argc, char **argv)
+static void
+test_engine(void)
 {
     test_eval_integer_expression();
     test_eval_bool_expression();
@@ -940,16 +1052,32 @@ main(int argc, char **argv)
     test_error_handling();
     test_let_statements();
     test_function_object();
+    test_function_object_sharing();
     test_function_application();
     test_string_literal();
     test_string_concatenation();
     test_builtins();
     test_array_literals();
     test_array_index_expressions();
+    test_slice_expressions();
     test_enclosing_env();
     test_hash_literals();
     test_hash_index_expressions();
     test_while_expressions();
     test_string_comparison();
+}
+
+int
+main(int argc, char **argv)
+{
+    programs = cm_array_list_init(64, free_program);
+    compiled = cm_array_list_init(64, free_closure_program);
+    printf("Testing the AST walker\n");
+    test_engine();
+    use_closures = true;
+    printf("Testing the closure compiler\n");
+    test_engine();
+    cm_array_list_free(compiled);
+    cm_array_list_free(programs);
     return 0;
 }
@@ -10,8 +10,6 @@ typedef struct frame_t {
     size_t bp;
 } frame_t;
 
-frame_t *frame_init(monkey_compiled_fn_t *, size_t);
-void frame_free(frame_t *);
-instructions_t *get_frame_instructions(frame_t *);
+void frame_init(frame_t *, monkey_compiled_fn_t *, size_t);
 
 #endif
\ No newline at end of file
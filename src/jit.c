@@ -0,0 +1,706 @@
+#include <err.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "jit.h"
+#include "opcode.h"
+
+#ifdef VM_JIT
+
+/*
+ * Register usage of the generated code. All of these are callee saved in
+ * the System V ABI, so they survive the calls into the helpers.
+ *  rbx: jit_state_t *
+ *  r12: vm->stack
+ *  r13: stack pointer, an index into vm->stack, written back to vm->sp
+ *       around helper calls
+ *  r14: the current frame's first local
+ *  r15: vm_t *
+ */
+enum x86_register {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+enum x86_condition {
+    CC_O = 0x0,
+    CC_AE = 0x3,
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_LE = 0xe,
+    CC_G = 0xf
+};
+
+/* ALU opcodes of the reg/reg forms and /digit extensions of 0x83 and 0xff */
+#define ALU_ADD 0x01
+#define ALU_AND 0x21
+#define ALU_SUB 0x29
+#define ALU_CMP 0x39
+#define ALU_TEST 0x85
+#define ALU_MOV 0x89
+#define EXT_ADD 0
+#define EXT_INC 0
+#define EXT_OR 1
+#define EXT_SUB 5
+#define EXT_CMP 7
+
+#define EXIT_TARGET SIZE_MAX
+
+typedef struct jump_fixup_t {
+    size_t offset; // of the rel32 to patch
+    size_t target; // word index of the target instruction or EXIT_TARGET
+} jump_fixup_t;
+
+typedef struct code_buffer_t {
+    uint8_t *bytes;
+    size_t length;
+    size_t size;
+    jump_fixup_t *fixups;
+    size_t nfixups;
+    size_t fixups_size;
+} code_buffer_t;
+
+static FILE *perf_map;
+
+static void
+emit_byte(code_buffer_t *buf, uint8_t byte)
+{
+    if (buf->length == buf->size) {
+        buf->size *= 2;
+        buf->bytes = realloc(buf->bytes, buf->size);
+        if (buf->bytes == NULL)
+            err(EXIT_FAILURE, "malloc failed");
+    }
+    buf->bytes[buf->length++] = byte;
+}
+
+static void
+emit_u32(code_buffer_t *buf, uint32_t value)
+{
+    for (size_t i = 0; i < 4; i++)
+        emit_byte(buf, (value >> (i * 8)) & 0xff);
+}
+
+static void
+emit_u64(code_buffer_t *buf, uint64_t value)
+{
+    for (size_t i = 0; i < 8; i++)
+        emit_byte(buf, (value >> (i * 8)) & 0xff);
+}
+
+static void
+emit_rex_w(code_buffer_t *buf, int reg, int index, int base)
+{
+    emit_byte(buf, 0x48 | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3));
+}
+
+/* op reg, [base + disp32] */
+static void
+emit_mem(code_buffer_t *buf, uint8_t opcode, int reg, int base, int32_t disp)
+{
+    emit_rex_w(buf, reg, 0, base);
+    emit_byte(buf, opcode);
+    emit_byte(buf, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP)
+        emit_byte(buf, 0x24);
+    emit_u32(buf, (uint32_t) disp);
+}
+
+/* op reg, [r12 + r13 * 8 + disp32], i.e. a stack slot relative to sp */
+static void
+emit_slot(code_buffer_t *buf, uint8_t opcode, int reg, int32_t disp)
+{
+    emit_rex_w(buf, reg, R13, R12);
+    emit_byte(buf, opcode);
+    emit_byte(buf, 0x80 | ((reg & 7) << 3) | RSP);
+    emit_byte(buf, 0xc0 | ((R13 & 7) << 3) | (R12 & 7));
+    emit_u32(buf, (uint32_t) disp);
+}
+
+/* op dword [base + disp32], for the 32 bit refcounts */
+static void
+emit_mem32(code_buffer_t *buf, uint8_t opcode, int reg, int base, int32_t disp)
+{
+    if (((reg | base) >> 3) != 0)
+        emit_byte(buf, 0x40 | ((reg >> 3) << 2) | (base >> 3));
+    emit_byte(buf, opcode);
+    emit_byte(buf, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP)
+        emit_byte(buf, 0x24);
+    emit_u32(buf, (uint32_t) disp);
+}
+
+#define emit_load(buf, reg, base, disp) emit_mem(buf, 0x8b, reg, base, disp)
+#define emit_store(buf, base, disp, reg) emit_mem(buf, 0x89, reg, base, disp)
+#define emit_load_slot(buf, reg, disp) emit_slot(buf, 0x8b, reg, disp)
+#define emit_store_slot(buf, disp, reg) emit_slot(buf, 0x89, reg, disp)
+
+/* op dst, src */
+static void
+emit_alu(code_buffer_t *buf, uint8_t opcode, int dst, int src)
+{
+    emit_rex_w(buf, src, 0, dst);
+    emit_byte(buf, opcode);
+    emit_byte(buf, 0xc0 | ((src & 7) << 3) | (dst & 7));
+}
+
+/* op reg, imm8 */
+static void
+emit_alu_imm8(code_buffer_t *buf, int ext, int reg, int8_t imm)
+{
+    emit_rex_w(buf, 0, 0, reg);
+    emit_byte(buf, 0x83);
+    emit_byte(buf, 0xc0 | (ext << 3) | (reg & 7));
+    emit_byte(buf, (uint8_t) imm);
+}
+
+static void
+emit_cmp_imm32(code_buffer_t *buf, int reg, int32_t imm)
+{
+    emit_rex_w(buf, 0, 0, reg);
+    emit_byte(buf, 0x81);
+    emit_byte(buf, 0xc0 | (7 << 3) | (reg & 7));
+    emit_u32(buf, (uint32_t) imm);
+}
+
+static void
+emit_test_imm32(code_buffer_t *buf, int reg, int32_t imm)
+{
+    emit_rex_w(buf, 0, 0, reg);
+    emit_byte(buf, 0xf7);
+    emit_byte(buf, 0xc0 | (reg & 7));
+    emit_u32(buf, (uint32_t) imm);
+}
+
+static void
+emit_mov_imm64(code_buffer_t *buf, int reg, uint64_t imm)
+{
+    emit_rex_w(buf, 0, 0, reg);
+    emit_byte(buf, 0xb8 | (reg & 7));
+    emit_u64(buf, imm);
+}
+
+static void
+emit_cmov(code_buffer_t *buf, int cc, int dst, int src)
+{
+    emit_rex_w(buf, dst, 0, src);
+    emit_byte(buf, 0x0f);
+    emit_byte(buf, 0x40 | cc);
+    emit_byte(buf, 0xc0 | ((dst & 7) << 3) | (src & 7));
+}
+
+/* the helpers return an int, so only eax is meaningful */
+static void
+emit_test_eax(code_buffer_t *buf)
+{
+    emit_byte(buf, 0x85);
+    emit_byte(buf, 0xc0);
+}
+
+static void
+emit_cmp_eax_imm8(code_buffer_t *buf, int8_t imm)
+{
+    emit_byte(buf, 0x83);
+    emit_byte(buf, 0xf8);
+    emit_byte(buf, (uint8_t) imm);
+}
+
+/* Emits a jump with a zero rel32 and returns the offset of the rel32. */
+static size_t
+emit_jcc(code_buffer_t *buf, int cc)
+{
+    emit_byte(buf, 0x0f);
+    emit_byte(buf, 0x80 | cc);
+    emit_u32(buf, 0);
+    return buf->length - 4;
+}
+
+static size_t
+emit_jmp(code_buffer_t *buf)
+{
+    emit_byte(buf, 0xe9);
+    emit_u32(buf, 0);
+    return buf->length - 4;
+}
+
+static void
+patch_rel32(code_buffer_t *buf, size_t offset, size_t target)
+{
+    uint32_t rel = (uint32_t) (target - (offset + 4));
+    memcpy(buf->bytes + offset, &rel, sizeof(rel));
+}
+
+/* Points a jump emitted by emit_jcc or emit_jmp at the current offset. */
+#define patch_here(buf, offset) patch_rel32(buf, offset, (buf)->length)
+
+/* Records a jump to an instruction or to the exit, patched once all are emitted. */
+static void
+add_fixup(code_buffer_t *buf, size_t offset, size_t target)
+{
+    if (buf->nfixups == buf->fixups_size) {
+        buf->fixups_size *= 2;
+        buf->fixups = realloc(buf->fixups, sizeof(*buf->fixups) * buf->fixups_size);
+        if (buf->fixups == NULL)
+            err(EXIT_FAILURE, "malloc failed");
+    }
+    buf->fixups[buf->nfixups].offset = offset;
+    buf->fixups[buf->nfixups++].target = target;
+}
+
+/*
+ * Calls helper(state, a, b) with the stack pointer synchronised with the
+ * VM's before and after the call.
+ */
+static void
+emit_helper_call(code_buffer_t *buf, jit_helper_fn helper, size_t a, size_t b)
+{
+    emit_store(buf, R15, offsetof(vm_t, sp), R13);
+    emit_alu(buf, ALU_MOV, RDI, RBX);
+    emit_mov_imm64(buf, RSI, a);
+    emit_mov_imm64(buf, RDX, b);
+    emit_mov_imm64(buf, RAX, (uint64_t) (uintptr_t) helper);
+    emit_byte(buf, 0xff);
+    emit_byte(buf, 0xd0);
+    emit_load(buf, R13, R15, offsetof(vm_t, sp));
+}
+
+/* leaves the generated code if the helper did not return JIT_OK */
+static void
+emit_exit_on_status(code_buffer_t *buf)
+{
+    emit_test_eax(buf);
+    add_fixup(buf, emit_jcc(buf, CC_NE), EXIT_TARGET);
+}
+
+static void
+emit_execute(code_buffer_t *buf, const jit_helpers_t *helpers, size_t op, size_t operand)
+{
+    emit_helper_call(buf, helpers->execute, op, operand);
+    emit_exit_on_status(buf);
+}
+
+/* Pushes a constant which needs no refcounting, a tagged int or a static object. */
+static void
+emit_push_imm(code_buffer_t *buf, const jit_helpers_t *helpers, uint64_t value,
+    size_t op, size_t operand)
+{
+    size_t slow, done;
+    emit_cmp_imm32(buf, R13, STACKSIZE);
+    slow = emit_jcc(buf, CC_AE);
+    emit_mov_imm64(buf, RAX, value);
+    emit_store_slot(buf, 0, RAX);
+    emit_alu_imm8(buf, EXT_ADD, R13, 1);
+    done = emit_jmp(buf);
+    patch_here(buf, slow);
+    emit_execute(buf, helpers, op, operand);
+    patch_here(buf, done);
+}
+
+/* pushes a local, retaining it inline like retain_monkey_object */
+static void
+emit_get_local(code_buffer_t *buf, const jit_helpers_t *helpers, size_t index)
+{
+    size_t overflow, is_int, is_null, is_immortal, done;
+    emit_cmp_imm32(buf, R13, STACKSIZE);
+    overflow = emit_jcc(buf, CC_AE);
+    emit_load(buf, RAX, R14, index * sizeof(monkey_object_t *));
+    emit_test_imm32(buf, RAX, MONKEY_IMMEDIATE_TAG);
+    is_int = emit_jcc(buf, CC_NE);
+    emit_alu(buf, ALU_TEST, RAX, RAX);
+    is_null = emit_jcc(buf, CC_E);
+    emit_mem32(buf, 0x83, EXT_CMP, RAX, offsetof(monkey_object_t, refcount));
+    emit_byte(buf, MONKEY_REFCOUNT_IMMORTAL);
+    is_immortal = emit_jcc(buf, CC_E);
+    emit_mem32(buf, 0xff, EXT_INC, RAX, offsetof(monkey_object_t, refcount));
+    patch_here(buf, is_int);
+    patch_here(buf, is_null);
+    patch_here(buf, is_immortal);
+    emit_store_slot(buf, 0, RAX);
+    emit_alu_imm8(buf, EXT_ADD, R13, 1);
+    done = emit_jmp(buf);
+    patch_here(buf, overflow);
+    emit_execute(buf, helpers, OPGETLOCAL, index);
+    patch_here(buf, done);
+}
+
+static void
+emit_constant(code_buffer_t *buf, const jit_helpers_t *helpers, cm_array_list *constants,
+    size_t index)
+{
+    monkey_object_t *constant = cm_array_list_get(constants, index);
+    if (is_immediate_int(constant))
+        emit_push_imm(buf, helpers, (uint64_t) (uintptr_t) constant, OPCONSTANT, index);
+    else
+        emit_execute(buf, helpers, OPCONSTANT, index);
+}
+
+/*
+ * Loads the two topmost stack values into rax and rcx and returns a jump
+ * taken unless both are immediate ints.
+ */
+static size_t
+emit_load_int_operands(code_buffer_t *buf)
+{
+    emit_load_slot(buf, RAX, -16);
+    emit_load_slot(buf, RCX, -8);
+    emit_alu(buf, ALU_MOV, RDX, RAX);
+    emit_alu(buf, ALU_AND, RDX, RCX);
+    emit_test_imm32(buf, RDX, MONKEY_IMMEDIATE_TAG);
+    return emit_jcc(buf, CC_E);
+}
+
+/*
+ * Adds or subtracts two immediate ints without untagging them:
+ * (2a + 1) + (2b + 1) - 1 = 2(a + b) + 1 and (2a + 1) - (2b + 1) + 1 =
+ * 2(a - b) + 1. Results which do not fit an immediate go the slow path,
+ * which boxes them.
+ */
+static void
+emit_int_arith(code_buffer_t *buf, const jit_helpers_t *helpers, size_t op)
+{
+    size_t not_int, overflow, done;
+    not_int = emit_load_int_operands(buf);
+    emit_alu(buf, ALU_MOV, RDX, RAX);
+    if (op == OPADD) {
+        emit_alu_imm8(buf, EXT_SUB, RDX, 1);
+        emit_alu(buf, ALU_ADD, RDX, RCX);
+        overflow = emit_jcc(buf, CC_O);
+    } else {
+        emit_alu(buf, ALU_SUB, RDX, RCX);
+        overflow = emit_jcc(buf, CC_O);
+        emit_alu_imm8(buf, EXT_OR, RDX, 1);
+    }
+    emit_store_slot(buf, -16, RDX);
+    emit_alu_imm8(buf, EXT_SUB, R13, 1);
+    done = emit_jmp(buf);
+    patch_here(buf, not_int);
+    patch_here(buf, overflow);
+    emit_execute(buf, helpers, op, 0);
+    patch_here(buf, done);
+}
+
+/* tagging preserves the order of ints, so tagged values compare directly */
+static int
+get_true_condition(size_t op)
+{
+    switch (op) {
+    case OPGREATERTHAN:
+        return CC_G;
+    case OPEQUAL:
+        return CC_E;
+    default:
+        return CC_NE;
+    }
+}
+
+static void
+emit_compare(code_buffer_t *buf, const jit_helpers_t *helpers, size_t op)
+{
+    size_t not_int, done;
+    not_int = emit_load_int_operands(buf);
+    emit_alu(buf, ALU_CMP, RAX, RCX);
+    emit_mov_imm64(buf, RDX, (uint64_t) (uintptr_t) &MONKEY_FALSE_OBJ);
+    emit_mov_imm64(buf, RSI, (uint64_t) (uintptr_t) &MONKEY_TRUE_OBJ);
+    emit_cmov(buf, get_true_condition(op), RDX, RSI);
+    emit_store_slot(buf, -16, RDX);
+    emit_alu_imm8(buf, EXT_SUB, R13, 1);
+    done = emit_jmp(buf);
+    patch_here(buf, not_int);
+    emit_execute(buf, helpers, op, 0);
+    patch_here(buf, done);
+}
+
+/* jumps to target if the helper returned JIT_JUMP, exits on errors */
+static void
+emit_conditional_jump(code_buffer_t *buf, size_t target)
+{
+    emit_cmp_eax_imm8(buf, JIT_JUMP);
+    add_fixup(buf, emit_jcc(buf, CC_E), target);
+    emit_exit_on_status(buf);
+}
+
+static void
+emit_compare_and_jump(code_buffer_t *buf, const jit_helpers_t *helpers, size_t op,
+    size_t target)
+{
+    size_t not_int, done;
+    not_int = emit_load_int_operands(buf);
+    emit_alu_imm8(buf, EXT_SUB, R13, 2);
+    emit_alu(buf, ALU_CMP, RAX, RCX);
+    add_fixup(buf, emit_jcc(buf, op == OPGREATERTHAN? CC_LE: CC_NE), target);
+    done = emit_jmp(buf);
+    patch_here(buf, not_int);
+    emit_helper_call(buf, helpers->compare_and_jump, op, 0);
+    emit_conditional_jump(buf, target);
+    patch_here(buf, done);
+}
+
+static void
+emit_prologue(code_buffer_t *buf)
+{
+    static const uint8_t prologue[] = {
+        0x53,               // push rbx
+        0x55,               // push rbp
+        0x41, 0x54,         // push r12
+        0x41, 0x55,         // push r13
+        0x41, 0x56,         // push r14
+        0x41, 0x57,         // push r15
+        0x48, 0x83, 0xec, 0x08 // sub rsp, 8, to keep the stack 16 byte aligned
+    };
+    for (size_t i = 0; i < sizeof(prologue); i++)
+        emit_byte(buf, prologue[i]);
+    emit_alu(buf, ALU_MOV, RBX, RDI);
+    emit_load(buf, R15, RBX, offsetof(jit_state_t, vm));
+    emit_load(buf, R14, RBX, offsetof(jit_state_t, locals));
+    emit_mem(buf, 0x8d, R12, R15, offsetof(vm_t, stack));
+    emit_load(buf, R13, R15, offsetof(vm_t, sp));
+    // jmp rsi, to the entry point of the instruction to resume at
+    emit_byte(buf, 0xff);
+    emit_byte(buf, 0xe6);
+}
+
+static void
+emit_epilogue(code_buffer_t *buf)
+{
+    static const uint8_t epilogue[] = {
+        0x48, 0x83, 0xc4, 0x08, // add rsp, 8
+        0x41, 0x5f,         // pop r15
+        0x41, 0x5e,         // pop r14
+        0x41, 0x5d,         // pop r13
+        0x41, 0x5c,         // pop r12
+        0x5d,               // pop rbp
+        0x5b,               // pop rbx
+        0xc3                // ret
+    };
+    emit_store(buf, R15, offsetof(vm_t, sp), R13);
+    for (size_t i = 0; i < sizeof(epilogue); i++)
+        emit_byte(buf, epilogue[i]);
+}
+
+static size_t
+get_operand_count(size_t op)
+{
+    size_t count = 0;
+    opcode_definition_t op_def = opcode_definition_lookup(op);
+    while (count < MAX_OPERANDS && op_def.operand_widths[count] != 0)
+        count++;
+    return count;
+}
+
+static void
+emit_instruction(code_buffer_t *buf, const jit_helpers_t *helpers, cm_array_list *constants,
+    size_t *words, size_t next_ip)
+{
+    size_t op = words[0];
+    switch (op) {
+    case OPCONSTANT:
+        emit_constant(buf, helpers, constants, words[1]);
+        break;
+    case OPTRUE:
+        emit_push_imm(buf, helpers, (uint64_t) (uintptr_t) &MONKEY_TRUE_OBJ, op, 0);
+        break;
+    case OPFALSE:
+        emit_push_imm(buf, helpers, (uint64_t) (uintptr_t) &MONKEY_FALSE_OBJ, op, 0);
+        break;
+    case OPNULL:
+        emit_push_imm(buf, helpers, (uint64_t) (uintptr_t) &MONKEY_NULL_OBJ, op, 0);
+        break;
+    case OPGETLOCAL:
+        emit_get_local(buf, helpers, words[1]);
+        break;
+    case OPADD:
+    case OPSUB:
+        emit_int_arith(buf, helpers, op);
+        break;
+    case OPGREATERTHAN:
+    case OPEQUAL:
+    case OPNOTEQUAL:
+        emit_compare(buf, helpers, op);
+        break;
+    case OPJMP:
+        add_fixup(buf, emit_jmp(buf), words[1]);
+        break;
+    case OPJMPFALSE:
+        emit_helper_call(buf, helpers->jump_if_false, 0, 0);
+        emit_conditional_jump(buf, words[1]);
+        break;
+    case OPGREATERTHANJMPFALSE:
+        emit_compare_and_jump(buf, helpers, OPGREATERTHAN, words[1]);
+        break;
+    case OPEQUALJMPFALSE:
+        emit_compare_and_jump(buf, helpers, OPEQUAL, words[1]);
+        break;
+    case OPCALL:
+        emit_helper_call(buf, helpers->call, words[1], next_ip);
+        emit_exit_on_status(buf);
+        break;
+    case OPRETURNVALUE:
+    case OPRETURN:
+        emit_helper_call(buf, helpers->return_value, op == OPRETURNVALUE, 0);
+        add_fixup(buf, emit_jmp(buf), EXIT_TARGET);
+        break;
+    /* superinstructions are emitted as the pair they replace */
+    case OPGETLOCAL2:
+        emit_get_local(buf, helpers, words[1]);
+        emit_get_local(buf, helpers, words[2]);
+        break;
+    case OPGETLOCALCONSTANT:
+        emit_get_local(buf, helpers, words[1]);
+        emit_constant(buf, helpers, constants, words[2]);
+        break;
+    case OPADDLOCALS:
+        emit_get_local(buf, helpers, words[1]);
+        emit_get_local(buf, helpers, words[2]);
+        emit_int_arith(buf, helpers, OPADD);
+        break;
+    case OPADDLOCALCONSTANT:
+    case OPSUBLOCALCONSTANT:
+        emit_get_local(buf, helpers, words[1]);
+        emit_constant(buf, helpers, constants, words[2]);
+        emit_int_arith(buf, helpers, op == OPADDLOCALCONSTANT? OPADD: OPSUB);
+        break;
+    default:
+        emit_execute(buf, helpers, op, get_operand_count(op)? words[1]: 0);
+        break;
+    }
+}
+
+static void
+write_perf_map_entry(monkey_compiled_fn_t *fn, jit_code_t *code)
+{
+    if (perf_map == NULL)
+        return;
+    fprintf(perf_map, "%lx %zx monkey_fn_%p\n", (unsigned long) (uintptr_t) code->code,
+        code->length, (void *) fn);
+    fflush(perf_map);
+}
+
+/*
+ * Writes /tmp/perf-<pid>.map entries for the functions compiled from now
+ * on, so that perf can symbolize samples in generated code.
+ */
+void
+jit_enable_perf_map(void)
+{
+    char *path = NULL;
+    if (perf_map != NULL)
+        return;
+    if (asprintf(&path, "/tmp/perf-%ld.map", (long) getpid()) == -1)
+        err(EXIT_FAILURE, "malloc failed");
+    perf_map = fopen(path, "a");
+    if (perf_map == NULL)
+        warn("Failed to open %s", path);
+    free(path);
+}
+
+jit_code_t *
+jit_compile(monkey_compiled_fn_t *fn, cm_array_list *constants, const jit_helpers_t *helpers)
+{
+    code_buffer_t buf;
+    jit_code_t *code;
+    decoded_instructions_t *decoded;
+    size_t ip, next_ip, page_size, target;
+
+    /*
+     * Work from a fresh decoding, the interpreter's copy may contain
+     * quickened opcodes. The word indices are the same in both.
+     */
+    decoded = decode_instructions(fn->instructions);
+    code = malloc(sizeof(*code));
+    if (code == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    code->entries = malloc(sizeof(*code->entries) * (decoded->length + 1));
+    if (code->entries == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    buf.size = 256;
+    buf.length = 0;
+    buf.bytes = malloc(buf.size);
+    buf.fixups_size = 16;
+    buf.nfixups = 0;
+    buf.fixups = malloc(sizeof(*buf.fixups) * buf.fixups_size);
+    if (buf.bytes == NULL || buf.fixups == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+
+    emit_prologue(&buf);
+    for (ip = 0; ip < decoded->length; ip = next_ip) {
+        code->entries[ip] = buf.length;
+        next_ip = ip + 1 + get_operand_count(decoded->words[ip]);
+        emit_instruction(&buf, helpers, constants, decoded->words + ip, next_ip);
+    }
+    /* the terminating DECODED_HALT, jumps past the last instruction land here */
+    code->entries[decoded->length] = buf.length;
+    emit_byte(&buf, 0xb8);  // mov eax, JIT_DONE
+    emit_u32(&buf, JIT_DONE);
+    add_fixup(&buf, emit_jmp(&buf), EXIT_TARGET);
+    size_t exit_offset = buf.length;
+    emit_epilogue(&buf);
+    for (size_t i = 0; i < buf.nfixups; i++) {
+        target = buf.fixups[i].target;
+        patch_rel32(&buf, buf.fixups[i].offset,
+            target == EXIT_TARGET? exit_offset: code->entries[target]);
+    }
+
+    page_size = (size_t) sysconf(_SC_PAGESIZE);
+    code->length = buf.length;
+    code->size = (buf.length + page_size - 1) / page_size * page_size;
+    code->code = mmap(NULL, code->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code->code == MAP_FAILED)
+        err(EXIT_FAILURE, "mmap failed");
+    memcpy(code->code, buf.bytes, buf.length);
+    if (mprotect(code->code, code->size, PROT_READ | PROT_EXEC) == -1)
+        err(EXIT_FAILURE, "mprotect failed");
+    write_perf_map_entry(fn, code);
+
+    free(buf.bytes);
+    free(buf.fixups);
+    decoded_instructions_free(decoded);
+    return code;
+}
+
+/* Runs the current frame's function from the instruction at ip. */
+int
+jit_run(jit_code_t *code, jit_state_t *state, size_t ip)
+{
+    int (*entry)(jit_state_t *, void *) = (int (*)(jit_state_t *, void *)) code->code;
+    return entry(state, code->code + code->entries[ip]);
+}
+
+void
+jit_free(jit_code_t *code)
+{
+    if (code == NULL)
+        return;
+    munmap(code->code, code->size);
+    free(code->entries);
+    free(code);
+}
+
+#else
+
+jit_code_t *
+jit_compile(monkey_compiled_fn_t *fn, cm_array_list *constants, const jit_helpers_t *helpers)
+{
+    return NULL;
+}
+
+int
+jit_run(jit_code_t *code, jit_state_t *state, size_t ip)
+{
+    return JIT_ERROR;
+}
+
+void
+jit_free(jit_code_t *code)
+{
+}
+
+void
+jit_enable_perf_map(void)
+{
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "object.h"
+#include "vm.h"
+
+/*
+ * Baseline JIT for the stack VM. Once a compiled function has been called
+ * vm->jit_threshold times, its instructions are translated into x86-64
+ * machine code, one template per instruction. Integer arithmetic,
+ * comparisons, jumps and loads of locals and constants are done inline;
+ * everything else, as well as the inline paths' fallbacks, calls the VM's
+ * helpers. The generated code works on the VM's own stack and frames, so
+ * vm_run can hand a frame over to it and take it back at any instruction
+ * boundary. The JIT is only built on x86-64 Linux, and can be left out
+ * with -DVM_NO_JIT.
+ */
+#if defined(__x86_64__) && defined(__linux__) && !defined(VM_NO_JIT)
+#define VM_JIT
+#endif
+
+#define JIT_CALL_THRESHOLD 1000
+
+/* status returned by the generated code and by the helpers it calls */
+typedef enum jit_status_t {
+    JIT_OK,             // continue with the next instruction
+    JIT_FRAME_CHANGED,  // a frame was pushed or popped, the VM takes over
+    JIT_ERROR,          // the error is in jit_state_t.err
+    JIT_DONE,           // the program has finished
+    JIT_JUMP            // the condition was false, take the jump
+} jit_status_t;
+
+typedef struct jit_state_t {
+    vm_t *vm;
+    monkey_object_t **locals; // first local of the current frame
+    monkey_object_t *top;     // the last popped value, see vm_run
+    vm_error_t err;
+} jit_state_t;
+
+typedef int (*jit_helper_fn)(jit_state_t *, size_t, size_t);
+
+/* slow paths of the generated code, implemented by the VM */
+typedef struct jit_helpers_t {
+    jit_helper_fn execute;          // (opcode, operand) any opcode
+    jit_helper_fn jump_if_false;    // pops the condition
+    jit_helper_fn compare_and_jump; // (opcode) compares and pops the result
+    jit_helper_fn call;             // (argument count, ip after the call)
+    jit_helper_fn return_value;     // (1 to return the top of the stack, 0 for null)
+} jit_helpers_t;
+
+typedef struct jit_code_t {
+    uint8_t *code;
+    size_t size;    // of the mapping, whole pages
+    size_t length;  // of the generated code
+    size_t *entries; // offset in code of every instruction, by word index
+} jit_code_t;
+
+jit_code_t *jit_compile(monkey_compiled_fn_t *, cm_array_list *, const jit_helpers_t *);
+int jit_run(jit_code_t *, jit_state_t *, size_t);
+void jit_free(jit_code_t *);
+void jit_enable_perf_map(void);
+
+#endif
@@ -0,0 +1,169 @@
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "c_backend.h"
+#include "cmonkey_utils.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "parser.h"
+
+/* where the runtime headers and library are, set by the Makefile */
+#ifndef MONKEYC_INCLUDE_DIR
+#define MONKEYC_INCLUDE_DIR "src"
+#endif
+#ifndef MONKEYC_RUNTIME
+#define MONKEYC_RUNTIME "bin/libmonkeyrt.a"
+#endif
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: monkeyc [-S] [-o output] program.mnk\n");
+	exit(EXIT_FAILURE);
+}
+
+static char *
+read_file(const char *filename)
+{
+	char *line = NULL;
+	size_t linesize = 0;
+	char *program_string;
+	FILE *file = fopen(filename, "r");
+	if (file == NULL)
+		err(EXIT_FAILURE, "Failed to open file %s", filename);
+	cm_array_list *lines = cm_array_list_init(4, free);
+	while (getline(&line, &linesize, file) != -1) {
+		cm_array_list_add(lines, line);
+		line = NULL;
+		linesize = 0;
+	}
+	free(line);
+	fclose(file);
+	program_string = cm_array_string_list_join(lines, "\n");
+	cm_array_list_free(lines);
+	return program_string;
+}
+
+/* compiles the program to bytecode and lowers that to C */
+static char *
+generate_c(const char *filename)
+{
+	char *program_string = read_file(filename);
+	lexer_t *lexer = lexer_init(program_string);
+	parser_t *parser = parser_init(lexer);
+	program_t *program = parse_program(parser);
+	free(program_string);
+	if (parser->errors) {
+		cm_list_node *list_node = parser->errors->head;
+		while (list_node) {
+			fprintf(stderr, "%s: %s\n", filename, (char *) list_node->data);
+			list_node = list_node->next;
+		}
+		exit(EXIT_FAILURE);
+	}
+	compiler_t *compiler = compiler_init();
+	compiler_error_t compile_err = compile(compiler, (node_t *) program);
+	if (compile_err.code != COMPILER_ERROR_NONE)
+		errx(EXIT_FAILURE, "%s: Compile error: %s", filename, compile_err.msg);
+	bytecode_t *bytecode = get_bytecode(compiler);
+	char *c_code = c_backend_generate(bytecode);
+	bytecode_free(bytecode);
+	compiler_free(compiler);
+	program_free(program);
+	parser_free(parser);
+	return c_code;
+}
+
+static void
+write_file(int fd, const char *path, const char *contents)
+{
+	size_t length = strlen(contents);
+	while (length > 0) {
+		ssize_t written = write(fd, contents, length);
+		if (written == -1)
+			err(EXIT_FAILURE, "Failed to write %s", path);
+		contents += written;
+		length -= written;
+	}
+}
+
+/* runs the system C compiler, $CC or cc, on the generated code */
+static int
+run_cc(const char *source, const char *output)
+{
+	int status;
+	const char *cc = getenv("CC");
+	if (cc == NULL || *cc == 0)
+		cc = "cc";
+	const char *argv[] = {
+		cc, "-O2", "-std=c11", "-D_GNU_SOURCE", "-w", "-I", MONKEYC_INCLUDE_DIR,
+		"-o", output, source, MONKEYC_RUNTIME, NULL
+	};
+	pid_t pid = fork();
+	if (pid == -1)
+		err(EXIT_FAILURE, "fork failed");
+	if (pid == 0) {
+		execvp(cc, (char **) argv);
+		err(EXIT_FAILURE, "Failed to run %s", cc);
+	}
+	if (waitpid(pid, &status, 0) == -1)
+		err(EXIT_FAILURE, "waitpid failed");
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		warnx("%s failed to compile the generated code", cc);
+		return -1;
+	}
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *output = NULL;
+	char source[] = "/tmp/monkeyc-XXXXXX.c";
+	_Bool emit_c = false;
+	FILE *file;
+	int ch, fd, status;
+
+	while ((ch = getopt(argc, argv, "So:")) != -1) {
+		switch (ch) {
+		case 'S':
+			emit_c = true;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1)
+		usage();
+
+	char *c_code = generate_c(argv[optind]);
+	if (emit_c) {
+		/* -S only writes the C code, to stdout by default */
+		if (output == NULL || strcmp(output, "-") == 0) {
+			fputs(c_code, stdout);
+		} else {
+			file = fopen(output, "w");
+			if (file == NULL || fputs(c_code, file) == EOF || fclose(file) == EOF)
+				err(EXIT_FAILURE, "Failed to write %s", output);
+		}
+		free(c_code);
+		return 0;
+	}
+
+	fd = mkstemps(source, 2);
+	if (fd == -1)
+		err(EXIT_FAILURE, "Failed to create %s", source);
+	write_file(fd, source, c_code);
+	close(fd);
+	free(c_code);
+	status = run_cc(source, output == NULL? "a.out": output);
+	unlink(source);
+	return status == 0? EXIT_SUCCESS: EXIT_FAILURE;
+}
@@ -0,0 +1,175 @@
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "c_backend.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "parser.h"
+#include "test_utils.h"
+
+#ifndef MONKEYC_INCLUDE_DIR
+#define MONKEYC_INCLUDE_DIR "src"
+#endif
+#ifndef MONKEYC_RUNTIME
+#define MONKEYC_RUNTIME "bin/libmonkeyrt.a"
+#endif
+#ifndef MONKEYC_CFLAGS
+#define MONKEYC_CFLAGS ""
+#endif
+
+static char *
+generate(const char *input)
+{
+    lexer_t *lexer = lexer_init(input);
+    parser_t *parser = parser_init(lexer);
+    program_t *program = parse_program(parser);
+    compiler_t *compiler = compiler_init();
+    compiler_error_t error = compile(compiler, (node_t *) program);
+    if (error.code != COMPILER_ERROR_NONE)
+        errx(EXIT_FAILURE, "compilation failed for input %s with error %s\n",
+            input, error.msg);
+    bytecode_t *bytecode = get_bytecode(compiler);
+    char *c_code = c_backend_generate(bytecode);
+    bytecode_free(bytecode);
+    compiler_free(compiler);
+    program_free(program);
+    parser_free(parser);
+    return c_code;
+}
+
+/* compiles the generated code with cc and returns what the program prints */
+static char *
+compile_and_run(const char *input)
+{
+    char source[] = "/tmp/monkeyc_tests-XXXXXX.c";
+    char *binary, *command, *output = NULL;
+    size_t output_size = 0;
+    ssize_t output_length;
+    FILE *file;
+    int fd;
+
+    char *c_code = generate(input);
+    fd = mkstemps(source, 2);
+    if (fd == -1 || (file = fdopen(fd, "w")) == NULL)
+        err(EXIT_FAILURE, "Failed to create %s", source);
+    fputs(c_code, file);
+    fclose(file);
+    free(c_code);
+    if (asprintf(&binary, "%.*s", (int) strlen(source) - 2, source) == -1 ||
+        asprintf(&command, "cc %s -O2 -std=c11 -D_GNU_SOURCE -w -I %s -o %s %s %s",
+            MONKEYC_CFLAGS, MONKEYC_INCLUDE_DIR, binary, source, MONKEYC_RUNTIME) == -1)
+        err(EXIT_FAILURE, "malloc failed");
+    test(system(command) == 0, "Failed to compile the generated code for %s\n", input);
+    file = popen(binary, "r");
+    if (file == NULL)
+        err(EXIT_FAILURE, "Failed to run %s", binary);
+    output_length = getdelim(&output, &output_size, '\0', file);
+    pclose(file);
+    if (output_length == -1) {
+        free(output);
+        output = strdup("");
+    }
+    unlink(source);
+    unlink(binary);
+    free(binary);
+    free(command);
+    return output;
+}
+
+static void
+test_generated_code(void)
+{
+    const char *input = "let add = fn(a, b) { a + b }; add(1, 2);";
+    const char *expected[] = {
+        "static aot_function_t fn_obj_0 = AOT_FUNCTION(fn_0, 2, 2);",
+        "s0 = aot_add(aot_retain(l0), aot_retain(l1));",
+        "s0 = aot_call(s0, 2, (monkey_object_t *[]) {s1, s2}, bp + 1);",
+        "s1 = create_monkey_immediate_int(1L);"
+    };
+    print_test_separator_line();
+    printf("Testing generated C code for %s\n", input);
+    char *c_code = generate(input);
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+        test(strstr(c_code, expected[i]) != NULL, "Expected %s in the generated code:\n%s\n",
+            expected[i], c_code);
+    free(c_code);
+}
+
+static void
+test_compiled_programs(void)
+{
+    typedef struct testcase {
+        const char *input;
+        const char *expected;
+    } testcase;
+    testcase tests[] = {
+        {"1 + 2 * 3 - 8 / 2", "3\n"},
+        {"let fib = fn(f, n) { if (n < 2) { return n; } f(f, n - 1) + f(f, n - 2) }; fib(fib, 20)",
+            "6765\n"},
+        {"4611686018427387903 + 1", "4611686018427387904\n"},
+        {"let s = \"mon\"; puts(s + \"key\\t!\"); len(s)", "monkey\\t!\n3\n"},
+        {"let a = [1, 2, 3]; let h = {\"a\": a, 2: \"two\"}; [h[\"a\"][2], h[2], a[5], rest(push(a, 4))]",
+            "[3, two, null, [2, 3, 4]]\n"},
+        {"let a = [1, 2, 3, 4]; let s = \"monkey\"; [a[1:3], a[:1], rest(a)[2:], s[3:], rest(s)[:3]]",
+            "[[2, 3], [1], [4], key, onk]\n"},
+        {"let max = fn(a, b) { if (a > b) { a } else { b } }; [max(3, 7) == 7, !false]",
+            "[true, true]\n"},
+        {"let one = fn() { 1 }; let r = fn() { one }; r()() + -1", "0\n"},
+        {"let f = fn() { }; f()", ""},
+        {"fn(a) { a }(1, 2)", "VM Error: wrong number of arguments: want=1, got=2\n"},
+        {"puts(1); 1 + true; puts(2)",
+            "1\nVM Error: '+' operation not supported with types INTEGER and BOOLEAN\n"},
+        {"let f = fn(g, n) { g(g, n + 1) }; f(f, 0)",
+            "VM Error: Stackoverflow error: execeeded max stack size of 2048\n"}
+    };
+    print_test_separator_line();
+    printf("Testing programs compiled to C\n");
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        testcase t = tests[i];
+        printf("Testing %s\n", t.input);
+        char *output = compile_and_run(t.input);
+        test(strcmp(output, t.expected) == 0, "Expected output \"%s\", got \"%s\"\n",
+            t.expected, output);
+        free(output);
+    }
+}
+
+/* long programs are split into several functions which gcc compiles quickly */
+static void
+test_long_program(void)
+{
+    const char *statement = "let r = f(r, 1); if (r > 0) { r } else { 0 };";
+    const size_t count = 1100;
+    char *input, *c_code, *output;
+    size_t length = strlen(statement);
+
+    print_test_separator_line();
+    printf("Testing a program of %zu statements compiled to C\n", count);
+    input = malloc(length * count + 64);
+    if (input == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    strcpy(input, "let f = fn(a, b) { a + b }; let r = 0;");
+    for (size_t i = 0; i < count; i++)
+        strcat(input, statement);
+    strcat(input, "return r; 0");
+    c_code = generate(input);
+    test(strstr(c_code, "run_program_1();") != NULL,
+        "Expected the program to be split into several functions\n");
+    free(c_code);
+    output = compile_and_run(input);
+    test(strcmp(output, "1100\n") == 0, "Expected output \"1100\", got \"%s\"\n", output);
+    free(output);
+    free(input);
+}
+
+int
+main(int argc, char **argv)
+{
+    test_generated_code();
+    test_compiled_programs();
+    test_long_program();
+    return 0;
+}
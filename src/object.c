@@ -35,13 +35,14 @@
 #include <string.h>
 
 #include "cmonkey_utils.h"
+#include "jit.h"
 #include "parser.h"
 #include "object.h"
 #include "opcode.h"
 
-const monkey_bool_t MONKEY_TRUE_OBJ = {{MONKEY_BOOL, inspect, monkey_object_hash, monkey_object_equals}, true};
-const monkey_bool_t MONKEY_FALSE_OBJ = {{MONKEY_BOOL, inspect, monkey_object_hash, monkey_object_equals}, false};
-const monkey_null_t MONKEY_NULL_OBJ = {{MONKEY_NULL, inspect, NULL, NULL}};
+const monkey_bool_t MONKEY_TRUE_OBJ = {{MONKEY_BOOL, 0, MONKEY_REFCOUNT_IMMORTAL}, true};
+const monkey_bool_t MONKEY_FALSE_OBJ = {{MONKEY_BOOL, 0, MONKEY_REFCOUNT_IMMORTAL}, false};
+const monkey_null_t MONKEY_NULL_OBJ = {{MONKEY_NULL, 0, MONKEY_REFCOUNT_IMMORTAL}};
 
 static char *
 monkey_function_inspect(monkey_object_t *obj)
@@ -58,29 +59,53 @@ monkey_function_inspect(monkey_object_t *obj)
     return str;
 }
 
+/*
+ * The slots of the leaf holding element index of the array, starting at
+ * that element. *count is set to how many of them belong to the array.
+ */
+static void **
+get_monkey_array_slots(monkey_array_t *array, size_t index, size_t *count)
+{
+    size_t i = array->offset + index;
+    monkey_vector_node_t *node = array->tail;
+    if (i < monkey_vector_tail_offset(array->count)) {
+        node = array->root;
+        for (unsigned int level = array->shift; level > 0; level -= MONKEY_VECTOR_BITS)
+            node = node->slots[(i >> level) & MONKEY_VECTOR_MASK];
+    }
+    *count = MONKEY_VECTOR_WIDTH - (i & MONKEY_VECTOR_MASK);
+    if (*count > array->length - index)
+        *count = array->length - index;
+    return node->slots + (i & MONKEY_VECTOR_MASK);
+}
+
+/* the elements separated by commas, ints are printed without inspect() */
 static char *
-join_expressions_list(cm_array_list *list)
+join_expressions_list(monkey_array_t *array)
 {
     char *string = NULL;
-    char *temp = NULL;
     char *elem_string;
-    monkey_object_t *elem;
-    int ret;
-    for (size_t i = 0; i < list->length; i++) {
-        elem = (monkey_object_t *) list->array[i];
-        elem_string = elem->inspect(elem);
-        if (string == NULL) {
-            ret = asprintf(&temp, "%s", elem_string);
-        } else {
-            ret = asprintf(&temp, "%s, %s", string, elem_string);
-            free(string);
+    size_t size, count;
+    void **slots;
+    FILE *stream = open_memstream(&string, &size);
+    if (stream == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    for (size_t i = 0; i < get_monkey_array_length(array); i += count) {
+        slots = get_monkey_array_slots(array, i, &count);
+        for (size_t j = 0; j < count; j++) {
+            if (i + j > 0)
+                fputs(", ", stream);
+            if (array->kind == MONKEY_ELEMENTS_INT) {
+                fprintf(stream, "%ld", get_monkey_int_value(slots[j]));
+                continue;
+            }
+            elem_string = inspect(slots[j]);
+            fputs(elem_string, stream);
+            free(elem_string);
         }
-        free(elem_string);
-        if (ret == -1)
-            errx(EXIT_FAILURE, "malloc failed");
-        string = temp;
-        temp = NULL;
     }
+    if (fclose(stream) == EOF)
+        err(EXIT_FAILURE, "malloc failed");
     return string;
 }
 
@@ -94,30 +119,26 @@ join_expressions_table(cm_hash_table *table)
     monkey_object_t *key_obj;
     monkey_object_t *value_obj;
     int ret;
-    for (size_t i = 0; i < table->used_slots->length; i++) {
-        size_t *index = (size_t *) table->used_slots->array[i];
-        cm_list *entry_list = table->table[*index];
-        cm_list_node *entry_node = entry_list->head;
-        while (entry_node != NULL) {
-            cm_hash_entry *entry = (cm_hash_entry *) entry_node->data;
-            entry_node = entry_node->next;
-            key_obj = (monkey_object_t *) entry->key;
-            value_obj = (monkey_object_t *) entry->value;
-            key_string = key_obj->inspect(key_obj);
-            value_string = value_obj->inspect(value_obj);
-            if (string == NULL)
-                ret = asprintf(&temp, "%s: %s", key_string, value_string);
-            else {
-                ret = asprintf(&temp, "%s, %s: %s", string, key_string, value_string);
-                free(string);
-            }
-            free(key_string);
-            free(value_string);
-            if (ret == -1)
-                errx(EXIT_FAILURE, "malloc failed");
-            string = temp;
-            temp = NULL;
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_hash_table_iterator_init(&iterator, table);
+    while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL) {
+        key_obj = (monkey_object_t *) entry->key;
+        value_obj = (monkey_object_t *) entry->value;
+        key_string = inspect(key_obj);
+        value_string = inspect(value_obj);
+        if (string == NULL)
+            ret = asprintf(&temp, "%s: %s", key_string, value_string);
+        else {
+            ret = asprintf(&temp, "%s, %s: %s", string, key_string, value_string);
+            free(string);
         }
+        free(key_string);
+        free(value_string);
+        if (ret == -1)
+            errx(EXIT_FAILURE, "malloc failed");
+        string = temp;
+        temp = NULL;
     }
     ret = asprintf(&temp, "{%s}", string);
     free(string);
@@ -126,98 +147,189 @@ join_expressions_table(cm_hash_table *table)
     return temp;
 }
 
-char *
-inspect(monkey_object_t *obj)
+static char *
+monkey_int_inspect(monkey_object_t *obj)
 {
-    monkey_int_t *int_obj;
-    monkey_bool_t *bool_obj;
-    monkey_return_value_t *ret_obj;
-    monkey_error_t *err_obj;
-    monkey_array_t *array;
-    monkey_hash_t *hash_obj;
-    monkey_compiled_fn_t *compiled_fn;
+    return long_to_string(get_monkey_int_value(obj));
+}
+
+static char *
+monkey_bool_inspect(monkey_object_t *obj)
+{
+    return ((monkey_bool_t *) obj)->value? strdup("true"): strdup("false");
+}
+
+static char *
+monkey_null_inspect(monkey_object_t *obj)
+{
+    return strdup("null");
+}
+
+static char *
+monkey_return_value_inspect(monkey_object_t *obj)
+{
+    return inspect(((monkey_return_value_t *) obj)->value);
+}
+
+static char *
+monkey_error_inspect(monkey_object_t *obj)
+{
+    return strdup(((monkey_error_t *) obj)->message);
+}
+
+static char *
+monkey_string_inspect(monkey_object_t *obj)
+{
+    monkey_string_t *str_obj = (monkey_string_t *) obj;
+    char *string = strndup(get_monkey_string_value(str_obj), str_obj->length);
+    if (string == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    return string;
+}
+
+static char *
+monkey_builtin_inspect(monkey_object_t *obj)
+{
+    return strdup("builtin function");
+}
+
+static char *
+monkey_array_inspect(monkey_object_t *obj)
+{
+    monkey_array_t *array = (monkey_array_t *) obj;
     char *string = NULL;
     char *elements_string = NULL;
     int ret;
+    if (get_monkey_array_length(array) > 0)
+        elements_string = join_expressions_list(array);
+    ret = asprintf(&string, "[%s]", elements_string? elements_string: "");
+    if (elements_string != NULL)
+        free(elements_string);
+    if (ret == -1)
+        errx(EXIT_FAILURE, "malloc failed");
+    return string;
+}
 
-    switch (obj->type)
-    {
-        case MONKEY_INT:
-            int_obj = (monkey_int_t *) obj;
-            return long_to_string(int_obj->value);
-        case MONKEY_BOOL:
-            bool_obj = (monkey_bool_t *) obj;
-            return bool_obj->value? strdup("true"): strdup("false");
-        case MONKEY_NULL:
-            return strdup("null");
-        case MONKEY_RETURN_VALUE:
-            ret_obj = (monkey_return_value_t *) obj;
-            return ret_obj->value->inspect(ret_obj->value);
-        case MONKEY_ERROR:
-            err_obj = (monkey_error_t *) obj;
-            return strdup(err_obj->message);
-        case MONKEY_FUNCTION:
-            return monkey_function_inspect(obj);
-        case MONKEY_STRING:
-            return strdup(((monkey_string_t *) obj)->value);
-        case MONKEY_BUILTIN:
-            return strdup("builtin function");
-        case MONKEY_ARRAY:
-            array = (monkey_array_t *) obj;
-            if (array->elements->length > 0)
-                elements_string = join_expressions_list(array->elements);
-            ret = asprintf(&string, "[%s]", elements_string? elements_string: "");
-            if (elements_string != NULL)
-                free(elements_string);
-            if (ret == -1)
-                errx(EXIT_FAILURE, "malloc failed");
-            return string;
-        case MONKEY_HASH:
-            hash_obj = (monkey_hash_t *) obj;
-            return join_expressions_table(hash_obj->pairs);
-        case MONKEY_COMPILED_FUNCTION:
-            compiled_fn = (monkey_compiled_fn_t *) obj;
-            ret = asprintf(&string, "compiled function %p", compiled_fn);
-            if (ret == -1)
-                err(EXIT_FAILURE, "malloc failed");
-            return string;
-    }
+static char *
+monkey_hash_inspect(monkey_object_t *obj)
+{
+    return join_expressions_table(((monkey_hash_t *) obj)->pairs);
+}
+
+static char *
+monkey_compiled_fn_inspect(monkey_object_t *obj)
+{
+    char *string = NULL;
+    if (asprintf(&string, "compiled function %p", (void *) obj) == -1)
+        err(EXIT_FAILURE, "malloc failed");
+    return string;
 }
 
+/* ints and booleans are equal when their words are, compare those a leaf at a time */
 static _Bool
-array_equals(monkey_array_t *arr1, monkey_array_t *arr2)
+monkey_array_equals(monkey_object_t *obj1, monkey_object_t *obj2)
 {
-    if (arr1->elements->length != arr2->elements->length)
+    monkey_array_t *arr1 = (monkey_array_t *) obj1;
+    monkey_array_t *arr2 = (monkey_array_t *) obj2;
+    size_t count1, count2, count;
+    void **slots1, **slots2;
+    _Bool unboxed = arr1->kind != MONKEY_ELEMENTS_GENERIC &&
+        arr2->kind != MONKEY_ELEMENTS_GENERIC;
+    if (get_monkey_array_length(arr1) != get_monkey_array_length(arr2))
         return false;
-    for (size_t i = 0; i < arr1->elements->length; i++) {
-        if (!monkey_object_equals(arr1->elements->array[i], arr2->elements->array[i]))
-            return false;
+    for (size_t i = 0; i < get_monkey_array_length(arr1); i += count) {
+        slots1 = get_monkey_array_slots(arr1, i, &count1);
+        slots2 = get_monkey_array_slots(arr2, i, &count2);
+        count = count1 < count2? count1: count2;
+        if (unboxed) {
+            if (memcmp(slots1, slots2, count * sizeof(*slots1)) != 0)
+                return false;
+            continue;
+        }
+        for (size_t j = 0; j < count; j++) {
+            if (!monkey_object_equals(slots1[j], slots2[j]))
+                return false;
+        }
     }
     return true;
 }
 
 static _Bool
-hash_equals(monkey_hash_t *hash1, monkey_hash_t *hash2)
+monkey_hash_equals(monkey_object_t *obj1, monkey_object_t *obj2)
 {
+    monkey_hash_t *hash1 = (monkey_hash_t *) obj1;
+    monkey_hash_t *hash2 = (monkey_hash_t *) obj2;
     if (hash1->pairs->nkeys != hash2->pairs->nkeys)
         return false;
-    for (size_t i = 0; i < hash1->pairs->nkeys; i++) {
-        size_t *index1 = (size_t *) hash1->pairs->used_slots->array[i];
-        size_t *index2 = (size_t *) hash2->pairs->used_slots->array[i];
-        if (*index1 != *index2) {
-            /** since we are using same hash functions, and both tables
-             *  are supposed to have equal length, they must have same
-             *  objects at same indices
-             */
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_hash_table_iterator_init(&iterator, hash1->pairs);
+    while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL) {
+        monkey_object_t *value = cm_hash_table_get(hash2->pairs, entry->key);
+        if (value == NULL || !monkey_object_equals(entry->value, value))
             return false;
-        }
     }
     return true;
 }
 
+/*
+ * There is only one interned string per value, so two interned strings are
+ * equal only if they are the same object. Otherwise the lengths and the
+ * cached hashes, when both are known, rule out most unequal strings.
+ */
+static _Bool
+monkey_string_equals(monkey_object_t *obj1, monkey_object_t *obj2)
+{
+    monkey_string_t *str1 = (monkey_string_t *) obj1;
+    monkey_string_t *str2 = (monkey_string_t *) obj2;
+    if (str1 == str2)
+        return true;
+    if ((is_interned_monkey_string(str1) && is_interned_monkey_string(str2)) ||
+        str1->length != str2->length)
+        return false;
+    if (str1->hash != 0 && str2->hash != 0 && str1->hash != str2->hash)
+        return false;
+    return memcmp(get_monkey_string_value(str1), get_monkey_string_value(str2),
+        str1->length) == 0;
+}
+
+static _Bool
+monkey_int_equals(monkey_object_t *obj1, monkey_object_t *obj2)
+{
+    return get_monkey_int_value(obj1) == get_monkey_int_value(obj2);
+}
+
+static _Bool
+monkey_bool_equals(monkey_object_t *obj1, monkey_object_t *obj2)
+{
+    return ((monkey_bool_t *) obj1)->value == ((monkey_bool_t *) obj2)->value;
+}
+
+static _Bool
+monkey_error_equals(monkey_object_t *obj1, monkey_object_t *obj2)
+{
+    return strcmp(((monkey_error_t *) obj1)->message, ((monkey_error_t *) obj2)->message) == 0;
+}
+
+static _Bool
+monkey_return_value_equals(monkey_object_t *obj1, monkey_object_t *obj2)
+{
+    return monkey_object_equals(((monkey_return_value_t *) obj1)->value,
+        ((monkey_return_value_t *) obj2)->value);
+}
+
+/* null, builtins and functions are only equal to themselves */
+static _Bool
+monkey_identity_equals(monkey_object_t *obj1, monkey_object_t *obj2)
+{
+    return obj1 == obj2;
+}
+
 static _Bool
-instructions_equals(instructions_t *ins1, instructions_t *ins2)
+monkey_compiled_fn_equals(monkey_object_t *obj1, monkey_object_t *obj2)
 {
+    instructions_t *ins1 = ((monkey_compiled_fn_t *) obj1)->instructions;
+    instructions_t *ins2 = ((monkey_compiled_fn_t *) obj2)->instructions;
     if (ins1->length != ins2->length)
         return false;
     for (size_t i = 0; i < ins1->length; i++) {
@@ -227,129 +339,111 @@ instructions_equals(instructions_t *ins1, instructions_t *ins2)
     return true;
 }
 
+/* djb2 like string_hash_function, but over the known length */
+static size_t
+hash_string(const char *value, size_t length)
+{
+    size_t hash = 5381;
+    for (size_t i = 0; i < length; i++)
+        hash = ((hash << 5) + hash) + (unsigned char) value[i];
+    return hash;
+}
+
+static size_t
+monkey_string_hash(monkey_object_t *obj)
+{
+    monkey_string_t *str_obj = (monkey_string_t *) obj;
+    if (str_obj->hash == 0)
+        str_obj->hash = hash_string(get_monkey_string_value(str_obj), str_obj->length);
+    return str_obj->hash;
+}
+
+static size_t
+monkey_int_hash(monkey_object_t *obj)
+{
+    long value = get_monkey_int_value(obj);
+    return int_hash_function(&value);
+}
+
+static size_t
+monkey_bool_hash(monkey_object_t *obj)
+{
+    return pointer_hash_function(obj);
+}
+
+const monkey_object_ops_t monkey_object_ops[] = {
+    [MONKEY_INT] = {monkey_int_inspect, monkey_int_hash, monkey_int_equals},
+    [MONKEY_BOOL] = {monkey_bool_inspect, monkey_bool_hash, monkey_bool_equals},
+    [MONKEY_NULL] = {monkey_null_inspect, NULL, monkey_identity_equals},
+    [MONKEY_RETURN_VALUE] = {monkey_return_value_inspect, NULL, monkey_return_value_equals},
+    [MONKEY_ERROR] = {monkey_error_inspect, NULL, monkey_error_equals},
+    [MONKEY_FUNCTION] = {monkey_function_inspect, NULL, monkey_identity_equals},
+    [MONKEY_STRING] = {monkey_string_inspect, monkey_string_hash, monkey_string_equals},
+    [MONKEY_BUILTIN] = {monkey_builtin_inspect, NULL, monkey_identity_equals},
+    [MONKEY_ARRAY] = {monkey_array_inspect, NULL, monkey_array_equals},
+    [MONKEY_HASH] = {monkey_hash_inspect, NULL, monkey_hash_equals},
+    [MONKEY_COMPILED_FUNCTION] = {monkey_compiled_fn_inspect, NULL, monkey_compiled_fn_equals}
+};
+
+char *
+inspect(monkey_object_t *obj)
+{
+    return get_monkey_object_ops(obj)->inspect(obj);
+}
+
 _Bool
 monkey_object_equals(void *o1, void *o2)
 {
     monkey_object_t *obj1 = (monkey_object_t *) o1;
     monkey_object_t *obj2 = (monkey_object_t *) o2;
-    if (obj1->type != obj2->type)
+    if (get_monkey_object_type(obj1) != get_monkey_object_type(obj2))
         return false;
-
-    monkey_array_t *array1;
-    monkey_array_t *array2;
-    monkey_builtin_t *builtin1;
-    monkey_builtin_t *builtin2;
-    monkey_error_t *err1;
-    monkey_error_t *err2;
-    monkey_function_t *function1;
-    monkey_function_t *function2;
-    monkey_hash_t *hash1;
-    monkey_hash_t *hash2;
-    monkey_int_t *int1;
-    monkey_int_t *int2;
-    monkey_string_t *str1;
-    monkey_string_t *str2;
-    monkey_return_value_t *ret1;
-    monkey_return_value_t *ret2;
-    monkey_compiled_fn_t *fn1;
-    monkey_compiled_fn_t *fn2;
-    switch (obj1->type) {
-        case MONKEY_ARRAY:
-            array1 = (monkey_array_t *) obj1;
-            array2 = (monkey_array_t *) obj2;
-            return array_equals(array1, array2);
-        case MONKEY_BOOL:
-            return ((monkey_bool_t *) obj1)->value == ((monkey_bool_t *) obj2)->value;
-        case MONKEY_BUILTIN:
-            builtin1 = (monkey_builtin_t *) obj1;
-            builtin2 = (monkey_builtin_t *) obj2;
-            return builtin1 == builtin2; // these are static pointers
-        case MONKEY_ERROR:
-            err1 = (monkey_error_t *) obj1;
-            err2 = (monkey_error_t *) obj2;
-            return strcmp(err1->message, err2->message) == 0;
-        case MONKEY_FUNCTION:
-            function1 = (monkey_function_t *) obj1;
-            function2 = (monkey_function_t *) obj2;
-            return function1 == function2; //should we bother about this?
-        case MONKEY_HASH:
-            hash1 = (monkey_hash_t *) obj1;
-            hash2 = (monkey_hash_t *) obj2;
-            return hash_equals(hash1, hash2);
-        case MONKEY_INT:
-            int1 = (monkey_int_t *) obj1;
-            int2 = (monkey_int_t *) obj2;
-            return int1->value == int2->value;
-        case MONKEY_STRING:
-            str1 = (monkey_string_t *) obj1;
-            str2 = (monkey_string_t *) obj2;
-            return strcmp(str1->value, str2->value) == 0;
-        case MONKEY_RETURN_VALUE:
-            ret1 = (monkey_return_value_t *) obj1;
-            ret2 = (monkey_return_value_t *) obj2;
-            return monkey_object_equals(ret1->value, ret2->value);
-        case MONKEY_NULL:
-            return obj1 == obj2;
-        case MONKEY_COMPILED_FUNCTION:
-            fn1 = (monkey_compiled_fn_t *) obj1;
-            fn2 = (monkey_compiled_fn_t *) obj2;
-            return instructions_equals(fn1->instructions, fn2->instructions);
-    }
+    return get_monkey_object_ops(obj1)->equals(obj1, obj2);
 }
 
 size_t
 monkey_object_hash(void *object)
 {
-    monkey_object_t *monkey_object = (monkey_object_t *) object;
-    monkey_string_t *str_obj;
-    monkey_int_t *int_obj;
-    monkey_bool_t *bool_obj;
-    switch (monkey_object->type) {
-        case MONKEY_STRING:
-            str_obj = (monkey_string_t *) object;
-            return string_hash_function(str_obj->value);
-        case MONKEY_INT:
-            int_obj = (monkey_int_t *) object;
-            return int_hash_function(&int_obj->value);
-        case MONKEY_BOOL:
-            bool_obj = (monkey_bool_t *) object;
-            return pointer_hash_function(bool_obj);
-        default:
-            // We don't expect to come here, since the hash field is set to
-            // NULL for other object types
-            return 0;
-    }
+    monkey_object_t *obj = (monkey_object_t *) object;
+    const monkey_object_ops_t *ops = get_monkey_object_ops(obj);
+    // only hashable objects are used as keys
+    return ops->hash != NULL? ops->hash(obj): 0;
 }
 
 monkey_int_t *
 create_monkey_int(long value)
 {
     monkey_int_t *int_obj;
-    int_obj = malloc(sizeof(*int_obj));
-    if (int_obj == NULL)
-        err(EXIT_FAILURE, "malloc failed");
-    int_obj->object.inspect = inspect;
+    int_obj = cm_slab_alloc(sizeof(*int_obj));
     int_obj->object.type = MONKEY_INT;
-    int_obj->object.hash = monkey_object_hash;
-    int_obj->object.equals = monkey_object_equals;
+    int_obj->object.refcount = 1;
+    int_obj->object.flags = 0;
     int_obj->value = value;
     return int_obj;
 }
 
+monkey_object_t *
+create_monkey_int_object(long value)
+{
+    if (value >= MONKEY_IMMEDIATE_MIN && value <= MONKEY_IMMEDIATE_MAX)
+        return create_monkey_immediate_int(value);
+    return (monkey_object_t *) create_monkey_int(value);
+}
+
 monkey_compiled_fn_t *
 create_monkey_compiled_fn(instructions_t *ins, size_t num_locals, size_t num_args)
 {
     monkey_compiled_fn_t *compiled_fn;
-    compiled_fn = malloc(sizeof(*compiled_fn));
-    if (compiled_fn == NULL)
-        err(EXIT_FAILURE, "malloc failed");
+    compiled_fn = cm_slab_alloc(sizeof(*compiled_fn));
     compiled_fn->instructions = ins;
     compiled_fn->num_locals = num_locals;
     compiled_fn->num_args = num_args;
+    compiled_fn->decoded = NULL;
+    compiled_fn->calls = 0;
+    compiled_fn->jit = NULL;
     compiled_fn->object.type = MONKEY_COMPILED_FUNCTION;
-    compiled_fn->object.inspect = inspect;
-    compiled_fn->object.equals = monkey_object_equals;
-    compiled_fn->object.hash = NULL;
+    compiled_fn->object.refcount = 1;
+    compiled_fn->object.flags = 0;
     return compiled_fn;
 }
 
@@ -357,14 +451,11 @@ monkey_return_value_t *
 create_monkey_return_value(monkey_object_t *value)
 {
     monkey_return_value_t *ret;
-    ret = malloc(sizeof(*ret));
-    if (ret == NULL)
-        errx(EXIT_FAILURE, "malloc failed");
+    ret = cm_slab_alloc(sizeof(*ret));
     ret->value = value;
     ret->object.type = MONKEY_RETURN_VALUE;
-    ret->object.inspect = inspect;
-    ret->object.equals = monkey_object_equals;
-    ret->object.hash = NULL;
+    ret->object.refcount = 1;
+    ret->object.flags = 0;
     return ret;
 }
 
@@ -373,13 +464,10 @@ create_monkey_error(const char *fmt, ...)
 {
     monkey_error_t *error;
     char *message = NULL;
-    error = malloc(sizeof(*error));
-    if (error == NULL)
-        errx(EXIT_FAILURE, "malloc failed");
+    error = cm_slab_alloc(sizeof(*error));
     error->object.type = MONKEY_ERROR;
-    error->object.inspect = inspect;
-    error->object.hash = NULL;
-    error->object.equals = monkey_object_equals;
+    error->object.refcount = 1;
+    error->object.flags = 0;
     va_list args;
     va_start(args, fmt);
     int ret = vasprintf(&message, fmt, args);
@@ -394,18 +482,108 @@ create_monkey_error(const char *fmt, ...)
 static void
 free_monkey_function_object(monkey_function_t *function_obj)
 {
-    free_statement((statement_t *) function_obj->body);
-    cm_list_free(function_obj->parameters, free_expression);
-    free(function_obj);
+    if (function_obj->env != NULL)
+        env_free(function_obj->env);
+    cm_slab_free(function_obj, sizeof(*function_obj));
 }
 
-void
-free_monkey_object(void *v)
+/*
+ * Repeated concatenation builds ropes as deep as the number of
+ * concatenations, so they are freed with an explicit stack rather than by
+ * recursion.
+ */
+static void
+free_monkey_string(monkey_string_t *str)
+{
+    size_t size = 8, count = 0;
+    monkey_string_t **pending = malloc(size * sizeof(*pending));
+    if (pending == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    pending[count++] = str;
+    while (count > 0) {
+        str = pending[--count];
+        monkey_string_t *children[] = {str->left, str->right, str->base};
+        for (size_t i = 0; i < 3; i++) {
+            monkey_string_t *child = children[i];
+            if (child == NULL || child->object.refcount == MONKEY_REFCOUNT_IMMORTAL ||
+                --child->object.refcount > 0)
+                continue;
+            if (count == size) {
+                size *= 2;
+                pending = realloc(pending, size * sizeof(*pending));
+                if (pending == NULL)
+                    err(EXIT_FAILURE, "malloc failed");
+            }
+            pending[count++] = child;
+        }
+        if (str->base == NULL)
+            cm_slab_free(str->value, str->length + 1);
+        cm_slab_free(str, sizeof(*str));
+    }
+    free(pending);
+}
+
+static monkey_vector_node_t *
+create_vector_node(void)
+{
+    monkey_vector_node_t *node = cm_slab_alloc(sizeof(*node));
+    node->refcount = 1;
+    node->length = 0;
+    node->kind = MONKEY_ELEMENTS_INT;
+    return node;
+}
+
+static monkey_vector_node_t *
+retain_vector_node(monkey_vector_node_t *node)
+{
+    if (node != NULL)
+        node->refcount++;
+    return node;
+}
+
+/* level is 0 for leaves, whose slots are elements, and the shift of the node otherwise */
+static void
+release_vector_node(monkey_vector_node_t *node, unsigned int level)
+{
+    if (node == NULL || --node->refcount > 0)
+        return;
+    if (level == 0 && node->kind != MONKEY_ELEMENTS_GENERIC) {
+        cm_slab_free(node, sizeof(*node));
+        return;
+    }
+    for (size_t i = 0; i < node->length; i++) {
+        if (level == 0)
+            release_monkey_object(node->slots[i]);
+        else
+            release_vector_node(node->slots[i], level - MONKEY_VECTOR_BITS);
+    }
+    cm_slab_free(node, sizeof(*node));
+}
+
+/* a copy of the first length slots of the node, which it shares with it */
+static monkey_vector_node_t *
+copy_vector_node(monkey_vector_node_t *node, size_t length, unsigned int level)
+{
+    monkey_vector_node_t *copy = create_vector_node();
+    memcpy(copy->slots, node->slots, length * sizeof(node->slots[0]));
+    copy->length = length;
+    copy->kind = node->kind;
+    if (level == 0 && node->kind != MONKEY_ELEMENTS_GENERIC)
+        return copy;
+    for (size_t i = 0; i < length; i++) {
+        if (level == 0)
+            retain_monkey_object(copy->slots[i]);
+        else
+            retain_vector_node(copy->slots[i]);
+    }
+    return copy;
+}
+
+static void
+free_monkey_object(monkey_object_t *object)
 {
-    monkey_object_t *object = (monkey_object_t *) v;
     monkey_error_t *err_obj;
     monkey_return_value_t *return_value;
-    monkey_string_t *str_obj;
     monkey_array_t *array;
     monkey_hash_t *hash_obj;
     monkey_compiled_fn_t *compiled_fn;
@@ -414,115 +592,88 @@ free_monkey_object(void *v)
         case MONKEY_NULL:
             break;
         case MONKEY_INT:
-            free((monkey_int_t *) object);
+            cm_slab_free(object, sizeof(monkey_int_t));
             break;
         case MONKEY_ERROR:
             err_obj = (monkey_error_t *) object;
             free(err_obj->message);
-            free(err_obj);
+            cm_slab_free(err_obj, sizeof(*err_obj));
             break;
         case MONKEY_FUNCTION:
             free_monkey_function_object((monkey_function_t *) object);
             break;
         case MONKEY_RETURN_VALUE:
             return_value = (monkey_return_value_t *) object;
-            free_monkey_object(return_value->value);
-            free(return_value);
+            release_monkey_object(return_value->value);
+            cm_slab_free(return_value, sizeof(*return_value));
             break;
         case MONKEY_STRING:
-            str_obj = (monkey_string_t *) object;
-            free(str_obj->value);
-            free(str_obj);
+            free_monkey_string((monkey_string_t *) object);
             break;
         case MONKEY_ARRAY:
             array = (monkey_array_t *) object;
-            cm_array_list_free(array->elements);
-            free(array);
+            release_vector_node(array->root, array->shift);
+            release_vector_node(array->tail, 0);
+            cm_slab_free(array, sizeof(*array));
             break;
         case MONKEY_HASH:
             hash_obj = (monkey_hash_t *) object;
             cm_hash_table_free(hash_obj->pairs);
-            free(hash_obj);
+            cm_slab_free(hash_obj, sizeof(*hash_obj));
             break;
         case MONKEY_COMPILED_FUNCTION:
             compiled_fn = (monkey_compiled_fn_t *) object;
             instructions_free(compiled_fn->instructions);
-            free(compiled_fn);
+            decoded_instructions_free(compiled_fn->decoded);
+            jit_free(compiled_fn->jit);
+            cm_slab_free(compiled_fn, sizeof(*compiled_fn));
             break;
         case MONKEY_BUILTIN:
+            cm_slab_free(object, sizeof(monkey_builtin_t));
             break;
-        default:
-            free(object);
     }
 }
 
-static void *
-_copy_monkey_object(void *v)
+monkey_object_t *
+retain_monkey_object(monkey_object_t *object)
 {
-    return (void *) copy_monkey_object((monkey_object_t *) v);
+    if (object == NULL || is_immediate_int(object) ||
+        object->refcount == MONKEY_REFCOUNT_IMMORTAL)
+        return object;
+    object->refcount++;
+    return object;
 }
 
-monkey_object_t *
-copy_monkey_object(monkey_object_t *object)
+void
+release_monkey_object(void *v)
 {
-    monkey_int_t *int_obj;
-    monkey_function_t *function_obj;
-    monkey_string_t *str_obj;
-    monkey_builtin_t *builtin;
-    monkey_array_t *array_obj;
-    monkey_hash_t *hash_obj;
-    monkey_compiled_fn_t *compiled_fn;
-    if (object == NULL)
-        return (monkey_object_t *) create_monkey_null();
-
-    switch (object->type) {
-        case MONKEY_BOOL:
-        case MONKEY_NULL:
-            return object;
-        case MONKEY_INT:
-            int_obj = (monkey_int_t *) object;
-            return (monkey_object_t *) create_monkey_int(int_obj->value);
-        case MONKEY_FUNCTION:
-            function_obj = (monkey_function_t *) object;
-            return (monkey_object_t *) create_monkey_function(
-                function_obj->parameters, function_obj->body, function_obj->env);
-        case MONKEY_STRING:
-            str_obj = (monkey_string_t *) object;
-            return (monkey_object_t *) create_monkey_string(str_obj->value, str_obj->length);
-        case MONKEY_BUILTIN:
-            builtin = (monkey_builtin_t *) object;
-            return (monkey_object_t *) create_monkey_builtin(builtin->function);
-        case MONKEY_ARRAY:
-            array_obj = (monkey_array_t *) object;
-            return (monkey_object_t *) create_monkey_array(cm_array_list_copy(array_obj->elements, _copy_monkey_object));
-        case MONKEY_HASH:
-            hash_obj = (monkey_hash_t *) object;
-            return (monkey_object_t *) create_monkey_hash(cm_hash_table_copy(hash_obj->pairs,
-                _copy_monkey_object, _copy_monkey_object));
-        case MONKEY_COMPILED_FUNCTION:
-            compiled_fn = (monkey_compiled_fn_t *) object;
-            return (monkey_object_t *) create_monkey_compiled_fn(copy_instructions(compiled_fn->instructions),
-                compiled_fn->num_locals, compiled_fn->num_args);
-        default:
-            return NULL;
+    monkey_object_t *object = (monkey_object_t *) v;
+    if (object == NULL || is_immediate_int(object) ||
+        object->refcount == MONKEY_REFCOUNT_IMMORTAL)
+        return;
+    if (--object->refcount == 0) {
+        free_monkey_object(object);
+    } else if (object->refcount == 1 && object->type == MONKEY_FUNCTION &&
+        ((monkey_function_t *) object)->env != NULL) {
+        /* it may be left only in a slot of the environment it encloses */
+        env_collect(((monkey_function_t *) object)->env);
     }
 }
 
-
 monkey_function_t *
-create_monkey_function(cm_list *parameters, block_statement_t *body, environment_t *env)
+create_monkey_function(cm_list *parameters, block_statement_t *body, size_t nslots,
+    environment_t *env)
 {
     monkey_function_t *function;
-    function = malloc(sizeof(*function));
-    if (function == NULL)
-        errx(EXIT_FAILURE, "malloc failed");
-    function->parameters = copy_parameters(parameters);
-    function->body = (block_statement_t *) copy_statement((statement_t *) body);
-    function->env = env;
+    function = cm_slab_alloc(sizeof(*function));
+    function->parameters = parameters;
+    function->body = body;
+    function->nslots = nslots;
+    function->env = env_retain(env);
+    function->code = NULL;
     function->object.type = MONKEY_FUNCTION;
-    function->object.inspect = inspect;
-    function->object.hash = NULL;
-    function->object.equals = monkey_object_equals;
+    function->object.refcount = 1;
+    function->object.flags = 0;
     return function;
 }
 
@@ -530,66 +681,443 @@ monkey_string_t *
 create_monkey_string(const char *value, size_t length)
 {
     monkey_string_t *string_obj;
-    string_obj = malloc(sizeof(*string_obj));
-    if (string_obj == NULL)
-        err(EXIT_FAILURE, "malloc failed");
+    string_obj = cm_slab_alloc(sizeof(*string_obj));
     if (value != NULL) {
-        string_obj->value = malloc(sizeof(*value) * (length + 1));
-        if (value == NULL)
-            err(EXIT_FAILURE, "malloc failed");
+        string_obj->value = cm_slab_alloc(length + 1);
         memcpy(string_obj->value, value, length);
         string_obj->value[length] = 0;
-        if (string_obj->value == NULL)
-            err(EXIT_FAILURE, "malloc failed");
         string_obj->length = length;
     } else {
         string_obj->value = NULL;
         string_obj->length = 0;
     }
+    string_obj->hash = 0;
+    string_obj->left = NULL;
+    string_obj->right = NULL;
+    string_obj->base = NULL;
     string_obj->object.type = MONKEY_STRING;
-    string_obj->object.hash = monkey_object_hash;
-    string_obj->object.inspect = inspect;
-    string_obj->object.equals = monkey_object_equals;
+    string_obj->object.refcount = 1;
+    string_obj->object.flags = 0;
+    return string_obj;
+}
+
+monkey_string_t *
+concat_monkey_strings(monkey_string_t *left, monkey_string_t *right)
+{
+    size_t length = left->length + right->length;
+    monkey_string_t *string_obj;
+    if (length < MONKEY_ROPE_MIN_LENGTH) {
+        string_obj = create_monkey_string(NULL, 0);
+        string_obj->value = cm_slab_alloc(length + 1);
+        memcpy(string_obj->value, get_monkey_string_value(left), left->length);
+        memcpy(string_obj->value + left->length, get_monkey_string_value(right), right->length);
+        string_obj->value[length] = 0;
+        string_obj->length = length;
+        return string_obj;
+    }
+    if (right->length == 0)
+        return (monkey_string_t *) retain_monkey_object((monkey_object_t *) left);
+    if (left->length == 0)
+        return (monkey_string_t *) retain_monkey_object((monkey_object_t *) right);
+    string_obj = create_monkey_string(NULL, 0);
+    string_obj->length = length;
+    string_obj->left = (monkey_string_t *) retain_monkey_object((monkey_object_t *) left);
+    string_obj->right = (monkey_string_t *) retain_monkey_object((monkey_object_t *) right);
+    return string_obj;
+}
+
+/*
+ * The bytes from start up to end, which must be within the string. Slices
+ * point into the flat string owning the bytes, ropes are flattened first.
+ */
+monkey_string_t *
+create_monkey_string_slice(monkey_string_t *str, size_t start, size_t end)
+{
+    const char *value = get_monkey_string_value(str);
+    if (end - start <= 1)
+        return intern_monkey_string(value + start, end - start);
+    monkey_string_t *slice = create_monkey_string(NULL, 0);
+    slice->value = (char *) value + start;
+    slice->length = end - start;
+    slice->base = (monkey_string_t *) retain_monkey_object((monkey_object_t *)
+        (str->base != NULL? str->base: str));
+    return slice;
+}
+
+static _Bool
+get_slice_bound(monkey_object_t *bound, size_t length, size_t *value)
+{
+    long index;
+    if (bound == NULL || get_monkey_object_type(bound) == MONKEY_NULL)
+        return true;
+    if (get_monkey_object_type(bound) != MONKEY_INT)
+        return false;
+    index = get_monkey_int_value(bound);
+    *value = index < 0? 0: (size_t) index > length? length: (size_t) index;
+    return true;
+}
+
+/*
+ * left[start:end] on an array or a string, shared by all the engines. A
+ * missing or null start means 0 and a missing or null end means the
+ * length, the bounds are clamped to the length and an end before the start
+ * gives an empty slice. Returns a new reference, or NULL when the operands
+ * do not support slicing.
+ */
+monkey_object_t *
+slice_monkey_object(monkey_object_t *left, monkey_object_t *start, monkey_object_t *end)
+{
+    monkey_object_type left_type = get_monkey_object_type(left);
+    size_t length, from = 0, to;
+    if (left_type == MONKEY_ARRAY)
+        length = get_monkey_array_length((monkey_array_t *) left);
+    else if (left_type == MONKEY_STRING)
+        length = ((monkey_string_t *) left)->length;
+    else
+        return NULL;
+    to = length;
+    if (!get_slice_bound(start, length, &from) || !get_slice_bound(end, length, &to))
+        return NULL;
+    if (to < from)
+        to = from;
+    if (left_type == MONKEY_ARRAY)
+        return (monkey_object_t *) create_monkey_array_slice((monkey_array_t *) left, from, to);
+    return (monkey_object_t *) create_monkey_string_slice((monkey_string_t *) left, from, to);
+}
+
+/*
+ * Copies the leaves of a rope into value, which has room for its length.
+ * The buffer is filled from the end: the walk descends into the right
+ * halves and keeps the left ones on an explicit stack, so a rope built by
+ * appending to the same string needs almost no stack however deep it is.
+ */
+static void
+copy_rope(monkey_string_t *str, char *value)
+{
+    size_t size = 8, count = 0, offset = str->length;
+    monkey_string_t **pending = malloc(size * sizeof(*pending));
+    if (pending == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    pending[count++] = str;
+    while (count > 0) {
+        monkey_string_t *node = pending[--count];
+        while (node->left != NULL) {
+            if (count == size) {
+                size *= 2;
+                pending = realloc(pending, size * sizeof(*pending));
+                if (pending == NULL)
+                    err(EXIT_FAILURE, "malloc failed");
+            }
+            pending[count++] = node->left;
+            node = node->right;
+        }
+        offset -= node->length;
+        memcpy(value + offset, node->value, node->length);
+    }
+    free(pending);
+}
+
+/* turns a rope into a flat string */
+char *
+flatten_monkey_string(monkey_string_t *str)
+{
+    char *value = cm_slab_alloc(str->length + 1);
+    copy_rope(str, value);
+    value[str->length] = 0;
+    monkey_string_t *left = str->left;
+    monkey_string_t *right = str->right;
+    str->value = value;
+    str->left = NULL;
+    str->right = NULL;
+    release_monkey_object(left);
+    release_monkey_object(right);
+    return value;
+}
+
+/*
+ * Interned strings are shared by every compiler, VM and evaluator in the
+ * process: string constants, string literals and hash keys written in the
+ * program. They are immortal, so their number is bounded by the size of the
+ * programs. Of the strings computed at runtime only the empty and one byte
+ * slices of create_monkey_string_slice are interned, at most 257 of them.
+ */
+static cm_hash_table *intern_table;
+
+monkey_string_t *
+intern_monkey_string(const char *value, size_t length)
+{
+    monkey_string_t key;
+    key.object.type = MONKEY_STRING;
+    key.value = (char *) value;
+    key.length = length;
+    key.hash = 0;
+    key.object.flags = 0;
+    key.left = NULL;
+    key.right = NULL;
+    key.base = NULL;
+    monkey_string_t *string_obj;
+    cm_region *region = cm_slab_region;
+    if (intern_table != NULL && (string_obj = cm_hash_table_get(intern_table, &key)) != NULL)
+        return string_obj;
+    /* the string and the table outlive the region of a VM run */
+    if (region != NULL)
+        cm_region_leave(region);
+    if (intern_table == NULL)
+        intern_table = cm_hash_table_init(monkey_object_hash, monkey_object_equals, NULL, NULL);
+    string_obj = create_monkey_string(value, length);
+    string_obj->hash = monkey_object_hash(&key);
+    string_obj->object.flags |= MONKEY_FLAG_INTERNED;
+    string_obj->object.refcount = MONKEY_REFCOUNT_IMMORTAL;
+    cm_hash_table_put(intern_table, string_obj, string_obj);
+    if (region != NULL)
+        cm_region_enter(region);
     return string_obj;
 }
 
 monkey_builtin_t *
 create_monkey_builtin(builtin_fn function)
 {
-    monkey_builtin_t *builtin = malloc(sizeof(*builtin));
-    if (builtin == NULL)
-        errx(EXIT_FAILURE, "malloc failed");
+    monkey_builtin_t *builtin = cm_slab_alloc(sizeof(*builtin));
     builtin->object.type = MONKEY_BUILTIN;
-    builtin->object.inspect = inspect;
-    builtin->object.hash = NULL;
+    builtin->object.refcount = 1;
+    builtin->object.flags = 0;
     builtin->function = function;
     return builtin;
 }
 
+static monkey_array_t *
+create_empty_monkey_array(void)
+{
+    monkey_array_t *array = cm_slab_alloc(sizeof(*array));
+    array->object.type = MONKEY_ARRAY;
+    array->object.refcount = 1;
+    array->object.flags = 0;
+    array->root = NULL;
+    array->tail = NULL;
+    array->shift = MONKEY_VECTOR_BITS;
+    array->kind = MONKEY_ELEMENTS_INT;
+    array->count = 0;
+    array->offset = 0;
+    array->length = 0;
+    return array;
+}
+
+/* a node at the given level whose leftmost path leads to the leaf */
+static monkey_vector_node_t *
+new_vector_path(unsigned int level, monkey_vector_node_t *leaf)
+{
+    if (level == 0)
+        return leaf;
+    monkey_vector_node_t *node = create_vector_node();
+    node->slots[0] = new_vector_path(level - MONKEY_VECTOR_BITS, leaf);
+    node->length = 1;
+    return node;
+}
+
+/*
+ * Returns a copy of the subtrie with the full tail of a vector of count
+ * elements added as its last leaf. Only the path to the leaf is copied,
+ * the copy takes over the reference to the tail.
+ */
+static monkey_vector_node_t *
+push_vector_tail(size_t count, unsigned int level, monkey_vector_node_t *parent,
+    monkey_vector_node_t *tail)
+{
+    size_t subidx = ((count - 1) >> level) & MONKEY_VECTOR_MASK;
+    monkey_vector_node_t *node = parent != NULL?
+        copy_vector_node(parent, parent->length, level): create_vector_node();
+    monkey_vector_node_t *child;
+    if (level == MONKEY_VECTOR_BITS) {
+        child = tail;
+    } else if (subidx < node->length) {
+        child = push_vector_tail(count, level - MONKEY_VECTOR_BITS, node->slots[subidx], tail);
+        release_vector_node(node->slots[subidx], level - MONKEY_VECTOR_BITS);
+    } else {
+        child = new_vector_path(level - MONKEY_VECTOR_BITS, tail);
+    }
+    node->slots[subidx] = child;
+    if (subidx >= node->length)
+        node->length = subidx + 1;
+    return node;
+}
+
+/*
+ * Appends obj, whose reference it takes over, to the end of the array's
+ * vector, which must also be the end of the array. The array must not be
+ * visible to anyone else yet, the nodes it shares are not modified except
+ * for appending to a tail in which no other array has used the next slot.
+ * Boxed ints which fit in an immediate are stored unboxed, so that arrays
+ * built by the evaluator get the int kind too.
+ */
+static void
+append_monkey_array(monkey_array_t *array, monkey_object_t *obj)
+{
+    size_t tail_length = array->count - monkey_vector_tail_offset(array->count);
+    monkey_elements_kind_t kind;
+    monkey_vector_node_t *root;
+    long value;
+
+    if (!is_immediate_int(obj) && obj->type == MONKEY_INT) {
+        value = ((monkey_int_t *) obj)->value;
+        if (value >= MONKEY_IMMEDIATE_MIN && value <= MONKEY_IMMEDIATE_MAX) {
+            release_monkey_object(obj);
+            obj = create_monkey_immediate_int(value);
+        }
+    }
+    kind = get_monkey_elements_kind(obj);
+    if (array->tail == NULL) {
+        array->tail = create_vector_node();
+    } else if (tail_length == MONKEY_VECTOR_WIDTH) {
+        if ((array->count >> MONKEY_VECTOR_BITS) > ((size_t) 1 << array->shift)) {
+            /* the trie is full, grow it by a level */
+            root = create_vector_node();
+            root->slots[0] = array->root;
+            root->slots[1] = new_vector_path(array->shift, array->tail);
+            root->length = 2;
+            array->shift += MONKEY_VECTOR_BITS;
+        } else {
+            root = push_vector_tail(array->count, array->shift, array->root, array->tail);
+            release_vector_node(array->root, array->shift);
+        }
+        array->root = root;
+        array->tail = create_vector_node();
+        tail_length = 0;
+    } else if (array->tail->length != tail_length) {
+        /* another array appended to the shared tail already */
+        monkey_vector_node_t *tail = copy_vector_node(array->tail, tail_length, 0);
+        release_vector_node(array->tail, 0);
+        array->tail = tail;
+    }
+    array->tail->slots[tail_length] = obj;
+    array->tail->length = tail_length + 1;
+    if (tail_length == 0)
+        array->tail->kind = kind;
+    else
+        array->tail->kind = join_monkey_elements_kinds(array->tail->kind, kind);
+    if (array->count == 0)
+        array->kind = kind;
+    else
+        array->kind = join_monkey_elements_kinds(array->kind, kind);
+    array->count++;
+    array->length++;
+}
+
+/* takes over the elements of the list and frees it */
 monkey_array_t *
 create_monkey_array(cm_array_list *elements)
 {
-    monkey_array_t *array = malloc(sizeof(*array));
-    if (array == NULL)
-        errx(EXIT_FAILURE, "malloc failed");
-    array->object.type = MONKEY_ARRAY;
-    array->object.inspect = inspect;
-    array->object.hash = NULL;
-    array->elements = elements;
-    array->object.equals = monkey_object_equals;
+    monkey_array_t *array = create_empty_monkey_array();
+    for (size_t i = 0; i < elements->length; i++)
+        append_monkey_array(array, elements->array[i]);
+    elements->free_func = NULL;
+    cm_array_list_free(elements);
     return array;
 }
 
+/* the elements from start up to end, which must be within the array */
+monkey_array_t *
+create_monkey_array_slice(monkey_array_t *array, size_t start, size_t end)
+{
+    monkey_array_t *slice = create_empty_monkey_array();
+    slice->root = retain_vector_node(array->root);
+    slice->tail = retain_vector_node(array->tail);
+    slice->shift = array->shift;
+    slice->kind = array->kind;
+    slice->count = array->count;
+    slice->offset = array->offset + start;
+    slice->length = end - start;
+    return slice;
+}
+
+/*
+ * A new array with obj added at the end. It shares the vector of the array
+ * and copies at most the path to the new element, unless the array is a
+ * slice which ends before its vector does; those are copied.
+ */
+monkey_array_t *
+push_monkey_array(monkey_array_t *array, monkey_object_t *obj)
+{
+    monkey_array_t *result;
+    if (array->offset + array->length == array->count) {
+        result = create_monkey_array_slice(array, 0, array->length);
+    } else {
+        result = create_empty_monkey_array();
+        for (size_t i = 0; i < array->length; i++)
+            append_monkey_array(result, retain_monkey_object(get_monkey_array_element(array, i)));
+    }
+    append_monkey_array(result, retain_monkey_object(obj));
+    return result;
+}
+
 monkey_hash_t *
 create_monkey_hash(cm_hash_table *pairs)
 {
-    monkey_hash_t *hash_obj = malloc(sizeof(*hash_obj));
-    if (hash_obj == NULL)
-        errx(EXIT_FAILURE, "malloc failed");
+    monkey_hash_t *hash_obj = cm_slab_alloc(sizeof(*hash_obj));
     hash_obj->object.type = MONKEY_HASH;
-    hash_obj->object.inspect = inspect;
-    hash_obj->object.hash = NULL;
-    hash_obj->object.equals = monkey_object_equals;
+    hash_obj->object.refcount = 1;
+    hash_obj->object.flags = 0;
     hash_obj->pairs = pairs;
     return hash_obj;
-}
\ No newline at end of file
+}
+static void *
+copy_monkey_object_void(void *obj)
+{
+    return copy_monkey_object(obj);
+}
+
+/*
+ * A copy of obj which shares none of the objects a program allocates while
+ * it runs with it, for moving a value out of memory which is about to go
+ * away, like the region of a VM run. Ropes are copied flat without
+ * flattening the original. Only the immortal objects, builtins and
+ * compiled functions, which the compiler creates before the run, are
+ * shared. Returns a new reference.
+ */
+monkey_object_t *
+copy_monkey_object(monkey_object_t *obj)
+{
+    monkey_string_t *str, *copy;
+    monkey_array_t *array, *array_copy;
+    monkey_function_t *function, *function_copy;
+    switch (get_monkey_object_type(obj)) {
+    case MONKEY_INT:
+        if (is_immediate_int(obj))
+            return obj;
+        return (monkey_object_t *) create_monkey_int(((monkey_int_t *) obj)->value);
+    case MONKEY_STRING:
+        str = (monkey_string_t *) obj;
+        if (is_interned_monkey_string(str))
+            return obj;
+        if (str->left == NULL)
+            return (monkey_object_t *) create_monkey_string(str->value, str->length);
+        copy = create_monkey_string(NULL, 0);
+        copy->value = cm_slab_alloc(str->length + 1);
+        copy->length = str->length;
+        copy_rope(str, copy->value);
+        copy->value[str->length] = 0;
+        return (monkey_object_t *) copy;
+    case MONKEY_ARRAY:
+        array = (monkey_array_t *) obj;
+        array_copy = create_empty_monkey_array();
+        for (size_t i = 0; i < array->length; i++)
+            append_monkey_array(array_copy, copy_monkey_object(get_monkey_array_element(array, i)));
+        return (monkey_object_t *) array_copy;
+    case MONKEY_HASH:
+        return (monkey_object_t *) create_monkey_hash(cm_hash_table_copy(
+            ((monkey_hash_t *) obj)->pairs, copy_monkey_object_void, copy_monkey_object_void));
+    case MONKEY_ERROR:
+        return (monkey_object_t *) create_monkey_error("%s", ((monkey_error_t *) obj)->message);
+    case MONKEY_RETURN_VALUE:
+        return (monkey_object_t *) create_monkey_return_value(
+            copy_monkey_object(((monkey_return_value_t *) obj)->value));
+    case MONKEY_FUNCTION:
+        /* the AST and the environment are not allocated by the run */
+        function = (monkey_function_t *) obj;
+        function_copy = create_monkey_function(function->parameters, function->body,
+            function->nslots, function->env);
+        function_copy->code = function->code;
+        return (monkey_object_t *) function_copy;
+    default:
+        return retain_monkey_object(obj);
+    }
+}
@@ -30,7 +30,9 @@
 #ifndef OBJECT_H
 #define OBJECT_H
 
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "ast.h"
 #include "environment.h"
 #include "opcode.h"
@@ -65,13 +67,40 @@ static const char *type_names[] = {
 
 #define get_type_name(type) type_names[type]
 
+/*
+ * Objects are shared rather than copied: every holder of a pointer (a VM
+ * stack slot, a global, an array element, an environment entry, ...) owns
+ * one reference, taken with retain_monkey_object() and dropped with
+ * release_monkey_object(). Values are immutable once created, so a container
+ * can only ever point to objects which existed before it and reference cycles
+ * cannot be formed; function objects only borrow their environment. Statically
+ * allocated objects (true, false, null and the builtins) have a refcount of
+ * MONKEY_REFCOUNT_IMMORTAL and are never counted or freed.
+ */
+#define MONKEY_REFCOUNT_IMMORTAL 0
+
+/*
+ * The header every heap object starts with, 8 bytes. The operations on an
+ * object are not stored in it, they are found through its type in
+ * monkey_object_ops.
+ */
 typedef struct monkey_object_t {
-    monkey_object_type type;
-    char * (*inspect) (struct monkey_object_t *);
-    size_t (*hash) (void *);
-    _Bool (*equals) (void *, void *);
+    uint8_t type;       // a monkey_object_type
+    uint8_t flags;      // MONKEY_FLAG_*, depending on the type
+    uint32_t refcount;
 } monkey_object_t;
 
+/* flags of strings */
+#define MONKEY_FLAG_INTERNED 0x1    // the only string with this value in the intern table
+
+typedef struct monkey_object_ops_t {
+    char *(*inspect) (monkey_object_t *);
+    size_t (*hash) (monkey_object_t *);     // NULL when the type can't be a hash key
+    _Bool (*equals) (monkey_object_t *, monkey_object_t *);    // objects of the type
+} monkey_object_ops_t;
+
+extern const monkey_object_ops_t monkey_object_ops[];
+
 typedef struct monkey_int_t {
     monkey_object_t object;
     long value;
@@ -96,24 +125,53 @@ typedef struct monkey_error_t {
     char *message;
 } monkey_error_t;
 
+/*
+ * The parameters and the body point into the function literal of the
+ * program, which the evaluator never modifies. The program must outlive
+ * its functions, the REPL keeps every program it evaluated until the end.
+ */
 typedef struct monkey_function_t {
     monkey_object_t object;
     cm_list *parameters; // list of identifiers
     block_statement_t *body;
+    size_t nslots; // of the environment of a call
     environment_t *env;
+    struct closure_function_t *code; // the compiled literal, NULL for the AST walker
 } monkey_function_t;
 
+/*
+ * Concatenation does not copy long strings, it creates a rope node whose
+ * value is NULL and which references the two halves in left and right.
+ * The first use which needs the bytes flattens the node in place, so the
+ * value must be read with get_monkey_string_value(). length is always
+ * valid. A slice is a view into the value of its base string, it is not
+ * NUL terminated, so the value is only valid up to length.
+ */
 typedef struct monkey_string_t {
     monkey_object_t object;
     char *value;
     size_t length;
+    size_t hash;      // cached by monkey_object_hash, 0 until computed
+    struct monkey_string_t *left;   // the halves of an unflattened concatenation
+    struct monkey_string_t *right;
+    struct monkey_string_t *base;   // the string whose value a slice points into
 } monkey_string_t;
 
+/* concatenations shorter than this are copied right away */
+#define MONKEY_ROPE_MIN_LENGTH 64
+
+#define get_monkey_string_value(str) \
+    ((str)->left != NULL ? flatten_monkey_string(str): (str)->value)
+#define is_interned_monkey_string(str) (((str)->object.flags & MONKEY_FLAG_INTERNED) != 0)
+
 typedef struct monkey_compiled_fn_t {
     monkey_object_t object;
     instructions_t *instructions;
     size_t num_locals;
     size_t num_args;
+    decoded_instructions_t *decoded; // filled in by the VM on first call
+    size_t calls;                    // counted by the VM when the JIT is enabled
+    struct jit_code_t *jit;          // machine code, once the function got hot
 } monkey_compiled_fn_t;
 
 typedef monkey_object_t * (*builtin_fn) (cm_list *);
@@ -123,11 +181,75 @@ typedef struct monkey_builtin_t {
     builtin_fn function;
 } monkey_builtin_t;
 
+/*
+ * Arrays are persistent vectors: a trie of nodes with MONKEY_VECTOR_WIDTH
+ * slots whose leaves hold the elements, plus a tail leaf with the last
+ * elements which is kept out of the trie so that appending is cheap. Nodes
+ * are refcounted and shared between arrays. push() copies only the tail, or
+ * the path to a new leaf, and a slice shares the whole vector and is the
+ * length elements starting at offset. Use get_monkey_array_length() and
+ * get_monkey_array_element() to read an array.
+ */
+#define MONKEY_VECTOR_BITS 5
+#define MONKEY_VECTOR_WIDTH (1 << MONKEY_VECTOR_BITS)
+#define MONKEY_VECTOR_MASK (MONKEY_VECTOR_WIDTH - 1)
+
+/*
+ * What a leaf or an array holds, like the elements kinds of V8. Immediate
+ * ints and booleans are stored unboxed in the slots, need no refcounting
+ * and are equal only when they are the same word, so leaves and arrays of
+ * them skip the per-element work. A kind only moves towards generic.
+ */
+typedef enum monkey_elements_kind_t {
+    MONKEY_ELEMENTS_INT,
+    MONKEY_ELEMENTS_BOOL,
+    MONKEY_ELEMENTS_GENERIC
+} monkey_elements_kind_t;
+
+#define get_monkey_elements_kind(obj)                           \
+    (is_immediate_int(obj)? MONKEY_ELEMENTS_INT:                \
+    (obj)->type == MONKEY_BOOL? MONKEY_ELEMENTS_BOOL: MONKEY_ELEMENTS_GENERIC)
+
+#define join_monkey_elements_kinds(kind1, kind2) \
+    ((kind1) == (kind2)? (kind1): MONKEY_ELEMENTS_GENERIC)
+
+typedef struct monkey_vector_node_t {
+    size_t refcount;
+    size_t length;      // slots in use, arrays sharing a leaf may append to it
+    monkey_elements_kind_t kind;    // of the elements of a leaf
+    void *slots[MONKEY_VECTOR_WIDTH];
+} monkey_vector_node_t;
+
 typedef struct monkey_array_t {
     monkey_object_t object;
-    cm_array_list *elements;
+    monkey_vector_node_t *root;     // NULL while the elements fit in the tail
+    monkey_vector_node_t *tail;
+    unsigned int shift;             // index bits consumed above the leaves
+    monkey_elements_kind_t kind;    // of the elements of the vector
+    size_t count;                   // elements in the vector
+    size_t offset;                  // the first element of the array in the vector
+    size_t length;
 } monkey_array_t;
 
+/* the index of the first element in the tail of a vector of count elements */
+#define monkey_vector_tail_offset(count) \
+    ((count) < MONKEY_VECTOR_WIDTH? 0: (((count) - 1) >> MONKEY_VECTOR_BITS) << MONKEY_VECTOR_BITS)
+
+#define get_monkey_array_length(arr) ((arr)->length)
+
+static inline monkey_object_t *
+get_monkey_array_element(monkey_array_t *array, size_t index)
+{
+    size_t i = array->offset + index;
+    monkey_vector_node_t *node = array->tail;
+    if (i < monkey_vector_tail_offset(array->count)) {
+        node = array->root;
+        for (unsigned int level = array->shift; level > 0; level -= MONKEY_VECTOR_BITS)
+            node = node->slots[(i >> level) & MONKEY_VECTOR_MASK];
+    }
+    return node->slots[i & MONKEY_VECTOR_MASK];
+}
+
 typedef struct monkey_hash_t {
     monkey_object_t object;
     cm_hash_table *pairs;
@@ -144,18 +266,49 @@ extern const monkey_null_t MONKEY_NULL_OBJ;
 #define create_monkey_bool(val) ((val == true) ? ((monkey_bool_t *)&MONKEY_TRUE_OBJ): ((monkey_bool_t *)&MONKEY_FALSE_OBJ))
 #define create_monkey_null() (&MONKEY_NULL_OBJ)
 
+/*
+ * The VM does not allocate integers which fit in 63 bits, it encodes them
+ * directly in the object pointer with the lowest bit set. Heap objects are
+ * always at least 8 byte aligned, so that bit is otherwise unused. Booleans
+ * and null are already shared static objects and need no encoding. Any code
+ * which may see values produced by the VM must go through
+ * get_monkey_object_type() and get_monkey_int_value() instead of
+ * dereferencing the object.
+ */
+#define MONKEY_IMMEDIATE_TAG ((uintptr_t) 1)
+#define MONKEY_IMMEDIATE_MIN (LONG_MIN >> 1)
+#define MONKEY_IMMEDIATE_MAX (LONG_MAX >> 1)
+#define is_immediate_int(obj) ((((uintptr_t) (obj)) & MONKEY_IMMEDIATE_TAG) != 0)
+#define create_monkey_immediate_int(val) \
+    ((monkey_object_t *) ((((uintptr_t) (long) (val)) << 1) | MONKEY_IMMEDIATE_TAG))
+#define get_monkey_object_type(obj) \
+    (is_immediate_int(obj) ? MONKEY_INT: ((monkey_object_t *) (obj))->type)
+#define get_monkey_int_value(obj) \
+    (is_immediate_int(obj) ? (long) (((intptr_t) (obj)) >> 1): ((monkey_int_t *) (obj))->value)
+#define get_monkey_object_ops(obj) (&monkey_object_ops[get_monkey_object_type(obj)])
+#define is_hashable_monkey_object(obj) (get_monkey_object_ops(obj)->hash != NULL)
+
 
 monkey_int_t * create_monkey_int(long);
+monkey_object_t *create_monkey_int_object(long);
 monkey_bool_t *get_monkey_true(void);
-monkey_object_t *copy_monkey_object(monkey_object_t *);
+monkey_object_t *retain_monkey_object(monkey_object_t *);
 monkey_return_value_t *create_monkey_return_value(monkey_object_t *);
 monkey_error_t *create_monkey_error(const char *, ...);
-monkey_function_t *create_monkey_function(cm_list *, block_statement_t *, environment_t *);
+monkey_function_t *create_monkey_function(cm_list *, block_statement_t *, size_t, environment_t *);
 monkey_string_t *create_monkey_string(const char *, size_t);
+monkey_string_t *intern_monkey_string(const char *, size_t);
+monkey_string_t *concat_monkey_strings(monkey_string_t *, monkey_string_t *);
+char *flatten_monkey_string(monkey_string_t *);
 monkey_builtin_t *create_monkey_builtin(builtin_fn);
 monkey_array_t *create_monkey_array(cm_array_list *);
+monkey_array_t *create_monkey_array_slice(monkey_array_t *, size_t, size_t);
+monkey_array_t *push_monkey_array(monkey_array_t *, monkey_object_t *);
+monkey_string_t *create_monkey_string_slice(monkey_string_t *, size_t, size_t);
+monkey_object_t *slice_monkey_object(monkey_object_t *, monkey_object_t *, monkey_object_t *);
 monkey_hash_t *create_monkey_hash(cm_hash_table *);
 monkey_compiled_fn_t *create_monkey_compiled_fn(instructions_t *, size_t, size_t);
-void free_monkey_object(void *);
+monkey_object_t *copy_monkey_object(monkey_object_t *);
+void release_monkey_object(void *);
 
 #endif
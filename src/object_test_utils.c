@@ -8,8 +8,8 @@
 void
 test_boolean_object(monkey_object_t *object, _Bool expected_value)
 {
-    test(object->type == MONKEY_BOOL, "Expected object of type %s, got %s\n",
-        get_type_name(MONKEY_BOOL), get_type_name(object->type));
+    test(get_monkey_object_type(object) == MONKEY_BOOL, "Expected object of type %s, got %s\n",
+        get_type_name(MONKEY_BOOL), get_type_name(get_monkey_object_type(object)));
     monkey_bool_t *bool_obj = (monkey_bool_t *) object;
     test(bool_obj->value == expected_value, "Expected bool value %s, got %s\n",
         bool_to_string(expected_value), bool_to_string(bool_obj->value));
@@ -18,20 +18,20 @@ test_boolean_object(monkey_object_t *object, _Bool expected_value)
 void
 test_integer_object(monkey_object_t *object, long expected_value)
 {
-    test(object->type == MONKEY_INT, "Expected object of type %s, got %s\n",
-        get_type_name(MONKEY_INT), get_type_name(object->type));
+    test(get_monkey_object_type(object) == MONKEY_INT, "Expected object of type %s, got %s\n",
+        get_type_name(MONKEY_INT), get_type_name(get_monkey_object_type(object)));
     
-    monkey_int_t *int_obj = (monkey_int_t *) object;
-    test(int_obj->value == expected_value,
+    long value = get_monkey_int_value(object);
+    test(value == expected_value,
         "Expected integer object value to be %ld, found %ld\n",
-        expected_value, int_obj->value);
+        expected_value, value);
 }
 
 void
 test_null_object(monkey_object_t *object)
 {
-    test(object->type == MONKEY_NULL, "Expected a MONKEY_NULL object, found %s\n",
-        get_type_name(object->type));
+    test(get_monkey_object_type(object) == MONKEY_NULL, "Expected a MONKEY_NULL object, found %s\n",
+        get_type_name(get_monkey_object_type(object)));
 }
 
 void
@@ -41,25 +41,28 @@ test_string_object(monkey_object_t *obj, char *expected_value, size_t expected_l
     test(str_obj->length == expected_length,
         "Expected string length %zu, got %zu\n",
         expected_length, str_obj->length);
-    test(strncmp(str_obj->value, expected_value, expected_length) == 0,
-        "Expected string %s, got %s\n", expected_value, str_obj->value);
+    test(strncmp(get_monkey_string_value(str_obj), expected_value, expected_length) == 0,
+        "Expected string %s, got %.*s\n", expected_value, (int) str_obj->length,
+        get_monkey_string_value(str_obj));
 }
 
 
 void
 test_monkey_object(monkey_object_t *obj, monkey_object_t *expected)
 {
-    test(obj->type == expected->type, "Expected object of type %s, got %s\n",
-        get_type_name(expected->type), get_type_name(obj->type));
-    if (expected->type == MONKEY_INT)
-        test_integer_object(obj, ((monkey_int_t *) expected)->value);
+    test(get_monkey_object_type(obj) == get_monkey_object_type(expected),
+        "Expected object of type %s, got %s\n",
+        get_type_name(get_monkey_object_type(expected)),
+        get_type_name(get_monkey_object_type(obj)));
+    if (get_monkey_object_type(expected) == MONKEY_INT)
+        test_integer_object(obj, get_monkey_int_value(expected));
     else if (expected->type == MONKEY_BOOL)
         test_boolean_object(obj, ((monkey_bool_t *) expected)->value);
     else if (expected->type == MONKEY_NULL)
         test_null_object(expected);
     else if (expected->type == MONKEY_STRING) {
         monkey_string_t *expected_str_obj = (monkey_string_t *) expected;
-        test_string_object(obj, expected_str_obj->value, expected_str_obj->length);
+        test_string_object(obj, get_monkey_string_value(expected_str_obj), expected_str_obj->length);
     } else if (expected->type == MONKEY_ARRAY)
         test_array_object(obj, expected);
     else if (expected->type == MONKEY_HASH)
@@ -92,12 +95,12 @@ test_array_object(monkey_object_t *actual, monkey_object_t *expected)
 {
     monkey_array_t *actual_arr = (monkey_array_t *) actual;
     monkey_array_t *expected_arr = (monkey_array_t *) expected;
-    test(actual_arr->elements->length == expected_arr->elements->length,
+    test(get_monkey_array_length(actual_arr) == get_monkey_array_length(expected_arr),
         "Expected array size %zu, got %zu\n",
-        expected_arr->elements->length, actual_arr->elements->length);
-    for (size_t i = 0; i < actual_arr->elements->length; i++) {
-        monkey_object_t *actual_obj = (monkey_object_t *) cm_array_list_get(actual_arr->elements, i);
-        monkey_object_t *expected_obj = (monkey_object_t *) cm_array_list_get(expected_arr->elements, i);
+        get_monkey_array_length(expected_arr), get_monkey_array_length(actual_arr));
+    for (size_t i = 0; i < get_monkey_array_length(actual_arr); i++) {
+        monkey_object_t *actual_obj = get_monkey_array_element(actual_arr, i);
+        monkey_object_t *expected_obj = get_monkey_array_element(expected_arr, i);
         test_monkey_object(actual_obj, expected_obj);
     }
 }
@@ -119,7 +122,7 @@ test_hash_object(monkey_object_t *actual, monkey_object_t *expected)
             monkey_object_t *key = cm_array_list_get(expected_keys, i);
             monkey_object_t *expected_value = (monkey_object_t *) cm_hash_table_get(expected_hash->pairs, key);
             monkey_object_t *actual_value = (monkey_object_t *) cm_hash_table_get(actual_hash->pairs, key);
-            char *key_string = key->inspect(key);
+            char *key_string = inspect(key);
             test(actual_value != NULL, "No value found for key %s in hash\n", key_string);
             test_monkey_object(actual_value, expected_value);
             free(key_string);
@@ -27,6 +27,8 @@
  * SUCH DAMAGE.
  */
 
+#include <string.h>
+
 #include "object.h"
 #include "test_utils.h"
 
@@ -39,10 +41,10 @@ test_string_hash_key(void)
     monkey_string_t *hello2 = create_monkey_string("hello world", 11);
     monkey_string_t *diff1 = create_monkey_string("My name is johnny", 17);
     monkey_string_t *diff2 = create_monkey_string("My name is johnny", 17);
-    size_t hello1_hash = hello1->object.hash((monkey_object_t *) hello1);
-    size_t hello2_hash = hello2->object.hash((monkey_object_t *) hello2);
-    size_t diff1_hash = diff1->object.hash((monkey_object_t *) diff1);
-    size_t diff2_hash = diff2->object.hash((monkey_object_t *) diff2);
+    size_t hello1_hash = monkey_object_hash(hello1);
+    size_t hello2_hash = monkey_object_hash(hello2);
+    size_t diff1_hash = monkey_object_hash(diff1);
+    size_t diff2_hash = monkey_object_hash(diff2);
 
     test(hello1_hash == hello2_hash,
         "Hash of hello1 %zu, different from that of hello2 %zu\n",
@@ -55,14 +57,276 @@ test_string_hash_key(void)
     test(hello1_hash != diff1_hash,
         "Hash of hello1 %zu same as that of diff1 %zu\n",
         hello1_hash, diff1_hash);
-    free_monkey_object(hello1);
-    free_monkey_object(hello2);
-    free_monkey_object(diff1);
-    free_monkey_object(diff2);
+    release_monkey_object(hello1);
+    release_monkey_object(hello2);
+    release_monkey_object(diff1);
+    release_monkey_object(diff2);
+}
+
+static void
+test_string_interning(void)
+{
+    print_test_separator_line();
+    printf("Testing string interning and equality\n");
+    monkey_string_t *interned1 = intern_monkey_string("hello world", 11);
+    monkey_string_t *interned2 = intern_monkey_string("hello world!", 11);
+    monkey_string_t *other = intern_monkey_string("hello", 5);
+    monkey_string_t *hello = create_monkey_string("hello world", 11);
+    monkey_string_t *prefix = create_monkey_string("hello world", 5);
+    test(interned1 == interned2, "Expected equal strings to be interned only once\n");
+    test(is_interned_monkey_string(interned1) && !is_interned_monkey_string(hello), "Wrong interned flags\n");
+    test(interned1->object.refcount == MONKEY_REFCOUNT_IMMORTAL,
+        "Expected interned strings to be immortal\n");
+    test(monkey_object_equals(interned1, hello) && monkey_object_equals(hello, interned1),
+        "Expected an interned and a heap string with the same value to be equal\n");
+    test(!monkey_object_equals(interned1, other), "Expected different interned strings to differ\n");
+    test(monkey_object_equals(other, prefix), "Expected the lengths to be taken into account\n");
+    test(!monkey_object_equals(hello, prefix), "Expected strings of different lengths to differ\n");
+    test(monkey_object_hash(interned1) == monkey_object_hash(hello),
+        "Expected equal strings to have the same hash\n");
+    test(hello->hash == interned1->hash && hello->hash != 0, "Expected the hash to be cached\n");
+    release_monkey_object(hello);
+    release_monkey_object(prefix);
+}
+
+static void
+test_string_ropes(void)
+{
+    const size_t nappends = 100000;
+    print_test_separator_line();
+    printf("Testing concatenation of strings into ropes\n");
+    monkey_string_t *piece = create_monkey_string("0123456789", 10);
+    monkey_string_t *str = create_monkey_string("", 0);
+    for (size_t i = 0; i < nappends; i++) {
+        monkey_string_t *next = concat_monkey_strings(str, piece);
+        release_monkey_object(str);
+        str = next;
+    }
+    test(str->length == 10 * nappends, "Expected length %zu, got %zu\n",
+        10 * nappends, str->length);
+    test(str->value == NULL && str->left != NULL, "Expected a long concatenation to be a rope\n");
+    const char *value = get_monkey_string_value(str);
+    test(str->left == NULL && str->right == NULL && value == str->value,
+        "Expected the rope to be flattened in place\n");
+    for (size_t i = 0; i < str->length; i++)
+        test(value[i] == '0' + i % 10, "Wrong character at %zu: %c\n", i, value[i]);
+    test(value[str->length] == 0, "Expected the flattened string to be terminated\n");
+    monkey_string_t *small = concat_monkey_strings(piece, piece);
+    test(small->left == NULL && strcmp(small->value, "01234567890123456789") == 0,
+        "Expected a short concatenation to be copied\n");
+    monkey_string_t *rope = concat_monkey_strings(piece, str);
+    monkey_string_t *flat = create_monkey_string(value, str->length);
+    monkey_string_t *letters = create_monkey_string("abcdefghij", 10);
+    monkey_string_t *other = concat_monkey_strings(letters, flat);
+    test(!monkey_object_equals(other, rope), "Expected different ropes to differ\n");
+    release_monkey_object(other);
+    release_monkey_object(letters);
+    other = concat_monkey_strings(piece, flat);
+    test(monkey_object_equals(other, rope) && monkey_object_hash(other) == monkey_object_hash(rope),
+        "Expected equal ropes to be equal and to have the same hash\n");
+    release_monkey_object(other);
+    release_monkey_object(flat);
+    release_monkey_object(rope);
+    release_monkey_object(small);
+    release_monkey_object(piece);
+    /* a deep rope is freed without being flattened */
+    str = concat_monkey_strings(str, str);
+    for (size_t i = 0; i < nappends; i++) {
+        monkey_string_t *next = concat_monkey_strings(str, str->right);
+        release_monkey_object(str);
+        str = next;
+    }
+    release_monkey_object(str);
+}
+
+static monkey_hash_t *
+create_test_hash(monkey_object_t **keys, size_t nkeys, size_t first)
+{
+    cm_hash_table *pairs = cm_hash_table_init(monkey_object_hash,
+        monkey_object_equals, release_monkey_object, release_monkey_object);
+    for (size_t i = 0; i < nkeys; i++) {
+        size_t index = (first + i) % nkeys;
+        cm_hash_table_put(pairs, retain_monkey_object(keys[index]),
+            (monkey_object_t *) create_monkey_int(index + 1));
+    }
+    return create_monkey_hash(pairs);
+}
+
+static void
+test_hash_order(void)
+{
+    print_test_separator_line();
+    printf("Testing insertion order and equality of hashes\n");
+    monkey_object_t *keys[] = {
+        (monkey_object_t *) create_monkey_string("b", 1),
+        (monkey_object_t *) create_monkey_string("a", 1),
+        (monkey_object_t *) create_monkey_int(3),
+        (monkey_object_t *) create_monkey_bool(true)
+    };
+    size_t nkeys = sizeof(keys) / sizeof(keys[0]);
+    monkey_hash_t *hash1 = create_test_hash(keys, nkeys, 0);
+    monkey_hash_t *hash2 = create_test_hash(keys, nkeys, 2);
+    char *string = inspect((monkey_object_t *) hash1);
+    test(strcmp(string, "{b: 1, a: 2, 3: 3, true: 4}") == 0,
+        "Expected the hash to be printed in insertion order, got %s\n", string);
+    free(string);
+    string = inspect((monkey_object_t *) hash2);
+    test(strcmp(string, "{3: 3, true: 4, b: 1, a: 2}") == 0,
+        "Expected the hash to be printed in insertion order, got %s\n", string);
+    free(string);
+    test(monkey_object_equals(hash1, hash2),
+        "Expected hashes with the same pairs to be equal\n");
+    cm_hash_table_put(hash2->pairs, retain_monkey_object(keys[0]),
+        (monkey_object_t *) create_monkey_int(5));
+    test(!monkey_object_equals(hash1, hash2),
+        "Expected hashes with different values to be different\n");
+    release_monkey_object((monkey_object_t *) hash1);
+    release_monkey_object((monkey_object_t *) hash2);
+    for (size_t i = 0; i < nkeys; i++)
+        release_monkey_object(keys[i]);
+}
+
+static void
+test_array_elements(monkey_array_t *array, long first, size_t length)
+{
+    test(get_monkey_array_length(array) == length, "Expected %zu elements, got %zu\n",
+        length, get_monkey_array_length(array));
+    for (size_t i = 0; i < length; i++) {
+        long value = get_monkey_int_value(get_monkey_array_element(array, i));
+        test(value == first + (long) i, "Expected %ld at index %zu, got %ld\n",
+            first + (long) i, i, value);
+    }
+}
+
+static void
+test_array_push(void)
+{
+    size_t n = 100000;
+    print_test_separator_line();
+    printf("Testing that pushed arrays share their elements\n");
+    monkey_array_t *array = create_monkey_array(cm_array_list_init(1, release_monkey_object));
+    monkey_array_t *snapshot = NULL;
+    for (size_t i = 0; i < n; i++) {
+        monkey_array_t *next = push_monkey_array(array,
+            (monkey_object_t *) create_monkey_int((long) i));
+        if (i == 1056)
+            snapshot = (monkey_array_t *) retain_monkey_object((monkey_object_t *) array);
+        release_monkey_object((monkey_object_t *) array);
+        array = next;
+    }
+    test_array_elements(array, 0, n);
+    test_array_elements(snapshot, 0, 1056);
+
+    /* both pushes onto the snapshot append to the same tail slot */
+    monkey_array_t *branch1 = push_monkey_array(snapshot,
+        (monkey_object_t *) create_monkey_int(-1));
+    monkey_array_t *branch2 = push_monkey_array(snapshot,
+        (monkey_object_t *) create_monkey_int(-2));
+    test(get_monkey_int_value(get_monkey_array_element(branch1, 1056)) == -1,
+        "Expected the first branch to end with -1\n");
+    test(get_monkey_int_value(get_monkey_array_element(branch2, 1056)) == -2,
+        "Expected the second branch to end with -2\n");
+    test_array_elements(array, 0, n);
+
+    /* slices ending before the end of their vector are copied */
+    monkey_array_t *slice = create_monkey_array_slice(array, 10, 20);
+    monkey_array_t *pushed = push_monkey_array(slice,
+        (monkey_object_t *) create_monkey_int(20));
+    test_array_elements(pushed, 10, 11);
+    test_array_elements(array, 0, n);
+
+    monkey_array_t *arrays[] = {array, snapshot, branch1, branch2, slice, pushed};
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++)
+        release_monkey_object((monkey_object_t *) arrays[i]);
+}
+
+static monkey_array_t *
+create_test_array(size_t n, monkey_object_t *elements[n])
+{
+    cm_array_list *list = cm_array_list_init(n, release_monkey_object);
+    for (size_t i = 0; i < n; i++)
+        cm_array_list_add(list, elements[i]);
+    return create_monkey_array(list);
+}
+
+static void
+test_array_elements_kinds(void)
+{
+    print_test_separator_line();
+    printf("Testing array elements kinds\n");
+    /* boxed ints are unboxed when stored */
+    monkey_array_t *ints = create_test_array(3, (monkey_object_t *[]) {
+        (monkey_object_t *) create_monkey_int(1), (monkey_object_t *) create_monkey_int(2),
+        (monkey_object_t *) create_monkey_int(3)});
+    monkey_array_t *bools = create_test_array(2, (monkey_object_t *[]) {
+        (monkey_object_t *) create_monkey_bool(true),
+        (monkey_object_t *) create_monkey_bool(false)});
+    monkey_array_t *same_ints = create_test_array(3, (monkey_object_t *[]) {
+        create_monkey_int_object(1), create_monkey_int_object(2), create_monkey_int_object(3)});
+    monkey_object_t *str = (monkey_object_t *) create_monkey_string("4", 1);
+    monkey_array_t *mixed = push_monkey_array(ints, str);
+    test(ints->kind == MONKEY_ELEMENTS_INT, "Expected an array of ints\n");
+    test(bools->kind == MONKEY_ELEMENTS_BOOL, "Expected an array of booleans\n");
+    test(mixed->kind == MONKEY_ELEMENTS_GENERIC,
+        "Expected pushing a string to make the array generic\n");
+    test(ints->kind == MONKEY_ELEMENTS_INT, "Expected the pushed array to stay ints\n");
+    test(monkey_object_equals(ints, same_ints), "Expected equal arrays of ints\n");
+    test(!monkey_object_equals(ints, bools), "Expected arrays of different kinds to differ\n");
+
+    monkey_array_t *tail = create_monkey_array_slice(mixed, 1, 4);
+    monkey_array_t *other = create_test_array(3, (monkey_object_t *[]) {
+        create_monkey_int_object(2), create_monkey_int_object(3),
+        (monkey_object_t *) create_monkey_string("4", 1)});
+    test(monkey_object_equals(tail, other),
+        "Expected a generic slice to equal an array with the same elements\n");
+    char *string = inspect((monkey_object_t *) mixed);
+    test(strcmp(string, "[1, 2, 3, 4]") == 0, "Expected [1, 2, 3, 4], got %s\n", string);
+    free(string);
+
+    monkey_array_t *arrays[] = {ints, bools, same_ints, mixed, tail, other};
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++)
+        release_monkey_object((monkey_object_t *) arrays[i]);
+    release_monkey_object(str);
+}
+
+static void
+test_object_ops(void)
+{
+    print_test_separator_line();
+    printf("Testing the object header and operations\n");
+    test(sizeof(monkey_object_t) == 8, "Expected an 8 byte header, got %zu\n",
+        sizeof(monkey_object_t));
+    test(sizeof(monkey_int_t) == 16, "Expected a 16 byte int, got %zu\n", sizeof(monkey_int_t));
+
+    monkey_object_t *boxed = (monkey_object_t *) create_monkey_int(42);
+    monkey_object_t *builtin = (monkey_object_t *) create_monkey_builtin(NULL);
+    monkey_object_t *objects[] = {boxed, create_monkey_immediate_int(42),
+        (monkey_object_t *) create_monkey_bool(true), (monkey_object_t *) create_monkey_null(),
+        builtin};
+    const char *expected[] = {"42", "42", "true", "null", "builtin function"};
+    for (size_t i = 0; i < sizeof(objects) / sizeof(objects[0]); i++) {
+        char *string = inspect(objects[i]);
+        test(strcmp(string, expected[i]) == 0, "Expected %s, got %s\n", expected[i], string);
+        free(string);
+    }
+    test(monkey_object_equals(boxed, objects[1]) &&
+        monkey_object_hash(boxed) == monkey_object_hash(objects[1]),
+        "Expected boxed and immediate ints to be equal keys\n");
+    test(is_hashable_monkey_object(boxed) && is_hashable_monkey_object(objects[2]) &&
+        !is_hashable_monkey_object(objects[3]) && !is_hashable_monkey_object(builtin),
+        "Wrong hashable types\n");
+    release_monkey_object(boxed);
+    release_monkey_object(builtin);
 }
 
 int
 main(int argc, char **argv)
 {
     test_string_hash_key();
+    test_string_interning();
+    test_string_ropes();
+    test_hash_order();
+    test_array_push();
+    test_array_elements_kinds();
+    test_object_ops();
 }
\ No newline at end of file
@@ -10,7 +10,7 @@ instructions_t *
 vinstruction_init(opcode_t op, va_list ap)
 {
     instructions_t *ins;
-    size_t operand;
+    size_t operand, operand2;
     opcode_definition_t op_def;
     ins = malloc(sizeof(*ins));
     if (ins == NULL)
@@ -23,6 +23,8 @@ vinstruction_init(opcode_t op, va_list ap)
     case OPGETGLOBAL:
     case OPARRAY:
     case OPHASH:
+    case OPGREATERTHANJMPFALSE:
+    case OPEQUALJMPFALSE:
         // these opcodes need only one operand 2 bytes wide
         operand = va_arg(ap, size_t);
         uint8_t *boperand = size_t_to_uint8_be(operand, 2);
@@ -42,6 +44,27 @@ vinstruction_init(opcode_t op, va_list ap)
         ins->size = 2;
         free(boperand);
         return ins;
+    case OPGETLOCAL2:
+    case OPADDLOCALS:
+        // two operands, 1 byte each
+        operand = va_arg(ap, size_t);
+        operand2 = va_arg(ap, size_t);
+        ins->bytes = create_uint8_array(3, op, (uint8_t) operand, (uint8_t) operand2);
+        ins->length = 3;
+        ins->size = 3;
+        return ins;
+    case OPGETLOCALCONSTANT:
+    case OPADDLOCALCONSTANT:
+    case OPSUBLOCALCONSTANT:
+        // a 1 byte local index followed by a 2 byte constant index
+        operand = va_arg(ap, size_t);
+        operand2 = va_arg(ap, size_t);
+        boperand = size_t_to_uint8_be(operand2, 2);
+        ins->bytes = create_uint8_array(4, op, (uint8_t) operand, boperand[0], boperand[1]);
+        ins->length = 4;
+        ins->size = 4;
+        free(boperand);
+        return ins;
     case OPADD:
     case OPSUB:
     case OPMUL:
@@ -56,6 +79,7 @@ vinstruction_init(opcode_t op, va_list ap)
     case OPBANG:
     case OPNULL:
     case OPINDEX:
+    case OPSLICE:
     case OPRETURNVALUE:
     case OPRETURN:
         ins->bytes = create_uint8_array(1, op);
@@ -138,7 +162,7 @@ instructions_to_string(instructions_t *instructions)
     opcode_definition_t op_def;
     for (size_t i = 0; i < instructions->length; i++) {
         opcode_t op = (opcode_t) instructions->bytes[i];
-        size_t operand;
+        size_t operand, operand2;
         op_def = opcode_definition_lookup(op);
         switch (op) {
         case OPCONSTANT:
@@ -148,6 +172,8 @@ instructions_to_string(instructions_t *instructions)
         case OPGETGLOBAL:
         case OPARRAY:
         case OPHASH:
+        case OPGREATERTHANJMPFALSE:
+        case OPEQUALJMPFALSE:
             operand = be_to_size_t(instructions->bytes + i + 1, 2);
             if (string == NULL) {
                 int retval = asprintf(&string, "%04zu %s %zu", i, op_def.name, operand);
@@ -182,6 +208,28 @@ instructions_to_string(instructions_t *instructions)
             }
             i++;
             break;
+        case OPGETLOCAL2:
+        case OPADDLOCALS:
+        case OPGETLOCALCONSTANT:
+        case OPADDLOCALCONSTANT:
+        case OPSUBLOCALCONSTANT:
+            operand = instructions->bytes[i + 1];
+            operand2 = be_to_size_t(instructions->bytes + i + 2, op_def.operand_widths[1]);
+            if (string == NULL) {
+                int retval = asprintf(&string, "%04zu %s %zu %zu", i, op_def.name, operand, operand2);
+                if (retval == -1)
+                    err(EXIT_FAILURE, "malloc failed");
+            } else {
+                char *temp = NULL;
+                int retval = asprintf(&temp, "%s\n%04zu %s %zu %zu", string, i, op_def.name,
+                    operand, operand2);
+                if (retval == -1)
+                    err(EXIT_FAILURE, "malloc failed");
+                free(string);
+                string = temp;
+            }
+            i += 1 + op_def.operand_widths[1];
+            break;
         case OPADD:
         case OPSUB:
         case OPMUL:
@@ -195,6 +243,7 @@ instructions_to_string(instructions_t *instructions)
         case OPBANG:
         case OPNULL:
         case OPINDEX:
+        case OPSLICE:
         case OPRETURN:
         case OPRETURNVALUE:
             if (string == NULL) {
@@ -249,3 +298,80 @@ decode_instructions_to_sizet(uint8_t *bytes, size_t nbytes)
 {
     return be_to_size_t(bytes, nbytes);
 }
+
+static size_t
+get_operand_count(opcode_definition_t *op_def)
+{
+    size_t count = 0;
+    while (count < MAX_OPERANDS && op_def->operand_widths[count] != 0)
+        count++;
+    return count;
+}
+
+decoded_instructions_t *
+decode_instructions(instructions_t *ins)
+{
+    decoded_instructions_t *decoded;
+    opcode_definition_t op_def;
+    size_t *word_offsets;
+    size_t nwords = 0;
+    size_t i, j, noperands;
+    uint8_t op;
+
+    /* first pass maps each byte offset to the index of its decoded word */
+    word_offsets = calloc(ins->length + 1, sizeof(*word_offsets));
+    if (word_offsets == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    for (i = 0; i < ins->length;) {
+        op = ins->bytes[i];
+        word_offsets[i] = nwords++;
+        if (op == 0 || op > OPCODE_COUNT)
+            break;
+        op_def = opcode_definition_lookup(op);
+        noperands = get_operand_count(&op_def);
+        i++;
+        for (j = 0; j < noperands; j++)
+            i += op_def.operand_widths[j];
+        nwords += noperands;
+    }
+    word_offsets[ins->length] = nwords;
+
+    decoded = malloc(sizeof(*decoded));
+    if (decoded == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    decoded->words = malloc(sizeof(*decoded->words) * (nwords + 1));
+    if (decoded->words == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    decoded->length = nwords;
+
+    nwords = 0;
+    for (i = 0; i < ins->length;) {
+        op = ins->bytes[i++];
+        decoded->words[nwords++] = op;
+        if (op == 0 || op > OPCODE_COUNT)
+            break;
+        op_def = opcode_definition_lookup(op);
+        noperands = get_operand_count(&op_def);
+        for (j = 0; j < noperands; j++) {
+            size_t operand = decode_instructions_to_sizet(ins->bytes + i,
+                op_def.operand_widths[j]);
+            i += op_def.operand_widths[j];
+            if (op == OPJMP || op == OPJMPFALSE || op == OPGREATERTHANJMPFALSE ||
+                op == OPEQUALJMPFALSE)
+                operand = operand < ins->length? word_offsets[operand]: decoded->length;
+            decoded->words[nwords++] = operand;
+        }
+    }
+    decoded->words[nwords] = DECODED_HALT;
+    free(word_offsets);
+    return decoded;
+}
+
+void
+decoded_instructions_free(decoded_instructions_t *decoded)
+{
+    if (decoded == NULL)
+        return;
+    free(decoded->words);
+    free(decoded);
+}
@@ -40,7 +40,20 @@ typedef enum opcode_t {
     OPRETURN,
     OPSETLOCAL,
     OPGETLOCAL,
-    OPGETBUILTIN
+    OPGETBUILTIN,
+    OPSLICE,
+    /*
+     * Superinstructions: the compiler emits these in place of the pair of
+     * instructions they are named after, see the table in compiler.c.
+     * Their operands are the operands of the pair, in order.
+     */
+    OPGETLOCAL2,
+    OPGETLOCALCONSTANT,
+    OPADDLOCALS,
+    OPADDLOCALCONSTANT,
+    OPSUBLOCALCONSTANT,
+    OPGREATERTHANJMPFALSE,
+    OPEQUALJMPFALSE
 } opcode_t;
 
 typedef struct opcode_definition_t {
@@ -77,10 +90,33 @@ static opcode_definition_t opcode_definitions [] = {
     {"OPRETURN", "return", {(size_t) 0}},
     {"OPSETLOCAL", "set_local", {(size_t) 1}},
     {"OPGETLOCAL", "get_local", {(size_t) 1}},
-    {"OPGETBUILTIN", "get_builtin", {(size_t) 1}}
+    {"OPGETBUILTIN", "get_builtin", {(size_t) 1}},
+    {"OPSLICE", "slice", {(size_t) 0}},
+    {"OPGETLOCAL2", "get_local_get_local", {(size_t) 1, (size_t) 1}},
+    {"OPGETLOCALCONSTANT", "get_local_constant", {(size_t) 1, (size_t) 2}},
+    {"OPADDLOCALS", "add_locals", {(size_t) 1, (size_t) 1}},
+    {"OPADDLOCALCONSTANT", "add_local_constant", {(size_t) 1, (size_t) 2}},
+    {"OPSUBLOCALCONSTANT", "sub_local_constant", {(size_t) 1, (size_t) 2}},
+    {"OPGREATERTHANJMPFALSE", "greater_than_jump_if_false", {(size_t) 2}},
+    {"OPEQUALJMPFALSE", "equal_jump_if_false", {(size_t) 2}}
 };
 
 #define opcode_definition_lookup(op) opcode_definitions[op - 1];
+#define OPCODE_COUNT (sizeof(opcode_definitions) / sizeof(opcode_definitions[0]))
+
+/*
+ * The VM does not execute the serialized byte format, it executes a decoded
+ * copy made once per function: one word for each opcode followed by one word
+ * for each of its operands, in host byte order. Jump operands are converted
+ * from byte offsets into word indices and the stream is terminated by a
+ * DECODED_HALT word, so the interpreter loop needs no bounds checks.
+ */
+#define DECODED_HALT 0
+
+typedef struct decoded_instructions_t {
+    size_t *words;
+    size_t length;
+} decoded_instructions_t;
 
 instructions_t *instruction_init(opcode_t, ...);
 instructions_t *vinstruction_init(opcode_t, va_list);
@@ -90,4 +126,6 @@ instructions_t * flatten_instructions(size_t n, instructions_t *ins_array[n]);
 void concat_instructions(instructions_t *, instructions_t *);
 size_t decode_instructions_to_sizet(uint8_t *, size_t);
 instructions_t *copy_instructions(instructions_t *);
+decoded_instructions_t *decode_instructions(instructions_t *);
+void decoded_instructions_free(decoded_instructions_t *);
 #endif
\ No newline at end of file
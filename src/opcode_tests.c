@@ -87,10 +87,46 @@ test_instructions_string(void)
     instructions_free(ins_array[2]);
 }
 
+static void
+test_decode_instructions(void)
+{
+    instructions_t *ins_array[5] = {
+        instruction_init(OPTRUE),
+        instruction_init(OPJMPFALSE, 10),
+        instruction_init(OPCONSTANT, 65535),
+        instruction_init(OPJMP, 0),
+        instruction_init(OPGETLOCAL, 1)
+    };
+    size_t expected[] = {
+        OPTRUE,
+        OPJMPFALSE, 7,
+        OPCONSTANT, 65535,
+        OPJMP, 0,
+        OPGETLOCAL, 1,
+        DECODED_HALT
+    };
+    size_t nwords = sizeof(expected) / sizeof(expected[0]);
+
+    print_test_separator_line();
+    printf("Testing decode_instructions\n");
+    instructions_t *flat_ins = flatten_instructions(5, ins_array);
+    decoded_instructions_t *decoded = decode_instructions(flat_ins);
+    test(decoded->length == nwords - 1, "Expected %zu decoded words, found %zu\n",
+        nwords - 1, decoded->length);
+    for (size_t i = 0; i < nwords; i++)
+        test(decoded->words[i] == expected[i], "Expected word %zu at index %zu, found %zu\n",
+            expected[i], i, decoded->words[i]);
+    decoded_instructions_free(decoded);
+    instructions_free(flat_ins);
+    for (size_t i = 0; i < 5; i++)
+        instructions_free(ins_array[i]);
+}
+
 int
 main(int argc, char **argv)
 {
     test_instruction_init();
     test_instructions_string();
+    test_decode_instructions();
     return 0;
 }
\ No newline at end of file
@@ -191,6 +191,55 @@ precedence(token_type tok_type)
      return precedence(parser->cur_tok->type);
  }
 
+const char *operator_values[] = {
+    "+",
+    "-",
+    "!",
+    "*",
+    "/",
+    "%",
+    "<",
+    ">",
+    "==",
+    "!=",
+    "&&",
+    "||"
+};
+
+/* the operator of the token of a prefix or infix expression */
+static operator_t
+get_operator(token_type tok_type)
+{
+    switch (tok_type) {
+        case PLUS:
+            return OPERATOR_PLUS;
+        case MINUS:
+            return OPERATOR_MINUS;
+        case BANG:
+            return OPERATOR_BANG;
+        case ASTERISK:
+            return OPERATOR_MULTIPLY;
+        case SLASH:
+            return OPERATOR_DIVIDE;
+        case PERCENT:
+            return OPERATOR_MODULO;
+        case LT:
+            return OPERATOR_LESS_THAN;
+        case GT:
+            return OPERATOR_GREATER_THAN;
+        case EQ:
+            return OPERATOR_EQUAL;
+        case NOT_EQ:
+            return OPERATOR_NOT_EQUAL;
+        case AND:
+            return OPERATOR_AND;
+        case OR:
+            return OPERATOR_OR;
+        default:
+            errx(EXIT_FAILURE, "Token %s is not an operator", token_names[tok_type]);
+    }
+}
+
 static char *
 program_token_literal(void *prog_obj)
 {
@@ -414,11 +463,10 @@ hash_literal_string(void *exp)
     char *string = NULL;
     char *temp = NULL;
     int ret;
-    for (size_t i = 0; i < hash_exp->pairs->table_size; i++) {
-        void *obj = hash_exp->pairs->table[i];
-        if (obj == NULL)
-            continue;
-        cm_hash_entry *entry = (cm_hash_entry *) obj;
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_hash_table_iterator_init(&iterator, hash_exp->pairs);
+    while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL) {
         expression_t *keyexp = (expression_t *) entry->key;
         expression_t *valuexp = (expression_t *) entry->value;
         char *keystring = keyexp->node.string(keyexp);
@@ -532,6 +580,24 @@ index_exp_string(void *exp)
     return string;
 }
 
+static char *
+slice_exp_string(void *exp)
+{
+    slice_expression_t *slice_exp = (slice_expression_t *) exp;
+    char *string = NULL;
+    char *left_string = slice_exp->left->node.string(slice_exp->left);
+    char *start_string = slice_exp->start?
+        slice_exp->start->node.string(slice_exp->start): strdup("");
+    char *end_string = slice_exp->end? slice_exp->end->node.string(slice_exp->end): strdup("");
+    int ret = asprintf(&string, "(%s[%s:%s])", left_string, start_string, end_string);
+    free(left_string);
+    free(start_string);
+    free(end_string);
+    if (ret == -1)
+        errx(EXIT_FAILURE, "malloc failed");
+    return string;
+}
+
 char *
 join_parameters_list(cm_list *parameters_list)
 {
@@ -732,6 +798,7 @@ create_function_literal(parser_t *parser)
     func->parameters = cm_list_init();
     func->token = token_copy(parser->cur_tok);
     func->body = NULL;
+    func->nslots = 0;
     return func;
 }
 
@@ -946,6 +1013,19 @@ free_index_expression(index_expression_t *index_exp)
     free(index_exp);
 }
 
+static void
+free_slice_expression(slice_expression_t *slice_exp)
+{
+    token_free(slice_exp->token);
+    if (slice_exp->left)
+        free_expression(slice_exp->left);
+    if (slice_exp->start)
+        free_expression(slice_exp->start);
+    if (slice_exp->end)
+        free_expression(slice_exp->end);
+    free(slice_exp);
+}
+
 void
 free_expression(void *e)
 {
@@ -991,6 +1071,9 @@ free_expression(void *e)
         case WHILE_EXPRESSION:
             free_while_expression((while_expression_t *) exp);
             break;
+        case SLICE_EXPRESSION:
+            free_slice_expression((slice_expression_t *) exp);
+            break;
         default:
             break;
     }
@@ -1149,6 +1232,8 @@ create_identifier(parser_t *parser)
         free(ident);
         errx(EXIT_FAILURE, "malloc failed");
     }
+    ident->depth = 0;
+    ident->slot = 0;
     return ident;
 }
 
@@ -1320,6 +1405,13 @@ index_exp_token_literal(void *exp)
     return index_exp->token->literal;
 }
 
+static char *
+slice_exp_token_literal(void *exp)
+{
+    slice_expression_t *slice_exp = (slice_expression_t *) exp;
+    return slice_exp->token->literal;
+}
+
 expression_t *
 parse_integer_expression(parser_t *parser)
 {
@@ -1396,6 +1488,7 @@ parse_prefix_expression(parser_t *parser)
     prefix_exp->operator = strdup(parser->cur_tok->literal);
     if (prefix_exp->operator == NULL)
         errx(EXIT_FAILURE, "malloc failed");
+    prefix_exp->op = get_operator(parser->cur_tok->type);
     parser_next_token(parser);
     prefix_exp->right = parse_expression(parser, PREFIX);
 
@@ -1421,6 +1514,9 @@ parse_infix_expression(parser_t *parser, expression_t *left)
     infix_exp->expression.node.type = EXPRESSION;
     infix_exp->left = left;
     infix_exp->operator = strdup(parser->cur_tok->literal);
+    if (infix_exp->operator == NULL)
+        errx(EXIT_FAILURE, "malloc failed");
+    infix_exp->op = get_operator(parser->cur_tok->type);
     infix_exp->token = token_copy(parser->cur_tok);
     operator_precedence_t precedence = cur_precedence(parser);
     parser_next_token(parser);
@@ -1573,6 +1669,43 @@ parse_array_literal(parser_t *parser)
     return (expression_t *) array;
 }
 
+/*
+ * Parses the rest of left[start:end] after the colon, the start has been
+ * parsed already and is NULL when it was left out.
+ */
+static expression_t *
+parse_slice_expression(parser_t *parser, expression_t *left, token_t *token,
+    expression_t *start)
+{
+    #ifdef TRACE
+        trace("parse_slice_expression");
+    #endif
+    slice_expression_t *slice_exp;
+    slice_exp = malloc(sizeof(*slice_exp));
+    if (slice_exp == NULL)
+        errx(EXIT_FAILURE, "malloc failed");
+    slice_exp->expression.node.string = slice_exp_string;
+    slice_exp->expression.node.token_literal = slice_exp_token_literal;
+    slice_exp->expression.node.type = EXPRESSION;
+    slice_exp->expression.expression_type = SLICE_EXPRESSION;
+    slice_exp->token = token;
+    slice_exp->left = left;
+    slice_exp->start = start;
+    slice_exp->end = NULL;
+    if (parser->peek_tok->type != RBRACKET) {
+        parser_next_token(parser);
+        slice_exp->end = parse_expression(parser, LOWEST);
+    }
+    if (!expect_peek(parser, RBRACKET)) {
+        free_slice_expression(slice_exp);
+        slice_exp = NULL;
+    }
+    #ifdef TRACE
+        untrace("parse_slice_expression");
+    #endif
+    return (expression_t *) slice_exp;
+}
+
 static expression_t *
 parse_index_expression(parser_t *parser, expression_t *left)
 {
@@ -1580,6 +1713,11 @@ parse_index_expression(parser_t *parser, expression_t *left)
         trace("parse_index_expression");
     #endif
     index_expression_t *index_exp;
+    if (parser->peek_tok->type == COLON) {
+        token_t *token = token_copy(parser->cur_tok);
+        parser_next_token(parser);
+        return parse_slice_expression(parser, left, token, NULL);
+    }
     index_exp = malloc(sizeof(*index_exp));
     if (index_exp == NULL)
         errx(EXIT_FAILURE, "malloc failed");
@@ -1592,6 +1730,17 @@ parse_index_expression(parser_t *parser, expression_t *left)
     index_exp->token = token_copy(parser->cur_tok);
     parser_next_token(parser);
     index_exp->index = parse_expression(parser, LOWEST);
+    if (index_exp->index != NULL && parser->peek_tok->type == COLON) {
+        expression_t *slice_exp;
+        parser_next_token(parser);
+        slice_exp = parse_slice_expression(parser, left, index_exp->token,
+            index_exp->index);
+        free(index_exp);
+        #ifdef TRACE
+            untrace("parse_index_expression");
+        #endif
+        return slice_exp;
+    }
     if (!expect_peek(parser, RBRACKET)) {
         free_index_expression(index_exp);
         index_exp = NULL;
@@ -1832,6 +1981,8 @@ copy_identifier_expression(expression_t *exp)
     copy->value = strdup(ident_exp->value);
     if (copy->value == NULL)
         errx(EXIT_FAILURE, "malloc failed");
+    copy->depth = ident_exp->depth;
+    copy->slot = ident_exp->slot;
     return (expression_t *) copy;
 }
 
@@ -1866,6 +2017,7 @@ copy_prefix_expression(expression_t *exp)
     copy->operator = strdup(prefix_exp->operator);
     if (copy->operator == NULL)
         errx(EXIT_FAILURE, "malloc failed");
+    copy->op = prefix_exp->op;
     copy->right = copy_expression(prefix_exp->right);
     return (expression_t *) copy;
 }
@@ -1885,6 +2037,7 @@ copy_infix_expression(expression_t *exp)
     copy->operator = strdup(infix_exp->operator);
     if (copy->operator == NULL)
         errx(EXIT_FAILURE, "malloc failed");
+    copy->op = infix_exp->op;
     copy->left = copy_expression(infix_exp->left);
     copy->right = copy_expression(infix_exp->right);
     return (expression_t *) copy;
@@ -1954,6 +2107,7 @@ copy_function_literal(expression_t *exp)
     copy->body = (block_statement_t *) copy_statement((statement_t *) func->body);
     copy->token = token_copy(func->token);
     copy->parameters = copy_parameters(func->parameters);
+    copy->nslots = func->nslots;
     return (expression_t *) copy;
 }
 
@@ -1999,8 +2153,10 @@ copy_hash_literal(expression_t *exp)
 {
     hash_literal_t *hash_exp = (hash_literal_t *) exp;
     hash_literal_t *copy = create_hash_literal(hash_exp->token);
-    for (size_t i = 0; i < hash_exp->pairs->nkeys; i++) {
-        cm_hash_entry *entry = (cm_hash_entry *) hash_exp->pairs->table[i];
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_hash_table_iterator_init(&iterator, hash_exp->pairs);
+    while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL) {
         expression_t *key_exp = (expression_t *) entry->key;
         expression_t *value_exp = (expression_t *) entry->value;
         cm_hash_table_put(copy->pairs, copy_expression(key_exp), copy_expression(value_exp));
@@ -2044,6 +2200,24 @@ copy_index_expression(expression_t *exp)
     return (expression_t *) copy;
 }
 
+static expression_t *
+copy_slice_expression(expression_t *exp)
+{
+    slice_expression_t *slice_exp = (slice_expression_t *) exp;
+    slice_expression_t *copy = malloc(sizeof(*copy));
+    if (copy == NULL)
+        errx(EXIT_FAILURE, "malloc failed");
+    copy->expression.node.string = slice_exp_string;
+    copy->expression.node.token_literal = slice_exp_token_literal;
+    copy->expression.node.type = EXPRESSION;
+    copy->expression.expression_type = SLICE_EXPRESSION;
+    copy->token = token_copy(slice_exp->token);
+    copy->left = copy_expression(slice_exp->left);
+    copy->start = slice_exp->start? copy_expression(slice_exp->start): NULL;
+    copy->end = slice_exp->end? copy_expression(slice_exp->end): NULL;
+    return (expression_t *) copy;
+}
+
 expression_t *
 copy_expression(expression_t *exp)
 {
@@ -2072,6 +2246,8 @@ copy_expression(expression_t *exp)
             return copy_index_expression(exp);
         case HASH_LITERAL:
             return copy_hash_literal(exp);
+        case SLICE_EXPRESSION:
+            return copy_slice_expression(exp);
         default:
             return NULL;
     }
@@ -2084,13 +2260,7 @@ copy_letstatement(statement_t *stmt)
     letstatement_t *copy_stmt = malloc(sizeof(*let_stmt));
     if (copy_stmt == NULL)
         errx(EXIT_FAILURE, "malloc failed");
-    copy_stmt->name = malloc(sizeof(*copy_stmt->name));
-    if (copy_stmt->name == NULL)
-        errx(EXIT_FAILURE, "malloc failed");
-    copy_stmt->name->token = token_copy(let_stmt->token);
-    copy_stmt->name->value = strdup(let_stmt->name->value);
-    if (copy_stmt->name->value == NULL)
-        errx(EXIT_FAILURE, "malloc failed");
+    copy_stmt->name = (identifier_t *) copy_identifier_expression((expression_t *) let_stmt->name);
     copy_stmt->token = token_copy(let_stmt->token);
     copy_stmt->value = copy_expression(let_stmt->value);
     copy_stmt->statement.node.string = letstatement_string;
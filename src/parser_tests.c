@@ -157,6 +157,9 @@ test_infix_expression(expression_t *exp, const char *operator, const char *left,
         test(strcmp(infix_exp->operator, operator) == 0,
             "Expected infix expression operator to be %s, found %s\n",
             operator, infix_exp->operator);
+        test(strcmp(operator_values[infix_exp->op], operator) == 0,
+            "Expected the operator of the infix expression to be %s, found %s\n",
+            operator, operator_values[infix_exp->op]);
         printf("matched infix expression operator\n");
         printf("Testing left expression of the infix expression\n");
         test_literal_expression(infix_exp->left, left);
@@ -412,6 +415,7 @@ test_operator_precedence_parsing()
         {"add(a + b + c * d / f + g)", "add((((a + b) + ((c * d) / f)) + g))"},
         {"a * [1, 2, 3, 4][b * c] * d", "((a * ([1, 2, 3, 4][(b * c)])) * d)"},
         {"add(a * b[2], b[1], 2 * [1, 2][1])", "add((a * (b[2])), (b[1]), (2 * ([1, 2][1])))"},
+        {"a * b[1:c + 1][0]", "(a * ((b[1:(c + 1)])[0]))"},
         {"5 > 4 && 3 > 2", "((5 > 4) && (3 > 2))"},
         {"4 < 5 || 3 > 2", "((4 < 5) || (3 > 2))"}
     };
@@ -483,6 +487,9 @@ test_parse_prefix_expression()
         prefix_expression_t *prefix_exp = (prefix_expression_t *) exp_stmt->expression;
         test(strcmp(prefix_exp->operator, test.operator) == 0,
             "Expected operator to be %s, found %s\n", test.operator, prefix_exp->operator);
+        test(strcmp(operator_values[prefix_exp->op], test.operator) == 0,
+            "Expected the operator enum to be %s, found %s\n", test.operator,
+            operator_values[prefix_exp->op]);
         printf("Passed prefix operator test\n");
 
         test_literal_expression(prefix_exp->right, test.value);
@@ -994,6 +1001,49 @@ test_parse_index_expression(void)
     printf("Index expression parsing test passed\n");
 }
 
+static void
+test_parse_slice_expression(void)
+{
+    typedef struct testcase {
+        const char *input;
+        const char *start;
+        const char *end;
+    } testcase;
+    testcase tests[] = {
+        {"my_array[1:n]", "1", "n"},
+        {"my_array[:n]", NULL, "n"},
+        {"my_array[1:]", "1", NULL},
+        {"my_array[:]", NULL, NULL}
+    };
+    print_test_separator_line();
+    printf("Testing slice expression parsing\n");
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        testcase t = tests[i];
+        printf("Testing %s\n", t.input);
+        lexer_t *lexer = lexer_init(t.input);
+        parser_t *parser = parser_init(lexer);
+        program_t *program = parse_program(parser);
+        check_parser_errors(parser);
+        expression_statement_t *exp_stmt = (expression_statement_t *) program->statements[0];
+        test(exp_stmt->expression->expression_type == SLICE_EXPRESSION,
+            "Expected SLICE_EXPRESSION, got %s\n",
+            get_expression_type_name(exp_stmt->expression->expression_type));
+        slice_expression_t *slice_exp = (slice_expression_t *) exp_stmt->expression;
+        test_identifier(slice_exp->left, "my_array");
+        if (t.start == NULL) {
+            test(slice_exp->start == NULL, "Expected no start in %s\n", t.input);
+        } else
+            test_literal_expression(slice_exp->start, t.start);
+        if (t.end == NULL) {
+            test(slice_exp->end == NULL, "Expected no end in %s\n", t.input);
+        } else
+            test_literal_expression(slice_exp->end, t.end);
+        program_free(program);
+        parser_free(parser);
+    }
+    printf("Slice expression parsing test passed\n");
+}
+
 static void
 test_parse_hash_literals(void)
 {
@@ -1023,20 +1073,15 @@ test_parse_hash_literals(void)
     test(hash_exp->pairs->nkeys == 3,
         "Expected 3 entries in the hash pairs, got %zu\n",
         hash_exp->pairs->nkeys);
-    for (size_t i = 0; i < hash_exp->pairs->used_slots->length; i++) {
-        size_t *index = (size_t *) hash_exp->pairs->used_slots->array[i];
-        cm_list *entry_list = hash_exp->pairs->table[*index];
-        test(entry_list != NULL, "No entry found at index %zu in the pairs table\n", *index);
-        cm_list_node *node = entry_list->head;
-        while (node != NULL) {
-            cm_hash_entry *entry = (cm_hash_entry *) node->data;
-            expression_t *key = (expression_t *) entry->key;
-            int *expected_value = cm_hash_table_get(expected, ((string_t *)key)->value);
-            test(expected_value != NULL, "unknown key %s found in pairs\n", ((string_t *) key)->value);
-            integer_t *actual_value = (integer_t *) entry->value;
-            test_integer_literal_value((expression_t *) actual_value, *expected_value);
-            node = node->next;
-        }
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_hash_table_iterator_init(&iterator, hash_exp->pairs);
+    while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL) {
+        expression_t *key = (expression_t *) entry->key;
+        int *expected_value = cm_hash_table_get(expected, ((string_t *)key)->value);
+        test(expected_value != NULL, "unknown key %s found in pairs\n", ((string_t *) key)->value);
+        integer_t *actual_value = (integer_t *) entry->value;
+        test_integer_literal_value((expression_t *) actual_value, *expected_value);
     }
     program_free(program);
     parser_free(parser);
@@ -1080,9 +1125,10 @@ test_parsing_hash_literal_bool_keys(void)
         "Expected HASH_LITERAL expression, found %s\n",
         get_expression_type_name(exp_stmt->expression->expression_type));
     hash_literal_t *hash_exp = (hash_literal_t *) exp_stmt->expression;
-    for(size_t i = 0; i < hash_exp->pairs->nkeys; i++) {
-        size_t *index = (size_t *) hash_exp->pairs->used_slots->array[i];
-        cm_hash_entry *entry = (cm_hash_entry *) hash_exp->pairs->table[*index]->head->data;
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_hash_table_iterator_init(&iterator, hash_exp->pairs);
+    while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL) {
         expression_t *key_exp = (expression_t *) entry->key;
         test(key_exp->expression_type == BOOLEAN_EXPRESSION,
             "Expected BOOLEAN_EXPRESSION as key, found %s\n",
@@ -1120,7 +1166,7 @@ test_parsing_hash_literal_with_expression_values(void)
     print_test_separator_line();
     printf("Testing parsing of hash literal with expressions in values\n");
     cm_hash_table *expected = cm_hash_table_init(string_hash_function,
-        string_equals, NULL, free_expression);
+        string_equals, NULL, NULL);
     cm_hash_table_put(expected, "one", &((expected_value ) {"+", "0", "1"}));
     cm_hash_table_put(expected, "two", &((expected_value) {"-", "10", "8"}));
     cm_hash_table_put(expected, "three", &((expected_value) {"/", "15", "5"}));
@@ -1136,9 +1182,10 @@ test_parsing_hash_literal_with_expression_values(void)
     test(hash_exp->pairs->nkeys == 3,
         "Expected 3 entries in hash literal, found %zu\n",
         hash_exp->pairs->nkeys);
-    for (size_t i = 0; i < hash_exp->pairs->used_slots->length; i++) {
-        size_t *index = (size_t *) hash_exp->pairs->used_slots->array[i];
-        cm_hash_entry *entry = (cm_hash_entry *) hash_exp->pairs->table[*index]->head->data;
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_hash_table_iterator_init(&iterator, hash_exp->pairs);
+    while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL) {
         expression_t *key = (expression_t *) entry->key;
         test(key->expression_type == STRING_EXPRESSION,
             "Expected STRING_EXPRESSION as key, found %s\n",
@@ -1176,10 +1223,10 @@ test_parsing_hash_literal_with_integer_keys(void)
     hash_literal_t *hash_exp = (hash_literal_t *) exp_stmt->expression;
     test(hash_exp->pairs->nkeys == 3,
         "Expected 3 entries in pairs, found %zu\n", hash_exp->pairs->nkeys);
-    for (size_t i = 0; i < hash_exp->pairs->used_slots->length; i++) {
-        size_t *index = (size_t *) hash_exp->pairs->used_slots->array[i];
-        cm_hash_entry *entry = (cm_hash_entry *) hash_exp->pairs->table[*index]->head->data;
-        test(entry != NULL, "No entry found at slot %zu\n", *index);
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_hash_table_iterator_init(&iterator, hash_exp->pairs);
+    while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL) {
         expression_t *key_exp = (expression_t *) entry->key;
         char *string_key = key_exp->node.string(key_exp);
         long *expected_value = cm_hash_table_get(expected, string_key);
@@ -1250,6 +1297,7 @@ main(int argc, char **argv)
     test_string_literal();
     test_parse_array_literal();
     test_parse_index_expression();
+    test_parse_slice_expression();
     test_parse_hash_literals();
     test_parsing_empty_hash_literal();
     test_parsing_hash_literal_with_expression_values();
@@ -0,0 +1,649 @@
+#include <err.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtins.h"
+#include "cmonkey_utils.h"
+#include "object.h"
+#include "reg_compiler.h"
+
+#define CODE_INIT_SIZE 64
+#define CONSTANTS_POOL_INIT_SIZE 16
+#define UNPATCHED_JUMP 9999
+
+static char *
+get_err_msg(const char *s, ...)
+{
+    char *msg = NULL;
+    va_list ap;
+    va_start(ap, s);
+    int retval = vasprintf(&msg, s, ap);
+    va_end(ap);
+    if (retval == -1)
+        err(EXIT_FAILURE, "malloc failed");
+    return msg;
+}
+
+static reg_scope_t *
+reg_scope_init(reg_scope_t *outer)
+{
+    reg_scope_t *scope;
+    scope = malloc(sizeof(*scope));
+    if (scope == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    scope->code = malloc(sizeof(*scope->code));
+    if (scope->code == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    scope->code_size = CODE_INIT_SIZE;
+    scope->code->words = malloc(sizeof(*scope->code->words) * scope->code_size);
+    if (scope->code->words == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    scope->code->length = 0;
+    scope->local_registers = NULL;
+    scope->nlocal_registers = 0;
+    scope->next_register = 0;
+    scope->locals_top = 0;
+    scope->max_registers = 0;
+    scope->outer = outer;
+    return scope;
+}
+
+static void
+reg_scope_free(reg_scope_t *scope, _Bool free_code)
+{
+    if (free_code)
+        decoded_instructions_free(scope->code);
+    free(scope->local_registers);
+    free(scope);
+}
+
+reg_compiler_t *
+reg_compiler_init(void)
+{
+    reg_compiler_t *compiler;
+    compiler = malloc(sizeof(*compiler));
+    if (compiler == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    compiler->constants_pool = cm_array_list_init(CONSTANTS_POOL_INIT_SIZE, release_monkey_object);
+    compiler->symbol_table = symbol_table_init();
+    for (size_t i = 0; i < get_builtins_count(); i++) {
+        char *builtin_name = (char *) get_builtins_name(i);
+        if (builtin_name == NULL)
+            break;
+        symbol_define_builtin(compiler->symbol_table, i, builtin_name);
+    }
+    compiler->scope = reg_scope_init(NULL);
+    // the top level code keeps the value of its last expression statement here
+    compiler->scope->next_register = REG_RESULT_REGISTER + 1;
+    compiler->scope->locals_top = REG_RESULT_REGISTER + 1;
+    compiler->scope->max_registers = REG_RESULT_REGISTER + 1;
+    return compiler;
+}
+
+void
+reg_compiler_free(reg_compiler_t *compiler)
+{
+    while (compiler->scope != NULL) {
+        reg_scope_t *outer = compiler->scope->outer;
+        reg_scope_free(compiler->scope, true);
+        compiler->scope = outer;
+    }
+    while (compiler->symbol_table != NULL) {
+        symbol_table_t *outer = compiler->symbol_table->outer;
+        free_symbol_table(compiler->symbol_table);
+        compiler->symbol_table = outer;
+    }
+    cm_array_list_free(compiler->constants_pool);
+    free(compiler);
+}
+
+reg_bytecode_t *
+reg_get_bytecode(reg_compiler_t *compiler)
+{
+    reg_bytecode_t *bytecode;
+    bytecode = malloc(sizeof(*bytecode));
+    if (bytecode == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    bytecode->code = compiler->scope->code;
+    bytecode->num_registers = compiler->scope->max_registers;
+    bytecode->constants_pool = compiler->constants_pool;
+    return bytecode;
+}
+
+void
+reg_bytecode_free(reg_bytecode_t *bytecode)
+{
+    free(bytecode);
+}
+
+static size_t
+add_constant(reg_compiler_t *compiler, monkey_object_t *obj)
+{
+    cm_array_list_add(compiler->constants_pool, obj);
+    return compiler->constants_pool->length - 1;
+}
+
+/*
+ * Appends one instruction, the operands follow the opcode as size_t
+ * arguments. Returns the position of the instruction.
+ */
+static size_t
+reg_emit(reg_compiler_t *compiler, reg_opcode_t op, ...)
+{
+    reg_scope_t *scope = compiler->scope;
+    decoded_instructions_t *code = scope->code;
+    size_t noperands = reg_opcode_definitions[op].noperands;
+    size_t position = code->length;
+    va_list ap;
+    if (code->length + noperands + 1 >= scope->code_size) {
+        scope->code_size = scope->code_size * 2 + noperands + 1;
+        code->words = reallocarray(code->words, scope->code_size, sizeof(*code->words));
+        if (code->words == NULL)
+            err(EXIT_FAILURE, "malloc failed");
+    }
+    code->words[code->length++] = op;
+    va_start(ap, op);
+    for (size_t i = 0; i < noperands; i++)
+        code->words[code->length++] = va_arg(ap, size_t);
+    va_end(ap);
+    return position;
+}
+
+static void
+patch_jump(reg_compiler_t *compiler, size_t position)
+{
+    decoded_instructions_t *code = compiler->scope->code;
+    size_t noperands = reg_opcode_definitions[code->words[position]].noperands;
+    code->words[position + noperands] = code->length;
+}
+
+static size_t
+alloc_register(reg_compiler_t *compiler)
+{
+    reg_scope_t *scope = compiler->scope;
+    size_t reg = scope->next_register++;
+    if (scope->next_register > scope->max_registers)
+        scope->max_registers = scope->next_register;
+    return reg;
+}
+
+/* Frees the temporaries allocated since mark, locals are never freed. */
+static void
+free_registers(reg_compiler_t *compiler, size_t mark)
+{
+    reg_scope_t *scope = compiler->scope;
+    scope->next_register = mark > scope->locals_top? mark: scope->locals_top;
+}
+
+static void
+bind_local_register(reg_compiler_t *compiler, symbol_t *sym, size_t reg)
+{
+    reg_scope_t *scope = compiler->scope;
+    if (sym->index >= scope->nlocal_registers) {
+        scope->nlocal_registers = sym->index * 2 + 8;
+        scope->local_registers = reallocarray(scope->local_registers,
+            scope->nlocal_registers, sizeof(*scope->local_registers));
+        if (scope->local_registers == NULL)
+            err(EXIT_FAILURE, "malloc failed");
+    }
+    scope->local_registers[sym->index] = reg;
+    if (reg + 1 > scope->locals_top)
+        scope->locals_top = reg + 1;
+    if (scope->next_register < scope->locals_top)
+        scope->next_register = scope->locals_top;
+}
+
+static compiler_error_t
+resolve(reg_compiler_t *compiler, char *name, symbol_t **sym)
+{
+    compiler_error_t error = {COMPILER_ERROR_NONE, NULL};
+    *sym = symbol_resolve(compiler->symbol_table, name);
+    /* functions do not capture the locals of their enclosing function */
+    if (*sym == NULL || ((*sym)->scope == LOCAL &&
+        cm_hash_table_get(compiler->symbol_table->store, name) != *sym)) {
+        error.code = COMPILER_UNDEFINED_VARIABLE;
+        error.msg = get_err_msg("undefined variable: %s\n", name);
+    }
+    return error;
+}
+
+static compiler_error_t compile_expression(reg_compiler_t *, expression_t *, size_t);
+static compiler_error_t compile_statement(reg_compiler_t *, statement_t *);
+
+/*
+ * Finds a register holding the value of the expression. Locals already
+ * live in a register and need no code, anything else is evaluated into a
+ * new temporary.
+ */
+static compiler_error_t
+compile_operand(reg_compiler_t *compiler, expression_t *expression, size_t *reg)
+{
+    compiler_error_t error;
+    symbol_t *sym;
+    if (expression->expression_type == IDENTIFIER_EXPRESSION) {
+        error = resolve(compiler, ((identifier_t *) expression)->value, &sym);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+        if (sym->scope == LOCAL) {
+            *reg = compiler->scope->local_registers[sym->index];
+            return error;
+        }
+    }
+    *reg = alloc_register(compiler);
+    return compile_expression(compiler, expression, *reg);
+}
+
+/* Compiles a block of an if expression, leaving its value in dst. */
+static compiler_error_t
+compile_block_value(reg_compiler_t *compiler, block_statement_t *block, size_t dst)
+{
+    compiler_error_t error = {COMPILER_ERROR_NONE, NULL};
+    size_t last = block->nstatements;
+    statement_t *stmt;
+    if (last > 0 && block->statements[last - 1]->statement_type == EXPRESSION_STATEMENT)
+        last--;
+    for (size_t i = 0; i < last; i++) {
+        error = compile_statement(compiler, block->statements[i]);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+    }
+    if (last == block->nstatements) {
+        reg_emit(compiler, REGOP_LOADNULL, dst);
+        return error;
+    }
+    stmt = block->statements[last];
+    return compile_expression(compiler, ((expression_statement_t *) stmt)->expression, dst);
+}
+
+static compiler_error_t
+compile_infix_expression(reg_compiler_t *compiler, infix_expression_t *infix_exp, size_t dst)
+{
+    compiler_error_t error;
+    size_t mark = compiler->scope->next_register;
+    size_t left, right;
+    reg_opcode_t op;
+    expression_t *left_exp = infix_exp->left;
+    expression_t *right_exp = infix_exp->right;
+    switch (infix_exp->op) {
+    case OPERATOR_PLUS:
+        op = REGOP_ADD;
+        break;
+    case OPERATOR_MINUS:
+        op = REGOP_SUB;
+        break;
+    case OPERATOR_MULTIPLY:
+        op = REGOP_MUL;
+        break;
+    case OPERATOR_DIVIDE:
+        op = REGOP_DIV;
+        break;
+    case OPERATOR_GREATER_THAN:
+        op = REGOP_GREATERTHAN;
+        break;
+    case OPERATOR_LESS_THAN:
+        op = REGOP_GREATERTHAN;
+        left_exp = infix_exp->right;
+        right_exp = infix_exp->left;
+        break;
+    case OPERATOR_EQUAL:
+        op = REGOP_EQUAL;
+        break;
+    case OPERATOR_NOT_EQUAL:
+        op = REGOP_NOTEQUAL;
+        break;
+    default:
+        error.code = COMPILER_UNKNOWN_OPERATOR;
+        error.msg = get_err_msg("Unknown operator %s", infix_exp->operator);
+        return error;
+    }
+    error = compile_operand(compiler, left_exp, &left);
+    if (error.code != COMPILER_ERROR_NONE)
+        return error;
+    error = compile_operand(compiler, right_exp, &right);
+    if (error.code != COMPILER_ERROR_NONE)
+        return error;
+    reg_emit(compiler, op, dst, left, right);
+    free_registers(compiler, mark);
+    return error;
+}
+
+static compiler_error_t
+compile_if_expression(reg_compiler_t *compiler, if_expression_t *if_exp, size_t dst)
+{
+    compiler_error_t error;
+    size_t mark = compiler->scope->next_register;
+    size_t condition, jmpfalse_pos, jmp_pos;
+    error = compile_operand(compiler, if_exp->condition, &condition);
+    if (error.code != COMPILER_ERROR_NONE)
+        return error;
+    jmpfalse_pos = reg_emit(compiler, REGOP_JMPFALSE, condition, (size_t) UNPATCHED_JUMP);
+    free_registers(compiler, mark);
+    error = compile_block_value(compiler, if_exp->consequence, dst);
+    if (error.code != COMPILER_ERROR_NONE)
+        return error;
+    jmp_pos = reg_emit(compiler, REGOP_JMP, (size_t) UNPATCHED_JUMP);
+    patch_jump(compiler, jmpfalse_pos);
+    if (if_exp->alternative == NULL)
+        reg_emit(compiler, REGOP_LOADNULL, dst);
+    else {
+        error = compile_block_value(compiler, if_exp->alternative, dst);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+    }
+    patch_jump(compiler, jmp_pos);
+    return error;
+}
+
+static compiler_error_t
+compile_function_literal(reg_compiler_t *compiler, function_literal_t *func_exp, size_t dst)
+{
+    compiler_error_t error = {COMPILER_ERROR_NONE, NULL};
+    block_statement_t *body = func_exp->body;
+    size_t nstatements = body->nstatements;
+    size_t reg;
+    compiler->scope = reg_scope_init(compiler->scope);
+    compiler->symbol_table = enclosed_symbol_table_init(compiler->symbol_table);
+    cm_list_node *param_list_node = func_exp->parameters->head;
+    while (param_list_node != NULL) {
+        identifier_t *param = (identifier_t *) param_list_node->data;
+        symbol_t *sym = symbol_define(compiler->symbol_table, param->value);
+        bind_local_register(compiler, sym, alloc_register(compiler));
+        param_list_node = param_list_node->next;
+    }
+    if (nstatements > 0 && body->statements[nstatements - 1]->statement_type == EXPRESSION_STATEMENT)
+        nstatements--;
+    for (size_t i = 0; i < nstatements; i++) {
+        error = compile_statement(compiler, body->statements[i]);
+        if (error.code != COMPILER_ERROR_NONE)
+            break;
+    }
+    if (error.code == COMPILER_ERROR_NONE) {
+        if (nstatements < body->nstatements) {
+            // the value of a trailing expression statement is returned
+            expression_statement_t *stmt = (expression_statement_t *) body->statements[nstatements];
+            error = compile_operand(compiler, stmt->expression, &reg);
+            if (error.code == COMPILER_ERROR_NONE)
+                reg_emit(compiler, REGOP_RETURN, reg);
+        } else
+            reg_emit(compiler, REGOP_RETURNNULL);
+    }
+
+    reg_scope_t *scope = compiler->scope;
+    symbol_table_t *table = compiler->symbol_table;
+    compiler->scope = scope->outer;
+    compiler->symbol_table = table->outer;
+    free_symbol_table(table);
+    if (error.code != COMPILER_ERROR_NONE) {
+        reg_scope_free(scope, true);
+        return error;
+    }
+    /* the register code is kept where the stack VM keeps its decoded stream */
+    monkey_compiled_fn_t *fn = create_monkey_compiled_fn(NULL, scope->max_registers,
+        func_exp->parameters->length);
+    fn->decoded = scope->code;
+    reg_scope_free(scope, false);
+    reg_emit(compiler, REGOP_LOADK, dst, add_constant(compiler, (monkey_object_t *) fn));
+    return error;
+}
+
+static compiler_error_t
+compile_call_expression(reg_compiler_t *compiler, call_expression_t *call_exp, size_t dst)
+{
+    compiler_error_t error;
+    size_t mark = compiler->scope->next_register;
+    size_t nargs = call_exp->arguments->length;
+    // the arguments have to be in consecutive registers right after the callee
+    size_t callee = alloc_register(compiler);
+    for (size_t i = 0; i < nargs; i++)
+        alloc_register(compiler);
+    error = compile_expression(compiler, call_exp->function, callee);
+    if (error.code != COMPILER_ERROR_NONE)
+        return error;
+    for (size_t i = 0; i < nargs; i++) {
+        expression_t *arg = (expression_t *) cm_list_get_at(call_exp->arguments, i);
+        error = compile_expression(compiler, arg, callee + 1 + i);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+    }
+    reg_emit(compiler, REGOP_CALL, dst, callee, nargs);
+    free_registers(compiler, mark);
+    return error;
+}
+
+static compiler_error_t
+compile_array_literal(reg_compiler_t *compiler, array_literal_t *array_exp, size_t dst)
+{
+    compiler_error_t error = {COMPILER_ERROR_NONE, NULL};
+    size_t mark = compiler->scope->next_register;
+    size_t nelements = array_exp->elements->length;
+    size_t first = compiler->scope->next_register;
+    for (size_t i = 0; i < nelements; i++)
+        alloc_register(compiler);
+    for (size_t i = 0; i < nelements; i++) {
+        error = compile_expression(compiler, cm_array_list_get(array_exp->elements, i), first + i);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+    }
+    reg_emit(compiler, REGOP_ARRAY, dst, first, nelements);
+    free_registers(compiler, mark);
+    return error;
+}
+
+static compiler_error_t
+compile_hash_literal(reg_compiler_t *compiler, hash_literal_t *hash_exp, size_t dst)
+{
+    compiler_error_t error = {COMPILER_ERROR_NONE, NULL};
+    size_t mark = compiler->scope->next_register;
+    size_t first = compiler->scope->next_register;
+    cm_array_list *keys = cm_hash_table_get_keys(hash_exp->pairs);
+    if (keys == NULL) {
+        reg_emit(compiler, REGOP_HASH, dst, first, (size_t) 0);
+        return error;
+    }
+    for (size_t i = 0; i < 2 * keys->length; i++)
+        alloc_register(compiler);
+    for (size_t i = 0; i < keys->length; i++) {
+        expression_t *key = (expression_t *) cm_array_list_get(keys, i);
+        expression_t *value = (expression_t *) cm_hash_table_get(hash_exp->pairs, key);
+        error = compile_expression(compiler, key, first + 2 * i);
+        if (error.code != COMPILER_ERROR_NONE)
+            break;
+        error = compile_expression(compiler, value, first + 2 * i + 1);
+        if (error.code != COMPILER_ERROR_NONE)
+            break;
+    }
+    if (error.code == COMPILER_ERROR_NONE)
+        reg_emit(compiler, REGOP_HASH, dst, first, 2 * keys->length);
+    cm_array_list_free(keys);
+    free_registers(compiler, mark);
+    return error;
+}
+
+/* Compiles an expression leaving its value in register dst. */
+static compiler_error_t
+compile_expression(reg_compiler_t *compiler, expression_t *expression, size_t dst)
+{
+    compiler_error_t error = {COMPILER_ERROR_NONE, NULL};
+    size_t mark = compiler->scope->next_register;
+    size_t left, right;
+    prefix_expression_t *prefix_exp;
+    index_expression_t *index_exp;
+    slice_expression_t *slice_exp;
+    size_t bounds[2];
+    string_t *str_exp;
+    symbol_t *sym;
+    switch (expression->expression_type) {
+    case INFIX_EXPRESSION:
+        return compile_infix_expression(compiler, (infix_expression_t *) expression, dst);
+    case PREFIX_EXPRESSION:
+        prefix_exp = (prefix_expression_t *) expression;
+        if (prefix_exp->op != OPERATOR_MINUS && prefix_exp->op != OPERATOR_BANG) {
+            error.code = COMPILER_UNKNOWN_OPERATOR;
+            error.msg = get_err_msg("Unknown operator %s", prefix_exp->operator);
+            return error;
+        }
+        error = compile_operand(compiler, prefix_exp->right, &right);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+        reg_emit(compiler, prefix_exp->op == OPERATOR_MINUS? REGOP_MINUS: REGOP_BANG, dst, right);
+        break;
+    case INTEGER_EXPRESSION:
+        reg_emit(compiler, REGOP_LOADK, dst, add_constant(compiler,
+            create_monkey_int_object(((integer_t *) expression)->value)));
+        break;
+    case BOOLEAN_EXPRESSION:
+        reg_emit(compiler, ((boolean_expression_t *) expression)->value?
+            REGOP_LOADTRUE: REGOP_LOADFALSE, dst);
+        break;
+    case STRING_EXPRESSION:
+        str_exp = (string_t *) expression;
+        reg_emit(compiler, REGOP_LOADK, dst, add_constant(compiler, (monkey_object_t *)
+            intern_monkey_string(str_exp->value, strlen(str_exp->value))));
+        break;
+    case IF_EXPRESSION:
+        return compile_if_expression(compiler, (if_expression_t *) expression, dst);
+    case IDENTIFIER_EXPRESSION:
+        error = resolve(compiler, ((identifier_t *) expression)->value, &sym);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+        if (sym->scope == GLOBAL)
+            reg_emit(compiler, REGOP_GETGLOBAL, dst, (size_t) sym->index);
+        else if (sym->scope == BUILTIN)
+            reg_emit(compiler, REGOP_GETBUILTIN, dst, (size_t) sym->index);
+        else if (compiler->scope->local_registers[sym->index] != dst)
+            reg_emit(compiler, REGOP_MOVE, dst, compiler->scope->local_registers[sym->index]);
+        break;
+    case ARRAY_LITERAL:
+        return compile_array_literal(compiler, (array_literal_t *) expression, dst);
+    case HASH_LITERAL:
+        return compile_hash_literal(compiler, (hash_literal_t *) expression, dst);
+    case INDEX_EXPRESSION:
+        index_exp = (index_expression_t *) expression;
+        error = compile_operand(compiler, index_exp->left, &left);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+        error = compile_operand(compiler, index_exp->index, &right);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+        reg_emit(compiler, REGOP_INDEX, dst, left, right);
+        break;
+    case SLICE_EXPRESSION:
+        /* a missing bound is loaded as null */
+        slice_exp = (slice_expression_t *) expression;
+        error = compile_operand(compiler, slice_exp->left, &left);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+        expression_t *bound_exps[] = {slice_exp->start, slice_exp->end};
+        for (size_t i = 0; i < 2; i++) {
+            if (bound_exps[i] == NULL) {
+                bounds[i] = alloc_register(compiler);
+                reg_emit(compiler, REGOP_LOADNULL, bounds[i]);
+                continue;
+            }
+            error = compile_operand(compiler, bound_exps[i], &bounds[i]);
+            if (error.code != COMPILER_ERROR_NONE)
+                return error;
+        }
+        reg_emit(compiler, REGOP_SLICE, dst, left, bounds[0], bounds[1]);
+        break;
+    case FUNCTION_LITERAL:
+        return compile_function_literal(compiler, (function_literal_t *) expression, dst);
+    case CALL_EXPRESSION:
+        return compile_call_expression(compiler, (call_expression_t *) expression, dst);
+    default:
+        break;
+    }
+    free_registers(compiler, mark);
+    return error;
+}
+
+static compiler_error_t
+compile_statement(reg_compiler_t *compiler, statement_t *statement)
+{
+    compiler_error_t error = {COMPILER_ERROR_NONE, NULL};
+    size_t mark = compiler->scope->next_register;
+    size_t reg;
+    expression_statement_t *expression_stmt;
+    block_statement_t *block_stmt;
+    letstatement_t *let_stmt;
+    symbol_t *sym;
+    switch (statement->statement_type) {
+    case EXPRESSION_STATEMENT:
+        expression_stmt = (expression_statement_t *) statement;
+        if (compiler->scope->outer == NULL)
+            return compile_expression(compiler, expression_stmt->expression, REG_RESULT_REGISTER);
+        error = compile_operand(compiler, expression_stmt->expression, &reg);
+        break;
+    case BLOCK_STATEMENT:
+        block_stmt = (block_statement_t *) statement;
+        for (size_t i = 0; i < block_stmt->nstatements; i++) {
+            error = compile_statement(compiler, block_stmt->statements[i]);
+            if (error.code != COMPILER_ERROR_NONE)
+                return error;
+        }
+        break;
+    case LET_STATEMENT:
+        let_stmt = (letstatement_t *) statement;
+        if (compiler->scope->outer == NULL) {
+            error = compile_operand(compiler, let_stmt->value, &reg);
+            if (error.code != COMPILER_ERROR_NONE)
+                return error;
+            sym = symbol_define(compiler->symbol_table, let_stmt->name->value);
+            reg_emit(compiler, REGOP_SETGLOBAL, (size_t) sym->index, reg);
+            break;
+        }
+        // a local is evaluated directly into the register it will live in
+        reg = alloc_register(compiler);
+        error = compile_expression(compiler, let_stmt->value, reg);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+        sym = symbol_define(compiler->symbol_table, let_stmt->name->value);
+        bind_local_register(compiler, sym, reg);
+        return error;
+    case RETURN_STATEMENT:
+        error = compile_operand(compiler, ((return_statement_t *) statement)->return_value, &reg);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+        reg_emit(compiler, REGOP_RETURN, reg);
+        break;
+    default:
+        break;
+    }
+    free_registers(compiler, mark);
+    return error;
+}
+
+compiler_error_t
+reg_compile(reg_compiler_t *compiler, program_t *program)
+{
+    compiler_error_t error = {COMPILER_ERROR_NONE, NULL};
+    for (size_t i = 0; i < program->nstatements; i++) {
+        error = compile_statement(compiler, program->statements[i]);
+        if (error.code != COMPILER_ERROR_NONE)
+            return error;
+    }
+    reg_emit(compiler, REGOP_HALT);
+    return error;
+}
+
+char *
+reg_instructions_to_string(decoded_instructions_t *code)
+{
+    char *string = NULL;
+    size_t string_length = 0;
+    FILE *out = open_memstream(&string, &string_length);
+    if (out == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    for (size_t i = 0; i < code->length;) {
+        reg_opcode_t op = code->words[i];
+        const reg_opcode_definition_t *op_def = &reg_opcode_definitions[op];
+        fprintf(out, "%s%04zu %s", i == 0? "": "\n", i, op_def->name);
+        for (size_t j = 1; j <= op_def->noperands; j++)
+            fprintf(out, " %zu", code->words[i + j]);
+        i += op_def->noperands + 1;
+    }
+    fclose(out);
+    return string;
+}
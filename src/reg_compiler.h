@@ -0,0 +1,50 @@
+#ifndef REG_COMPILER_H
+#define REG_COMPILER_H
+
+#include "ast.h"
+#include "cmonkey_utils.h"
+#include "compiler.h"
+#include "opcode.h"
+#include "reg_opcode.h"
+#include "symbol_table.h"
+
+/*
+ * Register allocation within one function. Arguments and locals get a
+ * register for the whole function when they are defined, temporaries are
+ * allocated above them in stack order and released once the expression
+ * which needed them has been compiled.
+ */
+typedef struct reg_scope_t {
+    struct reg_scope_t *outer;
+    decoded_instructions_t *code;
+    size_t code_size;
+    size_t *local_registers; // register of each local, by symbol index
+    size_t nlocal_registers;
+    size_t next_register;
+    size_t locals_top;
+    size_t max_registers;
+} reg_scope_t;
+
+typedef struct reg_compiler_t {
+    cm_array_list *constants_pool;
+    symbol_table_t *symbol_table;
+    reg_scope_t *scope;
+} reg_compiler_t;
+
+typedef struct reg_bytecode_t {
+    decoded_instructions_t *code;
+    size_t num_registers;
+    cm_array_list *constants_pool;
+} reg_bytecode_t;
+
+/* register of the top level code holding the value of the last expression */
+#define REG_RESULT_REGISTER 0
+
+reg_compiler_t *reg_compiler_init(void);
+void reg_compiler_free(reg_compiler_t *);
+compiler_error_t reg_compile(reg_compiler_t *, program_t *);
+reg_bytecode_t *reg_get_bytecode(reg_compiler_t *);
+void reg_bytecode_free(reg_bytecode_t *);
+char *reg_instructions_to_string(decoded_instructions_t *);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef REG_OPCODE_H
+#define REG_OPCODE_H
+
+#include <stddef.h>
+
+/*
+ * Instruction set of the register engine (monkeyvm --engine=reg). Every
+ * function runs in a window of registers: its arguments, then its locals,
+ * then the temporaries used to evaluate expressions. Instructions name their
+ * source and destination registers explicitly, so a + b on two locals is
+ * the single instruction REGOP_ADD dst, a, b. Code is a stream of words, one
+ * for the opcode followed by one for each operand; register operands are
+ * relative to the frame's first register and jump operands are word indices.
+ */
+typedef enum reg_opcode_t {
+    REGOP_HALT,
+    REGOP_LOADK,        // dst, constant
+    REGOP_LOADTRUE,     // dst
+    REGOP_LOADFALSE,    // dst
+    REGOP_LOADNULL,     // dst
+    REGOP_MOVE,         // dst, src
+    REGOP_GETGLOBAL,    // dst, global
+    REGOP_SETGLOBAL,    // global, src
+    REGOP_GETBUILTIN,   // dst, builtin
+    REGOP_ADD,          // dst, left, right
+    REGOP_SUB,          // dst, left, right
+    REGOP_MUL,          // dst, left, right
+    REGOP_DIV,          // dst, left, right
+    REGOP_EQUAL,        // dst, left, right
+    REGOP_NOTEQUAL,     // dst, left, right
+    REGOP_GREATERTHAN,  // dst, left, right
+    REGOP_MINUS,        // dst, operand
+    REGOP_BANG,         // dst, operand
+    REGOP_JMP,          // target
+    REGOP_JMPFALSE,     // condition, target
+    REGOP_ARRAY,        // dst, first element, count
+    REGOP_HASH,         // dst, first key, 2 * number of pairs
+    REGOP_INDEX,        // dst, left, index
+    REGOP_SLICE,        // dst, left, start, end
+    REGOP_CALL,         // dst, callee, argument count; arguments follow the callee
+    REGOP_RETURN,       // src
+    REGOP_RETURNNULL
+} reg_opcode_t;
+
+typedef struct reg_opcode_definition_t {
+    const char *name;
+    size_t noperands;
+} reg_opcode_definition_t;
+
+static const reg_opcode_definition_t reg_opcode_definitions[] = {
+    {"HALT", 0},
+    {"LOADK", 2},
+    {"LOADTRUE", 1},
+    {"LOADFALSE", 1},
+    {"LOADNULL", 1},
+    {"MOVE", 2},
+    {"GETGLOBAL", 2},
+    {"SETGLOBAL", 2},
+    {"GETBUILTIN", 2},
+    {"ADD", 3},
+    {"SUB", 3},
+    {"MUL", 3},
+    {"DIV", 3},
+    {"EQUAL", 3},
+    {"NOTEQUAL", 3},
+    {"GREATERTHAN", 3},
+    {"MINUS", 2},
+    {"BANG", 2},
+    {"JMP", 1},
+    {"JMPFALSE", 2},
+    {"ARRAY", 3},
+    {"HASH", 3},
+    {"INDEX", 3},
+    {"SLICE", 4},
+    {"CALL", 3},
+    {"RETURN", 1},
+    {"RETURNNULL", 0}
+};
+
+#define REG_OPCODE_COUNT (sizeof(reg_opcode_definitions) / sizeof(reg_opcode_definitions[0]))
+
+#endif
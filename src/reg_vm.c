@@ -0,0 +1,656 @@
+#include <err.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "builtins.h"
+#include "object.h"
+#include "reg_opcode.h"
+#include "reg_vm.h"
+
+static char *
+get_err_msg(const char *s, ...)
+{
+    char *msg = NULL;
+    va_list ap;
+    va_start(ap, s);
+    int retval = vasprintf(&msg, s, ap);
+    va_end(ap);
+    if (retval == -1)
+        err(EXIT_FAILURE, "malloc failed");
+    return msg;
+}
+
+reg_vm_t *
+reg_vm_init(reg_bytecode_t *bytecode)
+{
+    reg_vm_t *vm;
+    vm = calloc(1, sizeof(*vm));
+    if (vm == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    /* as in the stack VM, the top level code runs as a borrowed function */
+    vm->main_fn = (monkey_compiled_fn_t) {
+        {MONKEY_COMPILED_FUNCTION, 0, MONKEY_REFCOUNT_IMMORTAL},
+        NULL, bytecode->num_registers, 0, bytecode->code
+    };
+    vm->frames[0].fn = &vm->main_fn;
+    vm->frames[0].ip = 0;
+    vm->frames[0].base = 0;
+    vm->frames[0].return_register = 0;
+    vm->frame_index = 1;
+    vm->constants = bytecode->constants_pool;
+    vm->result = NULL;
+    return vm;
+}
+
+void
+reg_vm_free(reg_vm_t *vm)
+{
+    for (size_t i = 0; i < REGISTER_FILE_SIZE; i++)
+        release_monkey_object(vm->registers[i]);
+    for (size_t i = 0; i < GLOBALS_SIZE; i++) {
+        if (vm->globals[i] == NULL)
+            break;
+        release_monkey_object(vm->globals[i]);
+    }
+    release_monkey_object(vm->result);
+    free(vm);
+}
+
+/*
+ * Returns the value of the last expression statement of the program, or
+ * the value of a top level return. The caller owns the returned reference.
+ */
+monkey_object_t *
+reg_vm_result(reg_vm_t *vm)
+{
+    monkey_object_t *result = vm->result;
+    vm->result = NULL;
+    return result;
+}
+
+static const char *
+get_operator_desc(reg_opcode_t op)
+{
+    switch (op) {
+    case REGOP_ADD:
+        return "+";
+    case REGOP_SUB:
+        return "-";
+    case REGOP_MUL:
+        return "*";
+    case REGOP_DIV:
+        return "/";
+    case REGOP_EQUAL:
+        return "==";
+    case REGOP_NOTEQUAL:
+        return "!=";
+    case REGOP_GREATERTHAN:
+        return ">";
+    default:
+        return reg_opcode_definitions[op].name;
+    }
+}
+
+static vm_error_t
+execute_binary_op(reg_opcode_t op, monkey_object_t *left, monkey_object_t *right,
+    monkey_object_t **result)
+{
+    vm_error_t vm_err = {VM_ERROR_NONE, NULL};
+    monkey_object_type left_type = get_monkey_object_type(left);
+    monkey_object_type right_type = get_monkey_object_type(right);
+    monkey_string_t *leftstr, *rightstr;
+    if (left_type == MONKEY_INT && right_type == MONKEY_INT) {
+        long leftval = get_monkey_int_value(left);
+        long rightval = get_monkey_int_value(right);
+        switch (op) {
+        case REGOP_ADD:
+            *result = create_monkey_int_object(leftval + rightval);
+            break;
+        case REGOP_SUB:
+            *result = create_monkey_int_object(leftval - rightval);
+            break;
+        case REGOP_MUL:
+            *result = create_monkey_int_object(leftval * rightval);
+            break;
+        default:
+            *result = create_monkey_int_object(leftval / rightval);
+            break;
+        }
+    } else if (left_type == MONKEY_STRING && right_type == MONKEY_STRING) {
+        if (op != REGOP_ADD) {
+            vm_err.code = VM_UNSUPPORTED_OPERATOR;
+            vm_err.msg = get_err_msg("opcode %s not support for string operands",
+                reg_opcode_definitions[op].name);
+            return vm_err;
+        }
+        leftstr = (monkey_string_t *) left;
+        rightstr = (monkey_string_t *) right;
+        *result = (monkey_object_t *) concat_monkey_strings(leftstr, rightstr);
+    } else {
+        vm_err.code = VM_UNSUPPORTED_OPERAND;
+        vm_err.msg = get_err_msg("'%s' operation not supported with types %s and %s",
+            get_operator_desc(op), get_type_name(left_type), get_type_name(right_type));
+    }
+    return vm_err;
+}
+
+static vm_error_t
+execute_comparison_op(reg_opcode_t op, monkey_object_t *left, monkey_object_t *right,
+    monkey_object_t **result)
+{
+    vm_error_t vm_err = {VM_ERROR_NONE, NULL};
+    monkey_object_type left_type = get_monkey_object_type(left);
+    monkey_object_type right_type = get_monkey_object_type(right);
+    _Bool value;
+    if (left_type == MONKEY_INT && right_type == MONKEY_INT) {
+        long leftval = get_monkey_int_value(left);
+        long rightval = get_monkey_int_value(right);
+        if (op == REGOP_GREATERTHAN)
+            value = leftval > rightval;
+        else if (op == REGOP_EQUAL)
+            value = leftval == rightval;
+        else
+            value = leftval != rightval;
+    } else if (left_type == MONKEY_BOOL && right_type == MONKEY_BOOL) {
+        if (op == REGOP_GREATERTHAN)
+            value = false;
+        else if (op == REGOP_EQUAL)
+            value = left == right;
+        else
+            value = left != right;
+    } else {
+        vm_err.code = VM_UNSUPPORTED_OPERAND;
+        vm_err.msg = get_err_msg("Unsupported operand types %s and %s",
+            get_type_name(left_type), get_type_name(right_type));
+        return vm_err;
+    }
+    *result = (monkey_object_t *) create_monkey_bool(value);
+    return vm_err;
+}
+
+static vm_error_t
+execute_prefix_op(reg_opcode_t op, monkey_object_t *operand, monkey_object_t **result)
+{
+    vm_error_t vm_err = {VM_ERROR_NONE, NULL};
+    monkey_object_type operand_type = get_monkey_object_type(operand);
+    if (op == REGOP_MINUS) {
+        if (operand_type != MONKEY_INT) {
+            vm_err.code = VM_UNSUPPORTED_OPERAND;
+            vm_err.msg = get_err_msg("'-' operator not supported for %s type operands",
+                get_type_name(operand_type));
+            return vm_err;
+        }
+        *result = create_monkey_int_object(-get_monkey_int_value(operand));
+        return vm_err;
+    }
+    if (operand_type == MONKEY_NULL)
+        *result = (monkey_object_t *) create_monkey_bool(true);
+    else if (operand_type == MONKEY_BOOL)
+        *result = (monkey_object_t *) create_monkey_bool(!((monkey_bool_t *) operand)->value);
+    else {
+        vm_err.code = VM_UNSUPPORTED_OPERAND;
+        vm_err.msg = get_err_msg("'!' operator not supported for %s type operands",
+            get_type_name(operand_type));
+    }
+    return vm_err;
+}
+
+static vm_error_t
+execute_index_expression(monkey_object_t *left, monkey_object_t *index, monkey_object_t **result)
+{
+    vm_error_t vm_err = {VM_ERROR_NONE, NULL};
+    monkey_object_type left_type = get_monkey_object_type(left);
+    monkey_array_t *array;
+    monkey_object_t *value;
+    long i;
+    if (left_type == MONKEY_ARRAY) {
+        if (get_monkey_object_type(index) != MONKEY_INT) {
+            vm_err.code = VM_UNSUPPORTED_OPERATOR;
+            vm_err.msg = get_err_msg("unsupported index operator type %s for array object",
+                get_type_name(get_monkey_object_type(index)));
+            return vm_err;
+        }
+        array = (monkey_array_t *) left;
+        i = get_monkey_int_value(index);
+        if (i < 0 || i >= get_monkey_array_length(array))
+            *result = (monkey_object_t *) create_monkey_null();
+        else
+            *result = retain_monkey_object(get_monkey_array_element(array, i));
+    } else if (left_type == MONKEY_HASH) {
+        value = cm_hash_table_get(((monkey_hash_t *) left)->pairs, index);
+        if (value == NULL)
+            *result = (monkey_object_t *) create_monkey_null();
+        else
+            *result = retain_monkey_object(value);
+    } else {
+        vm_err.code = VM_UNSUPPORTED_OPERATOR;
+        vm_err.msg = get_err_msg("index operator not supported for %s", get_type_name(left_type));
+    }
+    return vm_err;
+}
+
+static vm_error_t
+execute_slice_expression(monkey_object_t *left, monkey_object_t *start, monkey_object_t *end,
+    monkey_object_t **result)
+{
+    vm_error_t vm_err = {VM_ERROR_NONE, NULL};
+    *result = slice_monkey_object(left, start, end);
+    if (*result == NULL) {
+        vm_err.code = VM_UNSUPPORTED_OPERATOR;
+        vm_err.msg = get_err_msg("slice operator not supported for %s[%s:%s]",
+            get_type_name(get_monkey_object_type(left)),
+            get_type_name(get_monkey_object_type(start)),
+            get_type_name(get_monkey_object_type(end)));
+    }
+    return vm_err;
+}
+
+static _Bool
+is_truthy(monkey_object_t *condition)
+{
+    switch (get_monkey_object_type(condition)) {
+    case MONKEY_BOOL:
+        return ((monkey_bool_t *) condition)->value;
+    case MONKEY_NULL:
+        return false;
+    default:
+        return true;
+    }
+}
+
+/*
+ * Registers mostly hold immediate ints and the static booleans and null, so
+ * skip the call into the object layer for the values which need no
+ * refcounting.
+ */
+#define REG_RELEASE(obj) do {                                   \
+    if ((obj) != NULL && !is_immediate_int(obj))                \
+        release_monkey_object(obj);                             \
+} while (0)
+
+#define REG_RETAIN(obj) \
+    (is_immediate_int(obj)? (obj): retain_monkey_object(obj))
+
+/* Releases the registers of a frame which is being discarded. */
+static void
+clear_registers(reg_vm_t *vm, reg_frame_t *frame)
+{
+    monkey_object_t **regs = vm->registers + frame->base;
+    for (size_t i = 0; i < frame->fn->num_locals; i++) {
+        REG_RELEASE(regs[i]);
+        regs[i] = NULL;
+    }
+}
+
+static vm_error_t
+call_builtin(monkey_builtin_t *callee, monkey_object_t **args, size_t nargs,
+    monkey_object_t **result)
+{
+    vm_error_t vm_err = {VM_ERROR_NONE, NULL};
+    cm_list *list = cm_list_init();
+    for (size_t i = 0; i < nargs; i++)
+        cm_list_add(list, args[i]);
+    *result = callee->function(list);
+    cm_list_free(list, NULL);
+    return vm_err;
+}
+
+/*
+ * Pushes a frame for a compiled function. The arguments are moved out of
+ * the caller's registers into the first registers of the new frame, which
+ * starts right after the caller's registers.
+ */
+static vm_error_t
+call_function(reg_vm_t *vm, monkey_compiled_fn_t *callee, size_t callee_reg,
+    size_t nargs, size_t dst)
+{
+    vm_error_t vm_err = {VM_ERROR_NONE, NULL};
+    reg_frame_t *caller = &vm->frames[vm->frame_index - 1];
+    reg_frame_t *frame;
+    monkey_object_t **args = vm->registers + caller->base + callee_reg + 1;
+    size_t base = caller->base + caller->fn->num_locals;
+    if (callee->num_args != nargs) {
+        vm_err.code = VM_WRONG_NUMBER_ARGUMENTS;
+        vm_err.msg = get_err_msg("wrong number of arguments: want=%zu, got=%zu",
+            callee->num_args, nargs);
+        return vm_err;
+    }
+    if (vm->frame_index >= MAX_FRAMES) {
+        vm_err.code = VM_STACKOVERFLOW;
+        vm_err.msg = get_err_msg("Stackoverflow error: exceeded max call depth of %d",
+            MAX_FRAMES);
+        return vm_err;
+    }
+    if (base + callee->num_locals > REGISTER_FILE_SIZE) {
+        vm_err.code = VM_STACKOVERFLOW;
+        vm_err.msg = get_err_msg("Stackoverflow error: exceeded register file size of %d",
+            REGISTER_FILE_SIZE);
+        return vm_err;
+    }
+    frame = &vm->frames[vm->frame_index++];
+    frame->fn = callee;
+    frame->ip = 0;
+    frame->base = base;
+    frame->return_register = caller->base + dst;
+    for (size_t i = 0; i < nargs; i++) {
+        vm->registers[base + i] = args[i];
+        args[i] = NULL;
+    }
+    return vm_err;
+}
+
+/*
+ * The interpreter loop uses the same dispatch scheme as vm_run: computed
+ * gotos where available, a switch with -DVM_SWITCH_DISPATCH.
+ */
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define REG_VM_THREADED_DISPATCH
+#endif
+
+#ifdef REG_VM_THREADED_DISPATCH
+#define REG_TARGET(op) TARGET_##op:
+#define REG_DISPATCH() goto *dispatch_table[code[ip++]]
+#else
+#define REG_TARGET(op) case op:
+#define REG_DISPATCH() continue
+#endif
+
+#define REG_LOAD_STATE() do {                   \
+    frame = &vm->frames[vm->frame_index - 1];   \
+    regs = vm->registers + frame->base;         \
+    code = frame->fn->decoded->words;           \
+    ip = frame->ip;                             \
+} while (0)
+
+/* stores a new reference in a register, dropping the one it held */
+#define REG_SET(reg, value) do {                \
+    obj = (value);                              \
+    left = regs[reg];                           \
+    regs[reg] = obj;                            \
+    REG_RELEASE(left);                          \
+} while (0)
+
+#define REG_CHECK_ERROR() do {                  \
+    if (vm_err.code != VM_ERROR_NONE)           \
+        return vm_err;                          \
+} while (0)
+
+/*
+ * Leave the current frame with the given value. Returning from the top
+ * level ends the program.
+ */
+#define REG_RETURN(value) do {                          \
+    obj = (value);                                      \
+    if (vm->frame_index == 1) {                         \
+        release_monkey_object(vm->result);              \
+        vm->result = obj;                               \
+        return vm_err;                                  \
+    }                                                   \
+    clear_registers(vm, frame);                         \
+    dst = frame->return_register;                       \
+    vm->frame_index--;                                  \
+    left = vm->registers[dst];                          \
+    vm->registers[dst] = obj;                           \
+    REG_RELEASE(left);                                  \
+    REG_LOAD_STATE();                                   \
+} while (0)
+
+vm_error_t
+reg_vm_run(reg_vm_t *vm)
+{
+#ifdef REG_VM_THREADED_DISPATCH
+    static void *dispatch_table[] = {
+        [REGOP_HALT] = &&TARGET_REGOP_HALT,
+        [REGOP_LOADK] = &&TARGET_REGOP_LOADK,
+        [REGOP_LOADTRUE] = &&TARGET_REGOP_LOADTRUE,
+        [REGOP_LOADFALSE] = &&TARGET_REGOP_LOADFALSE,
+        [REGOP_LOADNULL] = &&TARGET_REGOP_LOADNULL,
+        [REGOP_MOVE] = &&TARGET_REGOP_MOVE,
+        [REGOP_GETGLOBAL] = &&TARGET_REGOP_GETGLOBAL,
+        [REGOP_SETGLOBAL] = &&TARGET_REGOP_SETGLOBAL,
+        [REGOP_GETBUILTIN] = &&TARGET_REGOP_GETBUILTIN,
+        [REGOP_ADD] = &&TARGET_REGOP_ADD,
+        [REGOP_SUB] = &&TARGET_REGOP_SUB,
+        [REGOP_MUL] = &&TARGET_REGOP_MUL,
+        [REGOP_DIV] = &&TARGET_REGOP_DIV,
+        [REGOP_EQUAL] = &&TARGET_REGOP_EQUAL,
+        [REGOP_NOTEQUAL] = &&TARGET_REGOP_NOTEQUAL,
+        [REGOP_GREATERTHAN] = &&TARGET_REGOP_GREATERTHAN,
+        [REGOP_MINUS] = &&TARGET_REGOP_MINUS,
+        [REGOP_BANG] = &&TARGET_REGOP_BANG,
+        [REGOP_JMP] = &&TARGET_REGOP_JMP,
+        [REGOP_JMPFALSE] = &&TARGET_REGOP_JMPFALSE,
+        [REGOP_ARRAY] = &&TARGET_REGOP_ARRAY,
+        [REGOP_HASH] = &&TARGET_REGOP_HASH,
+        [REGOP_INDEX] = &&TARGET_REGOP_INDEX,
+        [REGOP_SLICE] = &&TARGET_REGOP_SLICE,
+        [REGOP_CALL] = &&TARGET_REGOP_CALL,
+        [REGOP_RETURN] = &&TARGET_REGOP_RETURN,
+        [REGOP_RETURNNULL] = &&TARGET_REGOP_RETURNNULL
+    };
+#endif
+    vm_error_t vm_err = {VM_ERROR_NONE, NULL};
+    reg_frame_t *frame;
+    monkey_object_t **regs;
+    const size_t *code;
+    size_t ip, op, dst, a, b;
+    monkey_object_t *obj, *left, *right;
+    monkey_object_t *result = NULL;
+    cm_array_list *list;
+    cm_hash_table *table;
+
+    REG_LOAD_STATE();
+#ifdef REG_VM_THREADED_DISPATCH
+    REG_DISPATCH();
+#else
+    for (;;) {
+        switch (code[ip++]) {
+#endif
+        REG_TARGET(REGOP_HALT)
+            frame->ip = ip;
+            release_monkey_object(vm->result);
+            if (regs[REG_RESULT_REGISTER] == NULL)
+                vm->result = (monkey_object_t *) create_monkey_null();
+            else
+                vm->result = retain_monkey_object(regs[REG_RESULT_REGISTER]);
+            return vm_err;
+
+        REG_TARGET(REGOP_LOADK)
+            dst = code[ip++];
+            a = code[ip++];
+            REG_SET(dst, REG_RETAIN((monkey_object_t *) vm->constants->array[a]));
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_LOADTRUE)
+            dst = code[ip++];
+            REG_SET(dst, (monkey_object_t *) create_monkey_bool(true));
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_LOADFALSE)
+            dst = code[ip++];
+            REG_SET(dst, (monkey_object_t *) create_monkey_bool(false));
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_LOADNULL)
+            dst = code[ip++];
+            REG_SET(dst, (monkey_object_t *) create_monkey_null());
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_MOVE)
+            dst = code[ip++];
+            a = code[ip++];
+            REG_SET(dst, REG_RETAIN(regs[a]));
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_GETGLOBAL)
+            dst = code[ip++];
+            a = code[ip++];
+            REG_SET(dst, retain_monkey_object(vm->globals[a]));
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_SETGLOBAL)
+            a = code[ip++];
+            b = code[ip++];
+            left = vm->globals[a];
+            vm->globals[a] = retain_monkey_object(regs[b]);
+            release_monkey_object(left);
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_GETBUILTIN)
+            dst = code[ip++];
+            a = code[ip++];
+            REG_SET(dst, (monkey_object_t *) get_builtins(get_builtins_name(a)));
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_ADD)
+        REG_TARGET(REGOP_SUB)
+        REG_TARGET(REGOP_MUL)
+        REG_TARGET(REGOP_DIV)
+            op = code[ip - 1];
+            dst = code[ip++];
+            left = regs[code[ip++]];
+            right = regs[code[ip++]];
+            if (op != REGOP_DIV && is_immediate_int(left) && is_immediate_int(right)) {
+                if (op == REGOP_ADD)
+                    result = create_monkey_int_object(get_monkey_int_value(left) + get_monkey_int_value(right));
+                else if (op == REGOP_SUB)
+                    result = create_monkey_int_object(get_monkey_int_value(left) - get_monkey_int_value(right));
+                else
+                    result = create_monkey_int_object(get_monkey_int_value(left) * get_monkey_int_value(right));
+            } else {
+                vm_err = execute_binary_op(op, left, right, &result);
+                REG_CHECK_ERROR();
+            }
+            REG_SET(dst, result);
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_EQUAL)
+        REG_TARGET(REGOP_NOTEQUAL)
+        REG_TARGET(REGOP_GREATERTHAN)
+            op = code[ip - 1];
+            dst = code[ip++];
+            left = regs[code[ip++]];
+            right = regs[code[ip++]];
+            if (is_immediate_int(left) && is_immediate_int(right)) {
+                if (op == REGOP_GREATERTHAN)
+                    result = (monkey_object_t *) create_monkey_bool(
+                        (get_monkey_int_value(left) > get_monkey_int_value(right)));
+                else if (op == REGOP_EQUAL)
+                    result = (monkey_object_t *) create_monkey_bool((left == right));
+                else
+                    result = (monkey_object_t *) create_monkey_bool((left != right));
+            } else {
+                vm_err = execute_comparison_op(op, left, right, &result);
+                REG_CHECK_ERROR();
+            }
+            REG_SET(dst, result);
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_MINUS)
+        REG_TARGET(REGOP_BANG)
+            op = code[ip - 1];
+            dst = code[ip++];
+            vm_err = execute_prefix_op(op, regs[code[ip++]], &result);
+            REG_CHECK_ERROR();
+            REG_SET(dst, result);
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_JMP)
+            ip = code[ip];
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_JMPFALSE)
+            if (!is_truthy(regs[code[ip]]))
+                ip = code[ip + 1];
+            else
+                ip += 2;
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_ARRAY)
+            dst = code[ip++];
+            a = code[ip++];
+            b = code[ip++];
+            list = cm_array_list_init(b, release_monkey_object);
+            for (size_t i = a; i < a + b; i++) {
+                cm_array_list_add(list, regs[i]);
+                regs[i] = NULL;
+            }
+            REG_SET(dst, (monkey_object_t *) create_monkey_array(list));
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_HASH)
+            dst = code[ip++];
+            a = code[ip++];
+            b = code[ip++];
+            table = cm_hash_table_init(monkey_object_hash, monkey_object_equals,
+                release_monkey_object, release_monkey_object);
+            for (size_t i = a; i < a + b; i += 2) {
+                cm_hash_table_put(table, regs[i], regs[i + 1]);
+                regs[i] = regs[i + 1] = NULL;
+            }
+            REG_SET(dst, (monkey_object_t *) create_monkey_hash(table));
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_INDEX)
+            dst = code[ip++];
+            left = regs[code[ip++]];
+            right = regs[code[ip++]];
+            vm_err = execute_index_expression(left, right, &result);
+            REG_CHECK_ERROR();
+            REG_SET(dst, result);
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_SLICE)
+            dst = code[ip++];
+            left = regs[code[ip++]];
+            right = regs[code[ip++]];
+            obj = regs[code[ip++]];
+            vm_err = execute_slice_expression(left, right, obj, &result);
+            REG_CHECK_ERROR();
+            REG_SET(dst, result);
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_CALL)
+            dst = code[ip++];
+            a = code[ip++];
+            b = code[ip++];
+            obj = regs[a];
+            switch (get_monkey_object_type(obj)) {
+            case MONKEY_COMPILED_FUNCTION:
+                frame->ip = ip;
+                vm_err = call_function(vm, (monkey_compiled_fn_t *) obj, a, b, dst);
+                REG_CHECK_ERROR();
+                REG_LOAD_STATE();
+                break;
+            case MONKEY_BUILTIN:
+                vm_err = call_builtin((monkey_builtin_t *) obj, regs + a + 1, b, &result);
+                REG_CHECK_ERROR();
+                REG_SET(dst, result);
+                break;
+            default:
+                vm_err.code = VM_NON_FUNCTION;
+                vm_err.msg = get_err_msg("Calling non-function\n");
+                return vm_err;
+            }
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_RETURN)
+            a = code[ip++];
+            result = regs[a];
+            regs[a] = NULL;
+            REG_RETURN(result);
+            REG_DISPATCH();
+
+        REG_TARGET(REGOP_RETURNNULL)
+            REG_RETURN((monkey_object_t *) create_monkey_null());
+            REG_DISPATCH();
+#ifndef REG_VM_THREADED_DISPATCH
+        default:
+            vm_err.code = VM_UNSUPPORTED_OPERATOR;
+            vm_err.msg = get_err_msg("Unsupported opcode %zu", code[ip - 1]);
+            return vm_err;
+        }
+    }
+#endif
+}
@@ -0,0 +1,34 @@
+#ifndef REG_VM_H
+#define REG_VM_H
+
+#include <stdlib.h>
+#include "cmonkey_utils.h"
+#include "object.h"
+#include "reg_compiler.h"
+#include "vm.h"
+
+#define REGISTER_FILE_SIZE 65536
+
+typedef struct reg_frame_t {
+    monkey_compiled_fn_t *fn;
+    size_t ip;
+    size_t base;            // first register of the frame in the register file
+    size_t return_register; // caller's register receiving the return value
+} reg_frame_t;
+
+typedef struct reg_vm_t {
+    monkey_compiled_fn_t main_fn;
+    reg_frame_t frames[MAX_FRAMES];
+    size_t frame_index;
+    cm_array_list *constants;
+    monkey_object_t *registers[REGISTER_FILE_SIZE];
+    monkey_object_t *globals[GLOBALS_SIZE];
+    monkey_object_t *result;
+} reg_vm_t;
+
+reg_vm_t *reg_vm_init(reg_bytecode_t *);
+void reg_vm_free(reg_vm_t *);
+vm_error_t reg_vm_run(reg_vm_t *);
+monkey_object_t *reg_vm_result(reg_vm_t *);
+
+#endif
@@ -0,0 +1,259 @@
+#include <err.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer.h"
+#include "token.h"
+#include "object_test_utils.h"
+#include "parser.h"
+#include "reg_compiler.h"
+#include "reg_vm.h"
+#include "test_utils.h"
+
+typedef struct reg_vm_testcase {
+    const char *input;
+    monkey_object_t *expected;
+} reg_vm_testcase;
+
+static void
+run_reg_vm_tests(size_t test_count, reg_vm_testcase test_cases[test_count])
+{
+    for (size_t i = 0; i < test_count; i++) {
+        reg_vm_testcase t = test_cases[i];
+        printf("Testing register vm for input %s\n", t.input);
+        lexer_t *lexer = lexer_init(t.input);
+        parser_t *parser = parser_init(lexer);
+        program_t *program = parse_program(parser);
+        reg_compiler_t *compiler = reg_compiler_init();
+        compiler_error_t error = reg_compile(compiler, program);
+        if (error.code != COMPILER_ERROR_NONE)
+            errx(EXIT_FAILURE, "compilation failed for input %s with error %s\n",
+                t.input, error.msg);
+        reg_bytecode_t *bytecode = reg_get_bytecode(compiler);
+        reg_vm_t *vm = reg_vm_init(bytecode);
+        vm_error_t vm_error = reg_vm_run(vm);
+        if (vm_error.code != VM_ERROR_NONE)
+            errx(EXIT_FAILURE, "vm error: %s\n", vm_error.msg);
+        monkey_object_t *result = reg_vm_result(vm);
+        test_monkey_object(result, t.expected);
+        release_monkey_object(result);
+        parser_free(parser);
+        program_free(program);
+        reg_bytecode_free(bytecode);
+        reg_vm_free(vm);
+        reg_compiler_free(compiler);
+    }
+}
+
+static monkey_array_t *
+create_monkey_int_array(size_t count, ...)
+{
+    va_list ap;
+    va_start(ap, count);
+    cm_array_list *list = cm_array_list_init(count, release_monkey_object);
+    for (size_t i = 0; i < count; i++) {
+        int val = va_arg(ap, int);
+        cm_array_list_add(list, create_monkey_int(val));
+    }
+    va_end(ap);
+    return create_monkey_array(list);
+}
+
+static void
+run_and_release(reg_vm_testcase *tests, size_t ntests)
+{
+    run_reg_vm_tests(ntests, tests);
+    for (size_t i = 0; i < ntests; i++)
+        release_monkey_object(tests[i].expected);
+}
+
+static void
+test_expressions(void)
+{
+    reg_vm_testcase tests[] = {
+        {"1", (monkey_object_t *) create_monkey_int(1)},
+        {"50 / 2 * 2 + 10 - 5", (monkey_object_t *) create_monkey_int(55)},
+        {"(5 + 10 * 2 + 15 / 3) * 2 + -10", (monkey_object_t *) create_monkey_int(50)},
+        {"4611686018427387903 + 1", (monkey_object_t *) create_monkey_int(4611686018427387904)},
+        {"1 < 2", (monkey_object_t *) create_monkey_bool(true)},
+        {"1 > 2", (monkey_object_t *) create_monkey_bool(false)},
+        {"1 != 2", (monkey_object_t *) create_monkey_bool(true)},
+        {"(1 < 2) == true", (monkey_object_t *) create_monkey_bool(true)},
+        {"!(if (false) {5;})", (monkey_object_t *) create_monkey_bool(true)},
+        {"!!true", (monkey_object_t *) create_monkey_bool(true)},
+        {"if (1 > 2) {10}", (monkey_object_t *) create_monkey_null()},
+        {"if (if (false) {10}) {10} else {20}", (monkey_object_t *) create_monkey_int(20)},
+        {"\"mon\" + \"key\" + \"banana\"", (monkey_object_t *) create_monkey_string("monkeybanana", 12)},
+        {"[1 + 2, 3 * 4, 5 + 6]", (monkey_object_t *) create_monkey_int_array(3, 3, 12, 11)},
+        {"[[1, 1, 1]][0][0]", (monkey_object_t *) create_monkey_int(1)},
+        {"[1, 2, 3][99]", (monkey_object_t *) create_monkey_null()},
+        {"{1: 1, 2: 2}[2]", (monkey_object_t *) create_monkey_int(2)},
+        {"{1 + 1: 2 * 2}[2]", (monkey_object_t *) create_monkey_int(4)},
+        {"{}[0]", (monkey_object_t *) create_monkey_null()},
+        {"[1, 2, 3, 4][1:3]", (monkey_object_t *) create_monkey_int_array(2, 2, 3)},
+        {"[1, 2, 3, 4][:1 + 1][1:]", (monkey_object_t *) create_monkey_int_array(1, 2)},
+        {"\"monkey\"[3:]", (monkey_object_t *) create_monkey_string("key", 3)}
+    };
+    print_test_separator_line();
+    printf("Testing register vm expressions\n");
+    run_and_release(tests, sizeof(tests) / sizeof(tests[0]));
+}
+
+static void
+test_globals_and_functions(void)
+{
+    reg_vm_testcase tests[] = {
+        {"let one = 1; let two = one + one; one + two", (monkey_object_t *) create_monkey_int(3)},
+        {"let one = 1;", (monkey_object_t *) create_monkey_null()},
+        {"let f = fn() { 5 + 10 }; f()", (monkey_object_t *) create_monkey_int(15)},
+        {"let f = fn() { }; f()", (monkey_object_t *) create_monkey_null()},
+        {"let f = fn() { return 99; 100; }; f()", (monkey_object_t *) create_monkey_int(99)},
+        {"let f = fn() { let a = 1; let b = 2; a + b }; f()", (monkey_object_t *) create_monkey_int(3)},
+        {"let sum = fn(a, b) { let c = a + b; c; }; sum(1, 2) + sum(3, 4)",
+            (monkey_object_t *) create_monkey_int(10)},
+        {"let one = fn() { 1 }; let r = fn() { one }; r()()", (monkey_object_t *) create_monkey_int(1)},
+        {"let g = 50; let f = fn(a) { let b = a * 2; g - b }; f(5) + f(10)",
+            (monkey_object_t *) create_monkey_int(70)},
+        {"let fib = fn(f, n) { if (n < 2) { return n; } f(f, n - 1) + f(f, n - 2) }; fib(fib, 15)",
+            (monkey_object_t *) create_monkey_int(610)},
+        {"let f = fn(a) { [a, a + 1][1] }; f(4)", (monkey_object_t *) create_monkey_int(5)},
+        {"len(\"four\") + len([1, 2, 3])", (monkey_object_t *) create_monkey_int(7)},
+        {"let f = fn(a) { push(a, 4) }; f([1, 2, 3])", (monkey_object_t *) create_monkey_int_array(4, 1, 2, 3, 4)},
+        {"let f = fn(a, i) { let b = a[i:]; rest(b) }; f([1, 2, 3, 4], 1)",
+            (monkey_object_t *) create_monkey_int_array(2, 3, 4)},
+        {"return 5; 10", (monkey_object_t *) create_monkey_int(5)}
+    };
+    print_test_separator_line();
+    printf("Testing register vm globals and functions\n");
+    run_and_release(tests, sizeof(tests) / sizeof(tests[0]));
+}
+
+static void
+test_errors(void)
+{
+    typedef struct testcase {
+        const char *input;
+        const char *expected_errmsg;
+    } testcase;
+    testcase tests[] = {
+        {"fn() {1;}(1);", "wrong number of arguments: want=0, got=1"},
+        {"fn(a, b) {a + b;}(1);", "wrong number of arguments: want=2, got=1"},
+        {"1(2)", "Calling non-function\n"},
+        {"1 + true", "'+' operation not supported with types INTEGER and BOOLEAN"},
+        {"{}[1:]", "slice operator not supported for HASH[INTEGER:NULL]"},
+        {"let f = fn(g, n) { g(g, n + 1) }; f(f, 0)", "Stackoverflow error: exceeded max call depth of 1024"}
+    };
+    print_test_separator_line();
+    printf("Testing register vm errors\n");
+    size_t ntests = sizeof(tests) / sizeof(tests[0]);
+    for (size_t i = 0; i < ntests; i++) {
+        testcase t = tests[i];
+        printf("Testing %s\n", t.input);
+        lexer_t *lexer = lexer_init(t.input);
+        parser_t *parser = parser_init(lexer);
+        program_t *program = parse_program(parser);
+        reg_compiler_t *compiler = reg_compiler_init();
+        compiler_error_t error = reg_compile(compiler, program);
+        if (error.code != COMPILER_ERROR_NONE)
+            errx(EXIT_FAILURE, "compilation failed for input %s with error %s\n",
+                t.input, error.msg);
+        reg_bytecode_t *bytecode = reg_get_bytecode(compiler);
+        reg_vm_t *vm = reg_vm_init(bytecode);
+        vm_error_t vm_error = reg_vm_run(vm);
+        test(vm_error.code != VM_ERROR_NONE, "expected VM error but got no error\n");
+        test(strcmp(vm_error.msg, t.expected_errmsg) == 0, "Expected error: %s, got %s\n",
+            t.expected_errmsg, vm_error.msg);
+        free(vm_error.msg);
+        parser_free(parser);
+        program_free(program);
+        reg_bytecode_free(bytecode);
+        reg_vm_free(vm);
+        reg_compiler_free(compiler);
+    }
+}
+
+static void
+test_register_instructions(void)
+{
+    typedef struct testcase {
+        const char *input;
+        const char *expected;
+    } testcase;
+    testcase tests[] = {
+        {
+            "1 + 2",
+            "0000 LOADK 1 0\n"
+            "0003 LOADK 2 1\n"
+            "0006 ADD 0 1 2\n"
+            "0010 HALT"
+        },
+        {
+            "let a = 1; a",
+            "0000 LOADK 1 0\n"
+            "0003 SETGLOBAL 0 1\n"
+            "0006 GETGLOBAL 0 0\n"
+            "0009 HALT"
+        }
+    };
+    print_test_separator_line();
+    printf("Testing register instructions\n");
+    size_t ntests = sizeof(tests) / sizeof(tests[0]);
+    for (size_t i = 0; i < ntests; i++) {
+        testcase t = tests[i];
+        printf("Testing %s\n", t.input);
+        lexer_t *lexer = lexer_init(t.input);
+        parser_t *parser = parser_init(lexer);
+        program_t *program = parse_program(parser);
+        reg_compiler_t *compiler = reg_compiler_init();
+        compiler_error_t error = reg_compile(compiler, program);
+        if (error.code != COMPILER_ERROR_NONE)
+            errx(EXIT_FAILURE, "compilation failed for input %s with error %s\n",
+                t.input, error.msg);
+        char *actual = reg_instructions_to_string(compiler->scope->code);
+        test(strcmp(actual, t.expected) == 0, "Expected instructions:\n%s\ngot:\n%s\n",
+            t.expected, actual);
+        free(actual);
+        parser_free(parser);
+        program_free(program);
+        reg_compiler_free(compiler);
+    }
+}
+
+static void
+test_function_locals(void)
+{
+    /* a + b on two locals is a single instruction on their registers */
+    const char *input = "let f = fn(a, b) { a + b };";
+    const char *expected = "0000 ADD 2 0 1\n"
+        "0004 RETURN 2";
+    print_test_separator_line();
+    printf("Testing register allocation for %s\n", input);
+    lexer_t *lexer = lexer_init(input);
+    parser_t *parser = parser_init(lexer);
+    program_t *program = parse_program(parser);
+    reg_compiler_t *compiler = reg_compiler_init();
+    compiler_error_t error = reg_compile(compiler, program);
+    if (error.code != COMPILER_ERROR_NONE)
+        errx(EXIT_FAILURE, "compilation failed for input %s with error %s\n", input, error.msg);
+    monkey_compiled_fn_t *fn = cm_array_list_get(compiler->constants_pool, 0);
+    char *actual = reg_instructions_to_string(fn->decoded);
+    test(strcmp(actual, expected) == 0, "Expected instructions:\n%s\ngot:\n%s\n", expected, actual);
+    test(fn->num_args == 2, "Expected 2 arguments, got %zu\n", fn->num_args);
+    test(fn->num_locals == 3, "Expected 3 registers, got %zu\n", fn->num_locals);
+    free(actual);
+    parser_free(parser);
+    program_free(program);
+    reg_compiler_free(compiler);
+}
+
+int
+main(int argc, char **argv)
+{
+    test_expressions();
+    test_globals_and_functions();
+    test_errors();
+    test_register_instructions();
+    test_function_locals();
+    return 0;
+}
@@ -35,6 +35,7 @@
 #include <unistd.h>
 
 #include "ast.h"
+#include "closure_compiler.h"
 #include "cmonkey_utils.h"
 #include "environment.h"
 #include "evaluator.h"
@@ -42,6 +43,14 @@
 #include "token.h"
 #include "lexer.h"
 #include "parser.h"
+#include "resolver.h"
+
+typedef enum engine_t {
+	ENGINE_CLOSURES,
+	ENGINE_AST
+} engine_t;
+
+static engine_t engine = ENGINE_CLOSURES;
 
 static const char * PROMPT = ">> ";
 static const char *MONKEY_FACE = "            __,__\n\
@@ -80,6 +89,32 @@ free_lines(cm_array_list *lines)
 	lines->length = 0;
 }
 
+static void
+free_program(void *program)
+{
+	program_free(program);
+}
+
+static void
+free_closure_program(void *program)
+{
+	closure_program_free(program);
+}
+
+/*
+ * Evaluates the resolved program with the engine. The compiled closures
+ * go into compiled, which must outlive the values like the program.
+ */
+static monkey_object_t *
+evaluate(program_t *program, environment_t *env, cm_array_list *compiled)
+{
+	if (engine == ENGINE_AST)
+		return monkey_eval((node_t *) program, env);
+	closure_program_t *closures = compile_closures(program);
+	cm_array_list_add(compiled, closures);
+	return run_closures(closures, env);
+}
+
 static int
 execute_file(const char *filename)
 {
@@ -112,6 +147,7 @@ execute_file(const char *filename)
 
 	environment_t *env = create_env();
 	cm_array_list *lines = cm_array_list_init(4, free);
+	cm_array_list *compiled = cm_array_list_init(1, free_closure_program);
 	while ((bytes_read = getline(&line, &linesize, file)) != -1) {
 		cm_array_list_add(lines, line);
 		line = NULL;
@@ -127,19 +163,23 @@ execute_file(const char *filename)
 		print_parse_errors(parser);
 		goto EXIT;
 	}
-	monkey_object_t *evaluated = monkey_eval((node_t *) program, env);
+	resolver_t *resolver = resolver_init();
+	resolve_program(resolver, program);
+	resolver_free(resolver);
+	monkey_object_t *evaluated = evaluate(program, env, compiled);
 	env_free(env);
 	if (evaluated != NULL) {
-		if (evaluated->type != MONKEY_NULL) {
-			char *s = evaluated->inspect(evaluated);
+		if (get_monkey_object_type(evaluated) != MONKEY_NULL) {
+			char *s = inspect(evaluated);
 			printf("%s\n", s);
 			free(s);
 		}
-		free_monkey_object(evaluated);
+		release_monkey_object(evaluated);
 	}
 
 EXIT:
 	cm_array_list_free(lines);
+	cm_array_list_free(compiled);
 	program_free(program);
 	parser_free(parser);
 	fclose(file);
@@ -159,6 +199,10 @@ repl(void)
 	parser_t *parser = NULL;
 	program_t *program = NULL;
 	environment_t *env = create_env();
+	resolver_t *resolver = resolver_init();
+	/* the functions in env keep pointing into the programs which defined them */
+	cm_array_list *programs = cm_array_list_init(4, free_program);
+	cm_array_list *compiled = cm_array_list_init(4, free_closure_program);
 	printf("%s\n", MONKEY_FACE);
 	printf("Welcome to the monkey programming language\n");
 	printf("%s", PROMPT);
@@ -190,16 +234,20 @@ repl(void)
 			goto CONTINUE;
 		}
 
-		monkey_object_t *evaluated = monkey_eval((node_t *) program, env);
+		resolve_program(resolver, program);
+		monkey_object_t *evaluated = evaluate(program, env, compiled);
 		if (evaluated != NULL) {
-			char *s = evaluated->inspect(evaluated);
+			char *s = inspect(evaluated);
 			printf("%s\n", s);
 			free(s);
-			free_monkey_object(evaluated);
+			release_monkey_object(evaluated);
 		}
+		cm_array_list_add(programs, program);
+		program = NULL;
 
 CONTINUE:
-		program_free(program);
+		if (program)
+			program_free(program);
 		parser_free(parser);
 		free_lines(lines);
 		free(program_string);
@@ -217,12 +265,25 @@ CONTINUE:
 		free(line);
 	cm_array_list_free(lines);
 	env_free(env);
+	cm_array_list_free(compiled);
+	cm_array_list_free(programs);
+	resolver_free(resolver);
 	return 0;
 }
 
 int
 main(int argc, char **argv)
 {
+	while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+		if (strcmp(argv[1], "--engine=ast") == 0)
+			engine = ENGINE_AST;
+		else if (strcmp(argv[1], "--engine=closures") == 0)
+			engine = ENGINE_CLOSURES;
+		else
+			errx(EXIT_FAILURE, "Unknown option %s", argv[1]);
+		argc--;
+		argv++;
+	}
 	if (argc == 1)
 		return repl();
 	if (argc == 2)
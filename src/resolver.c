@@ -0,0 +1,295 @@
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resolver.h"
+
+typedef struct pending_identifier_t {
+    identifier_t *ident;
+    size_t depth;   // from the scope whose pending list holds it
+} pending_identifier_t;
+
+static void resolve_statement(resolver_t *, statement_t *);
+static void resolve_expression(resolver_t *, expression_t *);
+
+static resolver_scope_t *
+create_scope(resolver_scope_t *outer)
+{
+    resolver_scope_t *scope = malloc(sizeof(*scope));
+    if (scope == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    scope->outer = outer;
+    if (outer == NULL) {
+        scope->symbols = symbol_table_init();
+        scope->pending = NULL;
+    } else {
+        scope->symbols = enclosed_symbol_table_init(outer->symbols);
+        scope->pending = cm_array_list_init(4, free);
+    }
+    return scope;
+}
+
+static void
+free_scope(resolver_scope_t *scope)
+{
+    free_symbol_table(scope->symbols);
+    if (scope->pending != NULL)
+        cm_array_list_free(scope->pending);
+    free(scope);
+}
+
+resolver_t *
+resolver_init(void)
+{
+    resolver_t *resolver = malloc(sizeof(*resolver));
+    if (resolver == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    resolver->scope = create_scope(NULL);
+    return resolver;
+}
+
+void
+resolver_free(resolver_t *resolver)
+{
+    free_scope(resolver->scope);
+    free(resolver);
+}
+
+static symbol_t *
+get_symbol(resolver_scope_t *scope, char *name)
+{
+    return cm_hash_table_get(scope->symbols->store, name);
+}
+
+/* the slot of name in the scope, a new one unless the scope declared it already */
+static symbol_t *
+declare(resolver_scope_t *scope, char *name)
+{
+    symbol_t *symbol = get_symbol(scope, name);
+    if (symbol != NULL)
+        return symbol;
+    if (scope->symbols->nentries == UINT16_MAX)
+        errx(EXIT_FAILURE, "Too many variables in a function, the limit is %d", UINT16_MAX);
+    return symbol_define(scope->symbols, name);
+}
+
+static void
+add_pending(resolver_scope_t *scope, identifier_t *ident, size_t depth)
+{
+    pending_identifier_t *pending = malloc(sizeof(*pending));
+    if (pending == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    pending->ident = ident;
+    pending->depth = depth;
+    cm_array_list_add(scope->pending, pending);
+}
+
+/*
+ * Declares the name of a let or a parameter and resolves the identifiers
+ * of nested functions which were waiting for it. Those of the scope's own
+ * code keep waiting for an enclosing scope, when they run the name is not
+ * set yet.
+ */
+static void
+resolve_declaration(resolver_t *resolver, identifier_t *ident)
+{
+    resolver_scope_t *scope = resolver->scope;
+    symbol_t *symbol = declare(scope, ident->value);
+    ident->depth = 0;
+    ident->slot = symbol->index;
+    if (scope->pending == NULL)
+        return;
+    for (size_t i = 0; i < scope->pending->length; i++) {
+        pending_identifier_t *pending = scope->pending->array[i];
+        if (pending->ident != NULL && pending->depth > 0 &&
+            strcmp(pending->ident->value, ident->value) == 0) {
+            pending->ident->depth = pending->depth;
+            pending->ident->slot = symbol->index;
+            pending->ident = NULL;
+        }
+    }
+}
+
+static void
+resolve_identifier(resolver_t *resolver, identifier_t *ident)
+{
+    size_t depth = 0;
+    symbol_t *symbol;
+    for (resolver_scope_t *scope = resolver->scope; scope != NULL; scope = scope->outer) {
+        symbol = get_symbol(scope, ident->value);
+        if (symbol != NULL) {
+            ident->depth = depth;
+            ident->slot = symbol->index;
+            return;
+        }
+        depth++;
+    }
+    if (resolver->scope->outer == NULL) {
+        ident->depth = 0;
+        ident->slot = declare(resolver->scope, ident->value)->index;
+    } else {
+        add_pending(resolver->scope, ident, 0);
+    }
+}
+
+/* hands the identifiers still waiting in the function's scope to the enclosing one */
+static void
+leave_function_scope(resolver_t *resolver)
+{
+    resolver_scope_t *scope = resolver->scope;
+    resolver_scope_t *outer = scope->outer;
+    for (size_t i = 0; i < scope->pending->length; i++) {
+        pending_identifier_t *pending = scope->pending->array[i];
+        if (pending->ident == NULL)
+            continue;
+        if (outer->outer == NULL) {
+            pending->ident->depth = pending->depth + 1;
+            pending->ident->slot = declare(outer, pending->ident->value)->index;
+        } else {
+            add_pending(outer, pending->ident, pending->depth + 1);
+        }
+    }
+    resolver->scope = outer;
+    free_scope(scope);
+}
+
+static void
+resolve_block_statement(resolver_t *resolver, block_statement_t *block)
+{
+    for (size_t i = 0; i < block->nstatements; i++)
+        resolve_statement(resolver, block->statements[i]);
+}
+
+static void
+resolve_function_literal(resolver_t *resolver, function_literal_t *function)
+{
+    resolver->scope = create_scope(resolver->scope);
+    cm_list_node *list_node = function->parameters->head;
+    while (list_node != NULL) {
+        resolve_declaration(resolver, (identifier_t *) list_node->data);
+        list_node = list_node->next;
+    }
+    resolve_block_statement(resolver, function->body);
+    function->nslots = resolver->scope->symbols->nentries;
+    leave_function_scope(resolver);
+}
+
+static void
+resolve_expression(resolver_t *resolver, expression_t *exp)
+{
+    prefix_expression_t *prefix_exp;
+    infix_expression_t *infix_exp;
+    if_expression_t *if_exp;
+    while_expression_t *while_exp;
+    call_expression_t *call_exp;
+    array_literal_t *array_exp;
+    index_expression_t *index_exp;
+    slice_expression_t *slice_exp;
+    cm_hash_table_iterator iterator;
+    cm_hash_entry *entry;
+    cm_list_node *list_node;
+
+    if (exp == NULL)
+        return;
+    switch (exp->expression_type) {
+    case IDENTIFIER_EXPRESSION:
+        resolve_identifier(resolver, (identifier_t *) exp);
+        break;
+    case PREFIX_EXPRESSION:
+        prefix_exp = (prefix_expression_t *) exp;
+        resolve_expression(resolver, prefix_exp->right);
+        break;
+    case INFIX_EXPRESSION:
+        infix_exp = (infix_expression_t *) exp;
+        resolve_expression(resolver, infix_exp->left);
+        resolve_expression(resolver, infix_exp->right);
+        break;
+    case IF_EXPRESSION:
+        if_exp = (if_expression_t *) exp;
+        resolve_expression(resolver, if_exp->condition);
+        resolve_block_statement(resolver, if_exp->consequence);
+        if (if_exp->alternative != NULL)
+            resolve_block_statement(resolver, if_exp->alternative);
+        break;
+    case WHILE_EXPRESSION:
+        while_exp = (while_expression_t *) exp;
+        resolve_expression(resolver, while_exp->condition);
+        resolve_block_statement(resolver, while_exp->body);
+        break;
+    case FUNCTION_LITERAL:
+        resolve_function_literal(resolver, (function_literal_t *) exp);
+        break;
+    case CALL_EXPRESSION:
+        call_exp = (call_expression_t *) exp;
+        resolve_expression(resolver, call_exp->function);
+        list_node = call_exp->arguments->head;
+        while (list_node != NULL) {
+            resolve_expression(resolver, (expression_t *) list_node->data);
+            list_node = list_node->next;
+        }
+        break;
+    case ARRAY_LITERAL:
+        array_exp = (array_literal_t *) exp;
+        for (size_t i = 0; i < array_exp->elements->length; i++)
+            resolve_expression(resolver, array_exp->elements->array[i]);
+        break;
+    case INDEX_EXPRESSION:
+        index_exp = (index_expression_t *) exp;
+        resolve_expression(resolver, index_exp->left);
+        resolve_expression(resolver, index_exp->index);
+        break;
+    case SLICE_EXPRESSION:
+        slice_exp = (slice_expression_t *) exp;
+        resolve_expression(resolver, slice_exp->left);
+        if (slice_exp->start != NULL)
+            resolve_expression(resolver, slice_exp->start);
+        if (slice_exp->end != NULL)
+            resolve_expression(resolver, slice_exp->end);
+        break;
+    case HASH_LITERAL:
+        cm_hash_table_iterator_init(&iterator, ((hash_literal_t *) exp)->pairs);
+        while ((entry = cm_hash_table_iterator_next(&iterator)) != NULL) {
+            resolve_expression(resolver, entry->key);
+            resolve_expression(resolver, entry->value);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+resolve_statement(resolver_t *resolver, statement_t *statement)
+{
+    letstatement_t *let_stmt;
+    return_statement_t *ret_stmt;
+    switch (statement->statement_type) {
+    case LET_STATEMENT:
+        /* the value is resolved first, let x = x + 1 reads an outer x */
+        let_stmt = (letstatement_t *) statement;
+        resolve_expression(resolver, let_stmt->value);
+        resolve_declaration(resolver, let_stmt->name);
+        break;
+    case RETURN_STATEMENT:
+        ret_stmt = (return_statement_t *) statement;
+        resolve_expression(resolver, ret_stmt->return_value);
+        break;
+    case EXPRESSION_STATEMENT:
+        resolve_expression(resolver, ((expression_statement_t *) statement)->expression);
+        break;
+    case BLOCK_STATEMENT:
+        resolve_block_statement(resolver, (block_statement_t *) statement);
+        break;
+    }
+}
+
+/*
+ * The program's globals go into the resolver's global scope, which the REPL
+ * keeps for all the programs it evaluates in the same environment.
+ */
+void
+resolve_program(resolver_t *resolver, program_t *program)
+{
+    for (size_t i = 0; i < program->nstatements; i++)
+        resolve_statement(resolver, program->statements[i]);
+}
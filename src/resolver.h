@@ -0,0 +1,37 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "ast.h"
+#include "cmonkey_utils.h"
+#include "symbol_table.h"
+
+/*
+ * Resolves the identifiers of a program for the evaluator before it runs.
+ * Every function call gets an environment with one slot per parameter and
+ * let of the function, and the program a global one. The resolver sets the
+ * depth of each identifier, how many environments to go out from the one
+ * of the function it appears in, and its slot there, and the number of
+ * slots of each function literal.
+ *
+ * A name refers to the nearest declaration before it. Inside a function,
+ * a name no enclosing scope declares yet refers to the nearest one which
+ * declares it after the function, so that functions can call themselves
+ * and each other. Names which nothing else declares get a global slot,
+ * which stays empty for builtins and undefined names unless a later
+ * program in the REPL declares them.
+ */
+typedef struct resolver_scope_t {
+    struct resolver_scope_t *outer;
+    symbol_table_t *symbols;
+    cm_array_list *pending; // identifiers of nested functions declared by no scope yet
+} resolver_scope_t;
+
+typedef struct resolver_t {
+    resolver_scope_t *scope; // the innermost, the global scope has no outer
+} resolver_t;
+
+resolver_t *resolver_init(void);
+void resolve_program(resolver_t *, program_t *);
+void resolver_free(resolver_t *);
+
+#endif
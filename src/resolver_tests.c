@@ -0,0 +1,188 @@
+#include <err.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cmonkey_utils.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "test_utils.h"
+
+static void describe_statement(cm_array_list *, statement_t *);
+
+static void
+add_description(cm_array_list *descriptions, const char *format, ...)
+{
+    char *description;
+    va_list args;
+    va_start(args, format);
+    if (vasprintf(&description, format, args) == -1)
+        err(EXIT_FAILURE, "malloc failed");
+    va_end(args);
+    cm_array_list_add(descriptions, description);
+}
+
+static void
+describe_block(cm_array_list *descriptions, block_statement_t *block)
+{
+    for (size_t i = 0; i < block->nstatements; i++)
+        describe_statement(descriptions, block->statements[i]);
+}
+
+/*
+ * Lists the identifiers in the order the resolver visits them as
+ * name@depth:slot, and the function literals as fn/nslots.
+ */
+static void
+describe_expression(cm_array_list *descriptions, expression_t *exp)
+{
+    identifier_t *ident;
+    function_literal_t *function;
+    call_expression_t *call_exp;
+    if_expression_t *if_exp;
+    while_expression_t *while_exp;
+    cm_list_node *list_node;
+
+    switch (exp->expression_type) {
+    case IDENTIFIER_EXPRESSION:
+        ident = (identifier_t *) exp;
+        add_description(descriptions, "%s@%zu:%zu", ident->value, ident->depth, ident->slot);
+        break;
+    case PREFIX_EXPRESSION:
+        describe_expression(descriptions, ((prefix_expression_t *) exp)->right);
+        break;
+    case INFIX_EXPRESSION:
+        describe_expression(descriptions, ((infix_expression_t *) exp)->left);
+        describe_expression(descriptions, ((infix_expression_t *) exp)->right);
+        break;
+    case IF_EXPRESSION:
+        if_exp = (if_expression_t *) exp;
+        describe_expression(descriptions, if_exp->condition);
+        describe_block(descriptions, if_exp->consequence);
+        if (if_exp->alternative != NULL)
+            describe_block(descriptions, if_exp->alternative);
+        break;
+    case WHILE_EXPRESSION:
+        while_exp = (while_expression_t *) exp;
+        describe_expression(descriptions, while_exp->condition);
+        describe_block(descriptions, while_exp->body);
+        break;
+    case FUNCTION_LITERAL:
+        function = (function_literal_t *) exp;
+        add_description(descriptions, "fn/%zu", function->nslots);
+        for (list_node = function->parameters->head; list_node != NULL; list_node = list_node->next)
+            describe_expression(descriptions, list_node->data);
+        describe_block(descriptions, function->body);
+        break;
+    case CALL_EXPRESSION:
+        call_exp = (call_expression_t *) exp;
+        describe_expression(descriptions, call_exp->function);
+        for (list_node = call_exp->arguments->head; list_node != NULL; list_node = list_node->next)
+            describe_expression(descriptions, list_node->data);
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+describe_statement(cm_array_list *descriptions, statement_t *statement)
+{
+    letstatement_t *let_stmt;
+    switch (statement->statement_type) {
+    case LET_STATEMENT:
+        let_stmt = (letstatement_t *) statement;
+        describe_expression(descriptions, let_stmt->value);
+        describe_expression(descriptions, (expression_t *) let_stmt->name);
+        break;
+    case RETURN_STATEMENT:
+        describe_expression(descriptions, ((return_statement_t *) statement)->return_value);
+        break;
+    case EXPRESSION_STATEMENT:
+        describe_expression(descriptions, ((expression_statement_t *) statement)->expression);
+        break;
+    case BLOCK_STATEMENT:
+        describe_block(descriptions, (block_statement_t *) statement);
+        break;
+    }
+}
+
+static char *
+resolve(resolver_t *resolver, const char *input)
+{
+    lexer_t *lexer = lexer_init(input);
+    parser_t *parser = parser_init(lexer);
+    program_t *program = parse_program(parser);
+    test(parser->errors == NULL, "Failed to parse %s\n", input);
+    resolve_program(resolver, program);
+    cm_array_list *descriptions = cm_array_list_init(16, free);
+    for (size_t i = 0; i < program->nstatements; i++)
+        describe_statement(descriptions, program->statements[i]);
+    char *description = cm_array_string_list_join(descriptions, " ");
+    cm_array_list_free(descriptions);
+    program_free(program);
+    parser_free(parser);
+    return description;
+}
+
+static void
+test_resolve(void)
+{
+    typedef struct testcase {
+        const char *input;
+        const char *expected;
+    } testcase;
+    testcase tests[] = {
+        {"let a = 1; let b = 2; b + a", "a@0:0 b@0:1 b@0:1 a@0:0"},
+        {"let a = 1; let a = a + 1; a", "a@0:0 a@0:0 a@0:0 a@0:0"},
+        {"let a = 1; let f = fn(x, y) { let z = x; x + y + z + a }",
+            "a@0:0 fn/3 x@0:0 y@0:1 x@0:0 z@0:2 x@0:0 y@0:1 z@0:2 a@1:0 f@0:1"},
+        {"let f = fn(x) { fn(y) { fn() { x + y } } }",
+            "fn/1 x@0:0 fn/1 y@0:0 fn/0 x@2:0 y@1:0 f@0:0"},
+        {"let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) } }",
+            "fn/1 n@0:0 n@0:0 n@0:0 fib@1:0 n@0:0 fib@0:0"},
+        {"fn() { let even = fn(n) { odd(n) }; let odd = fn(n) { even(n) }; }",
+            "fn/2 fn/1 n@0:0 odd@1:1 n@0:0 even@0:0 fn/1 n@0:0 even@1:0 n@0:0 odd@0:1"},
+        {"let x = 1; fn() { let x = x + 1; x }", "x@0:0 fn/1 x@1:0 x@0:0 x@0:0"},
+        {"fn() { while (true) { let i = 1; } i }", "fn/1 i@0:0 i@0:0"},
+        {"fn() { len(g) }; let g = 1", "fn/0 len@1:0 g@1:1 g@0:1"}
+    };
+    print_test_separator_line();
+    printf("Testing identifier resolution\n");
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        printf("Testing resolution of %s\n", tests[i].input);
+        resolver_t *resolver = resolver_init();
+        char *actual = resolve(resolver, tests[i].input);
+        test(strcmp(actual, tests[i].expected) == 0, "Expected %s, got %s\n",
+            tests[i].expected, actual);
+        free(actual);
+        resolver_free(resolver);
+    }
+}
+
+/* the REPL resolves every line with the globals of the lines before */
+static void
+test_resolve_globals_across_programs(void)
+{
+    print_test_separator_line();
+    printf("Testing resolution of globals across programs\n");
+    resolver_t *resolver = resolver_init();
+    const char *inputs[] = {"let a = 1; let f = fn() { b }", "let b = 2; a + b"};
+    const char *expected[] = {"a@0:0 fn/0 b@1:1 f@0:2", "b@0:1 a@0:0 b@0:1"};
+    for (size_t i = 0; i < 2; i++) {
+        char *actual = resolve(resolver, inputs[i]);
+        test(strcmp(actual, expected[i]) == 0, "Expected %s, got %s\n", expected[i], actual);
+        free(actual);
+    }
+    resolver_free(resolver);
+}
+
+int
+main(int argc, char **argv)
+{
+    test_resolve();
+    test_resolve_globals_across_programs();
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 #include "builtins.h"
 #include "compiler.h"
+#include "jit.h"
 #include "object.h"
 #include "opcode.h"
 #include "vm.h"
@@ -23,21 +24,22 @@ get_err_msg(const char *s, ...)
 static frame_t *
 get_current_frame(vm_t *vm)
 {
-    return vm->frames[vm->frame_index - 1];
+    return &vm->frames[vm->frame_index - 1];
 }
 
-static void
-push_frame(vm_t *vm, frame_t *frame)
+static frame_t *
+push_frame(vm_t *vm, monkey_compiled_fn_t *fn, size_t bp)
 {
-    vm->frames[vm->frame_index] = frame;
-    vm->frame_index++;
+    frame_t *frame = &vm->frames[vm->frame_index++];
+    frame_init(frame, fn, bp);
+    return frame;
 }
 
 static frame_t *
 pop_frame(vm_t *vm)
 {
     vm->frame_index--;
-    return vm->frames[vm->frame_index];
+    return &vm->frames[vm->frame_index];
 }
 
 vm_t *
@@ -47,15 +49,22 @@ vm_init(bytecode_t *bytecode)
     vm = malloc(sizeof(*vm));
     if (vm == NULL)
         err(EXIT_FAILURE, "malloc failed");
-    monkey_compiled_fn_t *main_fn = create_monkey_compiled_fn(bytecode->instructions, 0, 0);
-    frame_t *main_frame = frame_init(main_fn, 0);
-    vm->frames[0] = main_frame;
-    vm->frame_index = 1;
+    /*
+     * The top level code runs as a function which borrows the bytecode's
+     * instructions, it is never counted or freed.
+     */
+    vm->main_fn = (monkey_compiled_fn_t) {
+        {MONKEY_COMPILED_FUNCTION, 0, MONKEY_REFCOUNT_IMMORTAL},
+        bytecode->instructions, 0, 0, decode_instructions(bytecode->instructions)
+    };
+    vm->frame_index = 0;
+    push_frame(vm, &vm->main_fn, 0);
     vm->constants = bytecode->constants_pool;
     vm->sp = 0;
+    vm->jit_threshold = 0;
+    vm->region = NULL;
     for (size_t i = 0; i < GLOBALS_SIZE; i++)
         vm->globals[i] = NULL;
-    free(main_fn);
     return vm;
 }
 
@@ -65,30 +74,53 @@ vm_init_with_state(bytecode_t *bytecode, monkey_object_t *globals[GLOBALS_SIZE])
     vm_t *vm = vm_init(bytecode);
     for (size_t i = 0; i < GLOBALS_SIZE; i++) {
         if (globals[i] != NULL)
-            vm->globals[i] = copy_monkey_object(globals[i]);
+            vm->globals[i] = retain_monkey_object(globals[i]);
         else
             break;
     }
     return vm;
 }
 
+/*
+ * Objects in the region are not released one by one, unmapping the region
+ * frees them all at once. Objects from outside which are referenced by
+ * objects in the region, such as interned strings or compiled function
+ * constants stored in arrays or hashes built during the run, keep the
+ * references those objects had.
+ */
 void
 vm_free(vm_t *vm)
 {
-    for (size_t i = 0; i < vm->sp; i++)
-        free_monkey_object(vm->stack[i]);
+    for (size_t i = 0; i < vm->sp; i++) {
+        if (vm->region == NULL || !cm_region_contains(vm->region, vm->stack[i]))
+            release_monkey_object(vm->stack[i]);
+    }
     for (size_t i = 0; i < GLOBALS_SIZE; i++) {
-        if (vm->globals[i] != NULL)
-            free_monkey_object(vm->globals[i]);
-        else
+        if (vm->globals[i] == NULL)
             break;
+        if (vm->region == NULL || !cm_region_contains(vm->region, vm->globals[i]))
+            release_monkey_object(vm->globals[i]);
     }
-    for (size_t i = 0; i < vm->frame_index; i++) {
-        frame_free(vm->frames[i]);
-    }
+    if (vm->region != NULL)
+        cm_region_free(vm->region);
+    decoded_instructions_free(vm->main_fn.decoded);
     free(vm);
 }
 
+/*
+ * Makes vm_run allocate the objects of the program from a region of its
+ * own, which vm_free unmaps in one go instead of freeing every object left
+ * in the globals. huge_pages asks the kernel to back the region with
+ * transparent huge pages. Only for a VM which runs a whole program once,
+ * the REPL keeps its globals across runs.
+ */
+void
+vm_use_region(vm_t *vm, _Bool huge_pages)
+{
+    if (vm->region == NULL)
+        vm->region = cm_region_init(huge_pages);
+}
+
 monkey_object_t *
 vm_last_popped_stack_elem(vm_t *vm)
 {
@@ -96,7 +128,7 @@ vm_last_popped_stack_elem(vm_t *vm)
 }
 
 static vm_error_t
-vm_push(vm_t *vm, monkey_object_t *obj, _Bool copy)
+vm_push(vm_t *vm, monkey_object_t *obj, _Bool retain)
 {
     vm_error_t error = {VM_ERROR_NONE, NULL};
     if (vm->sp >= STACKSIZE) {
@@ -105,7 +137,7 @@ vm_push(vm_t *vm, monkey_object_t *obj, _Bool copy)
             STACKSIZE);
         return error;
     }
-    vm->stack[vm->sp++] = copy? copy_monkey_object(obj): obj;
+    vm->stack[vm->sp++] = retain? retain_monkey_object(obj): obj;
     return error;
 }
 
@@ -117,6 +149,17 @@ vm_pop(vm_t *vm)
     return obj;
 }
 
+/*
+ * Pop and release everything above new_sp, used to discard the callee,
+ * its arguments and locals when a call completes.
+ */
+static void
+vm_unwind(vm_t *vm, size_t new_sp)
+{
+    while (vm->sp > new_sp)
+        release_monkey_object(vm->stack[--vm->sp]);
+}
+
 static monkey_object_t *
 get_constant(vm_t *vm, size_t const_index)
 {
@@ -148,15 +191,13 @@ execute_binary_int_op(vm_t *vm, opcode_t op, long leftval, long rightval)
         error.msg = get_err_msg("opcode %s not supported for integer operands", op_def.name);
         return error;
     }
-    monkey_object_t *result_obj = (monkey_object_t *) create_monkey_int(result);
-    vm_push(vm, result_obj, false);
+    vm_push(vm, create_monkey_int_object(result), false);
     return error;
 }
 
 static vm_error_t
 execute_binary_string_op(vm_t *vm, opcode_t op, monkey_string_t *leftval, monkey_string_t *rightval)
 {
-    char *result = NULL;
     vm_error_t error = {VM_ERROR_NONE, NULL};
     opcode_definition_t op_def;
     if (op != OPADD) {
@@ -165,11 +206,7 @@ execute_binary_string_op(vm_t *vm, opcode_t op, monkey_string_t *leftval, monkey
         error.msg = get_err_msg("opcode %s not support for string operands", op_def.name);
         return error;
     }
-    if ((asprintf(&result, "%s%s", leftval->value, rightval->value)) == -1)
-        err(EXIT_FAILURE, "malloc failed");
-    monkey_object_t *result_obj = (monkey_object_t *) create_monkey_string(result, leftval->length + rightval->length);
-    free(result);
-    vm_push(vm, result_obj, false);
+    vm_push(vm, (monkey_object_t *) concat_monkey_strings(leftval, rightval), false);
     return error;
 }
 
@@ -178,21 +215,23 @@ execute_binary_op(vm_t *vm, opcode_t op)
 {
     monkey_object_t *right = vm_pop(vm);
     monkey_object_t *left = vm_pop(vm);
+    monkey_object_type left_type = get_monkey_object_type(left);
+    monkey_object_type right_type = get_monkey_object_type(right);
     vm_error_t vm_err;
-    if (left->type == MONKEY_INT && right->type == MONKEY_INT) {
-        long leftval = ((monkey_int_t *) left)->value;
-        long rightval = ((monkey_int_t *) right)->value;
+    if (left_type == MONKEY_INT && right_type == MONKEY_INT) {
+        long leftval = get_monkey_int_value(left);
+        long rightval = get_monkey_int_value(right);
         vm_err = execute_binary_int_op(vm, op, leftval, rightval);
-    } else if (left->type == MONKEY_STRING && right->type == MONKEY_STRING) {
+    } else if (left_type == MONKEY_STRING && right_type == MONKEY_STRING) {
         vm_err = execute_binary_string_op(vm, op, (monkey_string_t *) left, (monkey_string_t *) right);
     }else {
         vm_err.code = VM_UNSUPPORTED_OPERAND;
         opcode_definition_t op_def = opcode_definition_lookup(op);
         vm_err.msg = get_err_msg("'%s' operation not supported with types %s and %s",
-            op_def.desc, get_type_name(left->type), get_type_name(right->type));
+            op_def.desc, get_type_name(left_type), get_type_name(right_type));
     }
-    free_monkey_object(left);
-    free_monkey_object(right);
+    release_monkey_object(left);
+    release_monkey_object(right);
     return vm_err;
 }
 
@@ -229,19 +268,21 @@ static vm_error_t
 execute_bang_operator(vm_t *vm)
 {
     monkey_object_t *operand = vm_pop(vm);
+    monkey_object_type operand_type = get_monkey_object_type(operand);
     monkey_bool_t *bool_operand;
     vm_error_t vm_err;
-    if (operand->type != MONKEY_BOOL && operand->type != MONKEY_NULL) {
+    if (operand_type != MONKEY_BOOL && operand_type != MONKEY_NULL) {
         vm_err.code = VM_UNSUPPORTED_OPERAND;
         vm_err.msg = get_err_msg("'!' operator not supported for %s type operands",
-            get_type_name(operand->type));
+            get_type_name(operand_type));
         return vm_err;
     }
-    if (operand->type == MONKEY_NULL)
+    if (operand_type == MONKEY_NULL)
         bool_operand = create_monkey_bool(false);
     else
         bool_operand = (monkey_bool_t *) operand;
     vm_push(vm, (monkey_object_t *) create_monkey_bool(!bool_operand->value), false);
+    release_monkey_object(operand);
     vm_err.code = VM_ERROR_NONE;
     vm_err.msg = NULL;
     return vm_err;
@@ -252,30 +293,28 @@ execute_minus_operator(vm_t *vm)
 {
     monkey_object_t *operand = vm_pop(vm);
     vm_error_t vm_err;
-    if (operand->type != MONKEY_INT) {
+    if (get_monkey_object_type(operand) != MONKEY_INT) {
         vm_err.code = VM_UNSUPPORTED_OPERAND;
         vm_err.msg = get_err_msg("'-' operator not supported for %s type operands",
-            get_type_name(operand->type));
+            get_type_name(get_monkey_object_type(operand)));
         return vm_err;
     }
-    monkey_int_t *int_operand = (monkey_int_t *) operand;
-    monkey_int_t *result = create_monkey_int(-int_operand->value);
-    vm_push(vm, (monkey_object_t *) result, false);
-    free_monkey_object(operand);
+    vm_push(vm, create_monkey_int_object(-get_monkey_int_value(operand)), false);
+    release_monkey_object(operand);
     vm_err.code = VM_ERROR_NONE;
     vm_err.msg = NULL;
     return vm_err;
 }
 
 static vm_error_t
-execute_array_index_expression(vm_t *vm, monkey_array_t *left, monkey_int_t *index)
+execute_array_index_expression(vm_t *vm, monkey_array_t *left, long index)
 {
     vm_error_t vm_err = {VM_ERROR_NONE, NULL};
-    if (index->value < 0 || index->value >= left->elements->length) {
+    if (index < 0 || index >= get_monkey_array_length(left)) {
         vm_push(vm, (monkey_object_t *) create_monkey_null(), false);
         return vm_err;
     }
-    vm_push(vm, cm_array_list_get(left->elements, index->value), true);
+    vm_push(vm, get_monkey_array_element(left, index), true);
     return vm_err;
 }
 
@@ -295,21 +334,40 @@ static vm_error_t
 execute_index_expression(vm_t *vm, monkey_object_t *left, monkey_object_t *index)
 {
     vm_error_t vm_err;
-    if (left->type == MONKEY_ARRAY) {
-        if (index->type != MONKEY_INT) {
+    monkey_object_type left_type = get_monkey_object_type(left);
+    if (left_type == MONKEY_ARRAY) {
+        if (get_monkey_object_type(index) != MONKEY_INT) {
             vm_err.code = VM_UNSUPPORTED_OPERATOR;
             vm_err.msg = get_err_msg("unsupported index operator type %s for array object",
-                get_type_name(index->type));
+                get_type_name(get_monkey_object_type(index)));
             return vm_err;
         }
-        return execute_array_index_expression(vm, (monkey_array_t *) left, (monkey_int_t *) index);
-    } else if (left->type == MONKEY_HASH)
+        return execute_array_index_expression(vm, (monkey_array_t *) left,
+            get_monkey_int_value(index));
+    } else if (left_type == MONKEY_HASH)
         return execute_hash_index_expression(vm, (monkey_hash_t *) left, index);
     vm_err.code = VM_UNSUPPORTED_OPERATOR;
-    vm_err.msg = get_err_msg("index operator not supported for %s", get_type_name(left->type));
+    vm_err.msg = get_err_msg("index operator not supported for %s", get_type_name(left_type));
     return vm_err;
 }
 
+static vm_error_t
+execute_slice_expression(vm_t *vm, monkey_object_t *left, monkey_object_t *start,
+    monkey_object_t *end)
+{
+    vm_error_t vm_err = {VM_ERROR_NONE, NULL};
+    monkey_object_t *slice = slice_monkey_object(left, start, end);
+    if (slice == NULL) {
+        vm_err.code = VM_UNSUPPORTED_OPERATOR;
+        vm_err.msg = get_err_msg("slice operator not supported for %s[%s:%s]",
+            get_type_name(get_monkey_object_type(left)),
+            get_type_name(get_monkey_object_type(start)),
+            get_type_name(get_monkey_object_type(end)));
+        return vm_err;
+    }
+    return vm_push(vm, slice, false);
+}
+
 static vm_error_t
 execute_comparison_op(vm_t *vm, opcode_t op)
 {
@@ -317,11 +375,13 @@ execute_comparison_op(vm_t *vm, opcode_t op)
     opcode_definition_t op_def;
     monkey_object_t *right = vm_pop(vm);
     monkey_object_t *left = vm_pop(vm);
-    if (left->type == MONKEY_INT && right->type == MONKEY_INT) {
-        long leftval = ((monkey_int_t *) left)->value;
-        long rightval = ((monkey_int_t *) right)->value;
+    monkey_object_type left_type = get_monkey_object_type(left);
+    monkey_object_type right_type = get_monkey_object_type(right);
+    if (left_type == MONKEY_INT && right_type == MONKEY_INT) {
+        long leftval = get_monkey_int_value(left);
+        long rightval = get_monkey_int_value(right);
         error = execute_integer_comparison(vm, op, leftval, rightval);
-    } else if (left->type == MONKEY_BOOL && right->type == MONKEY_BOOL) {
+    } else if (left_type == MONKEY_BOOL && right_type == MONKEY_BOOL) {
         _Bool result = false;
         switch (op) {
         case OPGREATERTHAN:
@@ -345,18 +405,18 @@ execute_comparison_op(vm_t *vm, opcode_t op)
     } else {
         error.code = VM_UNSUPPORTED_OPERAND;
         error.msg = get_err_msg("Unsupported operand types %s and %s",
-            get_type_name(left->type), get_type_name(right->type));
+            get_type_name(left_type), get_type_name(right_type));
     }
 RETURN:
-    free_monkey_object(left);
-    free_monkey_object(right);
+    release_monkey_object(left);
+    release_monkey_object(right);
     return error;
 }
 
 static _Bool
 is_truthy(monkey_object_t *condition)
 {
-    switch (condition->type) {
+    switch (get_monkey_object_type(condition)) {
     case MONKEY_BOOL:
         return ((monkey_bool_t *) condition)->value;
     case MONKEY_NULL:
@@ -369,7 +429,7 @@ is_truthy(monkey_object_t *condition)
 static cm_array_list *
 build_array(vm_t *vm, size_t array_size)
 {
-    cm_array_list *list = cm_array_list_init(array_size, free_monkey_object);
+    cm_array_list *list = cm_array_list_init(array_size, release_monkey_object);
     for (size_t i = vm->sp - array_size; i < vm->sp; i++) {
         monkey_object_t *obj = (monkey_object_t *) vm->stack[i];
         cm_array_list_add(list, obj);
@@ -382,7 +442,7 @@ static cm_hash_table *
 build_hash(vm_t *vm, size_t size)
 {
     cm_hash_table *table = cm_hash_table_init(monkey_object_hash,
-        monkey_object_equals, free_monkey_object, free_monkey_object);
+        monkey_object_equals, release_monkey_object, release_monkey_object);
     for (size_t i = vm->sp - size; i < vm->sp; i += 2) {
         monkey_object_t *key = (monkey_object_t *) vm->stack[i];
         monkey_object_t *value = (monkey_object_t *) vm->stack[i + 1];
@@ -392,6 +452,10 @@ build_hash(vm_t *vm, size_t size)
     return table;
 }
 
+#ifdef VM_JIT
+static void jit_count_call(vm_t *, monkey_compiled_fn_t *);
+#endif
+
 static vm_error_t
 call_function(vm_t *vm, monkey_compiled_fn_t *callee, size_t num_args)
 {
@@ -402,12 +466,29 @@ call_function(vm_t *vm, monkey_compiled_fn_t *callee, size_t num_args)
             callee->num_args, num_args);
         return vm_err;
     }
-    frame_t *new_frame = frame_init(callee, vm->sp - num_args);
-    push_frame(vm, new_frame);
-    vm->sp = new_frame->bp + callee->num_locals;
+    if (vm->frame_index >= MAX_FRAMES) {
+        vm_err.code = VM_STACKOVERFLOW;
+        vm_err.msg = get_err_msg("Stackoverflow error: exceeded max call depth of %d",
+            MAX_FRAMES);
+        return vm_err;
+    }
+    if (vm->sp - num_args + callee->num_locals >= STACKSIZE) {
+        vm_err.code = VM_STACKOVERFLOW;
+        vm_err.msg = get_err_msg("Stackoverflow error: execeeded max stack size of %d",
+            STACKSIZE);
+        return vm_err;
+    }
+    if (callee->decoded == NULL)
+        callee->decoded = decode_instructions(callee->instructions);
+#ifdef VM_JIT
+    if (vm->jit_threshold != 0 && callee->jit == NULL)
+        jit_count_call(vm, callee);
+#endif
+    frame_t *new_frame = push_frame(vm, callee, vm->sp - num_args);
+    while (vm->sp < new_frame->bp + callee->num_locals)
+        vm->stack[vm->sp++] = NULL;
     vm_err.code = VM_ERROR_NONE;
     vm_err.msg = NULL;
-    free_monkey_object(callee);
     return vm_err;
 }
 
@@ -422,6 +503,7 @@ call_builtin(vm_t *vm, monkey_builtin_t *callee, size_t num_args)
     }
     monkey_object_t *result = callee->function(args);
     cm_list_free(args, NULL);
+    vm_unwind(vm, vm->sp - num_args - 1);
     vm_push(vm, result, false);
     vm_err.code = VM_ERROR_NONE;
     vm_err.msg = NULL;
@@ -433,7 +515,7 @@ execute_call(vm_t *vm, size_t num_args)
 {
     monkey_object_t *callee = vm->stack[vm->sp - 1 - num_args];
     vm_error_t vm_err;
-    switch (callee->type) {
+    switch (get_monkey_object_type(callee)) {
     case MONKEY_COMPILED_FUNCTION:
         vm_err = call_function(vm, (monkey_compiled_fn_t *) callee, num_args);
         break;
@@ -448,181 +530,891 @@ execute_call(vm_t *vm, size_t num_args)
     return vm_err;
 }
 
-vm_error_t
-vm_run(vm_t *vm)
+#ifdef VM_JIT
+/*
+ * Slow paths of the JIT compiled code. They work on the VM's stack through
+ * vm->sp like the execute_* helpers, which the generated code keeps in sync
+ * around every call.
+ */
+static int
+jit_status(jit_state_t *state, vm_error_t vm_err)
+{
+    if (vm_err.code == VM_ERROR_NONE)
+        return JIT_OK;
+    state->err = vm_err;
+    return JIT_ERROR;
+}
+
+static int
+jit_execute(jit_state_t *state, size_t op, size_t operand)
+{
+    vm_t *vm = state->vm;
+    vm_error_t vm_err = {VM_ERROR_NONE, NULL};
+    monkey_object_t *left, *index, *right;
+
+    switch (op) {
+    case OPCONSTANT:
+        vm_err = vm_push(vm, get_constant(vm, operand), true);
+        break;
+    case OPADD:
+    case OPSUB:
+    case OPMUL:
+    case OPDIV:
+        vm_err = execute_binary_op(vm, op);
+        break;
+    case OPPOP:
+        release_monkey_object(state->top);
+        state->top = vm_pop(vm);
+        break;
+    case OPTRUE:
+        vm_err = vm_push(vm, (monkey_object_t *) create_monkey_bool(true), false);
+        break;
+    case OPFALSE:
+        vm_err = vm_push(vm, (monkey_object_t *) create_monkey_bool(false), false);
+        break;
+    case OPNULL:
+        vm_err = vm_push(vm, (monkey_object_t *) create_monkey_null(), false);
+        break;
+    case OPEQUAL:
+    case OPNOTEQUAL:
+    case OPGREATERTHAN:
+        vm_err = execute_comparison_op(vm, op);
+        break;
+    case OPMINUS:
+        vm_err = execute_minus_operator(vm);
+        break;
+    case OPBANG:
+        vm_err = execute_bang_operator(vm);
+        break;
+    case OPSETGLOBAL:
+        release_monkey_object(state->top);
+        state->top = vm_pop(vm);
+        left = vm->globals[operand];
+        vm->globals[operand] = retain_monkey_object(state->top);
+        release_monkey_object(left);
+        break;
+    case OPGETGLOBAL:
+        vm_err = vm_push(vm, vm->globals[operand], true);
+        break;
+    case OPSETLOCAL:
+        release_monkey_object(state->top);
+        state->top = vm_pop(vm);
+        left = state->locals[operand];
+        state->locals[operand] = retain_monkey_object(state->top);
+        release_monkey_object(left);
+        break;
+    case OPGETLOCAL:
+        vm_err = vm_push(vm, state->locals[operand], true);
+        break;
+    case OPARRAY:
+        left = (monkey_object_t *) create_monkey_array(build_array(vm, operand));
+        vm_err = vm_push(vm, left, false);
+        break;
+    case OPHASH:
+        left = (monkey_object_t *) create_monkey_hash(build_hash(vm, operand));
+        vm_err = vm_push(vm, left, false);
+        break;
+    case OPINDEX:
+        index = vm_pop(vm);
+        left = vm_pop(vm);
+        vm_err = execute_index_expression(vm, left, index);
+        release_monkey_object(index);
+        release_monkey_object(left);
+        break;
+    case OPSLICE:
+        right = vm_pop(vm);
+        index = vm_pop(vm);
+        left = vm_pop(vm);
+        vm_err = execute_slice_expression(vm, left, index, right);
+        release_monkey_object(right);
+        release_monkey_object(index);
+        release_monkey_object(left);
+        break;
+    case OPGETBUILTIN:
+        vm_err = vm_push(vm, (monkey_object_t *) get_builtins(get_builtins_name(operand)), false);
+        break;
+    default:
+        vm_err.code = VM_UNSUPPORTED_OPERATOR;
+        vm_err.msg = get_err_msg("Unsupported opcode %s", opcode_definitions[op - 1].name);
+        break;
+    }
+    return jit_status(state, vm_err);
+}
+
+static int
+jit_jump_if_false(jit_state_t *state, size_t unused1, size_t unused2)
+{
+    release_monkey_object(state->top);
+    state->top = vm_pop(state->vm);
+    return is_truthy(state->top)? JIT_OK: JIT_JUMP;
+}
+
+static int
+jit_compare_and_jump(jit_state_t *state, size_t op, size_t unused)
+{
+    vm_error_t vm_err = execute_comparison_op(state->vm, op);
+    if (vm_err.code != VM_ERROR_NONE)
+        return jit_status(state, vm_err);
+    return jit_jump_if_false(state, 0, 0);
+}
+
+/*
+ * A JIT compiled callee runs right away, nested in its caller's machine
+ * code, which continues once it has returned. Everything else needs the
+ * interpreter, which resumes the caller at next_ip after the callee returns.
+ */
+static int
+jit_call(jit_state_t *state, size_t num_args, size_t next_ip)
+{
+    vm_t *vm = state->vm;
+    monkey_object_t *callee = vm->stack[vm->sp - 1 - num_args];
+    size_t frame_index = vm->frame_index;
+    jit_state_t callee_state;
+    frame_t *frame;
+    int status;
+
+    get_current_frame(vm)->ip = next_ip;
+    vm_error_t vm_err = execute_call(vm, num_args);
+    if (vm_err.code != VM_ERROR_NONE)
+        return jit_status(state, vm_err);
+    if (get_monkey_object_type(callee) != MONKEY_COMPILED_FUNCTION)
+        return JIT_OK;
+    frame = get_current_frame(vm);
+    if (frame->fn->jit == NULL)
+        return JIT_FRAME_CHANGED;
+    callee_state.vm = vm;
+    callee_state.locals = &vm->stack[frame->bp];
+    callee_state.top = state->top;
+    status = jit_run(frame->fn->jit, &callee_state, 0);
+    state->top = callee_state.top;
+    if (status == JIT_ERROR)
+        state->err = callee_state.err;
+    else if (status == JIT_FRAME_CHANGED && vm->frame_index == frame_index)
+        return JIT_OK;
+    return status;
+}
+
+/* same as VM_RETURN */
+static int
+jit_return_value(jit_state_t *state, size_t has_value, size_t unused)
+{
+    vm_t *vm = state->vm;
+    monkey_object_t *value;
+    frame_t *frame;
+    value = has_value? vm_pop(vm): (monkey_object_t *) create_monkey_null();
+    if (vm->frame_index == 1) {
+        release_monkey_object(state->top);
+        state->top = value;
+        return JIT_DONE;
+    }
+    frame = pop_frame(vm);
+    vm_unwind(vm, frame->bp - 1);
+    vm->stack[vm->sp++] = value;
+    return JIT_FRAME_CHANGED;
+}
+
+static const jit_helpers_t jit_helpers = {
+    jit_execute,
+    jit_jump_if_false,
+    jit_compare_and_jump,
+    jit_call,
+    jit_return_value
+};
+
+static void
+jit_count_call(vm_t *vm, monkey_compiled_fn_t *callee)
+{
+    if (++callee->calls >= vm->jit_threshold)
+        callee->jit = jit_compile(callee, vm->constants, &jit_helpers);
+}
+#endif
+
+/*
+ * vm_run dispatches with computed gotos (direct threading) when built with a
+ * compiler supporting labels as values, so that every opcode handler ends in
+ * its own indirect jump. Building with -DVM_SWITCH_DISPATCH selects the
+ * portable switch based loop instead. Both variants share the handlers below,
+ * which keep the instruction pointer, the instruction base and the stack
+ * pointer in locals; the VM's copy of these is only synchronised around calls
+ * into helpers which need it.
+ */
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_THREADED_DISPATCH
+#endif
+
+/*
+ * Quickened opcodes. The first time a generic instruction executes it
+ * rewrites itself in the decoded stream into a variant specialised for the
+ * operand types it saw. The specialised handler only checks a cheap guard;
+ * if that fails it rewrites the instruction back to the generic opcode,
+ * which handles every type and may quicken it again later. These opcodes
+ * only ever appear in decoded streams.
+ */
+enum quickened_opcode {
+    OPADD_INT = 128,
+    OPSUB_INT,
+    OPMUL_INT,
+    OPGREATERTHAN_INT,
+    OPEQUAL_INT,
+    OPNOTEQUAL_INT,
+    OPINDEX_ARRAY,
+    OPINDEX_HASH,
+    OPCALL_COMPILED,
+    OPCALL_BUILTIN
+};
+
+#define VM_QUICKEN(quick_op) (ins[ip - 1] = (quick_op))
+#define VM_DEOPTIMIZE(generic_op) (ins[ip - 1] = op = (generic_op))
+
+/*
+ * Building with -DVM_OPCODE_STATS counts how often each opcode is executed
+ * right after each other opcode, see vm_print_opcode_stats. Frequent pairs
+ * are the candidates for new superinstructions in the compiler.
+ */
+#ifdef VM_OPCODE_STATS
+static unsigned long opcode_pair_counts[256][256];
+static size_t last_opcode;
+
+#define VM_COUNT_OPCODE(op) do {            \
+    opcode_pair_counts[last_opcode][op]++;  \
+    last_opcode = (op);                     \
+} while (0)
+
+typedef struct opcode_pair_count_t {
+    size_t first;
+    size_t second;
+    unsigned long count;
+} opcode_pair_count_t;
+
+static const char *quickened_opcode_names[] = {
+    "OPADD_INT",
+    "OPSUB_INT",
+    "OPMUL_INT",
+    "OPGREATERTHAN_INT",
+    "OPEQUAL_INT",
+    "OPNOTEQUAL_INT",
+    "OPINDEX_ARRAY",
+    "OPINDEX_HASH",
+    "OPCALL_COMPILED",
+    "OPCALL_BUILTIN"
+};
+
+static const char *
+get_opcode_name(size_t op)
+{
+    if (op == DECODED_HALT)
+        return "HALT";
+    if (op <= OPCODE_COUNT)
+        return opcode_definitions[op - 1].name;
+    if (op >= OPADD_INT && op <= OPCALL_BUILTIN)
+        return quickened_opcode_names[op - OPADD_INT];
+    return "UNKNOWN";
+}
+
+static int
+compare_opcode_pair_counts(const void *a, const void *b)
+{
+    const opcode_pair_count_t *p1 = a;
+    const opcode_pair_count_t *p2 = b;
+    if (p1->count == p2->count)
+        return 0;
+    return p1->count < p2->count? 1: -1;
+}
+
+void
+vm_print_opcode_stats(FILE *out, size_t max_pairs)
 {
-    size_t const_index, jmp_pos, sym_index, array_size, hash_size;
+    opcode_pair_count_t *pairs;
+    size_t npairs = 0;
+    pairs = malloc(sizeof(*pairs) * 256 * 256);
+    if (pairs == NULL)
+        err(EXIT_FAILURE, "malloc failed");
+    for (size_t i = 0; i < 256; i++) {
+        for (size_t j = 0; j < 256; j++) {
+            if (opcode_pair_counts[i][j] == 0)
+                continue;
+            pairs[npairs].first = i;
+            pairs[npairs].second = j;
+            pairs[npairs++].count = opcode_pair_counts[i][j];
+        }
+    }
+    qsort(pairs, npairs, sizeof(*pairs), compare_opcode_pair_counts);
+    fprintf(out, "%12s  %s\n", "count", "opcode pair");
+    for (size_t i = 0; i < npairs && i < max_pairs; i++)
+        fprintf(out, "%12lu  %s %s\n", pairs[i].count,
+            get_opcode_name(pairs[i].first), get_opcode_name(pairs[i].second));
+    free(pairs);
+}
+#else
+#define VM_COUNT_OPCODE(op)
+#endif
+
+#ifdef VM_THREADED_DISPATCH
+#define VM_TARGET(op) TARGET_##op:
+#define VM_DISPATCH() do {                  \
+    op = ins[ip++];                         \
+    VM_COUNT_OPCODE(op);                    \
+    goto *dispatch_table[op];               \
+} while (0)
+#else
+#define VM_TARGET(op) case op:
+#define VM_DISPATCH() continue
+#endif
+
+#define VM_READ_OPERAND() (ins[ip++])
+
+#define VM_PUSH(obj) do {                   \
+    if (sp >= STACKSIZE)                    \
+        goto stack_overflow;                \
+    vm->stack[sp++] = (obj);                \
+} while (0)
+
+/* the last popped value is kept alive until the next pop */
+#define VM_POP_TOP() do {                   \
+    release_monkey_object(top);             \
+    top = vm->stack[--sp];                  \
+} while (0)
+
+#define VM_SAVE_STATE() do {                \
+    vm->sp = sp;                            \
+    frame->ip = ip;                         \
+} while (0)
+
+/* frames of JIT compiled functions run as machine code */
+#ifdef VM_JIT
+#define VM_ENTER_JIT() do {                 \
+    if (frame->fn->jit != NULL)             \
+        goto run_jit;                       \
+} while (0)
+#else
+#define VM_ENTER_JIT()
+#endif
+
+#define VM_LOAD_STATE() do {                \
+    sp = vm->sp;                            \
+    frame = get_current_frame(vm);          \
+    ins = frame->fn->decoded->words;        \
+    ip = frame->ip;                         \
+    VM_ENTER_JIT();                         \
+} while (0)
+
+/*
+ * Return to the caller, discarding the callee together with its arguments
+ * and locals. A return at the top level ends the program.
+ */
+#define VM_RETURN(value) do {               \
+    obj = (value);                          \
+    if (vm->frame_index == 1) {             \
+        release_monkey_object(top);         \
+        top = obj;                          \
+        goto done;                          \
+    }                                       \
+    frame = pop_frame(vm);                  \
+    vm->sp = sp;                            \
+    vm_unwind(vm, frame->bp - 1);           \
+    vm->stack[vm->sp++] = obj;              \
+    VM_LOAD_STATE();                        \
+} while (0)
+
+#define VM_CHECK_ERROR() do {               \
+    if (vm_err.code != VM_ERROR_NONE) {     \
+        release_monkey_object(top);         \
+        return vm_err;                      \
+    }                                       \
+} while (0)
+
+static vm_error_t
+vm_execute(vm_t *vm)
+{
+#ifdef VM_THREADED_DISPATCH
+    static void *dispatch_table[256] = {
+        [0 ... 255] = &&unsupported_opcode,
+        [DECODED_HALT] = &&done,
+        [OPCONSTANT] = &&TARGET_OPCONSTANT,
+        [OPADD] = &&TARGET_OPADD,
+        [OPSUB] = &&TARGET_OPSUB,
+        [OPMUL] = &&TARGET_OPMUL,
+        [OPDIV] = &&TARGET_OPDIV,
+        [OPPOP] = &&TARGET_OPPOP,
+        [OPTRUE] = &&TARGET_OPTRUE,
+        [OPFALSE] = &&TARGET_OPFALSE,
+        [OPEQUAL] = &&TARGET_OPEQUAL,
+        [OPNOTEQUAL] = &&TARGET_OPNOTEQUAL,
+        [OPGREATERTHAN] = &&TARGET_OPGREATERTHAN,
+        [OPMINUS] = &&TARGET_OPMINUS,
+        [OPBANG] = &&TARGET_OPBANG,
+        [OPJMPFALSE] = &&TARGET_OPJMPFALSE,
+        [OPJMP] = &&TARGET_OPJMP,
+        [OPNULL] = &&TARGET_OPNULL,
+        [OPSETGLOBAL] = &&TARGET_OPSETGLOBAL,
+        [OPGETGLOBAL] = &&TARGET_OPGETGLOBAL,
+        [OPARRAY] = &&TARGET_OPARRAY,
+        [OPHASH] = &&TARGET_OPHASH,
+        [OPINDEX] = &&TARGET_OPINDEX,
+        [OPCALL] = &&TARGET_OPCALL,
+        [OPRETURNVALUE] = &&TARGET_OPRETURNVALUE,
+        [OPRETURN] = &&TARGET_OPRETURN,
+        [OPSETLOCAL] = &&TARGET_OPSETLOCAL,
+        [OPGETLOCAL] = &&TARGET_OPGETLOCAL,
+        [OPGETBUILTIN] = &&TARGET_OPGETBUILTIN,
+        [OPSLICE] = &&TARGET_OPSLICE,
+        [OPGETLOCAL2] = &&TARGET_OPGETLOCAL2,
+        [OPGETLOCALCONSTANT] = &&TARGET_OPGETLOCALCONSTANT,
+        [OPADDLOCALS] = &&TARGET_OPADDLOCALS,
+        [OPADDLOCALCONSTANT] = &&TARGET_OPADDLOCALCONSTANT,
+        [OPSUBLOCALCONSTANT] = &&TARGET_OPSUBLOCALCONSTANT,
+        [OPGREATERTHANJMPFALSE] = &&TARGET_OPGREATERTHANJMPFALSE,
+        [OPEQUALJMPFALSE] = &&TARGET_OPEQUALJMPFALSE,
+        [OPADD_INT] = &&TARGET_OPADD_INT,
+        [OPSUB_INT] = &&TARGET_OPSUB_INT,
+        [OPMUL_INT] = &&TARGET_OPMUL_INT,
+        [OPGREATERTHAN_INT] = &&TARGET_OPGREATERTHAN_INT,
+        [OPEQUAL_INT] = &&TARGET_OPEQUAL_INT,
+        [OPNOTEQUAL_INT] = &&TARGET_OPNOTEQUAL_INT,
+        [OPINDEX_ARRAY] = &&TARGET_OPINDEX_ARRAY,
+        [OPINDEX_HASH] = &&TARGET_OPINDEX_HASH,
+        [OPCALL_COMPILED] = &&TARGET_OPCALL_COMPILED,
+        [OPCALL_BUILTIN] = &&TARGET_OPCALL_BUILTIN
+    };
+#endif
+    size_t index, count;
     vm_error_t vm_err;
     opcode_definition_t op_def;
     monkey_object_t *top = NULL;
-    cm_array_list *array_list;
-    cm_hash_table *table;
-    monkey_array_t *array_obj;
-    monkey_hash_t *hash_obj;
-    monkey_object_t *index;
+    monkey_object_t *obj;
     monkey_object_t *left;
-    monkey_object_t *return_value;
-    frame_t *popped_frame = NULL;
+    monkey_object_t *right;
+    monkey_array_t *array;
+    long result;
+    frame_t *frame;
+    size_t *ins;
     size_t ip;
-    size_t num_args;
-    size_t builtin_idx;
-    frame_t *current_frame = get_current_frame(vm);
-    while (current_frame->ip < get_frame_instructions(current_frame)->length) {
-        ip = current_frame->ip;
-        instructions_t *current_frame_instructions = get_frame_instructions(current_frame);
-        opcode_t op = current_frame_instructions->bytes[ip];
-        if (top != NULL) {
-            free_monkey_object(top);
-            top = NULL;
-        }
+    size_t sp;
+    size_t op;
+#ifdef VM_JIT
+    jit_state_t jit_state;
+    int status;
+#endif
+
+    VM_LOAD_STATE();
+#ifdef VM_THREADED_DISPATCH
+    VM_DISPATCH();
+#else
+    for (;;) {
+#ifdef VM_JIT
+    next_instruction:
+#endif
+        op = ins[ip++];
+        VM_COUNT_OPCODE(op);
         switch (op) {
-        case OPCONSTANT:
-            const_index = decode_instructions_to_sizet(current_frame_instructions->bytes + ip + 1, 2);
-            current_frame->ip += 2;
-            vm_err = vm_push(vm, get_constant(vm, const_index), true);
-            if (vm_err.code != VM_ERROR_NONE)
-                return vm_err;
-            break;
-        case OPADD:
-        case OPSUB:
-        case OPMUL:
-        case OPDIV:
+        case DECODED_HALT:
+            goto done;
+#endif
+        VM_TARGET(OPCONSTANT)
+            index = VM_READ_OPERAND();
+            VM_PUSH(retain_monkey_object(get_constant(vm, index)));
+            VM_DISPATCH();
+
+        VM_TARGET(OPADD)
+        VM_TARGET(OPSUB)
+        VM_TARGET(OPMUL)
+        VM_TARGET(OPDIV)
+            if (op != OPDIV && is_immediate_int(vm->stack[sp - 1]) &&
+                is_immediate_int(vm->stack[sp - 2]))
+                VM_QUICKEN(op == OPADD? OPADD_INT: op == OPSUB? OPSUB_INT: OPMUL_INT);
+        binary_op:
+            vm->sp = sp;
             vm_err = execute_binary_op(vm, op);
-            if (vm_err.code != VM_ERROR_NONE)
-                return vm_err;
-            break;
-        case OPPOP:
-            top = vm_pop(vm);
-            break;
-        case OPTRUE:
-            vm_push(vm, (monkey_object_t *) create_monkey_bool(true), false);
-            break;
-        case OPFALSE:
-            vm_push(vm, (monkey_object_t *) create_monkey_bool(false), false);
-            break;
-        case OPNULL:
-            vm_push(vm, (monkey_object_t *) create_monkey_null(), false);
-            break;
-        case OPGREATERTHAN:
-        case OPEQUAL:
-        case OPNOTEQUAL:
+            sp = vm->sp;
+            VM_CHECK_ERROR();
+            VM_DISPATCH();
+
+        VM_TARGET(OPADD_INT)
+        VM_TARGET(OPSUB_INT)
+        VM_TARGET(OPMUL_INT)
+            right = vm->stack[sp - 1];
+            left = vm->stack[sp - 2];
+            if (!is_immediate_int(left) || !is_immediate_int(right)) {
+                VM_DEOPTIMIZE(op == OPADD_INT? OPADD: op == OPSUB_INT? OPSUB: OPMUL);
+                goto binary_op;
+            }
+            if (op == OPADD_INT)
+                result = get_monkey_int_value(left) + get_monkey_int_value(right);
+            else if (op == OPSUB_INT)
+                result = get_monkey_int_value(left) - get_monkey_int_value(right);
+            else
+                result = get_monkey_int_value(left) * get_monkey_int_value(right);
+            vm->stack[--sp - 1] = create_monkey_int_object(result);
+            VM_DISPATCH();
+
+        VM_TARGET(OPPOP)
+            VM_POP_TOP();
+            VM_DISPATCH();
+
+        VM_TARGET(OPTRUE)
+            VM_PUSH((monkey_object_t *) create_monkey_bool(true));
+            VM_DISPATCH();
+
+        VM_TARGET(OPFALSE)
+            VM_PUSH((monkey_object_t *) create_monkey_bool(false));
+            VM_DISPATCH();
+
+        VM_TARGET(OPNULL)
+            VM_PUSH((monkey_object_t *) create_monkey_null());
+            VM_DISPATCH();
+
+        VM_TARGET(OPGREATERTHAN)
+        VM_TARGET(OPEQUAL)
+        VM_TARGET(OPNOTEQUAL)
+            if (is_immediate_int(vm->stack[sp - 1]) && is_immediate_int(vm->stack[sp - 2]))
+                VM_QUICKEN(op == OPGREATERTHAN? OPGREATERTHAN_INT:
+                    op == OPEQUAL? OPEQUAL_INT: OPNOTEQUAL_INT);
+        comparison_op:
+            vm->sp = sp;
             vm_err = execute_comparison_op(vm, op);
-            if (vm_err.code != VM_ERROR_NONE)
-                return vm_err;
-            break;
-        case OPMINUS:
+            sp = vm->sp;
+            VM_CHECK_ERROR();
+            VM_DISPATCH();
+
+        VM_TARGET(OPGREATERTHAN_INT)
+        VM_TARGET(OPEQUAL_INT)
+        VM_TARGET(OPNOTEQUAL_INT)
+            right = vm->stack[sp - 1];
+            left = vm->stack[sp - 2];
+            if (!is_immediate_int(left) || !is_immediate_int(right)) {
+                VM_DEOPTIMIZE(op == OPGREATERTHAN_INT? OPGREATERTHAN:
+                    op == OPEQUAL_INT? OPEQUAL: OPNOTEQUAL);
+                goto comparison_op;
+            }
+            /* immediates with equal values are identical pointers */
+            if (op == OPGREATERTHAN_INT)
+                obj = (monkey_object_t *) create_monkey_bool(
+                    (get_monkey_int_value(left) > get_monkey_int_value(right)));
+            else if (op == OPEQUAL_INT)
+                obj = (monkey_object_t *) create_monkey_bool((left == right));
+            else
+                obj = (monkey_object_t *) create_monkey_bool((left != right));
+            vm->stack[--sp - 1] = obj;
+            VM_DISPATCH();
+
+        VM_TARGET(OPMINUS)
+            vm->sp = sp;
             vm_err = execute_minus_operator(vm);
-            if (vm_err.code != VM_ERROR_NONE)
-                return vm_err;
-            break;
-        case OPBANG:
+            sp = vm->sp;
+            VM_CHECK_ERROR();
+            VM_DISPATCH();
+
+        VM_TARGET(OPBANG)
+            vm->sp = sp;
             vm_err = execute_bang_operator(vm);
-            if (vm_err.code != VM_ERROR_NONE)
-                return vm_err;
-            break;
-        case OPJMP:
-            jmp_pos = decode_instructions_to_sizet(current_frame_instructions->bytes + ip + 1, 2);
-            current_frame->ip = jmp_pos - 1;
-            break;
-        case OPJMPFALSE:
-            jmp_pos = decode_instructions_to_sizet(current_frame_instructions->bytes + ip + 1, 2);
-            current_frame->ip += 2;
-            top = vm_pop(vm);
+            sp = vm->sp;
+            VM_CHECK_ERROR();
+            VM_DISPATCH();
+
+        VM_TARGET(OPJMP)
+            ip = ins[ip];
+            VM_DISPATCH();
+
+        VM_TARGET(OPJMPFALSE)
+            index = VM_READ_OPERAND();
+            VM_POP_TOP();
             if (!is_truthy(top))
-                current_frame->ip = jmp_pos - 1;
-            break;
-        case OPSETGLOBAL:
-            sym_index = decode_instructions_to_sizet(current_frame_instructions->bytes + ip + 1, 2);
-            current_frame->ip += 2;
-            top = vm_pop(vm);
-            vm->globals[sym_index] = copy_monkey_object(top);
-            break;
-        case OPSETLOCAL:
-            sym_index = decode_instructions_to_sizet(current_frame_instructions->bytes + ip + 1, 1);
-            current_frame->ip++;
-            top = vm_pop(vm);
-            vm->stack[current_frame->bp + sym_index] = copy_monkey_object(top);
-            break;
-        case OPGETGLOBAL:
-            sym_index = decode_instructions_to_sizet(current_frame_instructions->bytes + ip + 1, 2);
-            current_frame->ip += 2;
-            vm_err = vm_push(vm, vm->globals[sym_index], true);
-            if (vm_err.code != VM_ERROR_NONE)
-                return vm_err;
-            break;
-        case OPGETLOCAL:
-            sym_index = decode_instructions_to_sizet(current_frame_instructions->bytes + ip + 1, 1);
-            current_frame->ip++;
-            vm_err = vm_push(vm, vm->stack[current_frame->bp + sym_index], false);
-            if (vm_err.code != VM_ERROR_NONE)
-                return vm_err;
-            break;
-        case OPARRAY:
-            array_size = decode_instructions_to_sizet(current_frame_instructions->bytes + ip + 1, 2);
-            current_frame->ip += 2;
-            array_list = build_array(vm, array_size);
-            array_obj = create_monkey_array(array_list);
-            vm_err = vm_push(vm, (monkey_object_t *) array_obj, false);
-            if (vm_err.code != VM_ERROR_NONE)
-                return vm_err;
-            break;
-        case OPHASH:
-            hash_size = decode_instructions_to_sizet(current_frame_instructions->bytes + ip + 1, 2);
-            current_frame->ip += 2;
-            table = build_hash(vm, hash_size);
-            hash_obj = create_monkey_hash(table);
-            vm_err = vm_push(vm, (monkey_object_t *) hash_obj, false);
-            if (vm_err.code != VM_ERROR_NONE)
-                return vm_err;
-            break;
-        case OPINDEX:
-            index = vm_pop(vm);
-            left = vm_pop(vm);
-            vm_err = execute_index_expression(vm, left, index);
-            free_monkey_object(index);
-            free_monkey_object(left);
-            if (vm_err.code != VM_ERROR_NONE)
-                return vm_err;
-            break;
-        case OPCALL:
-            num_args = decode_instructions_to_sizet(current_frame_instructions->bytes + ip + 1, 1);
-            current_frame->ip++;
-            vm_err = execute_call(vm, num_args);
-            if (vm_err.code != VM_ERROR_NONE)
-                return vm_err;
-            break;
-        case OPRETURNVALUE:
-            return_value = (monkey_object_t *) vm_pop(vm);
-            popped_frame = pop_frame(vm);
-            vm->sp = popped_frame->bp - 1;
-            vm_push(vm, return_value, false);
-            break;
-        case OPRETURN:
-            popped_frame = pop_frame(vm);
-            vm->sp = popped_frame->bp - 1;
-            vm_push(vm, (monkey_object_t *) create_monkey_null(), false);
-            break;
-        case OPGETBUILTIN:
-            builtin_idx = decode_instructions_to_sizet(current_frame_instructions->bytes + ip + 1, 1);
-            current_frame->ip++;
-            const char *builtin_name = get_builtins_name(builtin_idx);
-            monkey_builtin_t *builtin = get_builtins(builtin_name);
-            vm_push(vm, (monkey_object_t *) builtin, false);
-            break;
+                ip = index;
+            VM_DISPATCH();
+
+        VM_TARGET(OPSETGLOBAL)
+            index = VM_READ_OPERAND();
+            VM_POP_TOP();
+            left = vm->globals[index];
+            vm->globals[index] = retain_monkey_object(top);
+            release_monkey_object(left);
+            VM_DISPATCH();
+
+        VM_TARGET(OPGETGLOBAL)
+            index = VM_READ_OPERAND();
+            VM_PUSH(retain_monkey_object(vm->globals[index]));
+            VM_DISPATCH();
+
+        VM_TARGET(OPSETLOCAL)
+            index = VM_READ_OPERAND();
+            VM_POP_TOP();
+            left = vm->stack[frame->bp + index];
+            vm->stack[frame->bp + index] = retain_monkey_object(top);
+            release_monkey_object(left);
+            VM_DISPATCH();
+
+        VM_TARGET(OPGETLOCAL)
+            index = VM_READ_OPERAND();
+            VM_PUSH(retain_monkey_object(vm->stack[frame->bp + index]));
+            VM_DISPATCH();
+
+        VM_TARGET(OPGETLOCAL2)
+            index = VM_READ_OPERAND();
+            VM_PUSH(retain_monkey_object(vm->stack[frame->bp + index]));
+            index = VM_READ_OPERAND();
+            VM_PUSH(retain_monkey_object(vm->stack[frame->bp + index]));
+            VM_DISPATCH();
+
+        VM_TARGET(OPGETLOCALCONSTANT)
+            index = VM_READ_OPERAND();
+            VM_PUSH(retain_monkey_object(vm->stack[frame->bp + index]));
+            index = VM_READ_OPERAND();
+            VM_PUSH(retain_monkey_object(get_constant(vm, index)));
+            VM_DISPATCH();
+
+        VM_TARGET(OPADDLOCALS)
+            left = vm->stack[frame->bp + VM_READ_OPERAND()];
+            right = vm->stack[frame->bp + VM_READ_OPERAND()];
+            op = OPADD;
+            goto local_binary_op;
+
+        VM_TARGET(OPADDLOCALCONSTANT)
+        VM_TARGET(OPSUBLOCALCONSTANT)
+            left = vm->stack[frame->bp + VM_READ_OPERAND()];
+            right = get_constant(vm, VM_READ_OPERAND());
+            op = op == OPADDLOCALCONSTANT? OPADD: OPSUB;
+        local_binary_op:
+            if (is_immediate_int(left) && is_immediate_int(right)) {
+                if (op == OPADD)
+                    result = get_monkey_int_value(left) + get_monkey_int_value(right);
+                else
+                    result = get_monkey_int_value(left) - get_monkey_int_value(right);
+                VM_PUSH(create_monkey_int_object(result));
+                VM_DISPATCH();
+            }
+            VM_PUSH(retain_monkey_object(left));
+            VM_PUSH(retain_monkey_object(right));
+            goto binary_op;
+
+        VM_TARGET(OPGREATERTHANJMPFALSE)
+        VM_TARGET(OPEQUALJMPFALSE)
+            index = VM_READ_OPERAND();
+            right = vm->stack[sp - 1];
+            left = vm->stack[sp - 2];
+            if (is_immediate_int(left) && is_immediate_int(right)) {
+                sp -= 2;
+                if (op == OPGREATERTHANJMPFALSE?
+                    get_monkey_int_value(left) <= get_monkey_int_value(right): left != right)
+                    ip = index;
+                VM_DISPATCH();
+            }
+            vm->sp = sp;
+            vm_err = execute_comparison_op(vm, op == OPGREATERTHANJMPFALSE? OPGREATERTHAN: OPEQUAL);
+            sp = vm->sp;
+            VM_CHECK_ERROR();
+            VM_POP_TOP();
+            if (!is_truthy(top))
+                ip = index;
+            VM_DISPATCH();
+
+        VM_TARGET(OPARRAY)
+            count = VM_READ_OPERAND();
+            vm->sp = sp;
+            obj = (monkey_object_t *) create_monkey_array(build_array(vm, count));
+            sp = vm->sp;
+            VM_PUSH(obj);
+            VM_DISPATCH();
+
+        VM_TARGET(OPHASH)
+            count = VM_READ_OPERAND();
+            vm->sp = sp;
+            obj = (monkey_object_t *) create_monkey_hash(build_hash(vm, count));
+            sp = vm->sp;
+            VM_PUSH(obj);
+            VM_DISPATCH();
+
+        VM_TARGET(OPINDEX)
+            obj = vm->stack[--sp];
+            left = vm->stack[--sp];
+            if (get_monkey_object_type(left) == MONKEY_ARRAY && is_immediate_int(obj))
+                VM_QUICKEN(OPINDEX_ARRAY);
+            else if (get_monkey_object_type(left) == MONKEY_HASH)
+                VM_QUICKEN(OPINDEX_HASH);
+        index_op:
+            vm->sp = sp;
+            vm_err = execute_index_expression(vm, left, obj);
+            sp = vm->sp;
+            release_monkey_object(obj);
+            release_monkey_object(left);
+            VM_CHECK_ERROR();
+            VM_DISPATCH();
+
+        VM_TARGET(OPINDEX_ARRAY)
+            obj = vm->stack[--sp];
+            left = vm->stack[--sp];
+            if (get_monkey_object_type(left) != MONKEY_ARRAY || !is_immediate_int(obj)) {
+                VM_DEOPTIMIZE(OPINDEX);
+                goto index_op;
+            }
+            index = get_monkey_int_value(obj);
+            array = (monkey_array_t *) left;
+            if (index < get_monkey_array_length(array)) {
+                right = get_monkey_array_element(array, index);
+                if (array->kind == MONKEY_ELEMENTS_GENERIC)
+                    retain_monkey_object(right);
+            } else {
+                right = (monkey_object_t *) create_monkey_null();
+            }
+            vm->stack[sp++] = right;
+            release_monkey_object(left);
+            VM_DISPATCH();
+
+        VM_TARGET(OPSLICE)
+            right = vm->stack[--sp];
+            obj = vm->stack[--sp];
+            left = vm->stack[--sp];
+            vm->sp = sp;
+            vm_err = execute_slice_expression(vm, left, obj, right);
+            sp = vm->sp;
+            release_monkey_object(right);
+            release_monkey_object(obj);
+            release_monkey_object(left);
+            VM_CHECK_ERROR();
+            VM_DISPATCH();
+
+        VM_TARGET(OPINDEX_HASH)
+            obj = vm->stack[--sp];
+            left = vm->stack[--sp];
+            if (get_monkey_object_type(left) != MONKEY_HASH) {
+                VM_DEOPTIMIZE(OPINDEX);
+                goto index_op;
+            }
+            right = cm_hash_table_get(((monkey_hash_t *) left)->pairs, obj);
+            if (right == NULL)
+                right = (monkey_object_t *) create_monkey_null();
+            vm->stack[sp++] = retain_monkey_object(right);
+            release_monkey_object(obj);
+            release_monkey_object(left);
+            VM_DISPATCH();
+
+        VM_TARGET(OPCALL)
+            count = ins[ip];
+            obj = vm->stack[sp - 1 - count];
+            if (get_monkey_object_type(obj) == MONKEY_COMPILED_FUNCTION)
+                VM_QUICKEN(OPCALL_COMPILED);
+            else if (get_monkey_object_type(obj) == MONKEY_BUILTIN)
+                VM_QUICKEN(OPCALL_BUILTIN);
+        call_op:
+            count = VM_READ_OPERAND();
+            VM_SAVE_STATE();
+            vm_err = execute_call(vm, count);
+            VM_CHECK_ERROR();
+            VM_LOAD_STATE();
+            VM_DISPATCH();
+
+        VM_TARGET(OPCALL_COMPILED)
+            count = ins[ip];
+            obj = vm->stack[sp - 1 - count];
+            if (get_monkey_object_type(obj) != MONKEY_COMPILED_FUNCTION) {
+                VM_DEOPTIMIZE(OPCALL);
+                goto call_op;
+            }
+            ip++;
+            VM_SAVE_STATE();
+            vm_err = call_function(vm, (monkey_compiled_fn_t *) obj, count);
+            VM_CHECK_ERROR();
+            VM_LOAD_STATE();
+            VM_DISPATCH();
+
+        VM_TARGET(OPCALL_BUILTIN)
+            count = ins[ip];
+            obj = vm->stack[sp - 1 - count];
+            if (get_monkey_object_type(obj) != MONKEY_BUILTIN) {
+                VM_DEOPTIMIZE(OPCALL);
+                goto call_op;
+            }
+            ip++;
+            vm->sp = sp;
+            vm_err = call_builtin(vm, (monkey_builtin_t *) obj, count);
+            sp = vm->sp;
+            VM_CHECK_ERROR();
+            VM_DISPATCH();
+
+        VM_TARGET(OPRETURNVALUE)
+            VM_RETURN(vm->stack[--sp]);
+            VM_DISPATCH();
+
+        VM_TARGET(OPRETURN)
+            VM_RETURN((monkey_object_t *) create_monkey_null());
+            VM_DISPATCH();
+
+        VM_TARGET(OPGETBUILTIN)
+            index = VM_READ_OPERAND();
+            VM_PUSH((monkey_object_t *) get_builtins(get_builtins_name(index)));
+            VM_DISPATCH();
+
+#ifndef VM_THREADED_DISPATCH
         default:
-            op_def = opcode_definition_lookup(op);
-            vm_err.code = VM_UNSUPPORTED_OPERATOR;
-            vm_err.msg = get_err_msg("Unsupported opcode %s", op_def.name);
-            return vm_err;
+            goto unsupported_opcode;
         }
-        if (popped_frame == current_frame) {
-            frame_free(popped_frame);
-            popped_frame = NULL;
-        } else
-            current_frame->ip++;
-        current_frame = get_current_frame(vm);
     }
+#endif
+
+#ifdef VM_JIT
+run_jit:
+    jit_state.vm = vm;
+    jit_state.locals = &vm->stack[frame->bp];
+    jit_state.top = top;
+    status = jit_run(frame->fn->jit, &jit_state, ip);
+    top = jit_state.top;
+    if (status == JIT_ERROR) {
+        vm_err = jit_state.err;
+        VM_CHECK_ERROR();
+    }
+    if (status == JIT_DONE) {
+        sp = vm->sp;
+        frame = get_current_frame(vm);
+        ip = frame->ip;
+        goto done;
+    }
+    VM_LOAD_STATE();
+#ifdef VM_THREADED_DISPATCH
+    VM_DISPATCH();
+#else
+    goto next_instruction;
+#endif
+#endif
+
+done:
+    VM_SAVE_STATE();
+    vm->stack[sp] = top;
     vm_err.code = VM_ERROR_NONE;
     vm_err.msg = NULL;
     return vm_err;
-}
\ No newline at end of file
+
+stack_overflow:
+    vm->sp = sp;
+    release_monkey_object(top);
+    vm_err.code = VM_STACKOVERFLOW;
+    vm_err.msg = get_err_msg("Stackoverflow error: execeeded max stack size of %d",
+        STACKSIZE);
+    return vm_err;
+
+unsupported_opcode:
+    vm->sp = sp;
+    release_monkey_object(top);
+    op_def = opcode_definition_lookup(op);
+    vm_err.code = VM_UNSUPPORTED_OPERATOR;
+    vm_err.msg = get_err_msg("Unsupported opcode %s", op_def.name);
+    return vm_err;
+}
+
+/*
+ * With a region the last popped value is copied out of it, so that it can
+ * be inspected after vm_free. The copy in the region is left to it.
+ */
+vm_error_t
+vm_run(vm_t *vm)
+{
+    vm_error_t vm_err;
+    monkey_object_t *top;
+    if (vm->region == NULL)
+        return vm_execute(vm);
+    cm_region_enter(vm->region);
+    vm_err = vm_execute(vm);
+    cm_region_leave(vm->region);
+    top = vm->stack[vm->sp];
+    if (vm_err.code == VM_ERROR_NONE && top != NULL && cm_region_contains(vm->region, top))
+        vm->stack[vm->sp] = copy_monkey_object(top);
+    return vm_err;
+}
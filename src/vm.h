@@ -1,6 +1,7 @@
 #ifndef VM_H
 #define VM_H
 
+#include <stdio.h>
 #include <stdlib.h>
 #include "cmonkey_utils.h"
 #include "compiler.h"
@@ -38,18 +39,25 @@ typedef struct vm_error_t {
 #define get_vm_error_desc(err) VM_ERROR_DESC[err]
 
 typedef struct vm_t {
-    frame_t *frames[MAX_FRAMES];
+    monkey_compiled_fn_t main_fn;
+    frame_t frames[MAX_FRAMES];
     size_t frame_index;
     cm_array_list *constants;
     monkey_object_t *stack[STACKSIZE];
     monkey_object_t *globals[GLOBALS_SIZE];
     size_t sp;
+    size_t jit_threshold; // calls before a function is JIT compiled, 0 disables the JIT
+    cm_region *region;    // allocations of vm_run when not NULL, see vm_use_region
 } vm_t;
 
 vm_t *vm_init(bytecode_t *);
 vm_t *vm_init_with_state(bytecode_t *, monkey_object_t *[GLOBALS_SIZE]);
 void vm_free(vm_t *);
+void vm_use_region(vm_t *, _Bool);
 monkey_object_t *vm_last_popped_stack_elem(vm_t *);
 vm_error_t vm_run(vm_t *);
+#ifdef VM_OPCODE_STATS
+void vm_print_opcode_stats(FILE *, size_t);
+#endif
 
 #endif
\ No newline at end of file
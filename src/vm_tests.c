@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include "compiler.h"
+#include "jit.h"
 #include "lexer.h"
 #include "token.h"
 #include "object_test_utils.h"
@@ -16,33 +17,48 @@ typedef struct vm_testcase {
 } vm_testcase;
 
 
+/* with the JIT, every test also runs with functions compiled on their first call */
+#ifdef VM_JIT
+static const size_t jit_thresholds[] = {0, 1};
+#else
+static const size_t jit_thresholds[] = {0};
+#endif
+
+static void
+run_vm_test(vm_testcase t, size_t jit_threshold)
+{
+    printf("Testing vm test for input %s\n", t.input);
+    lexer_t *lexer = lexer_init(t.input);
+    parser_t *parser = parser_init(lexer);
+    program_t *program = parse_program(parser);
+    compiler_t *compiler = compiler_init();
+    compiler_error_t error = compile(compiler, (node_t *) program);
+    if (error.code != COMPILER_ERROR_NONE)
+        errx(EXIT_FAILURE, "compilation failed for input %s with error %s\n",
+            t.input, error.msg);
+    bytecode_t *bytecode = get_bytecode(compiler);
+    vm_t *vm = vm_init(bytecode);
+    vm->jit_threshold = jit_threshold;
+    vm_error_t vm_error = vm_run(vm);
+    if (vm_error.code != VM_ERROR_NONE)
+        errx(EXIT_FAILURE, "vm error: %s\n", vm_error.msg);
+    monkey_object_t *top = vm_last_popped_stack_elem(vm);
+    test_monkey_object(top, t.expected);
+    release_monkey_object(top);
+    parser_free(parser);
+    program_free(program);
+    compiler_free(compiler);
+    bytecode_free(bytecode);
+    vm_free(vm);
+}
+
 static void
 run_vm_tests(size_t test_count, vm_testcase test_cases[test_count])
 {
-    for (size_t i = 0; i < test_count; i++) {
-        vm_testcase t = test_cases[i];
-        printf("Testing vm test for input %s\n", t.input);
-        lexer_t *lexer = lexer_init(t.input);
-        parser_t *parser = parser_init(lexer);
-        program_t *program = parse_program(parser);
-        compiler_t *compiler = compiler_init();
-        compiler_error_t error = compile(compiler, (node_t *) program);
-        if (error.code != COMPILER_ERROR_NONE)
-            errx(EXIT_FAILURE, "compilation failed for input %s with error %s\n",
-                t.input, error.msg);
-        bytecode_t *bytecode = get_bytecode(compiler);
-        vm_t *vm = vm_init(bytecode);
-        vm_error_t vm_error = vm_run(vm);
-        if (vm_error.code != VM_ERROR_NONE)
-            errx(EXIT_FAILURE, "vm error: %s\n", vm_error.msg);
-        monkey_object_t *top = vm_last_popped_stack_elem(vm);
-        test_monkey_object(top, t.expected);
-        free_monkey_object(top);
-        parser_free(parser);
-        program_free(program);
-        compiler_free(compiler);
-        bytecode_free(bytecode);
-        vm_free(vm);
+    size_t nthresholds = sizeof(jit_thresholds) / sizeof(jit_thresholds[0]);
+    for (size_t i = 0; i < nthresholds; i++) {
+        for (size_t j = 0; j < test_count; j++)
+            run_vm_test(test_cases[j], jit_thresholds[i]);
     }
 }
 
@@ -74,7 +90,7 @@ test_boolean_expressions(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static void
@@ -96,7 +112,10 @@ test_integer_aritmetic(void)
         {"-5", (monkey_object_t *) create_monkey_int(-5)},
         {"-10", (monkey_object_t *) create_monkey_int(-10)},
         {"-50 + 100 + -50", (monkey_object_t *) create_monkey_int(0)},
-        {"(5 + 10 * 2 + 15 / 3) * 2 + -10", (monkey_object_t *) create_monkey_int(50)}
+        {"(5 + 10 * 2 + 15 / 3) * 2 + -10", (monkey_object_t *) create_monkey_int(50)},
+        {"4611686018427387903 + 1", (monkey_object_t *) create_monkey_int(4611686018427387904)},
+        {"-4611686018427387904 - 1", (monkey_object_t *) create_monkey_int(-4611686018427387905)},
+        {"9223372036854775807 - 9223372036854775806", (monkey_object_t *) create_monkey_int(1)}
     };
 
     print_test_separator_line();
@@ -104,7 +123,7 @@ test_integer_aritmetic(void)
     size_t ntests = sizeof(tests)/ sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static void
@@ -126,7 +145,7 @@ test_conditionals(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static void
@@ -142,7 +161,7 @@ test_global_let_stmts(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static void
@@ -158,7 +177,7 @@ test_string_expressions(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static monkey_array_t *
@@ -166,7 +185,7 @@ create_monkey_int_array(size_t count, ...)
 {
     va_list ap;
     va_start(ap, count);
-    cm_array_list *list = cm_array_list_init(count, free_monkey_object);
+    cm_array_list *list = cm_array_list_init(count, release_monkey_object);
     for (size_t i = 0; i < count; i++) {
         int val = va_arg(ap, int);
         cm_array_list_add(list, create_monkey_int(val));
@@ -188,13 +207,13 @@ test_array_literals(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static monkey_hash_t *
 create_hash_table(size_t n, monkey_object_t *objects[n])
 {
-    cm_hash_table *table = cm_hash_table_init(monkey_object_hash, monkey_object_equals, free_monkey_object, free_monkey_object);
+    cm_hash_table *table = cm_hash_table_init(monkey_object_hash, monkey_object_equals, release_monkey_object, release_monkey_object);
     for (size_t i = 0; i < n; i += 2) {
         monkey_object_t *key = objects[i];
         monkey_object_t *value = objects[i + 1];
@@ -230,7 +249,7 @@ test_hash_literals(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static void
@@ -253,7 +272,7 @@ test_index_expresions(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static void
@@ -269,7 +288,7 @@ test_functions_without_arguments(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static void
@@ -284,7 +303,7 @@ test_function_with_return_statement(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static void
@@ -299,7 +318,7 @@ test_functions_without_return_value(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static void
@@ -314,7 +333,7 @@ test_first_class_functions(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static void
@@ -427,13 +446,13 @@ test_calling_functions_with_bindings_and_arguments(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
 }
 
 static monkey_array_t *
 create_int_array(int *int_arr, size_t length)
 {
-    cm_array_list *array_list = cm_array_list_init(length, free_monkey_object);
+    cm_array_list *array_list = cm_array_list_init(length, release_monkey_object);
     for (size_t i = 0; i < length; i++) {
         cm_array_list_add(array_list, (void *) create_monkey_int(int_arr[i]));
     }
@@ -522,7 +541,38 @@ test_builtin_functions(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
+}
+
+static void
+test_slice_expressions(void)
+{
+    vm_testcase tests[] = {
+        {"[1, 2, 3, 4][1:3]", (monkey_object_t *) create_int_array((int[]) {2, 3}, 2)},
+        {"[1, 2, 3, 4][:2]", (monkey_object_t *) create_int_array((int[]) {1, 2}, 2)},
+        {"[1, 2, 3, 4][2:]", (monkey_object_t *) create_int_array((int[]) {3, 4}, 2)},
+        {"[1, 2, 3][-5:99]", (monkey_object_t *) create_int_array((int[]) {1, 2, 3}, 3)},
+        {"[1, 2, 3][2:1]", (monkey_object_t *) create_int_array((int[]) {0}, 0)},
+        {"let a = [1, 2, 3, 4, 5]; a[1:][1:3][1]", (monkey_object_t *) create_monkey_int(4)},
+        {"let a = [1, 2, 3, 4, 5]; len(rest(rest(a))[1:])", (monkey_object_t *) create_monkey_int(2)},
+        {"\"hello world\"[6:]", (monkey_object_t *) create_monkey_string("world", 5)},
+        {"\"hello world\"[:5][1:]", (monkey_object_t *) create_monkey_string("ello", 4)},
+        {"\"hello\"[1:2] + \"hello\"[3:]", (monkey_object_t *) create_monkey_string("elo", 3)},
+        {"{\"ell\": 1}[\"hello\"[1:4]]", (monkey_object_t *) create_monkey_int(1)},
+        {"rest(\"abc\")", (monkey_object_t *) create_monkey_string("bc", 2)},
+        {"rest(\"\")", (monkey_object_t *) create_monkey_null()},
+        {
+            "let sum = fn(f, a) { if (len(a) == 0) { 0 } else { first(a) + f(f, rest(a)) } };"
+            "sum(sum, [1, 2, 3, 4, 5][1:])",
+            (monkey_object_t *) create_monkey_int(14)
+        }
+    };
+    print_test_separator_line();
+    printf("Testing slice expressions\n");
+    size_t ntests = sizeof(tests) / sizeof(tests[0]);
+    run_vm_tests(ntests, tests);
+    for (size_t i = 0; i < ntests; i++)
+        release_monkey_object(tests[i].expected);
 }
 
 static void
@@ -568,9 +618,228 @@ test_calling_functions_with_bindings(void)
     size_t ntests = sizeof(tests) / sizeof(tests[0]);
     run_vm_tests(ntests, tests);
     for (size_t i = 0; i < ntests; i++)
-        free_monkey_object(tests[i].expected);
+        release_monkey_object(tests[i].expected);
+
+}
+
+static void
+test_quickened_instructions(void)
+{
+    vm_testcase tests[] = {
+        {
+            "let add = fn(a, b) { a + b };\n"
+            "add(1, 2); add(3, 4);\n"
+            "add(\"mon\", \"key\");",
+            (monkey_object_t *) create_monkey_string("monkey", 6)
+        },
+        {
+            "let add = fn(a, b) { a + b };\n"
+            "add(\"a\", \"b\"); add(1, 2); add(40, 2);",
+            (monkey_object_t *) create_monkey_int(42)
+        },
+        {
+            "let mul = fn(a, b) { a * b };\n"
+            "mul(2, 3); mul(3037000499, 3037000499);",
+            (monkey_object_t *) create_monkey_int(9223372030926249001L)
+        },
+        {
+            "let eq = fn(a, b) { a == b };\n"
+            "eq(1, 1); eq(true, true);",
+            (monkey_object_t *) create_monkey_bool(true)
+        },
+        {
+            "let gt = fn(a, b) { a > b };\n"
+            "gt(2, 1); gt(1, 2);",
+            (monkey_object_t *) create_monkey_bool(false)
+        },
+        {
+            "let get = fn(c, k) { c[k] };\n"
+            "get([1, 2], 1) + get({1: 5}, 1) + get([7], 0) + get({\"a\": 3}, \"a\");",
+            (monkey_object_t *) create_monkey_int(17)
+        },
+        {
+            "let call = fn(f, x) { f(x) };\n"
+            "call(len, \"abc\") + call(fn(x) { x * 2 }, 4) + call(len, [1]);",
+            (monkey_object_t *) create_monkey_int(12)
+        }
+    };
+    print_test_separator_line();
+    printf("Testing quickened instructions with changing operand types\n");
+    size_t ntests = sizeof(tests) / sizeof(tests[0]);
+    run_vm_tests(ntests, tests);
+    for (size_t i = 0; i < ntests; i++)
+        release_monkey_object(tests[i].expected);
+}
+
+static void
+test_superinstructions(void)
+{
+    vm_testcase tests[] = {
+        {
+            "let fib = fn(f, n) { if (n < 2) { return n; } f(f, n - 1) + f(f, n - 2) };\n"
+            "fib(fib, 15);",
+            (monkey_object_t *) create_monkey_int(610)
+        },
+        {
+            "let join = fn(a, b) { a + b };\n"
+            "join(\"mon\", \"key\");",
+            (monkey_object_t *) create_monkey_string("monkey", 6)
+        },
+        {
+            "let inc = fn(a) { a + 1 };\n"
+            "inc(41);",
+            (monkey_object_t *) create_monkey_int(42)
+        },
+        {
+            "let pick = fn(a, b) { if (a == b) { 1 } else { 2 } };\n"
+            "pick(true, true) + pick(1, 2) + pick(3, 3);",
+            (monkey_object_t *) create_monkey_int(4)
+        },
+        {
+            "let max = fn(a, b) { if (a > b) { a } else { b } };\n"
+            "max(3, 7) + max(9, 2);",
+            (monkey_object_t *) create_monkey_int(16)
+        }
+    };
+    print_test_separator_line();
+    printf("Testing superinstructions\n");
+    size_t ntests = sizeof(tests) / sizeof(tests[0]);
+    run_vm_tests(ntests, tests);
+    for (size_t i = 0; i < ntests; i++)
+        release_monkey_object(tests[i].expected);
+}
+
+/* the result of a run in a region stays usable after the region is gone */
+static void
+test_region(void)
+{
+    typedef struct testcase {
+        const char *input;
+        const char *expected;
+    } testcase;
+    testcase tests[] = {
+        {"let a = [1, 2, 3]; push(a, 4)", "[1, 2, 3, 4]"},
+        {"let h = {\"a\": [1, \"x\"], 2: true}; h[\"a\"]", "[1, x]"},
+        {"let f = fn(g, s, n) { if (n == 0) { s } else { g(g, s + \"ab\", n - 1) } }; f(f, \"\", 40)[0:6]",
+            "ababab"},
+        {"let s = \"mon\" + \"key\"; [s, s[3:], rest([1, 2, 3])[1:]]", "[monkey, key, [3]]"},
+        {"let h = {\"k\": {1: \"v\" + \"w\"}}; h", "{k: {1: vw}}"},
+        {"let x = 4611686018427387903 + 1; x", "4611686018427387904"},
+        {"let f = fn(a) { a }; f(\"q\"[0:1])", "q"},
+        {"len(1)", "argument to `len` not supported, got INTEGER"},
+        {"[len(1)]", "[argument to `len` not supported, got INTEGER]"}
+    };
+    print_test_separator_line();
+    printf("Testing runs in a region\n");
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        testcase t = tests[i];
+        printf("Testing region run for input %s\n", t.input);
+        lexer_t *lexer = lexer_init(t.input);
+        parser_t *parser = parser_init(lexer);
+        program_t *program = parse_program(parser);
+        compiler_t *compiler = compiler_init();
+        compiler_error_t error = compile(compiler, (node_t *) program);
+        if (error.code != COMPILER_ERROR_NONE)
+            errx(EXIT_FAILURE, "compilation failed for input %s with error %s\n",
+                t.input, error.msg);
+        bytecode_t *bytecode = get_bytecode(compiler);
+        vm_t *vm = vm_init(bytecode);
+        vm_use_region(vm, false);
+        vm_error_t vm_error = vm_run(vm);
+        if (vm_error.code != VM_ERROR_NONE)
+            errx(EXIT_FAILURE, "vm error: %s\n", vm_error.msg);
+        monkey_object_t *top = vm_last_popped_stack_elem(vm);
+        vm_free(vm);
+        char *s = inspect(top);
+        test(strcmp(s, t.expected) == 0, "Expected %s, got %s\n", t.expected, s);
+        free(s);
+        release_monkey_object(top);
+        bytecode_free(bytecode);
+        parser_free(parser);
+        program_free(program);
+        compiler_free(compiler);
+    }
+}
+
+#ifdef VM_JIT
+static void
+test_jit(void)
+{
+    vm_testcase tests[] = {
+        {
+            "let fib = fn(f, n) { if (n < 2) { return n; } f(f, n - 1) + f(f, n - 2) };\n"
+            "fib(fib, 20);",
+            (monkey_object_t *) create_monkey_int(6765)
+        },
+        {
+            "let add = fn(a, b) { a + b };\n"
+            "add(1, 2); add(4611686018427387903, 1);",
+            (monkey_object_t *) create_monkey_int(4611686018427387904L)
+        },
+        {
+            "let sub = fn(a, b) { a - b };\n"
+            "sub(5, 7) + sub(-4611686018427387904, 1);",
+            (monkey_object_t *) create_monkey_int(-4611686018427387907L)
+        },
+        {
+            "let gt = fn(a, b) { if (a > b) { \"gt\" } else { \"le\" } };\n"
+            "gt(1, 2); gt(3, 2);",
+            (monkey_object_t *) create_monkey_string("gt", 2)
+        },
+        {
+            "let count = fn(c, n, acc) { if (n == 0) { return acc; } c(c, n - 1, push(acc, n)) };\n"
+            "len(count(count, 50, []));",
+            (monkey_object_t *) create_monkey_int(50)
+        },
+        {
+            "let g = 10; let f = fn(a) { let b = a * 2; let c = [b, g]; c[0] + c[1] };\n"
+            "f(1); f(2);",
+            (monkey_object_t *) create_monkey_int(14)
+        },
+        {
+            "let f = fn(h) { h[\"a\"] + len(h) };\n"
+            "f({\"a\": 1}) + f({\"a\": 2, \"b\": 3});",
+            (monkey_object_t *) create_monkey_int(6)
+        },
+        {
+            "let f = fn(x) { if (!x) { -1 } };\n"
+            "f(true); f(false);",
+            (monkey_object_t *) create_monkey_int(-1)
+        }
+    };
+    print_test_separator_line();
+    printf("Testing the JIT\n");
+    size_t ntests = sizeof(tests) / sizeof(tests[0]);
+    run_vm_tests(ntests, tests);
+    for (size_t i = 0; i < ntests; i++)
+        release_monkey_object(tests[i].expected);
 
+    const char *input = "let f = fn(a) { a + 1 }; f(1); f(2)";
+    printf("Testing that hot functions are compiled for input %s\n", input);
+    lexer_t *lexer = lexer_init(input);
+    parser_t *parser = parser_init(lexer);
+    program_t *program = parse_program(parser);
+    compiler_t *compiler = compiler_init();
+    compile(compiler, (node_t *) program);
+    bytecode_t *bytecode = get_bytecode(compiler);
+    vm_t *vm = vm_init(bytecode);
+    vm->jit_threshold = 2;
+    vm_error_t vm_error = vm_run(vm);
+    test(vm_error.code == VM_ERROR_NONE, "vm error: %s\n", vm_error.msg);
+    monkey_compiled_fn_t *fn = cm_array_list_get(bytecode->constants_pool, 1);
+    test(fn->object.type == MONKEY_COMPILED_FUNCTION, "Expected a compiled function\n");
+    test(fn->calls == 2, "Expected 2 calls, got %zu\n", fn->calls);
+    test(fn->jit != NULL, "Expected the function to be JIT compiled\n");
+    monkey_object_t *top = vm_last_popped_stack_elem(vm);
+    test(get_monkey_int_value(top) == 3, "Expected 3, got %ld\n", get_monkey_int_value(top));
+    release_monkey_object(top);
+    parser_free(parser);
+    program_free(program);
+    compiler_free(compiler);
+    bytecode_free(bytecode);
+    vm_free(vm);
 }
+#endif
 
 int
 main(int argc, char **argv)
@@ -583,6 +852,7 @@ main(int argc, char **argv)
     test_array_literals();
     test_hash_literals();
     test_index_expresions();
+    test_slice_expressions();
     test_functions_without_arguments();
     test_function_with_return_statement();
     test_functions_without_return_value();
@@ -591,5 +861,11 @@ main(int argc, char **argv)
     test_calling_functions_with_bindings_and_arguments();
     test_calling_functions_with_wrong_arguments();
     test_builtin_functions();
+    test_quickened_instructions();
+    test_superinstructions();
+    test_region();
+#ifdef VM_JIT
+    test_jit();
+#endif
     return 0;
 }
@@ -40,12 +40,32 @@
 #include "compiler.h"
 #include "environment.h"
 #include "evaluator.h"
+#include "jit.h"
 #include "token.h"
 #include "lexer.h"
 #include "object.h"
 #include "parser.h"
+#include "reg_compiler.h"
+#include "reg_vm.h"
 #include "vm.h"
 
+typedef enum engine_t {
+	ENGINE_STACK,
+	ENGINE_REGISTER
+} engine_t;
+
+/* set by --jit, 0 leaves the JIT disabled */
+static size_t jit_threshold;
+
+typedef enum region_mode_t {
+	REGION_NONE,
+	REGION_PAGES,
+	REGION_HUGE_PAGES
+} region_mode_t;
+
+/* set by --region, only used for running files */
+static region_mode_t region_mode;
+
 static const char * PROMPT = ">> ";
 static const char *MONKEY_FACE = "            __,__\n\
    .--.  .-\"     \"-.  .--.\n\
@@ -83,8 +103,40 @@ free_lines(cm_array_list *lines)
 	lines->length = 0;
 }
 
+static void
+run_register_engine(program_t *program)
+{
+	reg_compiler_t *compiler = reg_compiler_init();
+	compiler_error_t compile_err = reg_compile(compiler, program);
+	if (compile_err.code != COMPILER_ERROR_NONE) {
+		printf("Compile error: %s\n", compile_err.msg);
+		free(compile_err.msg);
+		reg_compiler_free(compiler);
+		return;
+	}
+
+	reg_bytecode_t *bytecode = reg_get_bytecode(compiler);
+	reg_vm_t *machine = reg_vm_init(bytecode);
+	vm_error_t vm_err = reg_vm_run(machine);
+	if (vm_err.code != VM_ERROR_NONE) {
+		printf("VM Error: %s\n", vm_err.msg);
+		free(vm_err.msg);
+	} else {
+		monkey_object_t *result = reg_vm_result(machine);
+		if (result != NULL && get_monkey_object_type(result) != MONKEY_NULL) {
+			char *s = inspect(result);
+			printf("%s\n", s);
+			free(s);
+		}
+		release_monkey_object(result);
+	}
+	reg_vm_free(machine);
+	reg_bytecode_free(bytecode);
+	reg_compiler_free(compiler);
+}
+
 static int
-execute_file(const char *filename)
+execute_file(const char *filename, engine_t engine)
 {
 	ssize_t bytes_read;
 	size_t linesize = 0;
@@ -131,6 +183,12 @@ execute_file(const char *filename)
 		goto EXIT;
 	}
 
+	if (engine == ENGINE_REGISTER) {
+		run_register_engine(program);
+		env_free(env);
+		goto EXIT;
+	}
+
 	compiler_t *compiler = compiler_init();
 	compiler_error_t compile_err = compile(compiler, (node_t *) program);
 	if (compile_err.code != COMPILER_ERROR_NONE) {
@@ -141,7 +199,13 @@ execute_file(const char *filename)
 
 	bytecode_t *bytecode = get_bytecode(compiler);
 	vm_t *machine = vm_init(bytecode);
+	machine->jit_threshold = jit_threshold;
+	if (region_mode != REGION_NONE)
+		vm_use_region(machine, region_mode == REGION_HUGE_PAGES);
 	vm_error_t vm_err =  vm_run(machine);
+#ifdef VM_OPCODE_STATS
+	vm_print_opcode_stats(stderr, 30);
+#endif
 	if (vm_err.code != VM_ERROR_NONE) {
 		printf("VM Error: %s\n", vm_err.msg);
 		free(vm_err.msg);
@@ -149,8 +213,8 @@ execute_file(const char *filename)
 	}
 	monkey_object_t *top = vm_last_popped_stack_elem(machine);
 	if (top != NULL) {
-		if (top->type != MONKEY_NULL) {
-			char *s = top->inspect(top);
+		if (get_monkey_object_type(top) != MONKEY_NULL) {
+			char *s = inspect(top);
 			printf("%s\n", s);
 			free(s);
 		}
@@ -175,17 +239,17 @@ copy_globals(monkey_object_t *dst[GLOBALS_SIZE], monkey_object_t *src[GLOBALS_SI
 {
 	for (size_t i = 0; i < GLOBALS_SIZE; i++) {
 		if (dst[i] != NULL)
-			free_monkey_object(dst[i]);
+			release_monkey_object(dst[i]);
 		if (src[i] == NULL)
 			return;
-		dst[i] = copy_monkey_object(src[i]);
+		dst[i] = retain_monkey_object(src[i]);
 	}
 }
 
 static void *
-_copy_monkey_object(void *obj)
+_retain_monkey_object(void *obj)
 {
-	return copy_monkey_object((monkey_object_t *) obj);
+	return retain_monkey_object((monkey_object_t *) obj);
 }
 
 static int
@@ -201,7 +265,7 @@ repl(void)
 	compiler_t *compiler = NULL;
 	bytecode_t *bytecode = NULL;
 	monkey_object_t *globals[GLOBALS_SIZE] = {NULL};
-	cm_array_list *constants = cm_array_list_init(16, free_monkey_object);
+	cm_array_list *constants = cm_array_list_init(16, release_monkey_object);
 	symbol_table_t *symbol_table = symbol_table_init();
 	for (size_t i = 0; i < get_builtins_count(); i++) {
 		char *builtin_name = (char *) get_builtins_name(i);
@@ -252,6 +316,7 @@ repl(void)
 
 		bytecode = get_bytecode(compiler);
 		machine = vm_init_with_state(bytecode, globals);
+		machine->jit_threshold = jit_threshold;
 		vm_error_t vm_err = vm_run(machine);
 		if (vm_err.code != VM_ERROR_NONE) {
 			printf("VM error: %s\n", vm_err.msg);
@@ -260,10 +325,10 @@ repl(void)
 		}
 		monkey_object_t *top = vm_last_popped_stack_elem(machine);
 		if (top != NULL) {
-			char *s = top->inspect(top);
+			char *s = inspect(top);
 			printf("%s\n", s);
 			free(s);
-			free_monkey_object(top);
+			release_monkey_object(top);
 		}
 
 CONTINUE:
@@ -277,7 +342,7 @@ CONTINUE:
 			free_symbol_table(symbol_table);
 			cm_array_list_free(constants);
 			symbol_table = symbol_table_copy(compiler->symbol_table);
-			constants = cm_array_list_copy(compiler->constants_pool, _copy_monkey_object);
+			constants = cm_array_list_copy(compiler->constants_pool, _retain_monkey_object);
 			compiler_free(compiler);
 		}
 		if (machine) {
@@ -312,7 +377,7 @@ CONTINUE:
 	for (size_t i = 0; i < GLOBALS_SIZE; i++) {
 		if (globals[i] == NULL)
 			break;
-		free_monkey_object(globals[i]);
+		release_monkey_object(globals[i]);
 	}
 	return 0;
 }
@@ -320,9 +385,50 @@ CONTINUE:
 int
 main(int argc, char **argv)
 {
-	if (argc == 1)
+	engine_t engine = ENGINE_STACK;
+	_Bool perf_map = false;
+	while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+		if (strncmp(argv[1], "--engine=", 9) == 0) {
+			if (strcmp(argv[1] + 9, "reg") == 0)
+				engine = ENGINE_REGISTER;
+			else if (strcmp(argv[1] + 9, "stack") != 0)
+				errx(EXIT_FAILURE, "Unknown engine %s", argv[1] + 9);
+		} else if (strcmp(argv[1], "--jit") == 0) {
+#ifdef VM_JIT
+			jit_threshold = JIT_CALL_THRESHOLD;
+#else
+			warnx("The JIT is not supported on this platform, ignoring --jit");
+#endif
+		} else if (strcmp(argv[1], "--perf-map") == 0) {
+#ifdef VM_JIT
+			perf_map = true;
+#else
+			warnx("The JIT is not supported on this platform, ignoring --perf-map");
+#endif
+		} else if (strcmp(argv[1], "--region") == 0) {
+			region_mode = REGION_PAGES;
+		} else if (strcmp(argv[1], "--region=huge") == 0) {
+			region_mode = REGION_HUGE_PAGES;
+		} else {
+			errx(EXIT_FAILURE, "Unknown option %s", argv[1]);
+		}
+		argc--;
+		argv++;
+	}
+	if (jit_threshold != 0 && engine != ENGINE_STACK)
+		errx(EXIT_FAILURE, "--jit is only supported with the stack engine");
+	if (perf_map && jit_threshold == 0)
+		errx(EXIT_FAILURE, "--perf-map is only supported with --jit");
+	if (perf_map)
+		jit_enable_perf_map();
+	if (region_mode != REGION_NONE && engine != ENGINE_STACK)
+		errx(EXIT_FAILURE, "--region is only supported with the stack engine");
+	if (argc == 1) {
+		if (engine != ENGINE_STACK)
+			errx(EXIT_FAILURE, "The repl only supports the stack engine");
 		return repl();
+	}
 	if (argc == 2)
-		return execute_file(argv[1]);
+		return execute_file(argv[1], engine);
 	errx(EXIT_FAILURE, "Unsupported numberof arguments %d", argc);
 }